@@ -0,0 +1,70 @@
+#include "bench.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    struct ENTRY
+    {
+        const char* name;
+        BENCH::CASE function;
+    };
+
+    std::vector<ENTRY>& Cases()
+    {
+        static std::vector<ENTRY> cases;
+        return cases;
+    }
+}
+
+int BENCH::Register(const char* name, CASE function)
+{
+    Cases().push_back({name, function});
+    return static_cast<int>(Cases().size());
+}
+
+int BENCH::RunAll(const char* filter)
+{
+    int ran = 0;
+    for (const ENTRY& entry : Cases())
+    {
+        if (filter && *filter && !std::strstr(entry.name, filter)) { continue; }
+        entry.function();
+        ran++;
+    }
+    if (ran == 0)
+    {
+        std::wcout << "No benchmark matches the filter" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void BENCH::Report(const char* case_name, const char* metric, double value, const char* unit)
+{
+    std::wcout << "BENCH " << case_name << " " << metric << " " << value << " " << unit << std::endl;
+}
+
+double BENCH::NowNs()
+{
+    using namespace std::chrono;
+    return static_cast<double>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+GUI& BENCH::Window()
+{
+    static GUI* gui = []
+    {
+        QUIET quiet;
+        GUI* window = new GUI;
+        window->CreateMainWindow(341, 399, L"Jordans winapi demo");
+        return window;
+    }();
+    return *gui;
+}
+
+BENCH::QUIET::QUIET() : previous(std::wcout.rdbuf(nullptr)) {}
+
+BENCH::QUIET::~QUIET() { std::wcout.rdbuf(previous); }
@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include "../gui.h"
+#include <streambuf>
+
+/*
+Small benchmark harness for the headless build.
+Every file in this folder registers its cases with BENCH_CASE, main.cpp runs them.
+Results are printed one per line as "BENCH <case> <metric> <value> <unit>" so CI can grep them.
+*/
+class BENCH
+{
+public:
+
+    typedef void (*CASE)();
+
+    // Registers a case. Returns a dummy value so it can be called from a static initializer
+    static int Register(const char* name, CASE function);
+
+    // Runs every case whose name contains filter. An empty filter runs everything
+    static int RunAll(const char* filter);
+
+    static void Report(const char* case_name, const char* metric, double value, const char* unit);
+
+    // Monotonic time in nanoseconds
+    static double NowNs();
+
+    // Main window shared by all cases. Created on first use with the same settings as main.cpp
+    static GUI& Window();
+
+    // Silences std::wcout while it is alive so console output does not end up in the measurements
+    class QUIET
+    {
+    public:
+        QUIET();
+        ~QUIET();
+    private:
+        std::wstreambuf* previous;
+    };
+};
+
+#define BENCH_CASE(name) \
+    static void name(); \
+    [[maybe_unused]] static const int name##_registration = BENCH::Register(#name, name); \
+    static void name()
+
+#endif // BENCH_H
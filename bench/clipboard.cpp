@@ -0,0 +1,222 @@
+#include "bench.h"
+#include "../clipboard.h"
+#include "../utf.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Clipboard with delayed rendering against the headless stand-in clipboard.
+"publish" is what the UI thread pays on "Clipboard Test", "paste" is what a consumer pays on the first GetClipboardData.
+The history add runs on workers like in the GUI, "in_history" is how long after publishing the text could be recalled.
+*/
+
+namespace
+{
+    WORKER_POOL     bench_workers;
+    CLIPBOARD       bench_clipboard;
+    std::thread::id render_thread;   // of the last WM_RENDERFORMAT
+
+    // Minimal clipboard owner window that forwards the render messages like GUI does
+    LRESULT CALLBACK OwnerProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_RENDERFORMAT:     render_thread = std::this_thread::get_id(); return bench_clipboard.renderFormat((UINT)wParam);
+            case WM_RENDERALLFORMATS: return bench_clipboard.renderAllFormats(hWnd);
+            case WM_DESTROYCLIPBOARD: return bench_clipboard.destroyClipboard();
+        }
+        return DefWindowProc(hWnd, uMsg, wParam, lParam);
+    }
+
+    HWND Owner()
+    {
+        static HWND owner = []
+        {
+            WNDCLASS wc      = {};
+            wc.lpfnWndProc   = OwnerProc;
+            wc.lpszClassName = L"BenchClipboardOwner";
+            RegisterClass(&wc);
+            bench_clipboard.setWorkers(&bench_workers);
+            return CreateWindowEx(0, wc.lpszClassName, L"", 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        }();
+        return owner;
+    }
+
+    // Waits until the history got adds more texts than before, in ms since start
+    double WaitForHistory(size_t before, size_t adds, double start)
+    {
+        while (bench_clipboard.getHistoryStats().adds < before + adds) { std::this_thread::yield(); }
+        bench_workers.RunCompletions();
+        return (BENCH::NowNs() - start) / 1e6;
+    }
+}
+
+BENCH_CASE(clipboard_delayed_render)
+{
+    std::vector<size_t> sizes = {10, size_t(1) << 20, size_t(64) << 20};
+    if (std::getenv("BENCH_LARGE")) { sizes.push_back(size_t(500) << 20); } // 500 MB needs a few GB of memory
+
+    for (size_t bytes : sizes)
+    {
+        std::string name = "clipboard_delayed_render_" + std::to_string(bytes);
+        size_t characters = bytes / sizeof(WCHAR);
+
+        // Source side, e.g. reading stdin. Not part of the UI thread latency
+        double start = BENCH::NowNs();
+        auto payload = std::make_shared<PAYLOAD>();
+        {
+            std::vector<WCHAR> block(std::min(characters, PAYLOAD::CHUNK_CHARS), L'x');
+            for (size_t filled = 0; filled < characters; filled += block.size())
+            {
+                payload->Append(block.data(), std::min(block.size(), characters - filled));
+            }
+        }
+        BENCH::Report(name.c_str(), "fill", (BENCH::NowNs() - start) / 1e6, "ms");
+
+        // UI thread: announce the formats
+        const size_t adds = bench_clipboard.getHistoryStats().adds;
+        start = BENCH::NowNs();
+        {
+            BENCH::QUIET quiet;
+            bench_clipboard.setClipboardToPayload(Owner(), std::move(payload));
+        }
+        BENCH::Report(name.c_str(), "publish", (BENCH::NowNs() - start) / 1e6, "ms");
+        BENCH::Report(name.c_str(), "in_history", WaitForHistory(adds, 1, start), "ms");
+
+        // Consumer: first paste renders the data
+        start = BENCH::NowNs();
+        OpenClipboard(NULL);
+        HANDLE hMem = GetClipboardData(CF_UNICODETEXT);
+        size_t rendered = hMem ? GlobalSize((HGLOBAL)hMem) : 0;
+        CloseClipboard();
+        BENCH::Report(name.c_str(), "paste", (BENCH::NowNs() - start) / 1e6, "ms");
+        if (rendered != (characters + 1) * sizeof(WCHAR)) { BENCH::Report(name.c_str(), "render_size_mismatch", (double)rendered, "bytes"); }
+    }
+
+    // Release the last payload and its rendered copy
+    OpenClipboard(NULL);
+    EmptyClipboard();
+    CloseClipboard();
+}
+
+BENCH_CASE(clipboard_edit_transfer)
+{
+    // "Clipboard Test" clicks: edit control -> payload -> clipboard -> paste, over and over with changing text
+    constexpr int transfers = 100000;
+    HWND edit = CreateWindowEx(0, L"edit", L"", WS_CHILD, 0, 0, 100, 20, Owner(), NULL, NULL, NULL);
+    std::wstring text(200, L'x');
+
+    const size_t       adds            = bench_clipboard.getHistoryStats().adds;
+    BUFFER_POOL::STATS pool_before     = bench_clipboard.getPoolStats();
+    HEADLESS::STATS    headless_before = HEADLESS::GetStats();
+    double start = BENCH::NowNs();
+    {
+        BENCH::QUIET quiet;
+        for (int i = 0; i < transfers; i++)
+        {
+            text[i % text.size()] = L'a' + (i % 26);
+            SetWindowText(edit, text.c_str());
+            bench_clipboard.setClipboardToWindowText(Owner(), edit);
+            OpenClipboard(NULL);
+            GetClipboardData(CF_UNICODETEXT);
+            CloseClipboard();
+        }
+    }
+    double ns = (BENCH::NowNs() - start) / transfers;
+    WaitForHistory(adds, transfers, start);
+    BUFFER_POOL::STATS pool_after     = bench_clipboard.getPoolStats();
+    HEADLESS::STATS    headless_after = HEADLESS::GetStats();
+
+    BENCH::Report("clipboard_edit_transfer", "latency", ns / 1e3, "us/click");
+    BENCH::Report("clipboard_edit_transfer", "heap_allocations", (double)(pool_after.heap_allocations - pool_before.heap_allocations), "buffers");
+    BENCH::Report("clipboard_edit_transfer", "pool_reuses", (double)(pool_after.reuses - pool_before.reuses), "buffers");
+    BENCH::Report("clipboard_edit_transfer", "global_allocs_alive", (double)headless_after.global_allocs_alive - (double)headless_before.global_allocs_alive, "blocks");
+    BENCH::Report("clipboard_edit_transfer", "virtual_allocs_alive", (double)headless_after.virtual_allocs_alive - (double)headless_before.virtual_allocs_alive, "blocks");
+
+    DestroyWindow(edit);
+    OpenClipboard(NULL);
+    EmptyClipboard();
+    CloseClipboard();
+}
+
+BENCH_CASE(clipboard_formats)
+{
+    // 4 MB of UTF-8 from stdin, published once and pasted in all three formats
+    std::string utf8;
+    while (utf8.size() < (size_t(4) << 20)) { utf8 += "Gr\xC3\xBC\xC3\x9F" "e aus K\xC3\xB6ln, \xE6\x9D\xB1\xE4\xBA\xAC \xF0\x9F\x98\x80\n"; }
+
+    double start = BENCH::NowNs();
+    {
+        BENCH::QUIET quiet;
+        bench_clipboard.setClipboardToUtf8(Owner(), utf8.data(), utf8.size());
+    }
+    BENCH::Report("clipboard_formats", "publish", (BENCH::NowNs() - start) / 1e6, "ms");
+
+    const std::pair<const char*, UINT> formats[] = {{"paste_unicode", CF_UNICODETEXT}, {"paste_text", CF_TEXT}, {"paste_utf8", CLIPBOARD::utf8Format()}};
+    OpenClipboard(NULL);
+    for (auto [metric, format] : formats)
+    {
+        start = BENCH::NowNs();
+        HANDLE hMem = GetClipboardData(format);
+        BENCH::Report("clipboard_formats", metric, (BENCH::NowNs() - start) / 1e6, "ms");
+
+        // The UTF-8 copy has to come out exactly as it went in
+        if (format == CLIPBOARD::utf8Format())
+        {
+            const char* text = hMem ? (const char*)GlobalLock((HGLOBAL)hMem) : nullptr;
+            bool same = text && GlobalSize((HGLOBAL)hMem) == utf8.size() + 1 && utf8.compare(0, utf8.size(), text, utf8.size()) == 0;
+            if (text) { GlobalUnlock((HGLOBAL)hMem); }
+            BENCH::Report("clipboard_formats", "utf8_round_trip", same ? 1 : 0, "ok");
+        }
+    }
+    EmptyClipboard();
+    CloseClipboard();
+}
+
+BENCH_CASE(clipboard_cross_thread_paste)
+{
+    // Another program pastes while the owner window waits in its message loop. The render runs on the owner thread like on windows
+    constexpr int PASTES = 1000;
+    const std::wstring text(1000, L'x');
+    auto payload = std::make_shared<PAYLOAD>();
+    payload->Append(text.data(), text.size());
+    {
+        BENCH::QUIET quiet;
+        bench_clipboard.setClipboardToPayload(Owner(), std::move(payload));
+    }
+    bench_workers.RunCompletions();
+
+    int    intact   = 0;
+    double paste_ns = 0;
+    std::thread consumer([&]
+    {
+        for (int paste = 0; paste < PASTES; paste++)
+        {
+            while (!OpenClipboard(NULL)) { std::this_thread::yield(); }
+            double start = BENCH::NowNs();
+            HANDLE hMem = GetClipboardData(CF_UNICODETEXT);
+            paste_ns += BENCH::NowNs() - start;
+            if (hMem && GlobalSize((HGLOBAL)hMem) == (text.size() + 1) * sizeof(WCHAR)) { intact++; }
+
+            // Back to delayed rendering for the next paste, the owner announces the formats again
+            SetClipboardData(CF_UNICODETEXT, NULL);
+            CloseClipboard();
+        }
+
+        // The owner hears about it on its own thread too
+        OpenClipboard(NULL);
+        EmptyClipboard();
+        CloseClipboard();
+        PostMessage(Owner(), WM_QUIT, 0, 0);
+    });
+    MSG msg;
+    while (GetMessage(&msg, NULL, 0, 0)) { DispatchMessage(&msg); }
+    consumer.join();
+
+    BENCH::Report("clipboard_cross_thread_paste", "paste", paste_ns / PASTES / 1e3, "us");
+    BENCH::Report("clipboard_cross_thread_paste", "intact", intact == PASTES ? 1 : 0, "ok");
+    BENCH::Report("clipboard_cross_thread_paste", "rendered_on_owner", render_thread == std::this_thread::get_id() ? 1 : 0, "ok");
+}
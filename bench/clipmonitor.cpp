@@ -0,0 +1,110 @@
+#include "bench.h"
+#include "../histogram.h"
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/*
+Another program edits a big text and copies it as fast as it can, the main window follows through WM_CLIPBOARDUPDATE.
+"latency" is from the CloseClipboard of the writer to the end of the monitor handler for that copy, queueing and diffing included.
+Under churn most notifications find a sequence number that was already read and are skipped.
+*/
+
+namespace
+{
+    // Writer side: a second "program" with its own window and thread
+    HWND WriterWindow()
+    {
+        WNDCLASS wc      = {};
+        wc.lpfnWndProc   = DefWindowProc;
+        wc.lpszClassName = L"BenchClipboardWriter";
+        RegisterClass(&wc);
+        return CreateWindowEx(0, wc.lpszClassName, L"", 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+
+    // Leaves the clipboard open, the caller closes it
+    void Copy(HWND owner, const std::wstring& text, DWORD* sequence)
+    {
+        while (!OpenClipboard(owner)) { std::this_thread::yield(); } // the monitor is reading
+        EmptyClipboard();
+        HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, (text.size() + 1) * sizeof(WCHAR));
+        std::memcpy(GlobalLock(hMem), text.c_str(), (text.size() + 1) * sizeof(WCHAR));
+        GlobalUnlock(hMem);
+        SetClipboardData(CF_UNICODETEXT, hMem);
+        *sequence = GetClipboardSequenceNumber();
+    }
+}
+
+BENCH_CASE(clipboard_monitor_churn)
+{
+    constexpr size_t TEXT_CHARS = size_t(1) << 20;
+    constexpr int    COPIES     = 2000;
+
+    GUI& gui = BENCH::Window();
+    HWND hWnd = gui.GetWindowHandle();
+    CLIPBOARD_MONITOR& monitor = gui.GetClipboardMonitor();
+
+    std::mutex mutex;
+    std::unordered_map<DWORD, double> published; // sequence -> CloseClipboard time
+    HISTOGRAM latency;
+    double changed_fraction = 0;
+    monitor.ResetStats();
+    monitor.SetHandler([&](const CLIPBOARD_MONITOR::CHANGE& change)
+    {
+        double now = BENCH::NowNs();
+        changed_fraction += double(change.changed_chars) / double(change.length);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = published.find(change.sequence);
+        if (it != published.end()) { latency.Record(static_cast<uint64_t>(now - it->second)); }
+    });
+
+    std::thread writer([&]
+    {
+        HWND owner = WriterWindow();
+        // Random words and lines
+        RANDOM random;
+        random.Seed(17);
+        std::wstring text;
+        while (text.size() < TEXT_CHARS)
+        {
+            for (uint64_t letters = random.Between(1, 10); letters > 0; letters--) { text += static_cast<wchar_t>(L'a' + random.Between(0, 25)); }
+            text += random.Between(0, 11) ? L' ' : L'\n';
+        }
+
+        for (int copy = 0; copy < COPIES; copy++)
+        {
+            // An edit somewhere: a few characters typed or deleted
+            size_t at = random.Between(0, text.size() - 100);
+            if (copy % 2) { text.insert(at, L"edited"); } else { text.erase(at, 6); }
+
+            DWORD sequence;
+            Copy(owner, text, &sequence);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                published[sequence] = BENCH::NowNs();
+            }
+            CloseClipboard();
+        }
+        // Behind the last notification in the queue
+        PostMessage(hWnd, WM_QUIT, 0, 0);
+        DestroyWindow(owner);
+    });
+    gui.RunMainLoop();
+    writer.join();
+
+    CLIPBOARD_MONITOR::STATS stats = monitor.GetStats();
+    BENCH::Report("clipboard_monitor_churn", "notifications", (double)stats.notifications, "msgs");
+    BENCH::Report("clipboard_monitor_churn", "skipped", (double)stats.skipped, "msgs");
+    BENCH::Report("clipboard_monitor_churn", "open_failures", (double)stats.open_failures, "msgs");
+    BENCH::Report("clipboard_monitor_churn", "retries", (double)stats.retries, "reads");
+    BENCH::Report("clipboard_monitor_churn", "reads", (double)stats.reads, "texts");
+    BENCH::Report("clipboard_monitor_churn", "latency_p50", (double)latency.Percentile(50) / 1e3, "us");
+    BENCH::Report("clipboard_monitor_churn", "latency_p99", (double)latency.Percentile(99) / 1e3, "us");
+    BENCH::Report("clipboard_monitor_churn", "chunks_changed", stats.chunks ? 100.0 * stats.chunks_changed / stats.chunks : 0, "%");
+    BENCH::Report("clipboard_monitor_churn", "chars_changed", stats.reads ? 100.0 * changed_fraction / stats.reads : 0, "%");
+
+    // Back to logging, like GUI sets it up
+    monitor.SetHandler(nullptr);
+}
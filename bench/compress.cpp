@@ -0,0 +1,239 @@
+#include "bench.h"
+#include "../clipboard.h"
+#include "../lz.h"
+#include "../random.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Compressed clipboard payloads: a log dump published through CLIPBOARD::setClipboardToUtf8 with and without compression.
+Compression runs on workers like in the GUI: "publish" is what the UI thread pays, "swapped" is how long until the compressed copy replaced the published text.
+ratio is the memory the text takes on the clipboard against the compressed blocks, paste is the first GetClipboardData of a format, which decompresses the whole text.
+"decompress" is PAYLOAD::CopyTo alone, chunk by chunk on one thread (READER) and on the workers and the calling thread, in GB/s of UTF-16/32 text.
+"lz_blocks" checks LZ itself: round trips of log text and random bytes, then truncated and corrupted blocks, which must be rejected without writing past the output.
+*/
+
+namespace
+{
+    WORKER_POOL bench_workers;
+    CLIPBOARD   bench_clipboard;
+
+    // Minimal clipboard owner window that forwards the render messages like GUI does
+    LRESULT CALLBACK OwnerProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_RENDERFORMAT:     return bench_clipboard.renderFormat((UINT)wParam);
+            case WM_RENDERALLFORMATS: return bench_clipboard.renderAllFormats(hWnd);
+            case WM_DESTROYCLIPBOARD: return bench_clipboard.destroyClipboard();
+        }
+        return DefWindowProc(hWnd, uMsg, wParam, lParam);
+    }
+
+    HWND Owner()
+    {
+        static HWND owner = []
+        {
+            WNDCLASS wc      = {};
+            wc.lpfnWndProc   = OwnerProc;
+            wc.lpszClassName = L"BenchCompressOwner";
+            RegisterClass(&wc);
+            bench_clipboard.setWorkers(&bench_workers);
+            return CreateWindowEx(0, wc.lpszClassName, L"", 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        }();
+        return owner;
+    }
+
+    // Log lines with the odd non ASCII character, like bench/stream.cpp
+    std::string LogDump(size_t bytes)
+    {
+        std::string text;
+        text.reserve(bytes + 128);
+        for (size_t line = 0; text.size() < bytes; line++)
+        {
+            text += "2024-05-01 12:00:" + std::to_string(line % 60) + " INFO  request " + std::to_string(line * 7919 % 100000);
+            text += line % 10 ? " handled in 3 ms\n" : " handled for café Zürich → ok\n";
+        }
+        text.resize(bytes);
+        return text;
+    }
+
+    // First paste of format, in ms
+    double Paste(UINT format)
+    {
+        double start = BENCH::NowNs();
+        OpenClipboard(NULL);
+        GetClipboardData(format);
+        CloseClipboard();
+        return (BENCH::NowNs() - start) / 1e6;
+    }
+}
+
+BENCH_CASE(clipboard_compressed)
+{
+    const size_t bytes = std::getenv("BENCH_LARGE") ? size_t(512) << 20 : size_t(64) << 20;
+    const std::string dump = LogDump(bytes);
+
+    for (bool compressed : {false, true})
+    {
+        const char* name = compressed ? "clipboard_compressed" : "clipboard_uncompressed";
+        bench_clipboard.setCompression(compressed ? 1 : 0);
+        const size_t completed = bench_workers.GetStats().completed;
+        double start = BENCH::NowNs();
+        {
+            BENCH::QUIET quiet;
+            bench_clipboard.setClipboardToUtf8(Owner(), dump.data(), dump.size());
+        }
+        BENCH::Report(name, "publish", (BENCH::NowNs() - start) / 1e6, "ms");
+
+        // The done function of the worker swaps the compressed copy in. Nothing else runs until then, the worker would share the core with it
+        while (bench_workers.GetStats().completed == completed)
+        {
+            BENCH::QUIET quiet;
+            bench_workers.RunCompletions();
+            std::this_thread::yield();
+        }
+        if (compressed) { BENCH::Report(name, "swapped", (BENCH::NowNs() - start) / 1e6, "ms"); }
+        BENCH::Report(name, "paste_unicode", Paste(CF_UNICODETEXT), "ms");
+        BENCH::Report(name, "paste_utf8", Paste(CLIPBOARD::utf8Format()), "ms");
+    }
+
+    const CLIPBOARD::COMPRESSION_STATS stats = bench_clipboard.getCompressionStats();
+    BENCH::Report("clipboard_compressed", "ratio", double(stats.raw_bytes) / double(stats.stored_bytes), "x");
+    BENCH::Report("clipboard_compressed", "stored", stats.stored_bytes / 1e6, "MB");
+    BENCH::Report("clipboard_compressed", "compress", double(stats.raw_bytes) / double(stats.compress_ns), "GB/s");
+    BENCH::Report("clipboard_compressed", "render", double(stats.decompressed_bytes) / double(stats.decompress_ns), "GB/s");
+
+    // Release the last payload before the next case
+    bench_clipboard.setCompression(0);
+    OpenClipboard(Owner());
+    EmptyClipboard();
+    CloseClipboard();
+}
+
+BENCH_CASE(payload_decompress)
+{
+    constexpr int ROUNDS = 5;
+    const std::string dump = LogDump(size_t(64) << 20);
+    PAYLOAD payload;
+    payload.AppendUtf8(dump.data(), dump.size());
+    const size_t raw_bytes = payload.Length() * sizeof(WCHAR);
+    const std::shared_ptr<const PAYLOAD> copy = payload.Compressed();
+    payload.Compress();
+    std::vector<WCHAR> text(payload.Length());
+
+    double start = BENCH::NowNs();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        PAYLOAD::READER reader(payload);
+        WCHAR* out = text.data();
+        for (size_t i = 0; i < payload.ChunkCount(); i++)
+        {
+            size_t length;
+            const WCHAR* chunk = reader.Chunk(i, &length);
+            out = std::copy(chunk, chunk + length, out);
+        }
+    }
+    double reader_ns = (BENCH::NowNs() - start) / ROUNDS;
+
+    start = BENCH::NowNs();
+    bool intact = true;
+    for (int round = 0; round < ROUNDS; round++) { intact = payload.CopyTo(text.data(), &bench_workers) && intact; }
+    double copy_ns = (BENCH::NowNs() - start) / ROUNDS;
+
+    BENCH::Report("payload_decompress", "ratio", double(raw_bytes) / double(payload.StoredBytes()), "x");
+    BENCH::Report("payload_decompress", "reader", raw_bytes / reader_ns, "GB/s");
+    BENCH::Report("payload_decompress", "copy_to", raw_bytes / copy_ns, "GB/s");
+    BENCH::Report("payload_decompress", "threads", static_cast<double>(bench_workers.GetStats().threads + 1), "threads");
+    BENCH::Report("payload_decompress", "copy_intact", intact ? 1 : 0, "ok");
+
+    // Compressed() of the text leaves it as it is and has to give the same blocks as compressing it in place
+    bool same = copy->ChunkCount() == payload.ChunkCount();
+    for (size_t i = 0; i < payload.ChunkCount() && same; i++)
+    {
+        size_t bytes, copy_bytes;
+        const unsigned char* block = payload.Block(i, &bytes);
+        same = bytes == (copy->Block(i, &copy_bytes), copy_bytes) && std::equal(block, block + bytes, copy->Block(i, &copy_bytes));
+    }
+    BENCH::Report("payload_decompress", "copy_same_blocks", same ? 1 : 0, "ok");
+
+    // A zeroed block is no valid block (offset 0), CopyTo and READER have to say so
+    size_t block_bytes;
+    unsigned char* damaged = const_cast<unsigned char*>(copy->Block(copy->ChunkCount() / 2, &block_bytes));
+    std::memset(damaged, 0, block_bytes);
+    size_t length;
+    bool rejected;
+    {
+        BENCH::QUIET quiet;
+        rejected = !copy->CopyTo(text.data(), &bench_workers) && !PAYLOAD::READER(*copy).Chunk(copy->ChunkCount() / 2, &length);
+    }
+    BENCH::Report("payload_decompress", "damaged_rejected", rejected ? 1 : 0, "ok");
+}
+
+BENCH_CASE(lz_blocks)
+{
+    constexpr size_t         SOURCE = size_t(1) << 20;
+    constexpr int            ROUNDS = 2000;
+    static constexpr size_t  GUARD  = 64;
+    static constexpr uint8_t CANARY = 0xCD;
+    RANDOM random(22);
+    const std::string log = LogDump(SOURCE);
+    std::vector<uint8_t> noise(SOURCE);
+    for (uint8_t& byte : noise) { byte = static_cast<uint8_t>(random.Next()); }
+
+    // Decompresses into exactly capacity bytes followed by a canary. False if anything was written behind capacity
+    std::vector<uint8_t> out;
+    auto decompress = [&out](const std::vector<uint8_t>& block, size_t block_bytes, size_t capacity, size_t* result)
+    {
+        out.assign(capacity + GUARD, CANARY);
+        *result = LZ::Decompress(block.data(), block_bytes, out.data(), capacity);
+        return std::all_of(out.begin() + capacity, out.end(), [](uint8_t byte) { return byte == CANARY; });
+    };
+
+    size_t failures = 0, overruns = 0, truncated_accepted = 0, short_accepted = 0, corrupt_wrong_size = 0;
+    std::vector<uint8_t> block;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        // Small blocks cover the cases without any match, larger ones many sequences and long lengths
+        const bool     text   = round % 2 == 0;
+        const size_t   bytes  = random.Next() % (round < ROUNDS / 2 ? 48 : 65536);
+        const uint8_t* source = (text ? reinterpret_cast<const uint8_t*>(log.data()) : noise.data()) + random.Next() % (SOURCE - bytes);
+
+        block.assign(LZ::Bound(bytes), 0);
+        const size_t block_bytes = LZ::Compress(source, bytes, block.data(), block.size());
+        size_t result;
+        overruns += !decompress(block, block_bytes, bytes, &result);
+        if (!block_bytes || result != bytes || !std::equal(source, source + bytes, out.begin())) { failures++; continue; }
+
+        // Every cut of the small blocks, a few of the large ones. None may give the whole text
+        for (int cut = 0; cut < 8; cut++)
+        {
+            const size_t shorter = bytes < 48 ? (cut < static_cast<int>(block_bytes) ? cut : block_bytes - 1) : random.Next() % block_bytes;
+            overruns += !decompress(block, shorter, bytes, &result);
+            truncated_accepted += result == bytes;
+        }
+        if (bytes)
+        {
+            overruns += !decompress(block, block_bytes, bytes - 1, &result);
+            short_accepted += result != SIZE_MAX;
+        }
+
+        // Flipped bytes may still be a valid block, but never one that claims more than fits
+        for (int flip = 0; flip < 4 && block_bytes; flip++)
+        {
+            std::vector<uint8_t> corrupt = block;
+            corrupt[random.Next() % block_bytes] ^= static_cast<uint8_t>(1 + random.Next() % 255);
+            overruns += !decompress(corrupt, block_bytes, bytes, &result);
+            corrupt_wrong_size += result != SIZE_MAX && result > bytes;
+        }
+    }
+    BENCH::Report("lz_blocks", "round_trip_failures", static_cast<double>(failures), "blocks");
+    BENCH::Report("lz_blocks", "truncated_accepted", static_cast<double>(truncated_accepted), "blocks");
+    BENCH::Report("lz_blocks", "too_small_accepted", static_cast<double>(short_accepted), "blocks");
+    BENCH::Report("lz_blocks", "corrupt_too_large", static_cast<double>(corrupt_wrong_size), "blocks");
+    BENCH::Report("lz_blocks", "overruns", static_cast<double>(overruns), "blocks");
+}
@@ -0,0 +1,132 @@
+#include "bench.h"
+#include "../controls.h"
+#include "../gdicache.h"
+#include <string>
+#include <vector>
+
+/*
+"lookup": the handle of the edit control and the state of the checkbox of the main window, from the system (GetDlgItem, IsDlgButtonChecked) and from the CONTROLS tables.
+The system walks the children of the window under the headless lock, windows does a similar walk.
+"form": a form of 1,000 controls, the way the GUI::Add... functions built it (CreateWindow, a font from the GDI_CACHE and a redrawing WM_SETFONT per control)
+against CONTROLS::CreateAll from a descriptor table.
+*/
+
+namespace
+{
+    constexpr int LOOKUPS = 1000000;
+    constexpr int FORM    = 1000;
+    constexpr int FORMS   = 20;
+
+    HWND Parent()
+    {
+        static HWND parent = []
+        {
+            WNDCLASS wc      = {};
+            wc.lpfnWndProc   = DefWindowProc;
+            wc.lpszClassName = L"BenchControlsParent";
+            RegisterClass(&wc);
+            return CreateWindowEx(0, wc.lpszClassName, L"", WS_VISIBLE, 0, 0, 1280, 800, 0, 0, 0, 0);
+        }();
+        return parent;
+    }
+
+    // Rows of a button and a label, every 10th row a checkbox and an edit control with a smaller font
+    std::vector<CONTROLS::DESCRIPTOR> Form()
+    {
+        using KIND = CONTROLS::KIND;
+        std::vector<CONTROLS::DESCRIPTOR> form;
+        for (int i = 0; form.size() < FORM; i++)
+        {
+            bool small = i % 10 == 0;
+            form.push_back({small ? KIND::CHECKBOX : KIND::BUTTON, 100 + i, L"Button", 80, 45, small ? 14 : 15});
+            form.push_back({small ? KIND::EDIT : KIND::LABEL, CONTROLS::AUTO_ID, L"Description of the button", 225, 45, 15});
+        }
+        return form;
+    }
+
+    void Pump()
+    {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) { DispatchMessage(&msg); }
+    }
+}
+
+BENCH_CASE(control_lookup)
+{
+    GUI& gui = BENCH::Window();
+    HWND hWnd = gui.GetWindowHandle();
+    const CONTROLS& controls = gui.GetControls();
+
+    // Keeps the compiler from dropping the loops
+    volatile uintptr_t sink = 0;
+
+    double start = BENCH::NowNs();
+    for (int i = 0; i < LOOKUPS; i++) { sink = sink + reinterpret_cast<uintptr_t>(GetDlgItem(hWnd, ID_TEXT_EDIT)); }
+    double system_ns = BENCH::NowNs() - start;
+
+    start = BENCH::NowNs();
+    for (int i = 0; i < LOOKUPS; i++) { sink = sink + reinterpret_cast<uintptr_t>(controls.Handle(ID_TEXT_EDIT)); }
+    double registry_ns = BENCH::NowNs() - start;
+
+    start = BENCH::NowNs();
+    for (int i = 0; i < LOOKUPS; i++) { sink = sink + IsDlgButtonChecked(hWnd, ID_CHECKBOX); }
+    double system_check_ns = BENCH::NowNs() - start;
+
+    start = BENCH::NowNs();
+    for (int i = 0; i < LOOKUPS; i++) { sink = sink + controls.IsChecked(ID_CHECKBOX); }
+    double registry_check_ns = BENCH::NowNs() - start;
+
+    BENCH::Report("control_lookup", "GetDlgItem", system_ns / LOOKUPS, "ns");
+    BENCH::Report("control_lookup", "registry_handle", registry_ns / LOOKUPS, "ns");
+    BENCH::Report("control_lookup", "IsDlgButtonChecked", system_check_ns / LOOKUPS, "ns");
+    BENCH::Report("control_lookup", "registry_checked", registry_check_ns / LOOKUPS, "ns");
+}
+
+BENCH_CASE(control_form)
+{
+    const std::vector<CONTROLS::DESCRIPTOR> form = Form();
+    std::vector<HWND>  handles(form.size());
+    std::vector<HFONT> fonts(form.size());
+    std::vector<int>   ids(form.size());
+    HWND parent = Parent();
+
+    // What the GUI::Add... functions did per control
+    double one_by_one_ns = 0;
+    for (int round = 0; round < FORMS; round++)
+    {
+        double start = BENCH::NowNs();
+        int auto_id = 100 + FORM;
+        for (size_t i = 0; i < form.size(); i++)
+        {
+            const CONTROLS::DESCRIPTOR& control = form[i];
+            const wchar_t* class_name = control.kind == CONTROLS::KIND::LABEL ? L"static" : control.kind == CONTROLS::KIND::EDIT ? L"edit" : L"button";
+            int id = control.id == CONTROLS::AUTO_ID ? auto_id++ : control.id;
+            handles[i] = CreateWindow(class_name, control.text, WS_CHILD | WS_VISIBLE, 0, 0, control.width, control.height, parent, (HMENU)(INT_PTR)id, 0, 0);
+            fonts[i]   = GDI_CACHE::Shared().AcquireFont(L"ARIAL", control.font_size);
+            SendMessage(handles[i], WM_SETFONT, WPARAM(fonts[i]), TRUE);
+        }
+        Pump();
+        one_by_one_ns += BENCH::NowNs() - start;
+
+        for (HWND hWnd : handles) { DestroyWindow(hWnd); }
+        for (HFONT font : fonts) { GDI_CACHE::Shared().Release(font); }
+        Pump();
+    }
+
+    double descriptor_ns = 0;
+    for (int round = 0; round < FORMS; round++)
+    {
+        CONTROLS controls(100, 100 + FORM, L"ARIAL");
+        double start = BENCH::NowNs();
+        controls.CreateAll(parent, form.data(), form.size(), ids.data());
+        Pump();
+        descriptor_ns += BENCH::NowNs() - start;
+
+        for (int id : ids) { DestroyWindow(controls.Handle(id)); }
+        controls.Clear();
+        Pump();
+    }
+
+    BENCH::Report("control_form", "one_by_one", one_by_one_ns / FORMS / 1e3, "us/form");
+    BENCH::Report("control_form", "descriptor_table", descriptor_ns / FORMS / 1e3, "us/form");
+}
@@ -0,0 +1,184 @@
+#include "bench.h"
+#include "../dispatch.h"
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+Dispatch cost only: the old switch of GUI::MessageHandler/OnCommand against DISPATCH_TABLE.
+Both sides call the same counting stubs, so the difference is the routing itself. The table goes through DISPATCH_TABLE::Dispatch with WM_MOUSEMOVE first, like GUI.
+*/
+
+namespace
+{
+    class STUB
+    {
+    public:
+        LRESULT OnDestroy()                      { calls++; return 0; }
+        LRESULT OnSize(LPARAM lParam)            { calls += LOWORD(lParam) & 1; return 0; }
+        LRESULT OnCTLCOLORSTATIC(WPARAM wParam)  { calls += wParam & 1; return 0; }
+        LRESULT OnMousehover(HWND)               { calls++; return 0; }
+        LRESULT OnMousemove(HWND)                { calls++; return 0; }
+        LRESULT OnMouseleave(HWND)               { calls++; return 0; }
+        LRESULT OnButton(WPARAM wParam)          { calls += HIWORD(wParam) + 1; return 0; }
+
+        LRESULT OnCommandSwitch(HWND, WPARAM wParam)
+        {
+            switch (LOWORD(wParam))
+            {
+                case ID_TEST_BUTTON:         return OnButton(wParam);
+                case ID_CLIPBOARD_BUTTON:    return OnButton(wParam);
+                case ID_MESSAGEBOX_BUTTON:   return OnButton(wParam);
+                case ID_MOVE_MOUSE_BUTTON:   return OnButton(wParam);
+                case ID_FREE_CONSOLE_BUTTON: return OnButton(wParam);
+                case ID_CLEAR_TEXT_BUTTON:   return OnButton(wParam);
+            }
+            return 0;
+        }
+
+        LRESULT OnCommandTable(HWND hWnd, WPARAM wParam);
+
+        size_t calls = 0;
+    };
+
+    using COMMANDS = DISPATCH_TABLE<STUB, 256,
+        ON<ID_TEST_BUTTON,         &STUB::OnButton>,
+        ON<ID_CLIPBOARD_BUTTON,    &STUB::OnButton>,
+        ON<ID_MESSAGEBOX_BUTTON,   &STUB::OnButton>,
+        ON<ID_MOVE_MOUSE_BUTTON,   &STUB::OnButton>,
+        ON<ID_FREE_CONSOLE_BUTTON, &STUB::OnButton>,
+        ON<ID_CLEAR_TEXT_BUTTON,   &STUB::OnButton>>;
+
+    using MESSAGES = DISPATCH_TABLE<STUB, WM_USER,
+        ON<WM_MOUSEMOVE,      &STUB::OnMousemove>,
+        ON<WM_DESTROY,        &STUB::OnDestroy>,
+        ON<WM_COMMAND,        &STUB::OnCommandTable>,
+        ON<WM_SIZE,           &STUB::OnSize>,
+        ON<WM_CTLCOLORSTATIC, &STUB::OnCTLCOLORSTATIC>,
+        ON<WM_MOUSEHOVER,     &STUB::OnMousehover>,
+        ON<WM_MOUSELEAVE,     &STUB::OnMouseleave>>;
+
+    LRESULT STUB::OnCommandTable(HWND hWnd, WPARAM wParam)
+    {
+        LRESULT result;
+        if (COMMANDS::Dispatch(this, LOWORD(wParam), hWnd, WM_COMMAND, wParam, 0, &result)) { return result; }
+        return 0;
+    }
+
+    // Same shape as the switch GUI::MessageHandler had. Unhandled messages return 0 instead of calling DefWindowProc
+    LRESULT SwitchDispatch(STUB* stub, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_DESTROY:        return stub->OnDestroy();
+            case WM_COMMAND:        return stub->OnCommandSwitch(hWnd, wParam);
+            case WM_SIZE:           return stub->OnSize(lParam);
+            case WM_CTLCOLORSTATIC: return stub->OnCTLCOLORSTATIC(wParam);
+            case WM_MOUSEHOVER:     return stub->OnMousehover(hWnd);
+            case WM_MOUSELEAVE:     return stub->OnMouseleave(hWnd);
+            case WM_MOUSEMOVE:      return stub->OnMousemove(hWnd);
+        }
+        return 0;
+    }
+
+    LRESULT TableDispatch(STUB* stub, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        LRESULT result;
+        if (MESSAGES::Dispatch(stub, uMsg, hWnd, uMsg, wParam, lParam, &result)) { return result; }
+        return 0;
+    }
+
+    struct WEIGHTED
+    {
+        UINT   message;
+        WORD   control_id;
+        double weight;
+    };
+
+    // Builds a shuffled stream that follows the given mix
+    std::vector<MSG> MakeStream(size_t count, const std::vector<WEIGHTED>& mix)
+    {
+        std::mt19937 mt(42);
+        std::vector<double> weights;
+        for (const WEIGHTED& entry : mix) { weights.push_back(entry.weight); }
+        std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+        std::vector<MSG> stream(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const WEIGHTED& entry = mix[pick(mt)];
+            stream[i]         = {};
+            stream[i].message = entry.message;
+            stream[i].wParam  = MAKEWPARAM(entry.control_id, BN_CLICKED);
+            stream[i].lParam  = MAKELPARAM(i % 300, i % 350);
+        }
+        return stream;
+    }
+
+    template<class F>
+    double NsPerMessage(const std::vector<MSG>& stream, F dispatch)
+    {
+        constexpr int rounds = 20;
+        STUB stub;
+        LRESULT sink = 0;
+        double start = BENCH::NowNs();
+        for (int round = 0; round < rounds; round++)
+        {
+            for (const MSG& msg : stream) { sink += dispatch(&stub, msg.hwnd, msg.message, msg.wParam, msg.lParam); }
+        }
+        double ns = (BENCH::NowNs() - start) / (static_cast<double>(stream.size()) * rounds);
+        // Keeps the compiler from dropping the loop
+        volatile size_t keep = static_cast<size_t>(sink) + stub.calls;
+        (void)keep;
+        return ns;
+    }
+
+    void Compare(const char* mix_name, const std::vector<WEIGHTED>& mix)
+    {
+        std::vector<MSG> stream = MakeStream(1 << 16, mix);
+        std::string name = std::string("dispatch_") + mix_name;
+        BENCH::Report(name.c_str(), "switch", NsPerMessage(stream, SwitchDispatch), "ns/msg");
+        BENCH::Report(name.c_str(), "table", NsPerMessage(stream, TableDispatch), "ns/msg");
+    }
+
+    // Messages the window gets but does not handle
+    constexpr UINT WM_SETCURSOR_ID   = 0x0020;
+    constexpr UINT WM_NCHITTEST_ID   = 0x0084;
+    constexpr UINT WM_NCMOUSEMOVE_ID = 0x00A0;
+}
+
+BENCH_CASE(dispatch_mouse_flood)
+{
+    Compare("mouse_flood", {
+        {WM_MOUSEMOVE,      0, 90},
+        {WM_NCHITTEST_ID,   0, 4},
+        {WM_SETCURSOR_ID,   0, 4},
+        {WM_MOUSEHOVER,     0, 1},
+        {WM_MOUSELEAVE,     0, 1},
+    });
+}
+
+BENCH_CASE(dispatch_command_burst)
+{
+    Compare("command_burst", {
+        {WM_COMMAND, ID_CLIPBOARD_BUTTON,    30},
+        {WM_COMMAND, ID_CLEAR_TEXT_BUTTON,   30},
+        {WM_COMMAND, ID_MOVE_MOUSE_BUTTON,   20},
+        {WM_COMMAND, ID_TEST_BUTTON,         10},
+        {WM_COMMAND, ID_FIRST_AUTO,          5},
+        {WM_CTLCOLORSTATIC, 0,               5},
+    });
+}
+
+BENCH_CASE(dispatch_mixed)
+{
+    Compare("mixed", {
+        {WM_MOUSEMOVE,       0, 40},
+        {WM_NCMOUSEMOVE_ID,  0, 10},
+        {WM_NCHITTEST_ID,    0, 10},
+        {WM_CTLCOLORSTATIC,  0, 15},
+        {WM_SIZE,            0, 10},
+        {WM_COMMAND, ID_CLEAR_TEXT_BUTTON, 10},
+        {WM_APP + 1,         0, 5},
+    });
+}
@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "../gdicache.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+Building a screen with a lot of controls: a CreateFont per control (what GUI::SetFont did) against fonts from GDI_CACHE.
+*/
+
+namespace
+{
+    constexpr int CONTROLS = 500;
+    constexpr int SCREENS  = 20;
+
+    HWND Parent()
+    {
+        static HWND parent = []
+        {
+            WNDCLASS wc      = {};
+            wc.lpfnWndProc   = DefWindowProc;
+            wc.lpszClassName = L"BenchGdiParent";
+            RegisterClass(&wc);
+            return CreateWindowEx(0, wc.lpszClassName, L"", 0, 0, 0, 800, 600, 0, 0, 0, 0);
+        }();
+        return parent;
+    }
+
+    // Same mix as the main window: mostly the default size, a few smaller buttons
+    int FontSize(int control) { return control % 10 == 0 ? 14 : 15; }
+
+    template<class CREATE, class RELEASE>
+    void Measure(const char* metric, CREATE create_font, RELEASE release_font)
+    {
+        std::vector<HWND>  controls(CONTROLS);
+        std::vector<HFONT> fonts(CONTROLS);
+        double create_ns = 0;
+        size_t gdi_peak  = 0;
+        for (int screen = 0; screen < SCREENS; screen++)
+        {
+            double start = BENCH::NowNs();
+            for (int i = 0; i < CONTROLS; i++)
+            {
+                controls[i] = CreateWindow(L"button", L"Button", WS_CHILD | WS_VISIBLE, 0, i, 50, 20, Parent(), (HMENU)(INT_PTR)(i + 1), 0, 0);
+                fonts[i]    = create_font(FontSize(i));
+                SendMessage(controls[i], WM_SETFONT, WPARAM(fonts[i]), TRUE);
+            }
+            create_ns += BENCH::NowNs() - start;
+            gdi_peak = std::max(gdi_peak, HEADLESS::GetStats().gdi_objects_alive);
+
+            for (int i = 0; i < CONTROLS; i++) { DestroyWindow(controls[i]); }
+            for (HFONT font : fonts) { release_font(font); }
+        }
+        std::string name = std::string("gdi_screen_") + metric;
+        BENCH::Report(name.c_str(), "create", create_ns / SCREENS / 1e3, "us/screen");
+        BENCH::Report(name.c_str(), "gdi_objects_peak", (double)gdi_peak, "handles");
+    }
+}
+
+BENCH_CASE(gdi_screen)
+{
+    size_t gdi_before = HEADLESS::GetStats().gdi_objects_alive;
+
+    Measure("create_font",
+        [](int size) { return CreateFont(size, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY, DEFAULT_PITCH | FF_SWISS, L"ARIAL"); },
+        [](HFONT font) { DeleteObject(font); });
+
+    GDI_CACHE::STATS before = GDI_CACHE::Shared().GetStats();
+    Measure("cached",
+        [](int size) { return GDI_CACHE::Shared().AcquireFont(L"ARIAL", size); },
+        [](HFONT font) { GDI_CACHE::Shared().Release(font); });
+    GDI_CACHE::STATS after = GDI_CACHE::Shared().GetStats();
+
+    BENCH::Report("gdi_screen_cached", "hits", (double)(after.hits - before.hits), "acquires");
+    BENCH::Report("gdi_screen_cached", "misses", (double)(after.misses - before.misses), "acquires");
+    BENCH::Report("gdi_screen", "gdi_objects_leaked", (double)HEADLESS::GetStats().gdi_objects_alive - (double)gdi_before, "handles");
+}
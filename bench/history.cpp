@@ -0,0 +1,194 @@
+#include "bench.h"
+#include "../hash.h"
+#include "../history.h"
+#include "../random.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+Content hash speed and the cost of adding, deduplicating and recalling history entries.
+"history_lru" checks a HISTORY against a plain model of it: random adds and recalls of texts that keep getting evicted and added again,
+half of them compressed payloads. Every recall has to give the model's text or nullptr, and the counters have to match.
+*/
+
+BENCH_CASE(history_hash)
+{
+    std::vector<unsigned char> data(size_t(64) << 20);
+    for (size_t i = 0; i < data.size(); i++) { data[i] = static_cast<unsigned char>(i * 131 + (i >> 9)); }
+
+    constexpr int rounds = 8;
+    uint64_t sink = 0;
+    double start = BENCH::NowNs();
+    for (int round = 0; round < rounds; round++) { sink ^= HASH::Of(data.data(), data.size()); }
+    double seconds = (BENCH::NowNs() - start) / 1e9;
+
+    std::string name = std::string("history_hash_") + HASH::Implementation();
+    BENCH::Report(name.c_str(), "throughput", static_cast<double>(data.size()) * rounds / seconds / 1e9, "GB/s");
+    volatile uint64_t keep = sink;
+    (void)keep;
+}
+
+BENCH_CASE(history_add_recall)
+{
+    // Operators copy the same few blobs over and over: 8 distinct 1 MB texts, copied 1000 times
+    constexpr size_t distinct = 8;
+    constexpr size_t copies   = 1000;
+    std::vector<std::wstring> blobs;
+    for (size_t i = 0; i < distinct; i++) { blobs.emplace_back(size_t(1) << 20 >> 1, static_cast<wchar_t>(L'a' + i)); }
+
+    HISTORY history(size_t(16) << 20);
+    double start = BENCH::NowNs();
+    for (size_t i = 0; i < copies; i++)
+    {
+        const std::wstring& blob = blobs[(i * 7) % distinct];
+        history.Add(blob.data(), blob.size());
+    }
+    BENCH::Report("history_add_recall", "add_duplicate", (BENCH::NowNs() - start) / copies / 1e3, "us/add");
+
+    HISTORY::STATS stats = history.GetStats();
+    BENCH::Report("history_add_recall", "bytes_used", static_cast<double>(stats.bytes_used), "bytes");
+    BENCH::Report("history_add_recall", "dedup_hits", static_cast<double>(stats.dedup_hits), "adds");
+
+    // The arena grows with the texts, one text in a window's 64 MB history allocates about its own size
+    HISTORY fresh(size_t(64) << 20);
+    fresh.Add(blobs[0].data(), blobs[0].size());
+    BENCH::Report("history_add_recall", "arena_one_text", static_cast<double>(fresh.GetStats().capacity) / 1e6, "MB");
+
+    // Unique texts against a small budget, so every add evicts
+    HISTORY small(size_t(4) << 20);
+    std::wstring unique(size_t(256) << 10, L'x');
+    start = BENCH::NowNs();
+    for (size_t i = 0; i < copies; i++)
+    {
+        unique[i % unique.size()] = static_cast<wchar_t>(L'0' + i % 10);
+        unique[0] = static_cast<wchar_t>(i);
+        small.Add(unique.data(), unique.size());
+    }
+    BENCH::Report("history_add_recall", "add_unique_evicting", (BENCH::NowNs() - start) / copies / 1e3, "us/add");
+    BENCH::Report("history_add_recall", "evictions", static_cast<double>(small.GetStats().evictions), "texts");
+
+    // A recall copies the 1 MB text into a new payload
+    constexpr size_t recalls = 10000;
+    std::shared_ptr<BUFFER_POOL> pool = std::make_shared<BUFFER_POOL>();
+    size_t sink = 0;
+    start = BENCH::NowNs();
+    for (size_t i = 0; i < recalls; i++)
+    {
+        if (std::shared_ptr<const PAYLOAD> recalled = small.Recall(i % 32, pool)) { sink += recalled->Length(); }
+    }
+    BENCH::Report("history_add_recall", "recall", (BENCH::NowNs() - start) / recalls / 1e3, "us/recall");
+    volatile size_t keep = sink;
+    (void)keep;
+
+    // Compressed payloads are kept as they are, hashed and compared by their blocks
+    HISTORY compressed(size_t(16) << 20);
+    std::vector<std::shared_ptr<const PAYLOAD>> packed;
+    for (const std::wstring& blob : blobs) { packed.push_back(PAYLOAD(blob.data(), blob.size()).Compressed()); }
+    start = BENCH::NowNs();
+    for (size_t i = 0; i < copies; i++) { compressed.Add(packed[(i * 7) % distinct]); }
+    BENCH::Report("history_add_recall", "add_compressed_duplicate", (BENCH::NowNs() - start) / copies / 1e3, "us/add");
+    BENCH::Report("history_add_recall", "compressed_bytes_used", static_cast<double>(compressed.GetStats().bytes_used), "bytes");
+}
+
+BENCH_CASE(history_lru)
+{
+    constexpr size_t TEXTS       = 24;
+    constexpr size_t BUDGET      = size_t(256) << 10;
+    constexpr size_t MAX_ENTRIES = 16;
+    constexpr int    OPERATIONS  = 200000;
+    RANDOM random(4);
+
+    // Texts of 1 to 16 K characters, the odd ones compressed. A compressed text is only a duplicate of its own payload
+    std::vector<std::wstring> contents;
+    std::vector<std::shared_ptr<const PAYLOAD>> compressed(TEXTS);
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < TEXTS; i++)
+    {
+        std::wstring text(1024 + random.Next() % (15 * 1024), L' ');
+        for (size_t c = 0; c < text.size(); c++) { text[c] = static_cast<wchar_t>(L'a' + (c * (i + 1) + c / 64) % 26); }
+        contents.push_back(text);
+        if (i % 2) { compressed[i] = PAYLOAD(text.data(), text.size()).Compressed(); }
+        sizes.push_back(compressed[i] ? compressed[i]->StoredBytes() : text.size() * sizeof(WCHAR));
+    }
+
+    // The model: a text is either stored or not, the least recently added or recalled one goes first. Ring entries name a text and which time it was stored
+    struct MODEL_TEXT
+    {
+        bool     stored = false;
+        uint32_t instance = 0;
+        uint32_t entries  = 0;
+        uint64_t used     = 0;
+    };
+    std::vector<MODEL_TEXT> model(TEXTS);
+    std::vector<std::pair<size_t, uint32_t>> ring;
+    size_t bytes_used = 0, evictions = 0, dedup_hits = 0;
+    uint64_t clock = 0;
+    auto drop = [&](size_t i)
+    {
+        model[i].stored = false;
+        model[i].instance++;
+        bytes_used -= sizes[i];
+    };
+
+    HISTORY history(BUDGET, MAX_ENTRIES);
+    size_t wrong_recalls = 0, evicted_recalls = 0;
+    for (int operation = 0; operation < OPERATIONS; operation++)
+    {
+        if (random.Next() % 10 < 7)
+        {
+            const size_t i = random.Next() % TEXTS;
+            if (compressed[i]) { history.Add(compressed[i]); } else { history.Add(contents[i].data(), contents[i].size()); }
+
+            if (model[i].stored) { dedup_hits++; }
+            else
+            {
+                while (bytes_used + sizes[i] > BUDGET)
+                {
+                    size_t oldest = TEXTS;
+                    for (size_t t = 0; t < TEXTS; t++) { if (model[t].stored && (oldest == TEXTS || model[t].used < model[oldest].used)) { oldest = t; } }
+                    drop(oldest);
+                    evictions++;
+                }
+                model[i] = {true, model[i].instance, 0, 0};
+                bytes_used += sizes[i];
+            }
+            model[i].used = ++clock;
+            model[i].entries++;
+            if (ring.size() == MAX_ENTRIES)
+            {
+                const auto [old, instance] = ring.front();
+                if (model[old].stored && model[old].instance == instance && --model[old].entries == 0) { drop(old); }
+                ring.erase(ring.begin());
+            }
+            ring.emplace_back(i, model[i].instance);
+        }
+        else
+        {
+            const size_t n = random.Next() % (MAX_ENTRIES + 4);
+            const std::shared_ptr<const PAYLOAD> recalled = history.Recall(n);
+            const std::wstring* expected = nullptr;
+            if (n < ring.size())
+            {
+                const auto [i, instance] = ring[ring.size() - 1 - n];
+                if (model[i].stored && model[i].instance == instance)
+                {
+                    model[i].used = ++clock;
+                    expected = &contents[i];
+                }
+                else { evicted_recalls++; }
+            }
+            if (!recalled || !expected) { wrong_recalls += !recalled != !expected; continue; }
+            std::wstring text(recalled->Length(), L' ');
+            recalled->CopyTo(text.data());
+            wrong_recalls += text != *expected;
+        }
+    }
+
+    const HISTORY::STATS stats = history.GetStats();
+    const size_t counters_wrong = (stats.evictions != evictions) + (stats.dedup_hits != dedup_hits) + (stats.bytes_used != bytes_used);
+    BENCH::Report("history_lru", "evictions", static_cast<double>(stats.evictions), "texts");
+    BENCH::Report("history_lru", "recalls_of_evicted", static_cast<double>(evicted_recalls), "recalls");
+    BENCH::Report("history_lru", "wrong_recalls", static_cast<double>(wrong_recalls), "recalls");
+    BENCH::Report("history_lru", "counters_wrong", static_cast<double>(counters_wrong), "counters");
+}
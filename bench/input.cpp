@@ -0,0 +1,123 @@
+#include "bench.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/*
+Mouse moves through RunMainLoop, made like the system makes them (HEADLESS::MoveMouse merges a move into the one still in the queue).
+"flood": moves in bursts with the loop running in between, how many get merged and how often TrackMouseEvent is called.
+"mouse_1000hz": a mouse reporting every millisecond from another thread for a second while the loop runs. The queue merges nothing
+the loop keeps up with, so received is what the loop would handle without the frame limit and handled is what it handles.
+*/
+
+namespace
+{
+    struct RESULT
+    {
+        double             ns_per_move;
+        MOUSE_INPUT::STATS mouse;
+        size_t             track_calls;  // seen by the headless backend
+    };
+
+    // Posts moves moves. Every leave_every moves the cursor leaves the window and every burst moves the loop gets to run
+    RESULT Flood(size_t moves, size_t leave_every, size_t burst)
+    {
+        GUI& gui  = BENCH::Window();
+        HWND hWnd = gui.GetWindowHandle();
+        gui.GetMessageStats().SetEnabled(false);
+        gui.ResetMouseStats();
+        size_t track_calls = HEADLESS::GetStats().track_mouse_calls;
+
+        double elapsed = 0;
+        for (size_t first = 0; first < moves; first += burst)
+        {
+            for (size_t i = first; i < first + burst && i < moves; i++)
+            {
+                HEADLESS::MoveMouse(hWnd, static_cast<int>(i % 300), static_cast<int>(i % 350));
+                if (leave_every && i % leave_every == leave_every - 1) { PostMessage(hWnd, WM_MOUSELEAVE, 0, 0); }
+            }
+            PostQuitMessage(0);
+
+            BENCH::QUIET quiet;
+            double start = BENCH::NowNs();
+            gui.RunMainLoop();
+            elapsed += BENCH::NowNs() - start;
+        }
+        gui.GetMessageStats().SetEnabled(true);
+
+        RESULT result;
+        result.ns_per_move = elapsed / static_cast<double>(moves);
+        result.mouse       = gui.GetMouseStats();
+        result.track_calls = HEADLESS::GetStats().track_mouse_calls - track_calls;
+        return result;
+    }
+
+    void Report(const char* case_name, const RESULT& result)
+    {
+        BENCH::Report(case_name, "loop", result.ns_per_move, "ns/move");
+        BENCH::Report(case_name, "received", static_cast<double>(result.mouse.received), "moves");
+        BENCH::Report(case_name, "coalesced", static_cast<double>(result.mouse.coalesced), "moves");
+        BENCH::Report(case_name, "deferred", static_cast<double>(result.mouse.deferred), "moves");
+        BENCH::Report(case_name, "handled", static_cast<double>(result.mouse.handled), "moves");
+        BENCH::Report(case_name, "track_mouse_event", static_cast<double>(result.track_calls), "calls");
+    }
+}
+
+BENCH_CASE(mouse_flood)
+{
+    // 16 moves per run of the loop, the queue holds one of them
+    Report("mouse_flood", Flood(200000, 0, 16));
+}
+
+BENCH_CASE(mouse_flood_enter_leave)
+{
+    // Cursor crosses the window every 64 moves, tracking is armed once per crossing
+    Report("mouse_flood_enter_leave", Flood(200000, 64, 16));
+}
+
+BENCH_CASE(mouse_single_moves)
+{
+    // Nothing to merge in the queue. The loop ends after every move and sends the one that waits out
+    Report("mouse_single_moves", Flood(20000, 0, 1));
+}
+
+BENCH_CASE(mouse_1000hz)
+{
+    constexpr int      RATE_HZ  = 1000;
+    constexpr uint64_t DURATION = 1000000000; // 1 s
+    GUI& gui  = BENCH::Window();
+    HWND hWnd = gui.GetWindowHandle();
+    gui.GetMessageStats().SetEnabled(false);
+    gui.ResetMouseStats();
+
+    std::atomic<bool> stop{false};
+    std::thread mouse([hWnd, &stop]
+    {
+        auto next = std::chrono::steady_clock::now();
+        for (int i = 0; !stop; i++)
+        {
+            HEADLESS::MoveMouse(hWnd, i % 300, i % 350);
+            next += std::chrono::microseconds(1000000 / RATE_HZ);
+            std::this_thread::sleep_until(next);
+        }
+    });
+    gui.GetTimers().Schedule(DURATION, [] { PostQuitMessage(0); });
+    {
+        BENCH::QUIET quiet;
+        gui.RunMainLoop();
+    }
+    stop = true;
+    mouse.join();
+    gui.GetMessageStats().SetEnabled(true);
+
+    // The moves the thread made after the loop ended are still queued
+    MSG left;
+    while (PeekMessage(&left, hWnd, WM_MOUSEMOVE, WM_MOUSEMOVE, PM_REMOVE)) {}
+
+    const MOUSE_INPUT::STATS stats = gui.GetMouseStats();
+    const double frames = static_cast<double>(DURATION) / MOUSE_INPUT::FRAME_NS;
+    BENCH::Report("mouse_1000hz", "received", static_cast<double>(stats.received), "moves");
+    BENCH::Report("mouse_1000hz", "handled", static_cast<double>(stats.handled), "moves");
+    BENCH::Report("mouse_1000hz", "handled_per_frame", stats.handled / frames, "moves");
+    BENCH::Report("mouse_1000hz", "coalesced", static_cast<double>(stats.coalesced), "moves");
+}
@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "../layout.h"
+#include <vector>
+
+/*
+Layout of a 10k node tree: the first solve, a resize drag and a change of a single node.
+A drag step has to fit into one frame at 60 Hz (16.7 ms) including moving the controls.
+*/
+
+namespace
+{
+    constexpr int ROWS           = 250;
+    constexpr int LEAVES_PER_ROW = 39; // 250 rows * (1 + 39) = 10k nodes
+
+    HWND Parent()
+    {
+        static HWND parent = []
+        {
+            WNDCLASS wc      = {};
+            wc.lpfnWndProc   = DefWindowProc;
+            wc.lpszClassName = L"BenchLayoutParent";
+            RegisterClass(&wc);
+            return CreateWindowEx(0, wc.lpszClassName, L"", 0, 0, 0, 1920, 1080, 0, 0, 0, 0);
+        }();
+        return parent;
+    }
+
+    // Rows of fixed and flex cells, every other cell is a control
+    void Build(LAYOUT& layout, std::vector<HWND>& controls, std::vector<int>& leaves)
+    {
+        int root = layout.Root(4, 2);
+        for (int row = 0; row < ROWS; row++)
+        {
+            int row_node = layout.Row(root, LAYOUT::Flex(), LAYOUT::Fixed(30), 1, 2);
+            for (int leaf = 0; leaf < LEAVES_PER_ROW; leaf++)
+            {
+                LAYOUT::LENGTH width = leaf % 3 == 0 ? LAYOUT::Fixed(40) : LAYOUT::Flex(static_cast<float>(1 + leaf % 2));
+                if (leaf % 2 == 0)
+                {
+                    HWND control = CreateWindow(L"static", L"", WS_CHILD, 0, 0, 0, 0, Parent(), 0, 0, 0);
+                    controls.push_back(control);
+                    leaves.push_back(layout.Control(row_node, control, width, LAYOUT::Flex()));
+                }
+                else
+                {
+                    leaves.push_back(layout.Spacer(row_node, width, LAYOUT::Flex()));
+                }
+            }
+        }
+    }
+}
+
+BENCH_CASE(layout_10k)
+{
+    LAYOUT layout;
+    std::vector<HWND> controls;
+    std::vector<int>  leaves;
+    Build(layout, controls, leaves);
+
+    double start  = BENCH::NowNs();
+    size_t solved = layout.Resize(1920, 1080);
+    double solve_ms = (BENCH::NowNs() - start) / 1e6;
+    size_t moved = layout.Apply();
+    double apply_ms = (BENCH::NowNs() - start) / 1e6 - solve_ms;
+    BENCH::Report("layout_10k", "nodes", (double)layout.NodeCount(), "nodes");
+    BENCH::Report("layout_10k", "first_solve", solve_ms, "ms");
+    BENCH::Report("layout_10k", "first_apply", apply_ms, "ms");
+    BENCH::Report("layout_10k", "first_solved", (double)solved, "nodes");
+    BENCH::Report("layout_10k", "first_moved", (double)moved, "controls");
+
+    // Dragging the right border: every row changes width
+    constexpr int steps = 60;
+    HEADLESS::STATS before = HEADLESS::GetStats();
+    solved = 0;
+    moved  = 0;
+    start  = BENCH::NowNs();
+    for (int step = 1; step <= steps; step++)
+    {
+        solved += layout.Resize(1920 - step * 4, 1080);
+        moved  += layout.Apply();
+    }
+    HEADLESS::STATS after = HEADLESS::GetStats();
+    BENCH::Report("layout_10k_drag_width", "frame", (BENCH::NowNs() - start) / 1e6 / steps, "ms/frame");
+    BENCH::Report("layout_10k_drag_width", "solved", (double)solved / steps, "nodes/frame");
+    BENCH::Report("layout_10k_drag_width", "moved", (double)moved / steps, "controls/frame");
+    BENCH::Report("layout_10k_drag_width", "batches", (double)(after.defer_batches - before.defer_batches) / steps, "batches/frame");
+
+    // Dragging the bottom border: the rows have a fixed height, so nothing below the root changes
+    solved = 0;
+    moved  = 0;
+    start  = BENCH::NowNs();
+    for (int step = 1; step <= steps; step++)
+    {
+        solved += layout.Resize(1920 - steps * 4, 1080 - step * 4);
+        moved  += layout.Apply();
+    }
+    BENCH::Report("layout_10k_drag_height", "frame", (BENCH::NowNs() - start) / 1e6 / steps, "ms/frame");
+    BENCH::Report("layout_10k_drag_height", "solved", (double)solved / steps, "nodes/frame");
+    BENCH::Report("layout_10k_drag_height", "moved", (double)moved / steps, "controls/frame");
+
+    // One cell changes its size: only its row is laid out again
+    solved = 0;
+    moved  = 0;
+    start  = BENCH::NowNs();
+    for (int step = 0; step < steps; step++)
+    {
+        int leaf = leaves[(step * 7919) % leaves.size()];
+        layout.SetSize(leaf, LAYOUT::Fixed(20 + step % 20), LAYOUT::Flex());
+        solved += layout.Resize(1920 - steps * 4, 1080 - steps * 4);
+        moved  += layout.Apply();
+    }
+    BENCH::Report("layout_10k_set_size", "frame", (BENCH::NowNs() - start) / 1e6 / steps, "ms/frame");
+    BENCH::Report("layout_10k_set_size", "solved", (double)solved / steps, "nodes/frame");
+    BENCH::Report("layout_10k_set_size", "moved", (double)moved / steps, "controls/frame");
+
+    for (HWND control : controls) { DestroyWindow(control); }
+}
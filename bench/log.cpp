@@ -0,0 +1,72 @@
+#include "bench.h"
+#include "../log.h"
+#include <fstream>
+
+/*
+What a log line costs the thread that writes it: the old synchronous std::wcout style against the asynchronous logger.
+*/
+
+namespace
+{
+    constexpr int LINES = 100000;
+
+    // std::endl after every line, like the handlers did
+    double NsPerSynchronousLine()
+    {
+        std::wofstream out("/dev/null");
+        double start = BENCH::NowNs();
+        for (int i = 0; i < LINES; i++) { out << L"Clipboard set to " << i << L" characters" << std::endl; }
+        return (BENCH::NowNs() - start) / LINES;
+    }
+
+    // Stays below the size of a ring so nothing gets dropped
+    double NsPerAsynchronousLine()
+    {
+        constexpr int BURST = static_cast<int>(LOG::RING_RECORDS / 2);
+        double total = 0;
+        for (int written = 0; written < LINES; written += BURST)
+        {
+            double start = BENCH::NowNs();
+            for (int i = 0; i < BURST; i++) { LOG_INFO(L"Clipboard set to", i, L"characters"); }
+            total += BENCH::NowNs() - start;
+            LOG::Flush();
+        }
+        return total / LINES;
+    }
+}
+
+BENCH_CASE(log_line)
+{
+    BENCH::Report("log_line", "wcout_endl", NsPerSynchronousLine(), "ns/line");
+
+    LOG::Discard();
+    BENCH::Report("log_line", "async_discard", NsPerAsynchronousLine(), "ns/line");
+
+    if (LOG::ToFile("/dev/null"))
+    {
+        BENCH::Report("log_line", "async_file", NsPerAsynchronousLine(), "ns/line");
+    }
+    LOG::Discard();
+
+    LOG::SetLevel(LOG::LEVEL_WARN);
+    double start = BENCH::NowNs();
+    for (int i = 0; i < LINES; i++) { LOG_INFO(L"Clipboard set to", i, L"characters"); }
+    BENCH::Report("log_line", "below_level", (BENCH::NowNs() - start) / LINES, "ns/line");
+    LOG::SetLevel(LOG::LEVEL_INFO);
+}
+
+BENCH_CASE(log_flood)
+{
+    // More lines in one go than a ring holds, the rest is dropped instead of blocking
+    LOG::Flush();
+    LOG::STATS before = LOG::GetStats();
+    double start = BENCH::NowNs();
+    for (int i = 0; i < LINES; i++) { LOG_INFO(L"Mouse moved", i, i); }
+    double elapsed = BENCH::NowNs() - start;
+    LOG::Flush();
+    LOG::STATS after = LOG::GetStats();
+
+    BENCH::Report("log_flood", "producer", elapsed / LINES, "ns/line");
+    BENCH::Report("log_flood", "written", static_cast<double>(after.written - before.written), "lines");
+    BENCH::Report("log_flood", "dropped", static_cast<double>(after.dropped - before.dropped), "lines");
+}
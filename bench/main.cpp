@@ -0,0 +1,16 @@
+#include "bench.h"
+#include "../log.h"
+
+int main(int argc, char** argv) {
+
+    // The log is written by a background thread, keep it away from the console the cases silence
+    LOG::Discard();
+
+    // Optional first argument filters the cases by name
+    return BENCH::RunAll(argc > 1 ? argv[1] : "");
+};
+
+
+/*
+    Benchmarks for the headless build. See readme.md for how to compile them.
+*/
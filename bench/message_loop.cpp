@@ -0,0 +1,110 @@
+#include "bench.h"
+#include <string>
+
+// Feeds synthetic message streams through RunMainLoop -> DispatchMessage -> GUI::MessageHandler
+
+namespace
+{
+    // Posts count messages produced by make_message (to the window unless they name one), then runs the loop until it drained them
+    template<class F>
+    double PumpNsPerMessage(size_t count, F make_message, bool message_stats = true)
+    {
+        GUI& gui  = BENCH::Window();
+        HWND hWnd = gui.GetWindowHandle();
+        gui.GetMessageStats().SetEnabled(message_stats);
+        gui.GetMessageStats().Reset();
+        for (size_t i = 0; i < count; i++)
+        {
+            MSG msg = make_message(i);
+            PostMessage(msg.hwnd ? msg.hwnd : hWnd, msg.message, msg.wParam, msg.lParam);
+        }
+        PostQuitMessage(0);
+
+        BENCH::QUIET quiet;
+        double start = BENCH::NowNs();
+        gui.RunMainLoop();
+        double ns = (BENCH::NowNs() - start) / static_cast<double>(count);
+        gui.GetMessageStats().SetEnabled(true);
+        return ns;
+    }
+
+    // Handler time percentiles of the last run
+    void ReportHandler(const char* case_name, UINT message, int control_id, const char* prefix = "handler")
+    {
+        for (const MESSAGE_STATS::ROW& row : BENCH::Window().GetMessageStats().Snapshot())
+        {
+            if (row.message != message || row.control_id != control_id) { continue; }
+            const std::string name = prefix;
+            BENCH::Report(case_name, (name + "_p50").c_str(), (double)row.handler_p50, "ns");
+            BENCH::Report(case_name, (name + "_p99").c_str(), (double)row.handler_p99, "ns");
+            BENCH::Report(case_name, (name + "_p999").c_str(), (double)row.handler_p999, "ns");
+        }
+    }
+
+    // Commands the last run counted for control_id
+    uint64_t CommandCount(int control_id)
+    {
+        for (const MESSAGE_STATS::ROW& row : BENCH::Window().GetMessageStats().Snapshot())
+        {
+            if (row.message == WM_COMMAND && row.control_id == control_id) { return row.count; }
+        }
+        return 0;
+    }
+}
+
+BENCH_CASE(message_loop_mouse_flood)
+{
+    // Posted moves are merged when the loop takes them out of the queue (see input.h), so almost none of these are dispatched
+    constexpr size_t count = 200000;
+    auto mouse_move = [](size_t i)
+    {
+        MSG msg = {};
+        msg.message = WM_MOUSEMOVE;
+        msg.lParam  = MAKELPARAM(i % 300, i % 350);
+        return msg;
+    };
+    BENCH::Report("message_loop_mouse_flood", "dispatch_no_stats", PumpNsPerMessage(count, mouse_move, false), "ns/msg");
+    BENCH::Report("message_loop_mouse_flood", "dispatch", PumpNsPerMessage(count, mouse_move), "ns/msg");
+    ReportHandler("message_loop_mouse_flood", WM_MOUSEMOVE, MESSAGE_STATS::NO_CONTROL);
+}
+
+BENCH_CASE(message_loop_command_burst)
+{
+    constexpr size_t count = 200000;
+    auto command = [](size_t i)
+    {
+        // Mostly no-op commands with a clear of the edit control every 16th message
+        MSG msg = {};
+        msg.message = WM_COMMAND;
+        msg.wParam  = MAKEWPARAM(i % 16 ? ID_TEST_BUTTON : ID_CLEAR_TEXT_BUTTON, BN_CLICKED);
+        return msg;
+    };
+    BENCH::Report("message_loop_command_burst", "dispatch_no_stats", PumpNsPerMessage(count, command, false), "ns/msg");
+    BENCH::Report("message_loop_command_burst", "dispatch", PumpNsPerMessage(count, command), "ns/msg");
+    ReportHandler("message_loop_command_burst", WM_COMMAND, ID_CLEAR_TEXT_BUTTON);
+}
+
+BENCH_CASE(message_loop_clicks)
+{
+    // Clicks on the checkbox and every 16th on Clear: the button gets the mouse messages and sends WM_COMMAND to the window while it handles WM_LBUTTONUP
+    constexpr size_t clicks = 100000;
+    HWND checkbox     = GetDlgItem(BENCH::Window().GetWindowHandle(), ID_CHECKBOX);
+    HWND clear_button = GetDlgItem(BENCH::Window().GetWindowHandle(), ID_CLEAR_TEXT_BUTTON);
+    auto click = [=](size_t i)
+    {
+        MSG msg = {};
+        msg.hwnd    = (i / 2) % 16 ? checkbox : clear_button;
+        msg.message = i % 2 ? WM_LBUTTONUP : WM_LBUTTONDOWN;
+        msg.wParam  = i % 2 ? 0 : MK_LBUTTON;
+        msg.lParam  = MAKELPARAM(5, 5);
+        return msg;
+    };
+    BENCH::Report("message_loop_clicks", "dispatch_no_stats", PumpNsPerMessage(clicks * 2, click, false), "ns/msg");
+    BENCH::Report("message_loop_clicks", "dispatch", PumpNsPerMessage(clicks * 2, click), "ns/msg");
+    ReportHandler("message_loop_clicks", WM_COMMAND, ID_CLEAR_TEXT_BUTTON);
+    ReportHandler("message_loop_clicks", WM_LBUTTONUP, MESSAGE_STATS::NO_CONTROL, "lbuttonup");
+
+    // Every click has to show up in the rows of its control, although none of them was posted
+    const double counted = static_cast<double>(CommandCount(ID_CHECKBOX) + CommandCount(ID_CLEAR_TEXT_BUTTON));
+    BENCH::Report("message_loop_clicks", "commands_missed", clicks - counted, "clicks");
+}
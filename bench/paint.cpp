@@ -0,0 +1,164 @@
+#include "bench.h"
+#include "../histogram.h"
+#include "../layout.h"
+#include "../paint.h"
+#include <string>
+#include <vector>
+
+/*
+Resize drag of a window with 400 labels, painted the way GUI used to and with the PAINTER.
+"whole": CS_HREDRAW | CS_VREDRAW, no WS_CLIPCHILDREN, the class brush erases straight onto the window and WM_CTLCOLORSTATIC picks the colors in the handler.
+"buffered": no redraw styles, WS_CLIPCHILDREN, back buffer and the color table.
+A frame is one resize step: WM_SIZE, the layout moving the labels and every WM_PAINT that follows.
+The labels flex, so every step moves a third of them. The headless update area is one bounding rectangle, so the slivers they uncover add up to most of the window
+and "buffered" fills and copies more pixels than windows would (its update region leaves out the labels with WS_CLIPCHILDREN).
+"recolor" changes the colors of 4 labels per frame: the color table repaints those 4, before the whole window had to be invalidated.
+*/
+
+namespace
+{
+    constexpr int ROWS    = 20;
+    constexpr int COLUMNS = 20;
+    constexpr int STEPS   = 60;
+    constexpr int RECOLOR = 4;
+    constexpr COLORREF GRAY = RGB(192, 192, 192);
+
+    struct WINDOW_STATE
+    {
+        bool    buffered;
+        LAYOUT  layout;
+        PAINTER painter;
+        HBRUSH  brush     = NULL;
+        size_t  ctlcolors = 0;
+    };
+
+    LRESULT CALLBACK Proc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        if (uMsg == WM_NCCREATE)
+        {
+            SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(reinterpret_cast<LPCREATESTRUCT>(lParam)->lpCreateParams));
+        }
+        WINDOW_STATE* state = reinterpret_cast<WINDOW_STATE*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
+        if (!state) { return DefWindowProc(hWnd, uMsg, wParam, lParam); }
+        switch (uMsg)
+        {
+            case WM_SIZE:
+                state->layout.Resize(LOWORD(lParam), HIWORD(lParam));
+                state->layout.Apply();
+                return 0;
+            case WM_PAINT:
+                if (!state->buffered) { break; }
+                state->painter.OnPaint();
+                return 0;
+            case WM_ERASEBKGND:
+                if (!state->buffered) { break; }
+                return 1;
+            case WM_CTLCOLORSTATIC:
+                state->ctlcolors++;
+                if (state->buffered) { return (INT_PTR)state->painter.OnCtlColorStatic((HDC)wParam, (HWND)lParam); }
+                // What GUI::OnCTLCOLORSTATIC did
+                SetTextColor((HDC)wParam, RGB(0, 0, 0));
+                SetBkColor((HDC)wParam, GRAY);
+                if (!state->brush) { state->brush = CreateSolidBrush(GRAY); }
+                return (INT_PTR)state->brush;
+        }
+        return DefWindowProc(hWnd, uMsg, wParam, lParam);
+    }
+
+    void Pump()
+    {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) { DispatchMessage(&msg); }
+    }
+
+    void Measure(const char* metric, bool buffered)
+    {
+        const wchar_t* class_name = buffered ? L"BenchPaintBuffered" : L"BenchPaintWhole";
+        WNDCLASS wc      = {};
+        wc.style         = buffered ? 0 : CS_HREDRAW | CS_VREDRAW;
+        wc.lpfnWndProc   = Proc;
+        wc.hbrBackground = (HBRUSH)GetStockObject(LTGRAY_BRUSH);
+        wc.lpszClassName = class_name;
+        RegisterClass(&wc);
+
+        WINDOW_STATE state;
+        state.buffered = buffered;
+        const DWORD style = WS_VISIBLE | (buffered ? WS_CLIPCHILDREN : 0);
+        HWND hWnd = CreateWindowEx(0, class_name, L"", style, 0, 0, 0, 0, 0, 0, 0, &state);
+        if (buffered) { state.painter.Start(hWnd, GRAY); }
+
+        // Rows of labels that share the width
+        std::vector<HWND> labels;
+        int root = state.layout.Root(10, 4);
+        for (int row = 0; row < ROWS; row++)
+        {
+            int row_node = state.layout.Row(root, LAYOUT::Flex(), LAYOUT::Fixed(24), 0, 4);
+            for (int column = 0; column < COLUMNS; column++)
+            {
+                HWND label = CreateWindow(L"static", L"Label", WS_CHILD | WS_VISIBLE, 0, 0, 0, 0, hWnd, 0, 0, 0);
+                state.layout.Control(row_node, label, LAYOUT::Flex(), LAYOUT::Flex());
+                labels.push_back(label);
+            }
+        }
+        SetWindowPos(hWnd, NULL, 0, 0, 1280, 800, SWP_NOMOVE | SWP_NOZORDER);
+        Pump();
+
+        // Dragging the right border out
+        HISTOGRAM frames;
+        state.ctlcolors = 0;
+        state.painter.ResetStats();
+        HEADLESS::STATS before = HEADLESS::GetStats();
+        for (int step = 1; step <= STEPS; step++)
+        {
+            double start = BENCH::NowNs();
+            SetWindowPos(hWnd, NULL, 0, 0, 1280 + step * 8, 800, SWP_NOMOVE | SWP_NOZORDER);
+            Pump();
+            frames.Record(static_cast<uint64_t>(BENCH::NowNs() - start));
+        }
+        HEADLESS::STATS after = HEADLESS::GetStats();
+
+        std::string name = std::string("paint_resize_") + metric;
+        BENCH::Report(name.c_str(), "frame_p50", frames.Percentile(50) / 1e6, "ms");
+        BENCH::Report(name.c_str(), "frame_p99", frames.Percentile(99) / 1e6, "ms");
+        BENCH::Report(name.c_str(), "paints", double(after.paints - before.paints) / STEPS, "per_frame");
+        BENCH::Report(name.c_str(), "ctlcolor", double(state.ctlcolors) / STEPS, "per_frame");
+        BENCH::Report(name.c_str(), "pixels_drawn", double(after.pixels_drawn - before.pixels_drawn) / STEPS / 1e3, "kpx/frame");
+        if (buffered) { BENCH::Report(name.c_str(), "buffer_resizes", (double)state.painter.GetStats().buffer_resizes, "resizes"); }
+
+        // A few labels change color every frame
+        frames.Reset();
+        state.ctlcolors = 0;
+        before = HEADLESS::GetStats();
+        for (int step = 0; step < STEPS; step++)
+        {
+            double start = BENCH::NowNs();
+            if (buffered)
+            {
+                for (int i = 0; i < RECOLOR; i++)
+                {
+                    HWND label = labels[(step * RECOLOR + i) * 7 % labels.size()];
+                    state.painter.SetColors(label, step % 2 ? RGB(255, 0, 0) : RGB(0, 0, 255), GRAY);
+                }
+            }
+            else { InvalidateRect(hWnd, NULL, TRUE); } // The handler decides the colors, so everything paints again
+            Pump();
+            frames.Record(static_cast<uint64_t>(BENCH::NowNs() - start));
+        }
+        after = HEADLESS::GetStats();
+        BENCH::Report(name.c_str(), "recolor_frame_p50", frames.Percentile(50) / 1e6, "ms");
+        BENCH::Report(name.c_str(), "recolor_paints", double(after.paints - before.paints) / STEPS, "per_frame");
+        BENCH::Report(name.c_str(), "recolor_ctlcolor", double(state.ctlcolors) / STEPS, "per_frame");
+
+        DestroyWindow(hWnd);
+        Pump();
+        if (buffered) { state.painter.Stop(); }
+        if (state.brush) { DeleteObject(state.brush); }
+        UnregisterClass(class_name, 0);
+    }
+}
+
+BENCH_CASE(paint_resize)
+{
+    Measure("whole", false);
+    Measure("buffered", true);
+}
@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "../random.h"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+// A random screen position the way the handlers made one before (new std::random_device and std::mt19937 per event) and with RANDOM
+
+namespace
+{
+    constexpr int WIDTH  = 1920;
+    constexpr int HEIGHT = 1080;
+}
+
+BENCH_CASE(random_position)
+{
+    constexpr int events = 20000;
+    volatile int sink = 0;
+
+    double start = BENCH::NowNs();
+    for (int i = 0; i < events; i++)
+    {
+        std::random_device rd;
+        std::mt19937 mt(rd());
+        std::uniform_int_distribution<> dist_x(0, WIDTH);
+        std::uniform_int_distribution<> dist_y(0, HEIGHT);
+        sink = dist_x(mt) + dist_y(mt);
+    }
+    BENCH::Report("random_position", "mt19937_per_event", (BENCH::NowNs() - start) / events, "ns/position");
+
+    RANDOM random(42);
+    constexpr int positions = 10000000;
+    start = BENCH::NowNs();
+    for (int i = 0; i < positions; i++) { sink = random.Between(0, WIDTH - 1) + random.Between(0, HEIGHT - 1); }
+    BENCH::Report("random_position", "xoshiro", (BENCH::NowNs() - start) / positions, "ns/position");
+    (void)sink;
+}
+
+BENCH_CASE(random_replay)
+{
+    // Two generators with the same seed give the same positions
+    RANDOM first(1234), second(1234);
+    int mismatches = 0;
+    for (int i = 0; i < 100000; i++) { mismatches += first.Between(0, WIDTH - 1) != second.Between(0, WIDTH - 1); }
+    BENCH::Report("random_replay", "mismatches", mismatches, "positions");
+
+    // Bias check: every column of a small range should get 1/7 of the draws
+    RANDOM random(99);
+    int counts[7] = {};
+    constexpr int draws = 7000000;
+    for (int i = 0; i < draws; i++) { counts[random.Between(0, 6)]++; }
+    int worst = 0;
+    for (int count : counts) { worst = std::max(worst, std::abs(count - draws / 7)); }
+    BENCH::Report("random_replay", "max_bucket_deviation", 100.0 * worst / (draws / 7), "%");
+}
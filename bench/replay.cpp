@@ -0,0 +1,101 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+
+/*
+Posts a synthetic session of a million messages through RunMainLoop, records what it dispatches and replays that a few times at maximum speed.
+The loop handles mouse moves once a frame (see input.h), so the recording holds only a few of the moves.
+The spread between the replays is what a release gate on the replay time has to tolerate.
+*/
+
+namespace
+{
+    const char* SESSION_PATH = "bench_session.rec";
+    constexpr size_t MESSAGES = 1000000;
+
+    // Mouse moves with commands, clears and the odd resize in between, so no move is merged in the queue
+    MSG SessionMessage(size_t i)
+    {
+        MSG msg = {};
+        if (i % 2 == 0)
+        {
+            msg.message = WM_MOUSEMOVE;
+            msg.lParam  = MAKELPARAM(i % 300, i % 350);
+        }
+        else if (i % 64 == 1)
+        {
+            msg.message = WM_SIZE;
+            msg.lParam  = MAKELPARAM(300 + i % 200, 350 + i % 100);
+        }
+        else
+        {
+            msg.message = WM_COMMAND;
+            msg.wParam  = MAKEWPARAM(i % 16 == 3 ? ID_CLEAR_TEXT_BUTTON : ID_TEST_BUTTON, BN_CLICKED);
+        }
+        return msg;
+    }
+
+    // Runs the session through the loop. Returns ns per message
+    double Pump(bool record)
+    {
+        GUI& gui  = BENCH::Window();
+        HWND hWnd = gui.GetWindowHandle();
+        gui.GetMessageStats().SetEnabled(false);
+        if (record) { gui.StartRecording(SESSION_PATH); }
+
+        constexpr size_t BURST = 10000;
+        double elapsed = 0;
+        for (size_t first = 0; first < MESSAGES; first += BURST)
+        {
+            for (size_t i = first; i < first + BURST; i++)
+            {
+                MSG msg = SessionMessage(i);
+                PostMessage(hWnd, msg.message, msg.wParam, msg.lParam);
+            }
+            PostQuitMessage(0);
+
+            BENCH::QUIET quiet;
+            double start = BENCH::NowNs();
+            gui.RunMainLoop();
+            elapsed += BENCH::NowNs() - start;
+        }
+
+        gui.StopRecording();
+        gui.GetMessageStats().SetEnabled(true);
+        return elapsed / MESSAGES;
+    }
+}
+
+BENCH_CASE(replay_session)
+{
+    double plain     = Pump(false);
+    double recording = Pump(true);
+    BENCH::Report("replay_session", "loop", plain, "ns/msg");
+    BENCH::Report("replay_session", "loop_recording", recording, "ns/msg");
+
+    MESSAGE_REPLAY replay;
+    if (!replay.Load(SESSION_PATH)) { BENCH::Report("replay_session", "load_failed", 1, ""); return; }
+    FILE* file = std::fopen(SESSION_PATH, "rb");
+    std::fseek(file, 0, SEEK_END);
+    double bytes = static_cast<double>(std::ftell(file));
+    std::fclose(file);
+    BENCH::Report("replay_session", "messages", static_cast<double>(replay.Count()), "msgs");
+    BENCH::Report("replay_session", "size", bytes / replay.Count(), "bytes/msg");
+
+    constexpr int RUNS = 5;
+    double fastest = 1e300, slowest = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        BENCH::QUIET quiet;
+        MESSAGE_REPLAY::RESULT result = BENCH::Window().Replay(replay, MESSAGE_REPLAY::SPEED::MAXIMUM);
+        fastest = std::min(fastest, result.elapsed_ns / 1e6);
+        slowest = std::max(slowest, result.elapsed_ns / 1e6);
+    }
+    BENCH::Report("replay_session", "replay_fastest", fastest, "ms");
+    BENCH::Report("replay_session", "replay_spread", 100.0 * (slowest - fastest) / fastest, "%");
+    for (const MESSAGE_STATS::ROW& row : BENCH::Window().GetMessageStats().Snapshot())
+    {
+        if (row.message == WM_SIZE) { BENCH::Report("replay_session", "wm_size_p99", row.handler_p99 / 1e3, "us"); }
+    }
+    std::remove(SESSION_PATH);
+}
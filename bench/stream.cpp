@@ -0,0 +1,131 @@
+#include "bench.h"
+#include "../clipboard.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+/*
+Log dumps through CLIPBOARD::setClipboardToStream, once as a file (mapped) and once through a pipe (read in blocks).
+"getline" is the iostream loop getStringFromStdin used to be built on, keeping every line, for comparison.
+peak_rss_growth is how much the peak resident memory grew during the run, in payloads: 1 means no copy besides the payload itself.
+Mapped pages are resident too, so the mapped run shows the page cache on top.
+*/
+
+namespace
+{
+    // Log lines with the odd non ASCII character
+    std::string LogDump(size_t bytes)
+    {
+        std::string text;
+        text.reserve(bytes + 128);
+        for (size_t line = 0; text.size() < bytes; line++)
+        {
+            text += "2024-05-01 12:00:" + std::to_string(line % 60) + " INFO  request " + std::to_string(line * 7919 % 100000);
+            text += line % 10 ? " handled in 3 ms\n" : " handled for café Zürich → ok\n";
+        }
+        text.resize(bytes);
+        return text;
+    }
+
+    // Peak resident set size in bytes, 0 where /proc is not available
+    size_t PeakRss()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.rfind("VmHWM:", 0) == 0) { return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024; }
+        }
+        return 0;
+    }
+
+    // Lets the peak start again from the current resident size
+    void ResetPeakRss()
+    {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5";
+    }
+
+    // Measures publish, reports throughput and memory
+    template<class F>
+    void Measure(const char* case_name, const char* metric, size_t bytes, F publish)
+    {
+        ResetPeakRss();
+        size_t rss_before = PeakRss();
+        double start = BENCH::NowNs();
+        size_t characters = publish();
+        double ns = BENCH::NowNs() - start;
+        size_t rss_growth = PeakRss() - rss_before;
+
+        std::string name = metric;
+        BENCH::Report(case_name, (name + "_throughput").c_str(), bytes / ns * 1e3, "MB/s");
+        if (rss_before) { BENCH::Report(case_name, (name + "_peak_rss_growth").c_str(), double(rss_growth) / double(characters * sizeof(WCHAR)), "payloads"); }
+    }
+}
+
+BENCH_CASE(stream_ingest)
+{
+    const size_t bytes = std::getenv("BENCH_LARGE") ? size_t(512) << 20 : size_t(64) << 20;
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "win32_demo_bench_stream.log";
+    {
+        std::string dump = LogDump(bytes);
+        std::FILE* file = std::fopen(path.string().c_str(), "wb");
+        if (!file) { return; }
+        std::fwrite(dump.data(), 1, dump.size(), file);
+        std::fclose(file);
+    }
+
+    GUI& gui = BENCH::Window();
+
+    Measure("stream_ingest", "getline", bytes, [&]
+    {
+        // The whole text as std::string first, then decoded like setClipboardToUtf8 does
+        std::ifstream input(path, std::ios::binary);
+        std::string text, line;
+        while (std::getline(input, line)) { text += line; text += '\n'; }
+        PAYLOAD payload;
+        payload.AppendUtf8(text.data(), text.size());
+        return payload.Length();
+    });
+
+    Measure("stream_ingest", "file_mapped", bytes, [&]
+    {
+        HANDLE file = CreateFile(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        CLIPBOARD::STREAM_STATS stats = {};
+        gui.SetClipboardToStream(file, &stats);
+        CloseHandle(file);
+        BENCH::Report("stream_ingest", "file_mapped_used_mapping", stats.mapped, "bool");
+        return stats.characters;
+    });
+
+    Measure("stream_ingest", "pipe", bytes, [&]
+    {
+        HANDLE read_end, write_end;
+        if (!CreatePipe(&read_end, &write_end, NULL, 0)) { return size_t(1); }
+        std::thread writer([&]
+        {
+            // Another process writing its log, in pieces of 64 KB
+            std::FILE* file = std::fopen(path.string().c_str(), "rb");
+            std::string block(64 * 1024, '\0');
+            size_t got;
+            while ((got = std::fread(block.data(), 1, block.size(), file)) > 0)
+            {
+                DWORD written;
+                WriteFile(write_end, block.data(), static_cast<DWORD>(got), &written, NULL);
+            }
+            std::fclose(file);
+            CloseHandle(write_end);
+        });
+        CLIPBOARD::STREAM_STATS stats = {};
+        gui.SetClipboardToStream(read_end, &stats);
+        writer.join();
+        CloseHandle(read_end);
+        return stats.characters;
+    });
+
+    std::filesystem::remove(path);
+    BENCH::Report("stream_ingest", "kernel_handles_alive", (double)HEADLESS::GetStats().kernel_handles_alive, "handles");
+}
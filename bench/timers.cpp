@@ -0,0 +1,177 @@
+#include "bench.h"
+#include "../histogram.h"
+#include "../random.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+/*
+"schedule": 100,000 timers at random delays up to 10 s, all cancelled again, in the TIMER_WHEEL against a std::multimap keyed by due time (what a timer queue would usually be).
+Then the same timers fired by advancing the wheel over the 10 s in 1 ms steps.
+"jitter": timers of the main window spread over half a second, fired by RunMainLoop through its waitable timer. How late each one fired, none may fire early.
+"cascade" checks the wheel on simulated time: timers just around the turns of every level and beyond what the top level reaches, some scheduled from callbacks on the way.
+The wheel is advanced in steps of every size and to NextDue. Each timer has to fire once, in the Advance that first reaches its tick, in order, and NextDue may never be after it.
+*/
+
+namespace
+{
+    constexpr int      TIMERS     = 100000;
+    constexpr uint64_t MAX_DELAY  = 10000000000;   // 10 s
+    constexpr int      JITTER     = 1000;
+    constexpr uint64_t SPREAD     = 500000000;     // 0.5 s
+}
+
+BENCH_CASE(timer_schedule)
+{
+    RANDOM random(21);
+    std::vector<uint64_t> delays(TIMERS);
+    for (uint64_t& delay : delays) { delay = random.Next() % MAX_DELAY; }
+
+    const uint64_t origin = 0;
+    TIMER_WHEEL wheel(origin);
+    std::vector<TIMER_WHEEL::TIMER> handles(TIMERS);
+    size_t fired = 0;
+
+    double start = BENCH::NowNs();
+    for (int i = 0; i < TIMERS; i++) { handles[i] = wheel.ScheduleAt(origin + delays[i], [&fired] { fired++; }); }
+    double wheel_schedule_ns = BENCH::NowNs() - start;
+
+    start = BENCH::NowNs();
+    for (int i = 0; i < TIMERS; i++) { wheel.Cancel(handles[i]); }
+    double wheel_cancel_ns = BENCH::NowNs() - start;
+
+    std::multimap<uint64_t, std::function<void()>> queue;
+    std::vector<std::multimap<uint64_t, std::function<void()>>::iterator> entries(TIMERS);
+    start = BENCH::NowNs();
+    for (int i = 0; i < TIMERS; i++) { entries[i] = queue.emplace(origin + delays[i], [&fired] { fired++; }); }
+    double map_schedule_ns = BENCH::NowNs() - start;
+
+    start = BENCH::NowNs();
+    for (int i = 0; i < TIMERS; i++) { queue.erase(entries[i]); }
+    double map_cancel_ns = BENCH::NowNs() - start;
+
+    // Every timer fires once, the far ones after moving down the levels
+    for (int i = 0; i < TIMERS; i++) { wheel.ScheduleAt(origin + delays[i], [&fired] { fired++; }); }
+    const uint64_t cascaded = wheel.GetStats().cascaded;
+    start = BENCH::NowNs();
+    for (uint64_t now = origin; now <= origin + MAX_DELAY + TIMER_WHEEL::TICK_NS; now += 1000000) { wheel.Advance(now); }
+    double fire_ns = BENCH::NowNs() - start;
+
+    BENCH::Report("timer_schedule", "wheel_schedule", wheel_schedule_ns / TIMERS, "ns");
+    BENCH::Report("timer_schedule", "wheel_cancel", wheel_cancel_ns / TIMERS, "ns");
+    BENCH::Report("timer_schedule", "multimap_schedule", map_schedule_ns / TIMERS, "ns");
+    BENCH::Report("timer_schedule", "multimap_cancel", map_cancel_ns / TIMERS, "ns");
+    BENCH::Report("timer_schedule", "wheel_fire", fire_ns / TIMERS, "ns");
+    BENCH::Report("timer_schedule", "cascades_per_timer", static_cast<double>(wheel.GetStats().cascaded - cascaded) / TIMERS, "moves");
+    BENCH::Report("timer_schedule", "not_fired", static_cast<double>(TIMERS - fired), "timers");
+}
+
+BENCH_CASE(timer_jitter)
+{
+    GUI& gui = BENCH::Window();
+    TIMER_WHEEL& timers = gui.GetTimers();
+    HISTOGRAM late;
+    size_t early = 0;
+
+    RANDOM random(21);
+    const uint64_t start = TIMER_WHEEL::Now();
+    for (int i = 0; i < JITTER; i++)
+    {
+        const uint64_t due = start + random.Next() % SPREAD;
+        timers.ScheduleAt(due, [&late, &early, due]
+        {
+            const uint64_t now = TIMER_WHEEL::Now();
+            if (now < due) { early++; }
+            else { late.Record(now - due); }
+        });
+    }
+    timers.ScheduleAt(start + SPREAD, [] { PostQuitMessage(0); });
+    {
+        BENCH::QUIET quiet;
+        gui.RunMainLoop();
+    }
+
+    BENCH::Report("timer_jitter", "fired", static_cast<double>(late.Count()), "timers");
+    BENCH::Report("timer_jitter", "early", static_cast<double>(early), "timers");
+    BENCH::Report("timer_jitter", "late_p50", late.Percentile(50) / 1e3, "us");
+    BENCH::Report("timer_jitter", "late_p99", late.Percentile(99) / 1e3, "us");
+    BENCH::Report("timer_jitter", "late_max", late.Max() / 1e3, "us");
+}
+
+BENCH_CASE(timer_cascade)
+{
+    constexpr int      CASCADE_TIMERS = 4000;
+    constexpr uint64_t REACH   = uint64_t(1) << (TIMER_WHEEL::SLOT_BITS * TIMER_WHEEL::LEVELS);   // ticks the top level covers
+    constexpr uint64_t HORIZON = 2 * REACH;
+    RANDOM random(21);
+
+    // A tick just around a turn of some level, or anywhere up to twice the reach
+    auto pick = [&random]
+    {
+        const uint64_t r = random.Next();
+        switch (r % 6)
+        {
+            case 0:  return (1 + r / 8 % 16) * uint64_t(TIMER_WHEEL::SLOTS) + r / 256 % 3 - 1;
+            case 1:  return (1 + r / 8 % 16) * (uint64_t(1) << 16) + r / 256 % 3 - 1;
+            case 2:  return (1 + r / 8 % 16) * (uint64_t(1) << 24) + r / 256 % 3 - 1;
+            case 3:  return REACH + r / 8 % 3 - 1;
+            case 4:  return 1 + r / 8 % 3;
+            default: return 1 + r / 8 % (HORIZON - 1);
+        }
+    };
+
+    TIMER_WHEEL wheel(0);
+    std::multiset<uint64_t> pending;
+    uint64_t target = 0, previous = 0, last_fired = 0;
+    size_t twice = 0, early = 0, late = 0, out_of_order = 0, next_due_late = 0;
+    std::vector<bool> done;
+
+    // Some callbacks schedule one more, from a tick that is not the start of any level
+    std::function<void(uint64_t)> schedule = [&](uint64_t tick)
+    {
+        const size_t id = done.size();
+        done.push_back(false);
+        pending.insert(tick);
+        wheel.ScheduleAt(tick * TIMER_WHEEL::TICK_NS - random.Next() % TIMER_WHEEL::TICK_NS, [&, id, tick]
+        {
+            twice += done[id];
+            done[id] = true;
+            early += tick > target;
+            late += tick <= previous;
+            out_of_order += tick < last_fired;
+            last_fired = tick;
+            pending.erase(pending.find(tick));
+            const uint64_t next = tick + pick();
+            if (random.Next() % 4 == 0 && next < HORIZON) { schedule(next); }
+        });
+    };
+    for (int i = 0; i < CASCADE_TIMERS; i++) { schedule(pick()); }
+
+    // Every timer is due before HORIZON, one that did not fire by then never will
+    while (!pending.empty() && target < HORIZON)
+    {
+        next_due_late += wheel.NextDue() > *pending.begin() * TIMER_WHEEL::TICK_NS;
+        const uint64_t r = random.Next();
+        uint64_t step;
+        switch (r % 6)
+        {
+            case 0:  step = 1 + r / 8 % 3; break;
+            case 1:  step = 1 + r / 8 % (2 * TIMER_WHEEL::SLOTS); break;
+            case 2:  step = 1 + r / 8 % (uint64_t(1) << 17); break;
+            case 3:  step = 1 + r / 8 % (uint64_t(1) << 25); break;
+            default: step = std::min(wheel.NextDue() / TIMER_WHEEL::TICK_NS, HORIZON) - target; break;
+        }
+        previous = target;
+        target  += step;
+        wheel.Advance(target * TIMER_WHEEL::TICK_NS + r / 64 % TIMER_WHEEL::TICK_NS);
+    }
+
+    BENCH::Report("timer_cascade", "timers", static_cast<double>(done.size()), "timers");
+    BENCH::Report("timer_cascade", "not_fired", static_cast<double>(std::count(done.begin(), done.end(), false)), "timers");
+    BENCH::Report("timer_cascade", "fired_twice", static_cast<double>(twice), "timers");
+    BENCH::Report("timer_cascade", "early", static_cast<double>(early), "timers");
+    BENCH::Report("timer_cascade", "late", static_cast<double>(late), "timers");
+    BENCH::Report("timer_cascade", "out_of_order", static_cast<double>(out_of_order), "timers");
+    BENCH::Report("timer_cascade", "next_due_late", static_cast<double>(next_due_late), "calls");
+}
@@ -0,0 +1,75 @@
+#include "bench.h"
+#include "../trace.h"
+#include <sstream>
+
+/*
+Cost of a span with tracing off and on, and a traced startup of the main window.
+*/
+
+namespace
+{
+    [[gnu::noinline]] int Traced(int value)
+    {
+        TRACE_SPAN("bench");
+        return value + 1;
+    }
+
+    double NsPerSpan(int spans)
+    {
+        volatile int sink = 0;
+        double start = BENCH::NowNs();
+        for (int i = 0; i < spans; i++) { sink = Traced(sink); }
+        return (BENCH::NowNs() - start) / spans;
+    }
+
+    // Runs CreateMainWindow of a second GUI. Returns the time it took
+    double Startup()
+    {
+        // The class of the main window can only be registered once. Windows that already exist keep their window procedure
+        UnregisterClass(L"MainWindowClass", GetModuleHandle(0));
+        double start = BENCH::NowNs();
+        {
+            BENCH::QUIET quiet;
+            GUI gui;
+            gui.CreateMainWindow(341, 399, L"Jordans winapi demo");
+            start = BENCH::NowNs() - start;
+            DestroyWindow(gui.GetWindowHandle());
+        }
+        UnregisterClass(L"MainWindowClass", GetModuleHandle(0));
+
+        // WM_DESTROY posted WM_QUIT, do not leave it for the next case
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {}
+        return start;
+    }
+}
+
+BENCH_CASE(trace_span)
+{
+    TRACE::Stop();
+    BENCH::Report("trace_span", "off", NsPerSpan(10000000), "ns/span");
+
+    TRACE::Clear();
+    TRACE::Start();
+    BENCH::Report("trace_span", "on", NsPerSpan(1000000), "ns/span");
+    TRACE::Stop();
+    TRACE::Clear();
+}
+
+BENCH_CASE(trace_startup)
+{
+    double untraced = Startup();
+
+    TRACE::Clear();
+    TRACE::Start();
+    double traced = Startup();
+    TRACE::Stop();
+
+    std::ostringstream json;
+    TRACE::WriteJson(json);
+    BENCH::Report("trace_startup", "create_main_window", untraced / 1e3, "us");
+    BENCH::Report("trace_startup", "create_main_window_traced", traced / 1e3, "us");
+    BENCH::Report("trace_startup", "spans", (double)TRACE::SpanCount(), "spans");
+    BENCH::Report("trace_startup", "json", (double)json.str().size(), "bytes");
+    TRACE::Clear();
+}
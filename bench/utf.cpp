@@ -0,0 +1,252 @@
+#include "bench.h"
+#include "../utf.h"
+#include "../random.h"
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Transcoding throughput on mostly ASCII text (prose with the odd accented letter) and on mostly CJK text.
+"per_char" is the one character at a time loop callers had to write before, for comparison.
+GB/s are of the input. The case without suffix is the code path UTF picked for this CPU, the others (e.g. utf_cjk_heavy_sse2) are the paths it has besides.
+"utf_invalid" checks that invalid UTF-8, lone surrogates and values above U+10FFFF become U+FFFD, alone and between CJK and ASCII runs at every offset of a vector block.
+It runs every code path the CPU has, IsValidUtf8 also against the scalar decoder on random mixes of valid and broken sequences.
+*/
+
+namespace
+{
+    constexpr size_t CHARACTERS = size_t(8) << 20;
+
+    // Code paths UTF may pick, the best first
+    constexpr const char* IMPLEMENTATIONS[] = {"avx2", "ssse3", "sse2", "scalar"};
+
+    // Runs check once with every code path the CPU has, then goes back to the one UTF picked
+    template<class CHECK>
+    void ForEachImplementation(CHECK check)
+    {
+        const char* picked = UTF::Implementation();
+        for (const char* name : IMPLEMENTATIONS)
+        {
+            if (UTF::SetImplementation(name)) { check(name, std::string_view(name) == picked); }
+        }
+        UTF::SetImplementation(picked);
+    }
+
+    std::u16string AsciiHeavy()
+    {
+        std::u16string text;
+        const char16_t* sentence = u"The quick brown fox jumps over the lazy dog near the café. ";
+        while (text.size() < CHARACTERS) { text += sentence; }
+        text.resize(CHARACTERS);
+        return text;
+    }
+
+    std::u16string CjkHeavy()
+    {
+        std::u16string text;
+        for (size_t i = 0; text.size() < CHARACTERS; i++)
+        {
+            text += static_cast<char16_t>(0x4E00 + (i * 7919) % 0x5000);
+            if (i % 20 == 19) { text += u"。"; }
+            if (i % 50 == 49) { text += u' '; }
+        }
+        text.resize(CHARACTERS);
+        return text;
+    }
+
+    // What a caller wrote by hand: one code unit at a time, no surrogate handling
+    size_t PerCharToUtf8(const std::u16string& text, char* out)
+    {
+        size_t written = 0;
+        for (char16_t c : text)
+        {
+            if (c < 0x80) { out[written++] = static_cast<char>(c); }
+            else if (c < 0x800) { out[written++] = static_cast<char>(0xC0 | (c >> 6)); out[written++] = static_cast<char>(0x80 | (c & 0x3F)); }
+            else
+            {
+                out[written++] = static_cast<char>(0xE0 | (c >> 12));
+                out[written++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out[written++] = static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
+        return written;
+    }
+
+    template<class F>
+    double GBPerSecond(size_t bytes, F convert)
+    {
+        constexpr int REPEAT = 5;
+        double best = 1e300;
+        for (int i = 0; i < REPEAT; i++)
+        {
+            double start = BENCH::NowNs();
+            convert();
+            best = std::min(best, BENCH::NowNs() - start);
+        }
+        return bytes / best;
+    }
+
+    void Measure(const char* case_name, const std::u16string& text)
+    {
+        std::vector<char>     utf8(text.size() * 3);
+        std::vector<char16_t> utf16(text.size() * 3);
+        volatile size_t sink = 0;
+        size_t utf16_bytes = text.size() * sizeof(char16_t);
+
+        BENCH::Report(case_name, "utf16_to_utf8_per_char", GBPerSecond(utf16_bytes, [&] { sink = PerCharToUtf8(text, utf8.data()); }), "GB/s");
+        BENCH::Report(case_name, "utf16_to_utf8", GBPerSecond(utf16_bytes, [&] { sink = UTF::ToUtf8(text.data(), text.size(), utf8.data()).written; }), "GB/s");
+        BENCH::Report(case_name, "utf8_length", GBPerSecond(utf16_bytes, [&] { sink = UTF::Utf8Length(text.data(), text.size()); }), "GB/s");
+
+        size_t utf8_bytes = UTF::ToUtf8(text.data(), text.size(), utf8.data()).written;
+        BENCH::Report(case_name, "utf8_to_utf16", GBPerSecond(utf8_bytes, [&] { sink = UTF::FromUtf8(utf8.data(), utf8_bytes, utf16.data()).written; }), "GB/s");
+        BENCH::Report(case_name, "utf8_validate", GBPerSecond(utf8_bytes, [&] { sink = UTF::IsValidUtf8(utf8.data(), utf8_bytes); }), "GB/s");
+        BENCH::Report(case_name, "utf16_to_latin1", GBPerSecond(utf16_bytes, [&] { sink = UTF::ToLatin1(text.data(), text.size(), utf8.data()).written; }), "GB/s");
+        (void)sink;
+    }
+}
+
+namespace
+{
+    struct UTF8_CASE
+    {
+        std::string    text;
+        std::u32string expected;
+        size_t         errors;
+    };
+
+    struct WIDE_CASE
+    {
+        std::u32string text;      // code units, char16_t ones are below 0x10000
+        std::string    expected;
+        size_t         errors;
+    };
+
+    std::u16string Utf16(const std::u32string& text)
+    {
+        std::u16string units;
+        for (char32_t c : text)
+        {
+            if (c < 0x10000) { units += static_cast<char16_t>(c); continue; }
+            units += static_cast<char16_t>(0xD800 + ((c - 0x10000) >> 10));
+            units += static_cast<char16_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+        }
+        return units;
+    }
+
+    std::string Utf8(const std::u32string& text)
+    {
+        std::vector<char> bytes(text.size() * 4);
+        return std::string(bytes.data(), UTF::ToUtf8(text.data(), text.size(), bytes.data()).written);
+    }
+}
+
+BENCH_CASE(utf_invalid)
+{
+    size_t mismatches = 0, errors_miscounted = 0, checked = 0;
+    ForEachImplementation([&](const char*, bool)
+    {
+        // One U+FFFD per maximal subpart of an invalid sequence, like the unicode standard recommends
+        const UTF8_CASE utf8_cases[] = {
+            {"\xE2\x82" "A",         U"\uFFFDA",                  1},  // cut off sequence
+            {"\xC0\x80",             U"\uFFFD\uFFFD",             2},  // overlong NUL
+            {"\xE0\x80\xAF",         U"\uFFFD\uFFFD\uFFFD",       3},  // overlong '/'
+            {"\xED\xA0\x80",         U"\uFFFD\uFFFD\uFFFD",       3},  // encoded surrogate
+            {"\xF4\x90\x80\x80",     U"\uFFFD\uFFFD\uFFFD\uFFFD", 4},  // above U+10FFFF
+            {"\xF0\x9F\x98",         U"\uFFFD",                   1},  // cut off at the end
+            {"\x80\xBF",             U"\uFFFD\uFFFD",             2},  // continuation bytes alone
+            {"\xFF\xFE",             U"\uFFFD\uFFFD",             2},
+            {"\xF0\x9F\x98\x80",     U"\U0001F600",               0},  // valid, a surrogate pair in UTF-16
+        };
+        const WIDE_CASE wide_cases[] = {
+            {{0xD800, U'A'},   "\xEF\xBF\xBD" "A",             1},  // high surrogate alone
+            {{0xDC00},         "\xEF\xBF\xBD",                 1},  // low surrogate alone
+            {{0xDC00, 0xD800}, "\xEF\xBF\xBD\xEF\xBF\xBD",     2},  // pair the wrong way round
+            {{0xD83D, 0xDE00}, "\xF0\x9F\x98\x80",             0},
+        };
+
+        // Alone and between runs the vector paths take, with 0 to 15 ASCII characters in front to start it at every offset of a block
+        const std::u32string cjk(40, U'\u4E2D');
+        const std::u32string ascii(40, U'a');
+        for (const std::u32string* context : {static_cast<const std::u32string*>(nullptr), &cjk, &ascii})
+        {
+            for (size_t pad = 0; pad < (context ? 16 : 1); pad++)
+            {
+                const std::u32string before = context ? *context + std::u32string(pad, U'x') : U"";
+                const std::u32string after  = context ? *context : U"";
+                for (const UTF8_CASE& test : utf8_cases)
+                {
+                    const std::string    text     = Utf8(before) + test.text + Utf8(after);
+                    const std::u32string expected = before + test.expected + after;
+                    std::vector<char32_t> wide(text.size());
+                    std::vector<char16_t> units(text.size());
+                    const UTF::RESULT to32 = UTF::FromUtf8(text.data(), text.size(), wide.data());
+                    const UTF::RESULT to16 = UTF::FromUtf8(text.data(), text.size(), units.data());
+                    mismatches += std::u32string(wide.data(), to32.written) != expected;
+                    mismatches += std::u16string(units.data(), to16.written) != Utf16(expected);
+                    errors_miscounted += (to32.errors != test.errors) + (to16.errors != test.errors);
+                    errors_miscounted += UTF::IsValidUtf8(text.data(), text.size()) != (test.errors == 0);
+                    checked += 2;
+                }
+                for (const WIDE_CASE& test : wide_cases)
+                {
+                    const std::u32string text     = before + test.text + after;
+                    const std::u16string units(text.begin(), text.end());
+                    const std::string    expected = Utf8(before) + test.expected + Utf8(after);
+                    std::vector<char> bytes(text.size() * 3);
+                    const UTF::RESULT from16 = UTF::ToUtf8(units.data(), units.size(), bytes.data());
+                    mismatches += std::string(bytes.data(), from16.written) != expected;
+                    mismatches += UTF::Utf8Length(units.data(), units.size()) != expected.size();
+                    errors_miscounted += from16.errors != test.errors;
+                    checked++;
+                }
+            }
+        }
+
+        // UTF-32 has no pairs: surrogates and values above U+10FFFF are invalid units
+        const std::u32string wide = {U'a', 0xD800, 0x110000, 0xFFFFFFFF, 0x10FFFF};
+        std::vector<char> bytes(wide.size() * 4);
+        const UTF::RESULT from32 = UTF::ToUtf8(wide.data(), wide.size(), bytes.data());
+        mismatches += std::string(bytes.data(), from32.written) != "a\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\xF4\x8F\xBF\xBF";
+        errors_miscounted += from32.errors != 3;
+
+        // Latin-1 has no U+FFFD, a lone surrogate is one '?' like any other character it cannot hold
+        const std::u16string latin = {u'\u00E9', 0xD800, u'\u4E2D', u'a'};
+        char narrow[4];
+        const UTF::RESULT to_latin1 = UTF::ToLatin1(latin.data(), latin.size(), narrow);
+        mismatches += std::string(narrow, to_latin1.written) != "\xE9??a";
+        errors_miscounted += to_latin1.errors != 2;
+        checked += 2;
+
+        // Valid text with a broken or valid sequence dropped in at random, the scalar decoder counts the errors
+        RANDOM random(15);
+        const std::string pieces[] = {"a", "\xC3\xA9", "\xE4\xB8\xAD", "\xF0\x9F\x98\x80", "\xE2\x82", "\xC0\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80",
+                                      "\x80", "\xFF", "\xF0\x9F\x98", "\xEF\xBF\xBF", "\xF4\x8F\xBF\xBF", "\xE0\xA0\x80", "\xDF\xBF"};
+        std::vector<char32_t> decoded;
+        for (int round = 0; round < 20000; round++)
+        {
+            std::string text;
+            const size_t length = random.Next() % 80;
+            while (text.size() < length) { text += random.Next() % 4 ? pieces[random.Next() % 4] : pieces[random.Next() % std::size(pieces)]; }
+            decoded.resize(text.size());
+            errors_miscounted += UTF::IsValidUtf8(text.data(), text.size()) != (UTF::FromUtf8(text.data(), text.size(), decoded.data()).errors == 0);
+            checked++;
+        }
+    });
+
+    BENCH::Report("utf_invalid", "checked", static_cast<double>(checked), "texts");
+    BENCH::Report("utf_invalid", "mismatches", static_cast<double>(mismatches), "texts");
+    BENCH::Report("utf_invalid", "errors_miscounted", static_cast<double>(errors_miscounted), "texts");
+}
+
+BENCH_CASE(utf_ascii_heavy)
+{
+    const std::u16string text = AsciiHeavy();
+    ForEachImplementation([&](const char* name, bool picked) { Measure(picked ? "utf_ascii_heavy" : ("utf_ascii_heavy_" + std::string(name)).c_str(), text); });
+}
+
+BENCH_CASE(utf_cjk_heavy)
+{
+    const std::u16string text = CjkHeavy();
+    ForEachImplementation([&](const char* name, bool picked) { Measure(picked ? "utf_cjk_heavy" : ("utf_cjk_heavy_" + std::string(name)).c_str(), text); });
+}
@@ -0,0 +1,93 @@
+#include "bench.h"
+#include "../log.h"
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <malloc.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Opens 1,000 main windows, each on its own thread with its own message loop (GUI::Spawn), then closes all of them with WM_CLOSE.
+"open" is from the first Spawn until every window is created and laid out, "close" from the first WM_CLOSE until every thread has ended.
+Memory is the resident size while all windows are open, minus before, per window. Thread stacks are included, only the pages they touched.
+Most of it is pixels: the headless window surface and the back buffer of the PAINTER, about 1.3 MB at this size.
+The second round shows what the first one left behind: windows, GDI objects, log rings and the heap should all be back where they started.
+The resident size is not, glibc keeps what the threads freed in its per thread arenas and the next round reuses it.
+*/
+
+namespace
+{
+    constexpr int WINDOWS = 1000;
+    constexpr int ROUNDS  = 2;
+
+    size_t Rss()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.rfind("VmRSS:", 0) == 0) { return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024; }
+        }
+        return 0;
+    }
+}
+
+BENCH_CASE(window_churn)
+{
+    HEADLESS::STATS start = HEADLESS::GetStats();
+    LOG::STATS start_log  = LOG::GetStats();
+    size_t start_heap     = mallinfo2().uordblks;
+
+    for (int round = 1; round <= ROUNDS; round++)
+    {
+        std::mutex              mutex;
+        std::condition_variable opened;
+        std::vector<HWND>       handles;
+        int                     failed = 0;
+        handles.reserve(WINDOWS);
+
+        size_t rss_before = Rss();
+        double open_start = BENCH::NowNs();
+        std::vector<std::thread> threads;
+        threads.reserve(WINDOWS);
+        for (int i = 0; i < WINDOWS; i++)
+        {
+            threads.push_back(GUI::Spawn(341, 399, L"Jordans winapi demo", [&](GUI& gui)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (gui.GetWindowHandle()) { handles.push_back(gui.GetWindowHandle()); } else { failed++; }
+                opened.notify_one();
+            }));
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            opened.wait(lock, [&] { return int(handles.size()) + failed == WINDOWS; });
+        }
+        double open_ns = BENCH::NowNs() - open_start;
+        size_t rss_open = Rss();
+
+        double close_start = BENCH::NowNs();
+        for (HWND hWnd : handles) { PostMessage(hWnd, WM_CLOSE, 0, 0); }
+        for (std::thread& thread : threads) { thread.join(); }
+        double close_ns = BENCH::NowNs() - close_start;
+
+        std::string name = "window_churn_round" + std::to_string(round);
+        BENCH::Report(name.c_str(), "open", WINDOWS / (open_ns / 1e9), "windows/s");
+        BENCH::Report(name.c_str(), "close", WINDOWS / (close_ns / 1e9), "windows/s");
+        BENCH::Report(name.c_str(), "rss_per_window", rss_open > rss_before ? double(rss_open - rss_before) / WINDOWS / 1024 : 0, "KB");
+        BENCH::Report(name.c_str(), "failed", (double)failed, "windows");
+    }
+
+    LOG::Flush();
+    HEADLESS::STATS end = HEADLESS::GetStats();
+    LOG::STATS end_log  = LOG::GetStats();
+    size_t end_heap     = mallinfo2().uordblks;
+    BENCH::Report("window_churn", "gui_size", (double)sizeof(GUI) / 1024, "KB");
+    BENCH::Report("window_churn", "windows_leaked", double(end.windows_alive) - double(start.windows_alive), "windows");
+    BENCH::Report("window_churn", "gdi_objects_leaked", double(end.gdi_objects_alive) - double(start.gdi_objects_alive), "objects");
+    BENCH::Report("window_churn", "log_threads_left", double(end_log.threads) - double(start_log.threads), "threads");
+    BENCH::Report("window_churn", "heap_retained", (double(end_heap) - double(start_heap)) / 1024, "KB");
+}
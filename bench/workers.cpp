@@ -0,0 +1,154 @@
+#include "bench.h"
+#include "../hash.h"
+#include "../histogram.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Worker pool driven through the message loop of the main window: tasks go out to the workers, results come back as WM_WORKER_DONE.
+*/
+
+namespace
+{
+    // Submits the next task from the done function of the previous one, so only one task is in flight
+    struct PING_PONG
+    {
+        WORKER_POOL& workers;
+        HISTOGRAM    round_trip;
+        size_t       left;
+
+        void Next()
+        {
+            if (left-- == 0) { PostQuitMessage(0); return; }
+            double submitted = BENCH::NowNs();
+            workers.Submit([] { return 0; }, [this, submitted](int)
+            {
+                round_trip.Record(static_cast<uint64_t>(BENCH::NowNs() - submitted));
+                Next();
+            });
+        }
+    };
+
+    void RunLoop()
+    {
+        BENCH::QUIET quiet;
+        BENCH::Window().RunMainLoop();
+    }
+}
+
+BENCH_CASE(workers_round_trip)
+{
+    WORKER_POOL& workers = BENCH::Window().GetWorkers();
+    PING_PONG ping_pong{workers, {}, 20000};
+    ping_pong.Next();
+    RunLoop();
+
+    BENCH::Report("workers_round_trip", "threads", static_cast<double>(workers.GetStats().threads), "threads");
+    BENCH::Report("workers_round_trip", "p50", ping_pong.round_trip.Percentile(50) / 1e3, "us");
+    BENCH::Report("workers_round_trip", "p99", ping_pong.round_trip.Percentile(99) / 1e3, "us");
+    BENCH::Report("workers_round_trip", "p999", ping_pong.round_trip.Percentile(99.9) / 1e3, "us");
+}
+
+BENCH_CASE(workers_throughput)
+{
+    // Hashes 64 KB per task, results are collected on the UI thread
+    constexpr size_t tasks = 20000;
+    static std::vector<unsigned char> block(64 * 1024, 0x5A);
+
+    WORKER_POOL& workers = BENCH::Window().GetWorkers();
+    WORKER_POOL::STATS before = workers.GetStats();
+    size_t done = 0;
+    double start = BENCH::NowNs();
+    for (size_t i = 0; i < tasks; i++)
+    {
+        workers.Submit([i] { return HASH::Of(block.data(), block.size()) ^ i; }, [&](uint64_t hash)
+        {
+            (void)hash;
+            if (++done == tasks) { PostQuitMessage(0); }
+        });
+    }
+    RunLoop();
+    double seconds = (BENCH::NowNs() - start) / 1e9;
+    WORKER_POOL::STATS after = workers.GetStats();
+
+    BENCH::Report("workers_throughput", "tasks", tasks / seconds, "tasks/s");
+    BENCH::Report("workers_throughput", "hashed", tasks * block.size() / seconds / (1 << 20), "MB/s");
+    BENCH::Report("workers_throughput", "stolen", static_cast<double>(after.stolen - before.stolen), "tasks");
+}
+
+BENCH_CASE(workers_steal)
+{
+    // Four workers, every task spawns its subtasks on its own deque. The idle workers have to steal them
+    constexpr size_t parents = 200, children = 64;
+    WORKER_POOL pool(4);
+    std::atomic<size_t> finished{0};
+    double start = BENCH::NowNs();
+    for (size_t i = 0; i < parents; i++)
+    {
+        pool.Submit([&pool, &finished]
+        {
+            for (size_t c = 0; c < children; c++)
+            {
+                pool.Submit([c] { return HASH::Of(&c, sizeof(c)); }, [&finished](uint64_t) { finished++; });
+            }
+        }, [] {});
+    }
+
+    // No window, the results are picked up by polling
+    while (finished < parents * children) { pool.RunCompletions(); std::this_thread::yield(); }
+    double elapsed = BENCH::NowNs() - start;
+    WORKER_POOL::STATS stats = pool.GetStats();
+
+    BENCH::Report("workers_steal", "task", elapsed / (parents * children), "ns/task");
+    BENCH::Report("workers_steal", "stolen", 100.0 * stats.stolen / stats.submitted, "%");
+}
+
+BENCH_CASE(workers_cancel)
+{
+    // Everything that did not run yet is dropped, no done function runs afterwards
+    WORKER_POOL& workers = BENCH::Window().GetWorkers();
+    WORKER_POOL::STATS before = workers.GetStats();
+    size_t done = 0;
+    for (size_t i = 0; i < 10000; i++) { workers.Submit([] { return 0; }, [&done](int) { done++; }); }
+    workers.Cancel();
+    PostQuitMessage(0);
+    RunLoop();
+    WORKER_POOL::STATS after = workers.GetStats();
+
+    BENCH::Report("workers_cancel", "cancelled", static_cast<double>(after.cancelled - before.cancelled), "tasks");
+    BENCH::Report("workers_cancel", "done_after_cancel", static_cast<double>(done), "tasks");
+}
+
+BENCH_CASE(workers_clipboard_large_text)
+{
+    // "Clipboard Test" with 4M characters in the edit control. The UI thread only publishes, the history hash runs on a worker
+    GUI& gui  = BENCH::Window();
+    HWND hWnd = gui.GetWindowHandle();
+    HWND edit = GetDlgItem(hWnd, ID_TEXT_EDIT);
+    std::wstring text(size_t(4) << 20, L'x');
+    text[12345] = L'y';  // not deduplicated against earlier cases
+    SetWindowText(edit, text.c_str());
+
+    double start = BENCH::NowNs();
+    {
+        BENCH::QUIET quiet;
+        SendMessage(hWnd, WM_COMMAND, MAKEWPARAM(ID_CLIPBOARD_BUTTON, BN_CLICKED), 0);
+    }
+    double ui_ns = BENCH::NowNs() - start;
+
+    // Wait for the worker and the WM_WORKER_DONE that adds the text to the history
+    WORKER_POOL::STATS before = gui.GetWorkers().GetStats();
+    while (gui.GetWorkers().GetStats().completed == before.completed)
+    {
+        MSG msg;
+        if (GetMessage(&msg, NULL, 0, 0) <= 0) { break; }
+        DispatchMessage(&msg);
+    }
+    double total_ns = BENCH::NowNs() - start;
+    SetWindowText(edit, L"");
+
+    BENCH::Report("workers_clipboard_large_text", "ui_thread", ui_ns / 1e6, "ms");
+    BENCH::Report("workers_clipboard_large_text", "until_in_history", total_ns / 1e6, "ms");
+}
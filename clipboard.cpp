@@ -1,32 +1,464 @@
 #include "clipboard.h"
-#include <iostream>
-#include <windows.h>
+#include <chrono>
+#include <cstring>
+#include "platform.h"
+#include "trace.h"
+#include "log.h"
+#include "utf.h"
+
+namespace
+{
+    // Calls convert(text, length) for every chunk of the payload. A surrogate pair split between two chunks is passed on as one piece
+    // Compressed chunks are decompressed one at a time as the conversion gets to them. False at a damaged one
+    template<class CONVERT>
+    bool forEachPiece(const PAYLOAD& payload, CONVERT convert)
+    {
+        PAYLOAD::READER reader(payload);
+        UTF::WIDE pair[2];
+        bool pending = false;
+        for (size_t i = 0; i < payload.ChunkCount(); i++)
+        {
+            size_t length;
+            const WCHAR* chunk = reader.Chunk(i, &length);
+            if (!chunk) { return false; }
+            const UTF::WIDE* text = UTF::Wide(chunk);
+            if (pending && length)
+            {
+                pair[1] = *text++;
+                length--;
+                convert(pair, 2);
+                pending = false;
+            }
+            if (i + 1 < payload.ChunkCount() && length && UTF::IsHighSurrogate(text[length - 1]))
+            {
+                pair[0] = text[--length];
+                pending = true;
+            }
+            convert(text, length);
+        }
+        if (pending) { convert(pair, 1); }
+        return true;
+    }
+
+    // Length of a UTF-8 byte order mark at the start of text, 0 if there is none. It is not part of the text
+    size_t byteOrderMark(const char* text, size_t length)
+    {
+        return length >= 3 && std::memcmp(text, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    }
+
+    // Reads a block from input. 0 at the end of input. A pipe whose writer closed its end is the regular end, not an error
+    bool readBlock(HANDLE input, char* buffer, size_t size, size_t* read)
+    {
+        DWORD bytes = 0;
+        BOOL ok = ReadFile(input, buffer, static_cast<DWORD>(size), &bytes, NULL);
+        *read = bytes;
+        return ok || GetLastError() == ERROR_BROKEN_PIPE;
+    }
+
+    /*
+    Decodes the whole file behind input through a read only view, the page cache is the only other copy.
+    Returns false if input is no file or can not be mapped (empty, or too big for a 32 bit address space), reading it still works then.
+    The file is mapped from its start, no matter where its file pointer is.
+    */
+    bool appendMappedFile(HANDLE input, PAYLOAD& payload, CLIPBOARD::STREAM_STATS& stats)
+    {
+        LARGE_INTEGER size;
+        if (GetFileType(input) != FILE_TYPE_DISK || !GetFileSizeEx(input, &size) || size.QuadPart <= 0) { return false; }
+        if (static_cast<uint64_t>(size.QuadPart) > SIZE_MAX) { return false; }
+        HANDLE mapping = CreateFileMapping(input, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) { return false; }
+        const char* text = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping); // The view keeps the mapping alive
+        if (!text) { return false; }
+
+        const size_t length = static_cast<size_t>(size.QuadPart);
+        const size_t skip   = byteOrderMark(text, length);
+        UTF::RESULT decoded = payload.AppendUtf8(text + skip, length - skip);
+        UnmapViewOfFile(text);
+        stats.bytes  = length - skip;
+        stats.errors = decoded.errors;
+        stats.mapped = true;
+        return true;
+    }
+
+    // Reads input in blocks until its end. A sequence cut off at the end of a block is moved to the front and completed by the next one
+    bool appendBlocks(HANDLE input, PAYLOAD& payload, CLIPBOARD::STREAM_STATS& stats)
+    {
+        std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(CLIPBOARD::STREAM_BLOCK_BYTES);
+        size_t carried = 0;
+        bool   started = false; // the byte order mark was checked
+        for (;;)
+        {
+            size_t read;
+            if (!readBlock(input, buffer.get() + carried, CLIPBOARD::STREAM_BLOCK_BYTES - carried, &read)) { return false; }
+            if (read == 0) { break; }
+            size_t available = carried + read;
+            size_t start     = 0;
+            if (!started)
+            {
+                if (available < 3) { carried = available; continue; }
+                start   = byteOrderMark(buffer.get(), available);
+                started = true;
+            }
+            size_t complete = start + UTF::CompleteUtf8(buffer.get() + start, available - start);
+            stats.errors += payload.AppendUtf8(buffer.get() + start, complete - start).errors;
+            stats.bytes  += complete - start;
+            carried = available - complete;
+            std::memmove(buffer.get(), buffer.get() + complete, carried);
+        }
+        // Whatever is left was cut off by the end of input and becomes U+FFFD
+        stats.errors += payload.AppendUtf8(buffer.get(), carried).errors;
+        stats.bytes  += carried;
+        return true;
+    }
+}
 
 std::string CLIPBOARD::getStringFromStdin()
 {
+    // Raw blocks instead of iostreams, every line and line ending stays as it is
     std::string stringFromStdin;
-    std::cin.ignore(); // Ignore 
-    getline(std::cin, stringFromStdin);
-
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    size_t length = 0;
+    for (;;)
+    {
+        stringFromStdin.resize(length + STREAM_BLOCK_BYTES);
+        size_t read;
+        if (!readBlock(input, stringFromStdin.data() + length, STREAM_BLOCK_BYTES, &read)) { LOG_ERROR(L"Reading stdin failed. Errnum =", GetLastError()); break; }
+        if (read == 0) { break; }
+        length += read;
+    }
+    stringFromStdin.resize(length);
     return stringFromStdin;
 };
 
 
+bool CLIPBOARD::setClipboardToStream(HWND hWnd, HANDLE input, STREAM_STATS* stats)
+{
+    TRACE_SPAN("CLIPBOARD::setClipboardToStream");
+    const auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<PAYLOAD> newPayload = createPayload();
+    STREAM_STATS result = {};
+    if (!appendMappedFile(input, *newPayload, result) && !appendBlocks(input, *newPayload, result))
+    {
+        LOG_ERROR(L"Reading the stream failed. Errnum =", GetLastError());
+        return false;
+    }
+    result.characters = newPayload->Length();
+    result.elapsed_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    if (result.errors) { LOG_WARN(L"Replaced invalid UTF-8 sequences:", result.errors); }
+    LOG_INFO(L"Read", result.bytes, L"bytes in", result.elapsed_ns / 1000000, L"ms", result.mapped ? L"(mapped)" : L"(read)");
+    if (stats) { *stats = result; }
+    publishText(hWnd, std::move(newPayload));
+    return true;
+}
+
+
 void CLIPBOARD::setClipboardToString(HWND hWnd, LPWSTR clipboardString)
 {
-    
-    const size_t len = wcslen(clipboardString) + 1; // defines size for buffer with terminate char
-    //allocate memory
-    HGLOBAL hMem =  GlobalAlloc(GMEM_MOVEABLE, sizeof(WCHAR) * len);
-    wcscpy((WCHAR*)GlobalLock(hMem), clipboardString);
-    GlobalUnlock(hMem);
+    const size_t len = wcslen(clipboardString); // size without terminate char, the payload adds it when rendering
+    std::shared_ptr<PAYLOAD> newPayload = std::make_shared<PAYLOAD>(clipboardString, len, pool);
+    publishText(hWnd, std::move(newPayload));
+};
+
+
+void CLIPBOARD::setClipboardToUtf8(HWND hWnd, const char* text, size_t length)
+{
+    TRACE_SPAN("CLIPBOARD::setClipboardToUtf8");
+    std::shared_ptr<PAYLOAD> newPayload = createPayload();
+    UTF::RESULT decoded = newPayload->AppendUtf8(text, length);
+    if (decoded.errors) { LOG_WARN(L"Replaced invalid UTF-8 sequences:", decoded.errors); }
+    publishText(hWnd, std::move(newPayload));
+}
 
+
+bool CLIPBOARD::setClipboardToWindowText(HWND hWnd, HWND source)
+{
+    TRACE_SPAN("CLIPBOARD::setClipboardToWindowText");
+    std::shared_ptr<PAYLOAD> newPayload = readWindowText(source);
+    if (!newPayload) { return false; }
+    publishText(hWnd, std::move(newPayload));
+    return true;
+}
+
+
+std::shared_ptr<PAYLOAD> CLIPBOARD::readWindowText(HWND source)
+{
+    const int len = GetWindowTextLength(source);
+    if (len <= 0) { return nullptr; }
+
+    // GetWindowText writes the text and the terminate char directly into the payload, no temporary buffer
+    std::shared_ptr<PAYLOAD> newPayload = createPayload();
+    WCHAR* text = newPayload->Reserve((size_t)len + 1);
+    const int copied = GetWindowText(source, text, len + 1);
+    if (copied <= 0) { return nullptr; }
+    newPayload->Commit((size_t)copied); // without terminate char, it gets added when rendering
+    return newPayload;
+}
+
+
+void CLIPBOARD::setClipboardToPayload(HWND hWnd, std::shared_ptr<const PAYLOAD> newPayload, bool remember)
+{
+    TRACE_SPAN("CLIPBOARD::setClipboardToPayload");
     int clipBoardOpened = OpenClipboard(hWnd);
-    if(clipBoardOpened){std::wcout << "Clipboard opened\n";}
-    EmptyClipboard();
-    std::wcout << "Clipboard emptied\n";
-    SetClipboardData(CF_UNICODETEXT, hMem);
-    std::wcout << L"Clipboard set to " << clipboardString << std::endl;
+    if(!clipBoardOpened){LOG_ERROR(L"Clipboard could not be opened. Errnum =", GetLastError()); return;}
+    LOG_DEBUG(L"Clipboard opened");
+    EmptyClipboard(); // Sends WM_DESTROYCLIPBOARD to the previous owner, so this needs to happen before taking the new payload
+    LOG_DEBUG(L"Clipboard emptied");
+    payload = std::move(newPayload);
+
+    // NULL data means delayed rendering. We will get WM_RENDERFORMAT once somebody pastes
+    for (UINT format : formats()) { if (format) { SetClipboardData(format, NULL); } }
+    LOG_INFO(L"Clipboard set to", payload->Length(), L"characters");
     int clipBoardClosed = CloseClipboard();
-    std::wcout << "Clipboard closed = " << clipBoardClosed << std::endl;
+    LOG_DEBUG(L"Clipboard closed =", clipBoardClosed);
+
+    // Remember it. Repeated copies of the same text are only stored once
+    if (remember) { afterPublish(payload, false); }
 };
+
+
+void CLIPBOARD::publishText(HWND hWnd, std::shared_ptr<const PAYLOAD> newPayload)
+{
+    setClipboardToPayload(hWnd, newPayload, false);
+    if (payload != newPayload) { return; } // the clipboard could not be opened
+    afterPublish(newPayload, compressionMinCharacters && newPayload->Length() >= compressionMinCharacters);
+}
+
+
+void CLIPBOARD::setWorkers(WORKER_POOL* pool)
+{
+    workers = pool;
+}
+
+
+void CLIPBOARD::afterPublish(std::shared_ptr<const PAYLOAD> published, bool compress)
+{
+    compress = compress && !published->IsCompressed();
+    {
+        std::lock_guard<std::mutex> lock(remembered->pending_mutex);
+        remembered->pending.push_back({std::move(published), compress});
+    }
+    if (!workers)
+    {
+        swapCompressed(addPending(*remembered, nullptr));
+        return;
+    }
+
+    // Every publish submits a task. A task dropped by WORKER_POOL::Cancel leaves its payload to the next one
+    workers->Submit([remembered = remembered, pool = workers] { return addPending(*remembered, pool); },
+                    [this](std::vector<COMPRESSED> compressed) { swapCompressed(compressed); });
+}
+
+
+std::vector<CLIPBOARD::COMPRESSED> CLIPBOARD::addPending(REMEMBERED& remembered, WORKER_POOL* workers)
+{
+    // One thread at a time takes and adds, so the history gets them in publish order
+    std::lock_guard<std::mutex> lock(remembered.draining);
+    std::vector<COMPRESSED> results;
+    for (;;)
+    {
+        PENDING next;
+        {
+            std::lock_guard<std::mutex> pendingLock(remembered.pending_mutex);
+            if (remembered.pending.empty()) { return results; }
+            next = std::move(remembered.pending.front());
+            remembered.pending.pop_front();
+        }
+
+        // The history gets the compressed text, it is not copied then
+        std::shared_ptr<const PAYLOAD> kept = next.payload;
+        if (next.compress)
+        {
+            TRACE_SPAN("PAYLOAD::Compressed");
+            const auto start = std::chrono::steady_clock::now();
+            kept = next.payload->Compressed(workers);
+            const uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            results.push_back({next.payload, kept, elapsed});
+        }
+
+        // Hashed before the history is locked, a recall on the UI thread does not wait for it
+        TRACE_SPAN("HISTORY::Add");
+        if (kept->IsCompressed())
+        {
+            std::lock_guard<std::mutex> historyLock(remembered.adding);
+            remembered.history.Add(kept);
+        }
+        else
+        {
+            // Do not hash hundreds of MB only to find out they do not fit
+            size_t budget;
+            {
+                std::lock_guard<std::mutex> historyLock(remembered.adding);
+                budget = remembered.history.GetBudget();
+            }
+            if (kept->Length() * sizeof(WCHAR) > budget) { continue; }
+            const uint64_t hash = HISTORY::Hash(*kept);
+            std::lock_guard<std::mutex> historyLock(remembered.adding);
+            remembered.history.Add(*kept, hash);
+        }
+    }
+}
+
+
+void CLIPBOARD::swapCompressed(const std::vector<COMPRESSED>& compressed)
+{
+    for (const COMPRESSED& result : compressed)
+    {
+        const size_t rawBytes = result.raw->StoredBytes();
+        compressionStats.payloads++;
+        compressionStats.raw_bytes    += rawBytes;
+        compressionStats.stored_bytes += result.compressed->StoredBytes();
+        compressionStats.compress_ns  += result.elapsed_ns;
+        LOG_INFO(L"Compressed", rawBytes, L"bytes to", result.compressed->StoredBytes(), L"in ms:", result.elapsed_ns / 1000000);
+
+        // Only if it is still ours and nothing newer was published, the raw text goes away with the last reference
+        if (payload == result.raw) { payload = result.compressed; }
+    }
+}
+
+
+bool CLIPBOARD::setClipboardToHistory(HWND hWnd, size_t n)
+{
+    std::shared_ptr<const PAYLOAD> recalled;
+    {
+        // Text from the arena is copied before a worker can add again
+        std::lock_guard<std::mutex> lock(remembered->adding);
+        recalled = remembered->history.Recall(n, pool);
+    }
+    if (!recalled) { return false; }
+    setClipboardToPayload(hWnd, std::move(recalled));
+    return true;
+}
+
+
+void CLIPBOARD::setHistoryBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(remembered->adding);
+    remembered->history.SetBudget(bytes);
+}
+
+
+HISTORY::STATS CLIPBOARD::getHistoryStats() const
+{
+    std::lock_guard<std::mutex> lock(remembered->adding);
+    return remembered->history.GetStats();
+}
+
+
+BUFFER_POOL::STATS CLIPBOARD::getPoolStats() const
+{
+    return pool->GetStats();
+}
+
+
+std::shared_ptr<PAYLOAD> CLIPBOARD::createPayload()
+{
+    return std::make_shared<PAYLOAD>(pool);
+}
+
+
+void CLIPBOARD::setCompression(size_t min_characters)
+{
+    compressionMinCharacters = min_characters;
+}
+
+
+UINT CLIPBOARD::utf8Format()
+{
+    static const UINT format = RegisterClipboardFormat(L"UTF8_STRING");
+    return format;
+}
+
+
+LRESULT CLIPBOARD::renderFormat(UINT format)
+{
+    // The clipboard is already opened by the app that wants the data
+    const bool compressed = payload && payload->IsCompressed();
+    const auto start = std::chrono::steady_clock::now();
+    HGLOBAL hMem = render(format);
+    if (compressed && hMem)
+    {
+        const uint64_t bytes = payload->Length() * sizeof(WCHAR);
+        const uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        compressionStats.decompressed_bytes += bytes;
+        compressionStats.decompress_ns      += elapsed;
+        LOG_INFO(L"Rendered format", format, L"from compressed text at", elapsed ? bytes * 1000 / elapsed : 0, L"MB/s");
+    }
+    if (hMem && !SetClipboardData(format, hMem)) { GlobalFree(hMem); }
+    return 0;
+}
+
+
+LRESULT CLIPBOARD::renderAllFormats(HWND hWnd)
+{
+    // We are about to be destroyed. Render everything so the content survives us, but only if we still own the clipboard
+    if (!payload || !OpenClipboard(hWnd)) { return 0; }
+    if (GetClipboardOwner() == hWnd)
+    {
+        for (UINT format : formats()) { if (format) { renderFormat(format); } }
+    }
+    CloseClipboard();
+    return 0;
+}
+
+
+LRESULT CLIPBOARD::destroyClipboard()
+{
+    // Another app emptied the clipboard, the payload is not needed anymore
+    payload.reset();
+    return 0;
+}
+
+
+HGLOBAL CLIPBOARD::render(UINT format) const
+{
+    TRACE_SPAN("CLIPBOARD::render");
+    if (!payload) { return NULL; }
+    if (format && format == utf8Format())
+    {
+        // Two passes over the text, the first one only counts
+        size_t bytes = 0;
+        if (!forEachPiece(*payload, [&](const UTF::WIDE* piece, size_t length) { bytes += UTF::Utf8Length(piece, length); })) { return NULL; }
+        HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, bytes + 1);
+        if (!hMem) { return NULL; }
+        char* text = (char*)GlobalLock(hMem);
+        size_t written = 0;
+        const bool intact = forEachPiece(*payload, [&](const UTF::WIDE* piece, size_t length) { written += UTF::ToUtf8(piece, length, text + written).written; });
+        text[written] = '\0';
+        GlobalUnlock(hMem);
+        if (!intact) { GlobalFree(hMem); return NULL; }
+        return hMem;
+    }
+    switch (format)
+    {
+        case CF_UNICODETEXT:
+        {
+            const size_t len = payload->Length() + 1; // defines size for buffer with terminate char
+            //allocate memory
+            HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, sizeof(WCHAR) * len);
+            if (!hMem) { return NULL; }
+            WCHAR* text = (WCHAR*)GlobalLock(hMem);
+            const bool intact = payload->CopyTo(text, workers);
+            text[len - 1] = L'\0';
+            GlobalUnlock(hMem);
+            if (!intact) { GlobalFree(hMem); return NULL; } // a damaged compressed block, no garbage on the clipboard
+            return hMem;
+        }
+#if !defined(_WIN32) || defined(GUI_HEADLESS)
+        case CF_TEXT:
+        {
+            // Latin-1, one byte per character at most. On windows the system converts CF_UNICODETEXT with the code page of the locale instead
+            HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, payload->Length() + 1);
+            if (!hMem) { return NULL; }
+            char* text = (char*)GlobalLock(hMem);
+            size_t written = 0;
+            const bool intact = forEachPiece(*payload, [&](const UTF::WIDE* piece, size_t length) { written += UTF::ToLatin1(piece, length, text + written).written; });
+            text[written] = '\0';
+            GlobalUnlock(hMem);
+            if (!intact) { GlobalFree(hMem); return NULL; }
+            return hMem;
+        }
+#endif
+    }
+    return NULL;
+}
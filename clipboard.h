@@ -1,17 +1,176 @@
 #ifndef CLIPBOARD_H
 #define CLIPBOARD_H
-#include <windows.h>
+#include "platform.h"
+#include "payload.h"
+#include "history.h"
+#include "pool.h"
+#include "workers.h"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 class CLIPBOARD
 {
 
 public:
 
+    // What setClipboardToStream read
+    struct STREAM_STATS
+    {
+        uint64_t bytes;       // UTF-8 bytes read, without a byte order mark
+        size_t   characters;  // in the payload
+        size_t   errors;      // invalid UTF-8 sequences, replaced with U+FFFD
+        uint64_t elapsed_ns;  // reading and decoding, publishing is not included
+        bool     mapped;      // the input was a file and got mapped instead of read
+    };
+
+    // What compressing the payloads saved and what it costs when they are pasted
+    struct COMPRESSION_STATS
+    {
+        size_t   payloads;            // compressed ones
+        uint64_t raw_bytes;           // of their text
+        uint64_t stored_bytes;        // after compressing
+        uint64_t compress_ns;
+        uint64_t decompressed_bytes;  // text rendered from compressed payloads, once per format
+        uint64_t decompress_ns;       // rendering them, the conversion of CF_TEXT and UTF-8 included
+    };
+
+    // Bytes read from a pipe at once by setClipboardToStream and getStringFromStdin
+    static constexpr size_t STREAM_BLOCK_BYTES = size_t(1) << 20;
+
+    // Everything on stdin up to its end, all lines
     std::string getStringFromStdin();
 
+    /*
+    Decodes UTF-8 from input (e.g. GetStdHandle(STD_INPUT_HANDLE)) until its end straight into a payload and publishes it.
+    A file is mapped, anything else is read in blocks of STREAM_BLOCK_BYTES. Either way no second copy of the text is made.
+    Returns false if input could not be read. stats may be NULL
+    */
+    bool setClipboardToStream(HWND hWnd, HANDLE input, STREAM_STATS* stats = nullptr);
+
+    // Copies the string into a payload and publishes it
     void setClipboardToString(HWND hWnd, LPWSTR clipboardString);
 
+    // Decodes UTF-8 (e.g. from getStringFromStdin) straight into a payload and publishes it. Invalid sequences become U+FFFD
+    void setClipboardToUtf8(HWND hWnd, const char* text, size_t length);
+
+    // Reads the text of source (e.g. an edit control) straight into a payload and publishes it. Returns false if there is no text
+    bool setClipboardToWindowText(HWND hWnd, HWND source);
+
+    // Text of source in a payload or nullptr if there is no text
+    std::shared_ptr<PAYLOAD> readWindowText(HWND source);
+
+    /*
+    Publishes the payload with delayed rendering.
+    Only the formats get announced here, no matter how big the payload is. The data is produced when a consumer asks for it (WM_RENDERFORMAT).
+    hWnd becomes the clipboard owner and has to forward the render messages to the functions below.
+    With remember the payload is added to the history, by a worker if there are workers (see setWorkers). It is never compressed here.
+    */
+    void setClipboardToPayload(HWND hWnd, std::shared_ptr<const PAYLOAD> payload, bool remember = true);
+
+    /*
+    Compressing published texts and adding them to the history is done by these workers instead of the thread that publishes.
+    The texts are added in the order they were published. Until a worker got to it a text is not in the history yet.
+    A compressed text replaces the published one in the done function, so RunCompletions has to be called on the thread that publishes while this CLIPBOARD exists.
+    nullptr (the default) does it all right away
+    */
+    void setWorkers(WORKER_POOL* workers);
+
+    // Publishes entry n of the history again (0 = newest). Returns false if the entry was evicted
+    bool setClipboardToHistory(HWND hWnd, size_t n);
+
+    /*
+    Compresses texts of at least min_characters that are published by the setClipboardTo... functions (not setClipboardToPayload), see PAYLOAD::Compress.
+    They are published as they are and swapped for the compressed copy once it is ready (see setWorkers), the history keeps the compressed copy.
+    They take a fraction of the memory while they sit on the clipboard and are decompressed every time a format is rendered. 0 turns it off, the default
+    */
+    void setCompression(size_t min_characters);
+    COMPRESSION_STATS getCompressionStats() const { return compressionStats; }
+
+    // Memory ceiling of the history in bytes. Texts bigger than this are published but not remembered
+    void setHistoryBudget(size_t bytes);
+    HISTORY::STATS getHistoryStats() const;
+
+    // Allocation counters of the payload buffers
+    BUFFER_POOL::STATS getPoolStats() const;
+
+    // Registered format of the UTF-8 copy ("UTF8_STRING"), published next to CF_UNICODETEXT
+    static UINT utf8Format();
+
+    // Delayed rendering. Called by the window procedure of the clipboard owner
+    LRESULT renderFormat(UINT format);          // WM_RENDERFORMAT
+    LRESULT renderAllFormats(HWND hWnd);        // WM_RENDERALLFORMATS
+    LRESULT destroyClipboard();                 // WM_DESTROYCLIPBOARD
+
+private:
+
+    // Creates the clipboard memory block for one format from the payload
+    HGLOBAL render(UINT format) const;
+
+    // Empty payload whose chunks come from the pool
+    std::shared_ptr<PAYLOAD> createPayload();
+
+    // Publishes a text of the setClipboardTo... functions, then compresses and remembers it
+    void publishText(HWND hWnd, std::shared_ptr<const PAYLOAD> newPayload);
+
+    // Formats the payload gets published as, all rendered from the same UTF-16 text.
+    // Windows makes CF_TEXT from CF_UNICODETEXT itself, in the code page of the CF_LOCALE it adds. The headless backend has no code pages, it gets Latin-1
+#if defined(_WIN32) && !defined(GUI_HEADLESS)
+    static std::array<UINT, 2> formats() { return {CF_UNICODETEXT, utf8Format()}; }
+#else
+    static std::array<UINT, 3> formats() { return {CF_UNICODETEXT, CF_TEXT, utf8Format()}; }
+#endif
+
+    // Buffers of the payloads. Shared, a payload can outlive the CLIPBOARD it was created by
+    std::shared_ptr<BUFFER_POOL> pool = std::make_shared<BUFFER_POOL>();
+
+    // What we currently own on the clipboard. Kept until another app takes over the clipboard
+    std::shared_ptr<const PAYLOAD> payload;
+
+    // A published payload on its way into the history
+    struct PENDING
+    {
+        std::shared_ptr<const PAYLOAD> payload;
+        bool compress;
+    };
+
+    // A published payload and its compressed copy that replaces it
+    struct COMPRESSED
+    {
+        std::shared_ptr<const PAYLOAD> raw;
+        std::shared_ptr<const PAYLOAD> compressed;
+        uint64_t elapsed_ns;
+    };
+
+    // Everything we published, deduplicated. Shared with the workers that add to it
+    struct REMEMBERED
+    {
+        HISTORY history;
+        std::mutex adding;          // held while the history is used, the workers add under it
+        std::mutex draining;        // one thread at a time takes the pending payloads
+        std::mutex pending_mutex;
+        std::deque<PENDING> pending;
+    };
+    std::shared_ptr<REMEMBERED> remembered = std::make_shared<REMEMBERED>();
+    WORKER_POOL* workers = nullptr;
+
+    // Compresses (if asked to) and remembers a payload that was just published, see setWorkers
+    void afterPublish(std::shared_ptr<const PAYLOAD> published, bool compress);
+
+    // Compresses and adds the pending payloads in order. Any thread, as often as it likes. Big texts are compressed on the workers too if there are any
+    static std::vector<COMPRESSED> addPending(REMEMBERED& remembered, WORKER_POOL* workers);
+
+    // Replaces the published payloads with their compressed copies
+    void swapCompressed(const std::vector<COMPRESSED>& compressed);
+
+    // Characters from which payloads are compressed, 0 for never
+    size_t compressionMinCharacters = 0;
+    COMPRESSION_STATS compressionStats = {};
+
 };
 
 #endif // CLIPBOARD_H
@@ -0,0 +1,154 @@
+#include "clipmonitor.h"
+#include "hash.h"
+#include "trace.h"
+#include "log.h"
+#include <algorithm>
+#include <array>
+#include <cwchar>
+
+namespace
+{
+    // Random value per byte for the rolling hash (splitmix64, fixed at compile time so boundaries are the same in every run)
+    constexpr std::array<uint64_t, 256> GEAR = []
+    {
+        std::array<uint64_t, 256> table = {};
+        uint64_t state = 0;
+        for (uint64_t& value : table)
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            value = z ^ (z >> 31);
+        }
+        return table;
+    }();
+
+    // Top bits of the rolling hash. They depend on the last 64 characters, the low bits only on the last few
+    constexpr uint64_t BOUNDARY_MASK = ~(~uint64_t(0) >> 11);
+    static_assert(uint64_t(1) << 11 == CLIPBOARD_MONITOR::AVERAGE_CHUNK, "the mask has log2(AVERAGE_CHUNK) bits");
+
+    // Retries per change when another program keeps the clipboard open, 1 ms after the first failure and twice as long after each one (31 ms in total)
+    constexpr int      MAX_RETRIES    = 5;
+    constexpr uint64_t RETRY_DELAY_NS = 1000000;
+
+    // End of the chunk that starts at start
+    size_t ChunkEnd(const WCHAR* text, size_t length, size_t start)
+    {
+        size_t end = std::min(length, start + CLIPBOARD_MONITOR::MAX_CHUNK);
+        uint64_t rolling = 0;
+        for (size_t i = std::min(end, start + CLIPBOARD_MONITOR::MIN_CHUNK); i < end; i++)
+        {
+            unsigned c = static_cast<unsigned>(text[i]);
+            rolling = (rolling << 1) + GEAR[(c ^ (c >> 8)) & 0xFF];
+            if (!(rolling & BOUNDARY_MASK)) { return i + 1; }
+        }
+        return end;
+    }
+}
+
+bool CLIPBOARD_MONITOR::Start(HWND window, TIMER_WHEEL* retry_timers)
+{
+    hWnd   = window;
+    timers = retry_timers;
+    last_sequence = 0;
+    previous.clear();
+    if (!AddClipboardFormatListener(hWnd)) { LOG_ERROR(L"AddClipboardFormatListener failed. Errnum =", GetLastError()); hWnd = NULL; return false; }
+    return true;
+}
+
+void CLIPBOARD_MONITOR::Stop()
+{
+    if (hWnd) { RemoveClipboardFormatListener(hWnd); }
+    if (retry_timer) { timers->Cancel(retry_timer); }
+    retry_timer = 0;
+    hWnd = NULL;
+}
+
+bool CLIPBOARD_MONITOR::OnUpdate()
+{
+    stats.notifications++;
+    if (!hWnd) { return false; }
+
+    // One copy changes the sequence number several times and the notifications queue up, only the first one for a sequence reads
+    if (GetClipboardSequenceNumber() == last_sequence) { stats.skipped++; return false; }
+    return Read();
+}
+
+bool CLIPBOARD_MONITOR::Read()
+{
+    if (!OpenClipboard(hWnd))
+    {
+        // Somebody else has it open right now. Ask again a bit later a few times, after that the next change will tell us.
+        // A new change starts over, one retry waiting is enough for any number of changes
+        stats.open_failures++;
+        const DWORD sequence = GetClipboardSequenceNumber();
+        if (sequence != retry_sequence)
+        {
+            retry_sequence = sequence;
+            retries        = 0;
+        }
+        if (timers && !retry_timer && retries < MAX_RETRIES)
+        {
+            stats.retries++;
+            retry_timer = timers->Schedule(RETRY_DELAY_NS << retries++, [this]
+            {
+                retry_timer = 0;
+                if (hWnd && GetClipboardSequenceNumber() != last_sequence) { Read(); }
+            });
+        }
+        return false;
+    }
+    if (retry_timer)
+    {
+        timers->Cancel(retry_timer);
+        retry_timer = 0;
+    }
+
+    // Nobody can change the clipboard while we have it open, so this is the sequence of what we read
+    const DWORD sequence = GetClipboardSequenceNumber();
+    bool read = false;
+    if (sequence != last_sequence && GetClipboardOwner() != hWnd)
+    {
+        HGLOBAL hMem = static_cast<HGLOBAL>(GetClipboardData(CF_UNICODETEXT));
+        const WCHAR* text = hMem ? static_cast<const WCHAR*>(GlobalLock(hMem)) : nullptr;
+        if (text)
+        {
+            TRACE_SPAN("CLIPBOARD_MONITOR::Diff");
+            const size_t length = wcsnlen(text, GlobalSize(hMem) / sizeof(WCHAR));
+            Diff(text, length);
+            size_t changed_chars = 0;
+            for (const SPAN& span : changed) { changed_chars += span.length; }
+            if (handler) { handler(CHANGE{sequence, text, length, changed.data(), changed.size(), changed_chars}); }
+            GlobalUnlock(hMem);
+            read = true;
+        }
+    }
+    else { stats.skipped++; } // our own copy
+    CloseClipboard();
+    last_sequence = sequence;
+    return read;
+}
+
+void CLIPBOARD_MONITOR::Diff(const WCHAR* text, size_t length)
+{
+    current.clear();
+    changed.clear();
+    for (size_t start = 0; start < length;)
+    {
+        size_t end = ChunkEnd(text, length, start);
+        uint64_t hash = HASH::Of(text + start, (end - start) * sizeof(WCHAR));
+        current.push_back(hash);
+        if (!std::binary_search(previous.begin(), previous.end(), hash))
+        {
+            stats.chunks_changed++;
+            if (!changed.empty() && changed.back().offset + changed.back().length == start) { changed.back().length += end - start; }
+            else { changed.push_back({start, end - start}); }
+        }
+        start = end;
+    }
+    stats.reads++;
+    stats.chars_read += length;
+    stats.chunks     += current.size();
+    std::sort(current.begin(), current.end());
+    previous.swap(current);
+}
@@ -0,0 +1,94 @@
+#ifndef CLIPMONITOR_H
+#define CLIPMONITOR_H
+#include "platform.h"
+#include "timerwheel.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+Follows what other programs put on the clipboard.
+The window is registered as clipboard format listener and gets WM_CLIPBOARDUPDATE after every change, nothing is polled.
+A notification for a sequence number that was already read is skipped (under churn they pile up in the queue), so are notifications for our own copies.
+When another program has the clipboard open, the read is tried again on a timer after 1, 2, 4... ms, a few times per change.
+
+The text is cut into content defined chunks: a rolling hash over the last 64 characters picks the boundaries,
+so inserting or deleting text only moves the boundaries next to the edit and the chunks after it stay the same.
+Every chunk is hashed. Chunks whose hash was in the previous text are unchanged, only the others are handed on as changed spans.
+*/
+class CLIPBOARD_MONITOR
+{
+public:
+
+    // Characters of the new text
+    struct SPAN
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    struct CHANGE
+    {
+        DWORD        sequence;      // GetClipboardSequenceNumber of the text
+        const WCHAR* text;          // the clipboard memory, only valid during the handler
+        size_t       length;
+        const SPAN*  changed;       // in text order, adjacent chunks merged
+        size_t       changed_count;
+        size_t       changed_chars;
+    };
+
+    // Runs on the thread of the window while the clipboard is open, keep it short
+    typedef std::function<void(const CHANGE&)> HANDLER;
+
+    struct STATS
+    {
+        uint64_t notifications;   // WM_CLIPBOARDUPDATE handled
+        uint64_t skipped;         // already read or our own copy
+        uint64_t reads;           // texts that got diffed
+        uint64_t open_failures;   // another program had the clipboard open
+        uint64_t retries;         // reads tried again after a failed open
+        uint64_t chars_read;
+        uint64_t chunks;
+        uint64_t chunks_changed;
+    };
+
+    // Chunk sizes in characters. The boundary test hits once in AVERAGE_CHUNK characters after the minimum
+    static constexpr size_t MIN_CHUNK     = 512;
+    static constexpr size_t AVERAGE_CHUNK = 2048;
+    static constexpr size_t MAX_CHUNK     = 8192;
+
+    // Registers hWnd as listener. It has to forward WM_CLIPBOARDUPDATE to OnUpdate. The retries run on timers, without them the next change is waited for
+    bool Start(HWND hWnd, TIMER_WHEEL* timers);
+    void Stop();
+
+    void SetHandler(HANDLER on_change) { handler = std::move(on_change); }
+
+    // WM_CLIPBOARDUPDATE. Returns true if a text was read and handed to the handler
+    bool OnUpdate();
+
+    STATS GetStats() const { return stats; }
+    void ResetStats() { stats = {}; }
+
+private:
+
+    // Reads the clipboard if it changed since the last read, or schedules the next retry
+    bool Read();
+
+    // Chunks and hashes text, fills changed and replaces the hashes of the previous text
+    void Diff(const WCHAR* text, size_t length);
+
+    HWND         hWnd           = NULL;
+    TIMER_WHEEL* timers         = nullptr;
+    DWORD        last_sequence  = 0;
+    DWORD        retry_sequence = 0;   // change the retries count for
+    int          retries        = 0;
+    TIMER_WHEEL::TIMER retry_timer = 0;
+    HANDLER      handler;
+
+    std::vector<uint64_t> previous;  // chunk hashes of the last text, sorted
+    std::vector<uint64_t> current;
+    std::vector<SPAN>     changed;
+    STATS                 stats = {};
+};
+
+#endif // CLIPMONITOR_H
@@ -0,0 +1,136 @@
+#include "controls.h"
+#include "gdicache.h"
+#include "trace.h"
+#include "log.h"
+#include <algorithm>
+
+HWND CONTROLS::CreateWindowFor(HWND parent, const DESCRIPTOR& descriptor, int id, int x, int y) const
+{
+    LPCWSTR class_name;
+    DWORD   style = WS_VISIBLE | WS_CHILD;
+    switch (descriptor.kind)
+    {
+        case KIND::BUTTON:   class_name = L"button"; style |= BS_MULTILINE | WS_TABSTOP | BS_DEFPUSHBUTTON; break;
+        case KIND::CHECKBOX: class_name = L"button"; style |= BS_MULTILINE | WS_TABSTOP | BS_AUTOCHECKBOX; break;
+        case KIND::LABEL:    class_name = L"static"; style |= SS_EDITCONTROL; break;
+        case KIND::EDIT:     class_name = L"edit";   style |= WS_VSCROLL | ES_AUTOVSCROLL | ES_MULTILINE | WS_TABSTOP | WS_BORDER; break;
+        case KIND::FENCE:    class_name = L"static"; style |= SS_EDITCONTROL | SS_ETCHEDHORZ; break;
+        default:             return NULL;
+    }
+    return CreateWindow(class_name, descriptor.text, style, x, y, descriptor.width, descriptor.height, parent, (HMENU)(INT_PTR)id, 0, 0);
+}
+
+int CONTROLS::Create(HWND parent, const DESCRIPTOR& descriptor, int x, int y)
+{
+    TRACE_SPAN_DETAIL("CONTROLS::Create", descriptor.text);
+    const int id = descriptor.id == AUTO_ID ? next_auto_id : descriptor.id;
+    if (id < first_id) { LOG_ERROR(L"Control ID", id, L"is below the first ID", first_id); return 0; }
+    HWND hWnd = CreateWindowFor(parent, descriptor, id, x, y);
+    if (!hWnd) { LOG_ERROR(L"Could not create control", id, L"Errnum =", GetLastError()); return 0; }
+    if (descriptor.id == AUTO_ID) { next_auto_id++; }
+
+    // The control paints for the first time after this anyway, no redraw for the font
+    if (descriptor.font_size)
+    {
+        TRACE_SPAN_DETAIL("CONTROLS::SetFont", font_face);
+        SendMessage(hWnd, WM_SETFONT, WPARAM(Font(descriptor.font_size)), FALSE);
+    }
+
+    Grow(id);
+    const size_t i = Index(id);
+    if (!handles[i]) { count++; } // AddButton without an ID reuses ID_TEST_BUTTON, the newest one wins
+    handles[i] = hWnd;
+    kinds[i]   = descriptor.kind;
+    rects[i]   = RECT{x, y, x + descriptor.width, y + descriptor.height};
+    checked[i] = 0;
+    nodes[i]   = LAYOUT::NONE;
+    return id;
+}
+
+size_t CONTROLS::CreateAll(HWND parent, const DESCRIPTOR* descriptors, size_t descriptor_count, int* ids)
+{
+    TRACE_SPAN("CONTROLS::CreateAll");
+
+    // The tables grow once for the whole form
+    int last_id = next_auto_id - 1;
+    int auto_id = next_auto_id;
+    for (size_t i = 0; i < descriptor_count; i++)
+    {
+        last_id = std::max(last_id, descriptors[i].id == AUTO_ID ? auto_id++ : descriptors[i].id);
+    }
+    Grow(last_id);
+
+    size_t created = 0;
+    for (size_t i = 0; i < descriptor_count; i++)
+    {
+        ids[i] = Create(parent, descriptors[i]);
+        if (ids[i]) { created++; }
+    }
+    return created;
+}
+
+void CONTROLS::Grow(int id)
+{
+    const size_t size = Index(id) + 1;
+    if (size <= handles.size()) { return; }
+    handles.resize(size, NULL);
+    kinds.resize(size, KIND::NONE);
+    rects.resize(size, RECT{0, 0, 0, 0});
+    checked.resize(size, 0);
+    nodes.resize(size, LAYOUT::NONE);
+}
+
+HFONT CONTROLS::Font(int size)
+{
+    for (const auto& [font_size, font] : fonts)
+    {
+        if (font_size == size) { return font; }
+    }
+    HFONT font = GDI_CACHE::Shared().AcquireFont(font_face, size);
+    fonts.emplace_back(size, font);
+    return font;
+}
+
+int CONTROLS::Place(LAYOUT& layout, int parent_node, int id, LAYOUT::LENGTH width, LAYOUT::LENGTH height)
+{
+    const int node = layout.Control(parent_node, Handle(id), width, height);
+    const size_t i = Index(id);
+    if (i < nodes.size()) { nodes[i] = node; }
+    return node;
+}
+
+void CONTROLS::UpdateRects(const LAYOUT& layout)
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (nodes[i] != LAYOUT::NONE) { rects[i] = layout.GetRect(nodes[i]); }
+    }
+}
+
+void CONTROLS::SetChecked(int id, bool check)
+{
+    const size_t i = Index(id);
+    if (i >= handles.size() || kinds[i] != KIND::CHECKBOX) { return; }
+    SendMessage(handles[i], BM_SETCHECK, check ? BST_CHECKED : BST_UNCHECKED, 0);
+    checked[i] = check;
+}
+
+void CONTROLS::OnClicked(int id)
+{
+    const size_t i = Index(id);
+    if (i >= handles.size() || kinds[i] != KIND::CHECKBOX) { return; }
+    checked[i] = SendMessage(handles[i], BM_GETCHECK, 0, 0) == BST_CHECKED;
+}
+
+void CONTROLS::Clear()
+{
+    for (const auto& [font_size, font] : fonts) { GDI_CACHE::Shared().Release(font); }
+    fonts.clear();
+    handles.clear();
+    kinds.clear();
+    rects.clear();
+    checked.clear();
+    nodes.clear();
+    count        = 0;
+    next_auto_id = first_auto_id;
+}
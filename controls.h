@@ -0,0 +1,104 @@
+#ifndef CONTROLS_H
+#define CONTROLS_H
+#include "platform.h"
+#include "layout.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+The child controls of one window, created through here by the GUI::Add... functions.
+Every control has its own ID. The tables have one entry per ID (index ID - first_id), one array per column, so a lookup is an index and no system call:
+
+    HWND edit = controls.Handle(ID_TEXT_EDIT);
+    if (controls.IsChecked(ID_CHECKBOX)) { ... }
+
+IDs below first_auto_id are chosen by the caller, controls created with AUTO_ID get the next one from first_auto_id up.
+With first_auto_id right after the fixed IDs the tables have no holes.
+
+The check state of checkboxes is cached. It changes with a click (OnClicked from the WM_COMMAND of the checkbox) or SetChecked, everything else reads the cache.
+Rectangles are in client coordinates of the parent, from the creation and then from the layout (UpdateRects after LAYOUT::Apply).
+
+CreateAll builds a whole form from a descriptor table. Fonts come from the GDI_CACHE once per size, not once per control, and are released by Clear.
+Controls are expected to live as long as the window, Clear forgets all of them at once.
+Only use from the thread of the window.
+*/
+class CONTROLS
+{
+public:
+
+    enum class KIND : uint8_t { NONE, BUTTON, CHECKBOX, LABEL, EDIT, FENCE };
+
+    static constexpr int AUTO_ID = 0;
+
+    struct DESCRIPTOR
+    {
+        KIND    kind;
+        int     id;          // or AUTO_ID
+        LPCWSTR text;
+        int     width;
+        int     height;
+        int     font_size;   // 0 for no font (FENCE)
+    };
+
+    CONTROLS(int first, int first_auto, LPCWSTR face) : first_id(first), first_auto_id(first_auto), next_auto_id(first_auto), font_face(face) {}
+    ~CONTROLS() { Clear(); }
+
+    CONTROLS(const CONTROLS&) = delete;
+    CONTROLS& operator=(const CONTROLS&) = delete;
+
+    // Creates one control at x, y as a child of parent. Returns its ID, 0 if CreateWindow failed
+    int Create(HWND parent, const DESCRIPTOR& descriptor, int x = 0, int y = 0);
+
+    // Creates a control for every descriptor at 0, 0, the layout places them. ids gets the ID of each (0 if it failed). Returns how many were created
+    size_t CreateAll(HWND parent, const DESCRIPTOR* descriptors, size_t descriptor_count, int* ids);
+
+    // NULL / NONE / empty / false for IDs without a control
+    HWND Handle(int id) const     { size_t i = Index(id); return i < handles.size() ? handles[i] : NULL; }
+    KIND Kind(int id) const       { size_t i = Index(id); return i < kinds.size() ? kinds[i] : KIND::NONE; }
+    RECT Rect(int id) const       { size_t i = Index(id); return i < rects.size() ? rects[i] : RECT{0, 0, 0, 0}; }
+    bool IsChecked(int id) const  { size_t i = Index(id); return i < checked.size() && checked[i]; }
+
+    // The layout node that places the control, UpdateRects copies its rectangle
+    int  Place(LAYOUT& layout, int parent_node, int id, LAYOUT::LENGTH width, LAYOUT::LENGTH height);
+    void UpdateRects(const LAYOUT& layout);
+
+    // Checks or unchecks a checkbox
+    void SetChecked(int id, bool check);
+
+    // WM_COMMAND of a checkbox. BS_AUTOCHECKBOX changed its state, reads it once
+    void OnClicked(int id);
+
+    // Forgets every control and gives the fonts back. On WM_NCDESTROY, the controls are destroyed with the window
+    void Clear();
+
+    size_t Count() const { return count; }
+
+private:
+
+    size_t Index(int id) const { return id >= first_id ? static_cast<size_t>(id - first_id) : SIZE_MAX; }
+
+    // Makes room up to id
+    void Grow(int id);
+
+    HWND CreateWindowFor(HWND parent, const DESCRIPTOR& descriptor, int id, int x, int y) const;
+
+    HFONT Font(int size);
+
+    int     first_id;
+    int     first_auto_id;
+    int     next_auto_id;
+    LPCWSTR font_face;
+    size_t  count = 0;
+
+    // One entry per ID
+    std::vector<HWND>    handles;
+    std::vector<KIND>    kinds;
+    std::vector<RECT>    rects;
+    std::vector<uint8_t> checked;
+    std::vector<int>     nodes;      // LAYOUT::NONE until Place
+
+    std::vector<std::pair<int, HFONT>> fonts;   // size -> font. Only a few sizes, searched linearly
+};
+
+#endif // CONTROLS_H
@@ -0,0 +1,185 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+#include "platform.h"
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+/*
+Compile time dispatch table. Maps IDs (window messages or control IDs of WM_COMMAND) to member functions of T.
+
+    using TABLE = DISPATCH_TABLE<GUI, WM_USER, ON<WM_MOUSEMOVE, &GUI::OnMousemove>, ON<WM_SIZE, &GUI::OnSize>>;
+    LRESULT result;
+    if (TABLE::Dispatch(pGui, uMsg, hWnd, uMsg, wParam, lParam, &result)) { return result; }
+
+The first route is the hot one: Dispatch compares it before looking at the tables and calls its handler directly, so a flood of that message costs what a switch would.
+IDs below DenseLimit are looked up with a single load from a byte table, everything else with a binary search over a sorted array.
+Both tables are built by the compiler, so adding a handler only means adding one ON<> entry.
+
+Handlers take any subset of (HWND, UINT, WPARAM, LPARAM) in any order, the arguments are picked by type.
+*/
+
+// One entry of the table
+template<UINT Id, auto Handler>
+struct ON
+{
+    static constexpr UINT id      = Id;
+    static constexpr auto handler = Handler;
+};
+
+template<class T>
+using DISPATCH_THUNK = LRESULT (*)(T* instance, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+namespace dispatch_detail
+{
+    template<class A>
+    A Pick(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        if constexpr (std::is_same_v<A, HWND>)        { return hWnd; }
+        else if constexpr (std::is_same_v<A, UINT>)   { return uMsg; }
+        else if constexpr (std::is_same_v<A, WPARAM>) { return wParam; }
+        else
+        {
+            static_assert(std::is_same_v<A, LPARAM>, "Handler arguments must be HWND, UINT, WPARAM or LPARAM");
+            return lParam;
+        }
+    }
+
+    template<class F>
+    struct HANDLER_TRAITS;
+
+    template<class T, class... A>
+    struct HANDLER_TRAITS<LRESULT (T::*)(A...)>
+    {
+        template<auto Handler>
+        static LRESULT Call(T* instance, [[maybe_unused]] HWND hWnd, [[maybe_unused]] UINT uMsg, [[maybe_unused]] WPARAM wParam, [[maybe_unused]] LPARAM lParam)
+        {
+            return (instance->*Handler)(Pick<A>(hWnd, uMsg, wParam, lParam)...);
+        }
+    };
+}
+
+template<class T, UINT DenseLimit, class... Routes>
+class DISPATCH_TABLE
+{
+public:
+
+    typedef DISPATCH_THUNK<T> THUNK;
+
+    // Returns the handler for id or nullptr
+    static THUNK Find(UINT id)
+    {
+        if (id < DenseLimit)
+        {
+            return thunks[dense[id]];
+        }
+
+        // Rare IDs: binary search over the sorted IDs
+        size_t first = 0;
+        size_t count = sparse.size();
+        while (count > 0)
+        {
+            size_t half = count / 2;
+            if (sparse[first + half].id < id)
+            {
+                first += half + 1;
+                count -= half + 1;
+            }
+            else
+            {
+                count = half;
+            }
+        }
+        if (first < sparse.size() && sparse[first].id == id) { return thunks[sparse[first].slot]; }
+        return nullptr;
+    }
+
+    // Calls the handler for id and stores what it returned in result. False if id has no handler
+    static bool Dispatch(T* instance, UINT id, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, LRESULT* result)
+    {
+        // Compared and called directly, the indirect call through the thunks is what made a table slower than a switch on floods of one message
+        using HOT = std::tuple_element_t<0, std::tuple<Routes...>>;
+        if (id == HOT::id)
+        {
+            *result = dispatch_detail::HANDLER_TRAITS<std::remove_const_t<decltype(HOT::handler)>>::template Call<HOT::handler>(instance, hWnd, uMsg, wParam, lParam);
+            return true;
+        }
+        if (THUNK handler = Find(id))
+        {
+            *result = handler(instance, hWnd, uMsg, wParam, lParam);
+            return true;
+        }
+        return false;
+    }
+
+    static constexpr size_t size() { return sizeof...(Routes); }
+
+private:
+
+    static_assert(sizeof...(Routes) < 255, "The dense table stores slots as bytes");
+
+    struct SPARSE_ENTRY
+    {
+        UINT    id;
+        uint8_t slot;
+    };
+
+    static constexpr std::array<UINT, sizeof...(Routes)> ids = {Routes::id...};
+
+    static constexpr size_t CountSparse()
+    {
+        size_t count = 0;
+        for (UINT id : ids) { if (id >= DenseLimit) { count++; } }
+        return count;
+    }
+
+    static constexpr bool Unique()
+    {
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            for (size_t j = i + 1; j < ids.size(); j++)
+            {
+                if (ids[i] == ids[j]) { return false; }
+            }
+        }
+        return true;
+    }
+    static_assert(Unique(), "Every ID can only have one handler");
+
+    // Slot 0 is "no handler", route i lives in slot i + 1
+    static constexpr THUNK thunks[sizeof...(Routes) + 1] = {nullptr, &dispatch_detail::HANDLER_TRAITS<std::remove_const_t<decltype(Routes::handler)>>::template Call<Routes::handler>...};
+
+    static constexpr std::array<uint8_t, DenseLimit> dense = []
+    {
+        std::array<uint8_t, DenseLimit> table = {};
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            if (ids[i] < DenseLimit) { table[ids[i]] = static_cast<uint8_t>(i + 1); }
+        }
+        return table;
+    }();
+
+    static constexpr std::array<SPARSE_ENTRY, CountSparse()> sparse = []
+    {
+        std::array<SPARSE_ENTRY, CountSparse()> table = {};
+        size_t count = 0;
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            if (ids[i] >= DenseLimit) { table[count++] = {ids[i], static_cast<uint8_t>(i + 1)}; }
+        }
+        // Insertion sort, the tables are small and this runs at compile time
+        for (size_t i = 1; i < count; i++)
+        {
+            for (size_t j = i; j > 0 && table[j - 1].id > table[j].id; j--)
+            {
+                SPARSE_ENTRY swap = table[j - 1];
+                table[j - 1]      = table[j];
+                table[j]          = swap;
+            }
+        }
+        return table;
+    }();
+};
+
+#endif // DISPATCH_H
@@ -0,0 +1,94 @@
+#include "gdicache.h"
+#include "trace.h"
+
+GDI_CACHE::~GDI_CACHE()
+{
+    // Whatever is still acquired at this point is deleted anyway, the users are gone with the process
+    for (auto& [key, entry] : fonts)   { DeleteObject(entry.object); }
+    for (auto& [key, entry] : brushes) { DeleteObject(entry.object); }
+}
+
+GDI_CACHE& GDI_CACHE::Shared()
+{
+    static GDI_CACHE cache;
+    return cache;
+}
+
+HFONT GDI_CACHE::AcquireFont(LPCWSTR face, int size, int weight)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = fonts.find(FONT_VIEW{face, size, weight});
+    if (found != fonts.end())
+    {
+        found->second.references++;
+        references++;
+        hits++;
+        return (HFONT)found->second.object;
+    }
+
+    TRACE_SPAN_DETAIL("CreateFont", face);
+    HFONT hFont = CreateFont(size, 0, 0, 0, weight, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY, DEFAULT_PITCH | FF_SWISS, face);
+    if (!hFont) { return NULL; }
+    FONT_KEY key = {face, size, weight};
+    fonts.emplace(key, ENTRY{hFont, 1});
+    font_keys.emplace(hFont, std::move(key));
+    references++;
+    misses++;
+    return hFont;
+}
+
+HBRUSH GDI_CACHE::AcquireBrush(COLORREF color)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = brushes.find(color);
+    if (found != brushes.end())
+    {
+        found->second.references++;
+        references++;
+        hits++;
+        return (HBRUSH)found->second.object;
+    }
+
+    TRACE_SPAN("CreateSolidBrush");
+    HBRUSH hBrush = CreateSolidBrush(color);
+    if (!hBrush) { return NULL; }
+    brushes.emplace(color, ENTRY{hBrush, 1});
+    brush_keys.emplace(hBrush, color);
+    references++;
+    misses++;
+    return hBrush;
+}
+
+void GDI_CACHE::Release(HGDIOBJ object)
+{
+    if (!object) { return; }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto font = font_keys.find(object); font != font_keys.end())
+    {
+        references--;
+        auto entry = fonts.find(font->second);
+        if (--entry->second.references == 0)
+        {
+            fonts.erase(entry);
+            font_keys.erase(font);
+            DeleteObject(object);
+        }
+    }
+    else if (auto brush = brush_keys.find(object); brush != brush_keys.end())
+    {
+        references--;
+        auto entry = brushes.find(brush->second);
+        if (--entry->second.references == 0)
+        {
+            brushes.erase(entry);
+            brush_keys.erase(brush);
+            DeleteObject(object);
+        }
+    }
+}
+
+GDI_CACHE::STATS GDI_CACHE::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return {fonts.size(), brushes.size(), references, hits, misses};
+}
@@ -0,0 +1,93 @@
+#ifndef GDICACHE_H
+#define GDICACHE_H
+#include "platform.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*
+Cache of GDI fonts and brushes.
+Controls that use the same font (face, size, weight) or brush (color) share one GDI object instead of creating their own.
+Every Acquire needs a matching Release, the object gets deleted when the last user released it.
+GDI objects belong to the process, so there is one cache for all windows (Shared()). Thread safe.
+*/
+class GDI_CACHE
+{
+public:
+
+    struct STATS
+    {
+        size_t fonts_alive;
+        size_t brushes_alive;
+        size_t references;   // Acquires that were not released yet
+        size_t hits;         // Acquires served by an existing object
+        size_t misses;       // Acquires that had to create an object
+    };
+
+    GDI_CACHE() = default;
+    ~GDI_CACHE();
+
+    GDI_CACHE(const GDI_CACHE&) = delete;
+    GDI_CACHE& operator=(const GDI_CACHE&) = delete;
+
+    static GDI_CACHE& Shared();
+
+    HFONT  AcquireFont(LPCWSTR face, int size, int weight = FW_DONTCARE);
+    HBRUSH AcquireBrush(COLORREF color);
+
+    // Gives up one reference of a font or brush returned by Acquire
+    void Release(HGDIOBJ object);
+
+    STATS GetStats() const;
+
+private:
+
+    struct FONT_KEY
+    {
+        std::wstring face;
+        int          size;
+        int          weight;
+    };
+
+    // Same as FONT_KEY without owning the face, so looking up a font does not allocate
+    struct FONT_VIEW
+    {
+        std::wstring_view face;
+        int               size;
+        int               weight;
+    };
+
+    struct FONT_LESS
+    {
+        using is_transparent = void;
+
+        template<class A, class B>
+        bool operator()(const A& a, const B& b) const
+        {
+            if (a.size != b.size)     { return a.size < b.size; }
+            if (a.weight != b.weight) { return a.weight < b.weight; }
+            return std::wstring_view(a.face) < std::wstring_view(b.face);
+        }
+    };
+
+    struct ENTRY
+    {
+        HGDIOBJ object;
+        size_t  references;
+    };
+
+    // Lookup by key to find an existing object, lookup by handle to release it
+    std::map<FONT_KEY, ENTRY, FONT_LESS>  fonts;
+    std::unordered_map<COLORREF, ENTRY>   brushes;
+    std::unordered_map<HGDIOBJ, FONT_KEY> font_keys;
+    std::unordered_map<HGDIOBJ, COLORREF> brush_keys;
+
+    mutable std::mutex mutex;
+    size_t             references = 0;
+    size_t             hits       = 0;
+    size_t             misses     = 0;
+};
+
+#endif // GDICACHE_H
@@ -1,21 +1,20 @@
 #include "gui.h"
 #include "clipboard.h"
-#include <windows.h>
-#include <cassert>
-#include <iostream>
-#include <random>
-#include <memory>
-
-// Defining IDs for the different controls
-constexpr int ID_TEST_BUTTON         = 100;
-constexpr int ID_CLIPBOARD_BUTTON    = 101;
-constexpr int ID_STATIC_TEXT         = 102;
-constexpr int ID_TEXT_EDIT           = 103;
-constexpr int ID_MESSAGEBOX_BUTTON   = 104;
-constexpr int ID_MOVE_MOUSE_BUTTON   = 105;
-constexpr int ID_FREE_CONSOLE_BUTTON = 106;
-constexpr int ID_CLEAR_TEXT_BUTTON   = 107;
-constexpr int ID_CHECKBOX            = 108;
+#include "platform.h"
+#include "dispatch.h"
+#include "trace.h"
+#include "log.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Windows 10 1803 and newer. Older MinGW headers do not have it
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 
 // function for pointer handling
 template<class T, class U, HWND(U::* m_hWnd)> T*
@@ -42,141 +41,375 @@ InstanceFromWndProc(HWND hWnd, UINT uMsg, LPARAM lParam)
     return pInstance;
 }
 
+// Message and command routing. Resolved at compile time, see dispatch.h
+struct GUI::ROUTES
+{
+    // WM_MOUSEMOVE first, it is by far the most frequent one
+    using MESSAGES = DISPATCH_TABLE<GUI, WM_USER,
+        ON<WM_MOUSEMOVE,         &GUI::OnMousemove>,
+        ON<WM_DESTROY,           &GUI::OnDestroy>,
+        ON<WM_NCDESTROY,         &GUI::OnNcDestroy>,
+        ON<WM_COMMAND,           &GUI::OnCommand>,
+        ON<WM_SIZE,              &GUI::OnSize>,
+        ON<WM_PAINT,             &GUI::OnPaint>,
+        ON<WM_ERASEBKGND,        &GUI::OnEraseBackground>,
+        ON<WM_CTLCOLORSTATIC,    &GUI::OnCTLCOLORSTATIC>,
+        ON<WM_MOUSEHOVER,        &GUI::OnMousehover>,
+        ON<WM_MOUSELEAVE,        &GUI::OnMouseleave>,
+        ON<WM_RENDERFORMAT,      &GUI::OnRenderFormat>,
+        ON<WM_RENDERALLFORMATS,  &GUI::OnRenderAllFormats>,
+        ON<WM_DESTROYCLIPBOARD,  &GUI::OnDestroyClipboard>,
+        ON<WM_CLIPBOARDUPDATE,   &GUI::OnClipboardUpdate>,
+        ON<WM_WORKER_DONE,       &GUI::OnWorkerDone>>;
+
+    // Control IDs are small, everything up to 255 is looked up directly
+    using COMMANDS = DISPATCH_TABLE<GUI, 256,
+        ON<ID_TEST_BUTTON,         &GUI::OnTestButton>,
+        ON<ID_CLIPBOARD_BUTTON,    &GUI::OnClipboardButton>,
+        ON<ID_MESSAGEBOX_BUTTON,   &GUI::OnMessageBoxButton>,
+        ON<ID_MOVE_MOUSE_BUTTON,   &GUI::OnMoveMouseButton>,
+        ON<ID_FREE_CONSOLE_BUTTON, &GUI::OnFreeConsoleButton>,
+        ON<ID_CLEAR_TEXT_BUTTON,   &GUI::OnClearTextButton>,
+        ON<ID_CHECKBOX,            &GUI::OnCheckbox>>;
+};
+
+// Background of the window and the static controls. The same gray as LTGRAY_BRUSH
+constexpr COLORREF BACKGROUND_COLOR = RGB(192, 192, 192);
+
+// Shared by every GUI
+constexpr LPCWSTR WINDOW_CLASS = L"MainWindowClass";
+
 // Callback function for the windowclass lpfnWndProc -> Function that windows calls when a message gets handled.
 LRESULT CALLBACK GUI::MessageHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
     // Pointer to class instance. This way we can use this function as a static member class and simply use private functions to handle the messages.
     GUI* pGui = InstanceFromWndProc<GUI, GUI, &GUI::m_hWnd>(hWnd, uMsg, lParam);
 
-    // Check for message and call needed functions
-    switch (uMsg)
-    {
-        case WM_DESTROY:
-        {
-            return pGui->OnDestroy();
-        }
-        case WM_COMMAND:
-        {
-            return pGui->OnCommand(hWnd, wParam);
-        }
-        case WM_SIZE:
-        {
-            return pGui->OnSize(lParam);
-        }
-        case WM_CTLCOLORSTATIC:
-        {
-            return pGui->OnCTLCOLORSTATIC(wParam);
-        }
-        case WM_MOUSEHOVER:
-        {
-            return pGui->OnMousehover(hWnd);
-        }
-        case WM_MOUSELEAVE:
-        {
-            return pGui->OnMouseleave(hWnd);
-        }
-        case WM_MOUSEMOVE:
-        {
-            return pGui->OnMousemove(hWnd);
-        }
-    }
+    // Look up the handler for the message. Messages that arrive before WM_NCCREATE have no instance yet
+    LRESULT result;
+    if (pGui && ROUTES::MESSAGES::Dispatch(pGui, uMsg, hWnd, uMsg, wParam, lParam, &result)) { return result; }
     return DefWindowProc(hWnd, uMsg, wParam, lParam);
 }
 
-// Main window functions
-void GUI::CreateMainWindow(int width, int height, LPCWSTR window_name)
+bool GUI::RegisterWindowClass(HINSTANCE hInstance)
 {
-    wc             = {}; // windowclass
-    wc.style       = CS_HREDRAW | CS_VREDRAW;
+    // Windows opened on several threads at once would race between the check and RegisterClass
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Looked up every time instead of remembered, somebody may have unregistered it since
+    WNDCLASS existing;
+    if (GetClassInfo(hInstance, WINDOW_CLASS, &existing)) { return true; }
+
+    WNDCLASS wc    = {}; // windowclass
+    wc.style       = 0; // No CS_HREDRAW | CS_VREDRAW, a resize only repaints what it uncovers
     wc.lpfnWndProc = GUI::MessageHandler; // long pointer function window procedure -> pointer to C function. Supplying static function to get around non class problem
     wc.hInstance   = hInstance;
     wc.hCursor     = LoadCursor(nullptr, IDC_ARROW);
 
-    // This color fits together with the background settings for the static controls. If the color here is changed it needs to be changed for them too.
+    // Only seen before the first WM_PAINT, the painter draws the background itself. Same color as BACKGROUND_COLOR
     wc.hbrBackground = (HBRUSH)GetStockObject(LTGRAY_BRUSH); // needs "-lgdi32" linked to compiler. See "https://stackoverflow.com/a/64842359/12971025"
-    wc.lpszClassName = L"MainWindowClass";
-    assert(RegisterClass(&wc));
+    wc.lpszClassName = WINDOW_CLASS;
+
+    TRACE_SPAN("RegisterClass");
+    if (!RegisterClass(&wc) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS)
+    {
+        LOG_ERROR(L"RegisterClass failed. Errnum =", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+GUI::~GUI()
+{
+    if (m_hWnd) { DestroyWindow(m_hWnd); }
+}
+
+std::thread GUI::Spawn(int width, int height, std::wstring window_name, std::function<void(GUI&)> ready)
+{
+    // Counted on the calling thread, so the numbers do not depend on which thread starts first
+    static std::atomic<int> spawned{0};
+    const int index = ++spawned;
+    return std::thread([width, height, index, window_name = std::move(window_name), ready = std::move(ready)]
+    {
+        GUI gui;
+        gui.window_index = index;
+        bool created = gui.CreateMainWindow(width, height, window_name.c_str());
+        if (ready) { ready(gui); }
+        if (created) { gui.RunMainLoop(); }
+    });
+}
 
+// Main window functions
+bool GUI::CreateMainWindow(int width, int height, LPCWSTR window_name)
+{
+    TRACE_SPAN("GUI::CreateMainWindow");
+
+    // GUI_RANDOM_SEED=<number> makes the cursor and window jumps the same on every run
+    if (const char* seed = std::getenv("GUI_RANDOM_SEED"))
+    {
+        random.Seed(std::strtoull(seed, nullptr, 0));
+        LOG_INFO(L"Random seed", random.GetSeed());
+    }
+
+    // GUI_CLIPBOARD_COMPRESS=<characters> keeps texts from that size on compressed while they are on the clipboard
+    if (const char* compress = std::getenv("GUI_CLIPBOARD_COMPRESS")) { clipboard.setCompression(std::strtoull(compress, nullptr, 0)); }
+
+    if (!RegisterWindowClass(hInstance)) { return false; }
 
     /*
     Passing a pointer of this class instance to the lParam of CreateWindowEx
     This way I can use a static member function for the lpfnWndProc callback
     Using that I simply return the function I want to call and handle all the messages like that.
     Using modified version I found here -> https://building.enlyze.com/posts/writing-win32-apps-like-its-2020-part-2/
+    The pointer has to be this instance. The handlers run on it for the whole lifetime of the window.
+    Every GUI has its own window and binds it to itself here, so any number of them can be open at once.
     */
-    auto pGUI = std::unique_ptr<GUI>(new GUI);
 
     // Main window handle
-    m_hWnd = CreateWindowEx(0, wc.lpszClassName, window_name, WS_OVERLAPPEDWINDOW | WS_VISIBLE, CW_USEDEFAULT, CW_USEDEFAULT, width, height, 0, 0, hInstance, pGUI.get()); // In windows every control is its own window bound to this main window
-
-    // Edit control
-    AddEditControl(10, 10, L"", (HMENU)ID_TEXT_EDIT, 305, 50);
-
-    // text label
-    constexpr int text_label_x      = 95;
-    constexpr int text_label_y      = 88;
-    constexpr int width_text_label  = 225;
-    constexpr int height_text_label = 45;
-
+    {
+        TRACE_SPAN_DETAIL("CreateWindowEx", window_name);
+        m_hWnd = CreateWindowEx(0, WINDOW_CLASS, window_name, WS_OVERLAPPEDWINDOW | WS_VISIBLE | WS_CLIPCHILDREN, CW_USEDEFAULT, CW_USEDEFAULT, width, height, 0, 0, hInstance, this); // In windows every control is its own window bound to this main window
+    }
+    if (!m_hWnd) { LOG_ERROR(L"CreateWindowEx failed. Errnum =", GetLastError()); return false; }
+    workers.SetTarget(m_hWnd, WM_WORKER_DONE);
+    clipboard.setWorkers(&workers);
+    mouse_input.Attach(&timers, [this](MSG& move) { DispatchLoopMessage(move); });
+    painter.Start(m_hWnd, BACKGROUND_COLOR);
+
+    // Hear about what other programs copy
+    clipboard_monitor.SetHandler([](const CLIPBOARD_MONITOR::CHANGE& change)
+    {
+        LOG_INFO(L"Another program copied", change.length, L"characters, changed:", change.changed_chars, L"in regions:", change.changed_count);
+    });
+    clipboard_monitor.Start(m_hWnd, &timers);
 
-    // Buttons
-    constexpr int FONT_SIZE_CLEAR_BUTTON = 14;
-    this->AddButton(248, 63, L"Clear", (HMENU)ID_CLEAR_TEXT_BUTTON, 50, 20, FONT_SIZE_CLEAR_BUTTON);
+    /*
+    The layout places every control, so they are all created at 0, 0.
+    Sizes are pixels at 96 DPI, the layout scales them.
 
+        Edit control
+                                 [Clear]
+        [Button]  Description
+        ...
+    */
+    constexpr int PADDING       = 10;
     constexpr int BUTTON_WIDTH  = 80;
     constexpr int BUTTON_HEIGHT = 45;
+    constexpr int LABEL_OFFSET  = 3; // Moves the description down so the text lines up with the button text
+    constexpr int ROW_GAP       = 5;
+    constexpr int FONT_SIZE_CLEAR_BUTTON = 14;
+    using KIND = CONTROLS::KIND;
 
-    this->AddButton(10, 85, L"Clipboard Test", (HMENU)ID_CLIPBOARD_BUTTON, BUTTON_WIDTH, BUTTON_HEIGHT);
-    LPCWSTR text_clipboard_desc = L"Click the button to set the Clipboard to the content of the text box.";
-    this->AddTextLabel(text_label_x, text_label_y, text_clipboard_desc, (HMENU)ID_STATIC_TEXT, width_text_label, height_text_label);
-    // this->AddFenceBar(95, 133);
-
-
-    this->AddButton(10, 140, L"Show Messagebox", (HMENU)ID_MESSAGEBOX_BUTTON, BUTTON_WIDTH, BUTTON_HEIGHT);
-    LPCWSTR descr_messagebox = L"Show a message box with buttons.";
-    this->AddTextLabel(text_label_x, 143, descr_messagebox, (HMENU)ID_STATIC_TEXT, width_text_label, height_text_label);
+    // Button on the left, description next to it
+    struct ROW
+    {
+        CONTROLS::DESCRIPTOR control;
+        LPCWSTR              description;
+        int                  gap_after;
+    };
+    static constexpr ROW ROWS[] =
+    {
+        {{KIND::BUTTON,   ID_CLIPBOARD_BUTTON,    L"Clipboard Test",  BUTTON_WIDTH, BUTTON_HEIGHT, FONT_SIZE}, L"Click the button to set the Clipboard to the content of the text box.", 10},
+        {{KIND::BUTTON,   ID_MESSAGEBOX_BUTTON,   L"Show Messagebox", BUTTON_WIDTH, BUTTON_HEIGHT, FONT_SIZE}, L"Show a message box with buttons.", 10},
+        {{KIND::BUTTON,   ID_MOVE_MOUSE_BUTTON,   L"Move Mouse",      BUTTON_WIDTH, BUTTON_HEIGHT, FONT_SIZE}, L"Move the mouse to a random position on the screen.", 10},
+        {{KIND::BUTTON,   ID_FREE_CONSOLE_BUTTON, L"Detach CMD",      BUTTON_WIDTH, BUTTON_HEIGHT, FONT_SIZE}, L"Detaches the console from the app.", 5},
+        {{KIND::CHECKBOX, ID_CHECKBOX,            L"Enable move",     BUTTON_WIDTH, BUTTON_HEIGHT, FONT_SIZE}, L"When this checkbox is ticked the window will randomly move around when hovering over it.", 0},
+    };
+    constexpr size_t ROW_COUNT  = sizeof(ROWS) / sizeof(ROWS[0]);
+    constexpr size_t FORM_COUNT = 2 + 2 * ROW_COUNT;
+
+    // Every control in one go: edit control, clear button, then button and label of each row
+    CONTROLS::DESCRIPTOR form[FORM_COUNT] =
+    {
+        {KIND::EDIT,   ID_TEXT_EDIT,         L"",      305, 50, FONT_SIZE},
+        {KIND::BUTTON, ID_CLEAR_TEXT_BUTTON, L"Clear", 50,  20, FONT_SIZE_CLEAR_BUTTON},
+    };
+    for (size_t i = 0; i < ROW_COUNT; i++)
+    {
+        form[2 + 2 * i]     = ROWS[i].control;
+        form[2 + 2 * i + 1] = {KIND::LABEL, CONTROLS::AUTO_ID, ROWS[i].description, 225, BUTTON_HEIGHT, FONT_SIZE};
+    }
+    int ids[FORM_COUNT];
+    controls.CreateAll(m_hWnd, form, FORM_COUNT, ids);
 
-    this->AddButton(10, 195, L"Move Mouse", (HMENU)ID_MOVE_MOUSE_BUTTON, BUTTON_WIDTH, BUTTON_HEIGHT);
-    LPCWSTR descr_mouse_move = L"Move the mouse to a random position on the screen.";
-    this->AddTextLabel(text_label_x, 198, descr_mouse_move, (HMENU)ID_STATIC_TEXT, width_text_label, height_text_label);
+    int root = layout.Root(PADDING);
 
+    // Edit control
+    controls.Place(layout, root, ids[0], LAYOUT::Flex(), LAYOUT::Fixed(50));
+    layout.Spacer(root, LAYOUT::Flex(), LAYOUT::Fixed(3));
 
-    this->AddButton(10, 250, L"Detach CMD", (HMENU)ID_FREE_CONSOLE_BUTTON, BUTTON_WIDTH, BUTTON_HEIGHT);
-    LPCWSTR descr_detach = L"Detaches the console from the app.";
-    this->AddTextLabel(text_label_x, 253, descr_detach, (HMENU)ID_STATIC_TEXT, width_text_label, height_text_label);
+    // Clear button aligned to the right edge of the edit control
+    int clear_row = layout.Row(root, LAYOUT::Flex(), LAYOUT::Fixed(20));
+    layout.Spacer(clear_row, LAYOUT::Flex(), LAYOUT::Flex());
+    controls.Place(layout, clear_row, ids[1], LAYOUT::Fixed(50), LAYOUT::Fixed(20));
+    layout.Spacer(root, LAYOUT::Flex(), LAYOUT::Fixed(2));
 
-    this->AddCheckbox(10, 300, L"Enable move", (HMENU)ID_CHECKBOX, BUTTON_WIDTH, BUTTON_HEIGHT);
-    LPCWSTR descr_checkbox = L"When this checkbox is ticked the window will randomly move around when hovering over it.";
-    this->AddTextLabel(text_label_x, 303, descr_checkbox, (HMENU)ID_STATIC_TEXT, width_text_label, height_text_label);
-    //todo: Replace magic numbers everywhere
+    for (size_t i = 0; i < ROW_COUNT; i++)
+    {
+        int row = layout.Row(root, LAYOUT::Flex(), LAYOUT::Fixed(BUTTON_HEIGHT), 0, ROW_GAP);
+        controls.Place(layout, row, ids[2 + 2 * i], LAYOUT::Fixed(BUTTON_WIDTH), LAYOUT::Fixed(BUTTON_HEIGHT));
+        int label_column = layout.Column(row, LAYOUT::Flex(), LAYOUT::Flex());
+        layout.Spacer(label_column, LAYOUT::Flex(), LAYOUT::Fixed(LABEL_OFFSET));
+        controls.Place(layout, label_column, ids[2 + 2 * i + 1], LAYOUT::Flex(), LAYOUT::Flex());
+        layout.Spacer(root, LAYOUT::Flex(), LAYOUT::Fixed(ROWS[i].gap_after));
+    }
+    // this->AddFenceBar(95, 133);
 
+    // Scale for the DPI of the screen and place everything. Later sizes come with WM_SIZE
+    TRACE_SPAN("LAYOUT");
+    HDC hdc = GetDC(m_hWnd);
+    layout.SetScale(GetDeviceCaps(hdc, LOGPIXELSX) / 96.0f);
+    ReleaseDC(m_hWnd, hdc);
+    RECT client;
+    GetClientRect(m_hWnd, &client);
+    layout.Resize(client.right - client.left, client.bottom - client.top);
+    layout.Apply();
+    controls.UpdateRects(layout);
+    return true;
 }
 
 // this function runs the main message loop to handle messages and send them to the callback
 int GUI::RunMainLoop()
 {
-    bool bRet;
+    BOOL bRet;
     constexpr int show_cmd = 1;
-    ShowWindow(m_hWnd, show_cmd);
-    UpdateWindow(m_hWnd);
+    {
+        TRACE_SPAN("ShowWindow");
+        ShowWindow(m_hWnd, show_cmd);
+        UpdateWindow(m_hWnd);
+    }
 
-    while ((bRet = GetMessage(&msg, NULL, 0, 0)) != 0) // Using this way to keep the loop running. This is recommended by microsoft.
+    // One kernel timer for all timers of the wheel. Windows before 1803 has no high resolution ones, the normal kind follows the system tick
+    wake_timer = CreateWaitableTimerEx(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!wake_timer) { wake_timer = CreateWaitableTimerEx(NULL, NULL, 0, TIMER_ALL_ACCESS); }
+    if (!wake_timer) { LOG_WARN(L"No waitable timer, timers wait with the millisecond timeout. Errnum =", GetLastError()); }
+    wake_due = TIMER_WHEEL::NEVER;
+
+    // GUI_MESSAGE_STATS=<file> writes the latency table to the file every few seconds and when the loop ends
+    constexpr uint64_t STATS_DUMP_INTERVAL_NS = 10000000000;
+    // Windows from Spawn write to <file>.1, <file>.2..., they would overwrite each other's file otherwise
+    auto window_path = [this](const char* path) { return window_index ? std::string(path) + "." + std::to_string(window_index) : std::string(path); };
+    const char* stats_variable = std::getenv("GUI_MESSAGE_STATS");
+    const std::string stats_path = stats_variable ? window_path(stats_variable) : std::string();
+    TIMER_WHEEL::TIMER stats_dump = 0;
+    if (stats_variable) { stats_dump = timers.Schedule(STATS_DUMP_INTERVAL_NS, [this, stats_path] { message_stats.Dump(stats_path.c_str()); }, STATS_DUMP_INTERVAL_NS); }
+
+    // GUI_RECORD=<file> records this run of the loop, GUI_REPLAY=<file> plays it back (see main.cpp)
+    const char* record_variable = recorder.IsOpen() ? nullptr : std::getenv("GUI_RECORD");
+    const std::string record_path = record_variable ? window_path(record_variable) : std::string();
+    if (record_variable && !StartRecording(record_path.c_str())) { LOG_ERROR(L"Could not open the recording", std::wstring(record_path.begin(), record_path.end())); } // copied, the log keeps char pointers as literals
+
+    // A wait that keeps failing does not get better. Backs off 2, 4, 8... ms, then the loop ends
+    constexpr int MAX_WAIT_FAILURES = 8;
+    int wait_failures = 0;
+    while ((bRet = NextMessage(&msg)) != 0) // Using this way to keep the loop running. This is recommended by microsoft.
     {
-        if (bRet == -1) // GetMessage return value can be nonzero, zero, or -1 so we cant avoid this
+        if (bRet == -1) // Same return values as GetMessage: nonzero, zero, or -1 so we cant avoid this
         {
-            // handle the error and possibly exit
-            std::wcout << "An error occurred";
+            // msg holds no new message, nothing to dispatch
+            LOG_ERROR(L"Waiting for messages failed. Errnum =", GetLastError(), L"in a row:", wait_failures + 1);
+            if (++wait_failures == MAX_WAIT_FAILURES)
+            {
+                msg.wParam = static_cast<WPARAM>(-1);
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1 << wait_failures));
+            continue;
         }
-        else
+        wait_failures = 0;
+
+        // Mouse moves go out once a frame, the newest one. What Defer took out of the queue instead of a move goes right after
+        if (!mouse_input.Defer(msg)) { DispatchLoopMessage(msg); }
+        while (mouse_input.TakeOther(msg) && msg.message != WM_QUIT)
         {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+            if (!mouse_input.Defer(msg)) { DispatchLoopMessage(msg); }
         }
+        if (msg.message == WM_QUIT) { break; }
+    }
+    mouse_input.Flush();
+    if (stats_variable)
+    {
+        timers.Cancel(stats_dump);
+        message_stats.Dump(stats_path.c_str());
+    }
+    if (record_variable) { StopRecording(); }
+    if (wake_timer)
+    {
+        CloseHandle(wake_timer);
+        wake_timer = NULL;
     }
 
     // Return the exit code to the system.
     return msg.wParam;
 }
 
+void GUI::DispatchLoopMessage(MSG& message)
+{
+    recorder.Record(message);
+    if (message_stats.Enabled())
+    {
+        // message.time is when the message was posted, in GetTickCount milliseconds
+        uint64_t queue_ns = uint64_t(GetTickCount() - message.time) * 1000000;
+        auto start = std::chrono::steady_clock::now();
+        TranslateMessage(&message);
+        DispatchMessage(&message);
+        auto handler_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        message_stats.Record(message, queue_ns, static_cast<uint64_t>(handler_ns));
+    }
+    else
+    {
+        TranslateMessage(&message);
+        DispatchMessage(&message);
+    }
+}
+
+BOOL GUI::NextMessage(LPMSG message)
+{
+    for (;;)
+    {
+        timers.Advance(TIMER_WHEEL::Now());
+        if (PeekMessage(message, NULL, 0, 0, PM_REMOVE)) { return message->message != WM_QUIT; }
+
+        // The kernel timer is only set again when the earliest timer changed, most waits reuse it
+        const uint64_t due = timers.NextDue();
+        DWORD timeout = INFINITE;
+        if (due == TIMER_WHEEL::NEVER)
+        {
+            if (wake_timer && wake_due != TIMER_WHEEL::NEVER) { CancelWaitableTimer(wake_timer); }
+            wake_due = TIMER_WHEEL::NEVER;
+        }
+        else
+        {
+            const uint64_t now     = TIMER_WHEEL::Now();
+            const uint64_t wait_ns = due > now ? due - now : 0;
+            if (wake_timer && due != wake_due)
+            {
+                LARGE_INTEGER relative;
+                relative.QuadPart = -static_cast<int64_t>((wait_ns + 99) / 100); // 100 ns units, negative is relative
+                wake_due = SetWaitableTimer(wake_timer, &relative, 0, NULL, NULL, FALSE) ? due : TIMER_WHEEL::NEVER;
+            }
+            if (wake_due != due) { timeout = static_cast<DWORD>((wait_ns + 999999) / 1000000); }
+        }
+
+        const DWORD result = MsgWaitForMultipleObjects(wake_timer ? 1 : 0, &wake_timer, FALSE, timeout, QS_ALLINPUT);
+        if (result == WAIT_FAILED) { return -1; }
+        if (wake_timer && result == WAIT_OBJECT_0) { wake_due = TIMER_WHEEL::NEVER; } // auto reset, it has to be set again
+    }
+}
+
+bool GUI::StartRecording(const char* path)
+{
+    return recorder.Open(path, m_hWnd, random.GetSeed());
+}
+
+MESSAGE_REPLAY::RESULT GUI::Replay(const MESSAGE_REPLAY& replay, MESSAGE_REPLAY::SPEED speed)
+{
+    TRACE_SPAN("GUI::Replay");
+    random.Seed(replay.Seed());
+    message_stats.Reset();
+    return replay.Run(m_hWnd, speed, &message_stats);
+}
+
 int GUI::DisplayMessageBox(HWND hWnd)
 {
     // Display a simply messagebox
@@ -184,13 +417,13 @@ int GUI::DisplayMessageBox(HWND hWnd)
     switch (msgboxID)
     {
         case IDCANCEL:
-            std::wcout << "Pressed cancel\n";
+            LOG_INFO(L"Pressed cancel");
             break;
         case IDTRYAGAIN:
-            std::wcout << "Pressed Try again\n";
+            LOG_INFO(L"Pressed Try again");
             break;
         case IDCONTINUE:
-            std::wcout << "Pressed continue\n";
+            LOG_INFO(L"Pressed continue");
             break;
     }
 
@@ -200,123 +433,159 @@ int GUI::DisplayMessageBox(HWND hWnd)
 // Handle message que functions
 LRESULT GUI::OnCommand(HWND hWnd, WPARAM wParam)
 {
-    HWND handle_edit = GetDlgItem(hWnd, ID_TEXT_EDIT);
-    switch (LOWORD(wParam))
+    // The low word holds the ID of the control that sent the command.
+    // Timed here and not only in the loop: a click sends WM_COMMAND from the WM_LBUTTONUP of the button, it never goes through the queue
+    LRESULT result = 0;
+    if (!message_stats.Enabled())
     {
-        case ID_TEST_BUTTON:
-        {
-            // For test purposes;
-            break;
-        }
+        ROUTES::COMMANDS::Dispatch(this, LOWORD(wParam), hWnd, WM_COMMAND, wParam, 0, &result);
+        return result;
+    }
+    auto start = std::chrono::steady_clock::now();
+    ROUTES::COMMANDS::Dispatch(this, LOWORD(wParam), hWnd, WM_COMMAND, wParam, 0, &result);
+    auto handler_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    message_stats.RecordCommand(LOWORD(wParam), static_cast<uint64_t>(handler_ns));
+    return result;
+}
 
-        case ID_CLIPBOARD_BUTTON:
-        {
+LRESULT GUI::OnTestButton()
+{
+    // For test purposes;
+    return 0;
+}
 
-            // Sets clipboard to string in the text edit
-            int text_length = GetWindowTextLength(handle_edit);
-            if (text_length == 0) { break; }
+LRESULT GUI::OnClipboardButton(HWND hWnd)
+{
+    // Sets clipboard to string in the text edit. Publishing is cheap with delayed rendering, the history add runs on a worker
+    clipboard.setClipboardToWindowText(hWnd, controls.Handle(ID_TEXT_EDIT));
+    return 0;
+}
 
-            // Allocates memory for GetWindowText
-            LPTSTR cbString = (LPTSTR)VirtualAlloc((LPVOID)NULL, (DWORD)text_length + 1, MEM_COMMIT, PAGE_READWRITE);
-            GetWindowText(handle_edit, cbString, text_length + 1);
-            CLIPBOARD cb;
-            cb.setClipboardToString(hWnd, cbString);
-            break;
-        }
-        case ID_MESSAGEBOX_BUTTON:
-        {
-            // Displays a test message box
-            int message_box = this->DisplayMessageBox(hWnd);
-            if (!message_box)
-            {
-                std::wcout << GetLastError() << std::endl;
-            }
-            break;
-        }
-        case ID_MOVE_MOUSE_BUTTON:
-        {
-            // Get primary monitor size
-            int primary_screen_width = GetSystemMetrics(SM_CXSCREEN);
-            int primary_screen_height = GetSystemMetrics(SM_CYSCREEN);
-
-            // Generate random x and y positions
-            std::random_device rd;
-            std::mt19937 mt(rd());
-            std::uniform_int_distribution<> dist_x(0, primary_screen_width);
-            std::uniform_int_distribution<> dist_y(0, primary_screen_height);
-            int move_mouse_x = dist_x(mt);
-            int move_mouse_y = dist_y(mt);
-
-            // moves cursor
-            SetCursorPos(move_mouse_x, move_mouse_y);
-            break;
-        }
-        case ID_FREE_CONSOLE_BUTTON:
-        {
-            // detaches console from program
-            FreeConsole();
-            break;
-        }
-        case ID_CLEAR_TEXT_BUTTON:
-        {
-            // Clears text edit field
-            SetWindowText(handle_edit, L"");
-            break;
-        }
+LRESULT GUI::OnMessageBoxButton(HWND hWnd)
+{
+    // Displays a test message box
+    int message_box = this->DisplayMessageBox(hWnd);
+    if (!message_box)
+    {
+        LOG_ERROR(L"MessageBox failed. Errnum =", GetLastError());
     }
     return 0;
 }
 
+LRESULT GUI::OnMoveMouseButton()
+{
+    // Get primary monitor size
+    int primary_screen_width = GetSystemMetrics(SM_CXSCREEN);
+    int primary_screen_height = GetSystemMetrics(SM_CYSCREEN);
+
+    // Generate random x and y positions
+    int move_mouse_x = random.Between(0, primary_screen_width - 1);
+    int move_mouse_y = random.Between(0, primary_screen_height - 1);
+
+    // moves cursor
+    SetCursorPos(move_mouse_x, move_mouse_y);
+    return 0;
+}
+
+LRESULT GUI::OnFreeConsoleButton()
+{
+    // detaches console from program. Whatever is logged until now still goes to the console
+    LOG::Flush();
+    FreeConsole();
+
+    // Without a console the log goes to GUI_LOG_FILE if it is set, otherwise it is dropped
+    const char* log_file = std::getenv("GUI_LOG_FILE");
+    if (!log_file || !LOG::ToFile(log_file)) { LOG::Discard(); }
+    LOG_INFO(L"Console detached");
+    return 0;
+}
+
+LRESULT GUI::OnClearTextButton()
+{
+    // Clears text edit field
+    SetWindowText(controls.Handle(ID_TEXT_EDIT), L"");
+    return 0;
+}
+
+LRESULT GUI::OnCheckbox()
+{
+    // The checkbox changed itself, remember the new state so a hover does not have to ask
+    controls.OnClicked(ID_CHECKBOX);
+    return 0;
+}
+
 LRESULT GUI::OnDestroy()
 {
     PostQuitMessage(0);
     return 0;
 }
 
+LRESULT GUI::OnNcDestroy(HWND hWnd)
+{
+    clipboard_monitor.Stop();
+
+    // Results that arrive from now on have no window to go to
+    workers.Cancel();
+    workers.SetTarget(NULL, 0);
+
+    // Last message of the window, the controls are already destroyed and do not use the fonts anymore
+    controls.Clear();
+
+    const HISTOGRAM& frame_times = painter.GetFrameTimes();
+    if (frame_times.Count()) { LOG_INFO(L"Painted frames:", frame_times.Count(), L"median us:", frame_times.Percentile(50) / 1000, L"p99 us:", frame_times.Percentile(99) / 1000); }
+    painter.Stop();
+
+    // Unbind, messages to the dead handle must not reach this instance, it may be gone soon
+    SetWindowLongPtr(hWnd, GWLP_USERDATA, 0);
+    m_hWnd = NULL;
+    return 0;
+}
+
 LRESULT GUI::OnSize(LPARAM lParam)
 {
     UINT width  = LOWORD(lParam);
     UINT height = HIWORD(lParam);
-    std::wcout << width << "\n" << height << std::endl;
+
+    // Reflow. Only the parts of the layout that changed size are recomputed and moved
+    TRACE_SPAN("LAYOUT");
+    layout.Resize(width, height);
+    layout.Apply();
+    controls.UpdateRects(layout);
     return 0;
 }
 
-LRESULT GUI::OnCTLCOLORSTATIC(WPARAM wParam)
+LRESULT GUI::OnPaint()
 {
-    //! This runs on any control that sends the WM_CTLCOLORSTATIC message
-    //todo: Check if it is possible to get the ID of the hWnd so we can ran this only when the ID is actually of something we want to modify
+    // Only the update area is drawn, through the back buffer
+    painter.OnPaint();
+    return 0;
+}
 
-    // This color is made to fit together with the LTGRAY_BRUSH background brush. If that is changed this needs to be changed as well.
+LRESULT GUI::OnEraseBackground()
+{
+    // Erasing here and painting later flickers. The background is drawn together with the rest in OnPaint
+    return 1;
+}
 
+LRESULT GUI::OnCTLCOLORSTATIC(WPARAM wParam, LPARAM lParam)
+{
+    // Runs every time a static control paints. The colors were decided when the control got them, this is only a lookup
     // For some reason the repaint does not work correctly when launching the app with a debugger attached.
-    constexpr int GRAY = 192;
-    HDC hdcStatic = (HDC)wParam;
-
-    SetTextColor(hdcStatic, RGB(0,0,0));
-    SetBkColor(hdcStatic, RGB(GRAY, GRAY, GRAY));
-    if (hbrBkgnd == NULL)
-    {
-        hbrBkgnd = (HBRUSH)GetStockObject(LTGRAY_BRUSH);
-    }
-    return (INT_PTR)hbrBkgnd;
+    return (INT_PTR)painter.OnCtlColorStatic((HDC)wParam, (HWND)lParam);
 }
 
 LRESULT GUI::OnMousehover(HWND hWnd)
 {
-    int checkbox_state = IsDlgButtonChecked(hWnd, ID_CHECKBOX); // Get state of the checkbox. checked or unchecked
-    if (checkbox_state)
+    mouse_input.OnHover();
+    if (controls.IsChecked(ID_CHECKBOX)) // Cached by OnCheckbox, no need to ask the checkbox
     {
         // Get primary monitor size
         int primary_screen_width  = GetSystemMetrics(SM_CXSCREEN);
         int primary_screen_height = GetSystemMetrics(SM_CYSCREEN);
 
         // Generate random x and y positions
-        std::random_device rd;
-        std::mt19937 mt(rd());
-        std::uniform_int_distribution<> dist_x(0, primary_screen_width);
-        std::uniform_int_distribution<> dist_y(0, primary_screen_height);
-        int move_window_x = dist_x(mt);
-        int move_window_y = dist_y(mt);
+        int move_window_x = random.Between(0, primary_screen_width - 1);
+        int move_window_y = random.Between(0, primary_screen_height - 1);
 
         // Make sure final coordinates dont move the window out of view
         int final_pos_x = (move_window_x > primary_screen_width - 300) ? (move_window_x - 300) : (move_window_x);
@@ -324,93 +593,103 @@ LRESULT GUI::OnMousehover(HWND hWnd)
 
         // Move window do coordinates
         int window_move = SetWindowPos(hWnd, HWND_TOP, final_pos_x, final_pos_y, 0, 0, SWP_NOSIZE | SWP_ASYNCWINDOWPOS);
-        if (!window_move){std::wcout << "An error occurred setting the window position. Errnum = " << GetLastError() << std::endl;}
+        if (!window_move){LOG_ERROR(L"An error occurred setting the window position. Errnum =", GetLastError());}
     }
     return 0;
 }
 
-LRESULT GUI::OnMousemove(HWND hWnd)
+LRESULT GUI::OnRenderFormat(WPARAM wParam)
+{
+    // Somebody pastes what we put on the clipboard with delayed rendering
+    return clipboard.renderFormat((UINT)wParam);
+}
+
+LRESULT GUI::OnRenderAllFormats(HWND hWnd)
+{
+    return clipboard.renderAllFormats(hWnd);
+}
+
+LRESULT GUI::OnDestroyClipboard()
+{
+    return clipboard.destroyClipboard();
+}
+
+LRESULT GUI::OnClipboardUpdate()
 {
-    // init mousetracker
-    TRACKMOUSEEVENT tme = {};
-    tme.cbSize      = sizeof(tme);
-    tme.dwFlags     = TME_HOVER | TME_LEAVE;
-    tme.hwndTrack   = hWnd;
-    tme.dwHoverTime = 0;
-    bool tme_bool   = TrackMouseEvent(&tme);
-    if(!tme_bool){std::wcout << "An error occurred. Errnum = " << GetLastError() << std::endl;}
+    clipboard_monitor.OnUpdate();
     return 0;
 }
-LRESULT GUI::OnMouseleave(HWND hWnd)
+
+LRESULT GUI::OnWorkerDone()
 {
-    // stop mousetracker when mouse leaves window
-    TRACKMOUSEEVENT tme = {};
-    tme.cbSize      = sizeof(tme);
-    tme.dwFlags     = TME_HOVER | TME_LEAVE | TME_CANCEL;
-    tme.hwndTrack   = hWnd;
-    tme.dwHoverTime = 0;
-    bool tme_bool   = TrackMouseEvent(&tme);
-    if(!tme_bool){std::wcout << "An error occurred. Errnum = " << GetLastError() << std::endl;}
+    TRACE_SPAN("GUI::OnWorkerDone");
+    workers.RunCompletions();
     return 0;
 }
 
-// Functions to add controls and set font
-void GUI::SetFont(HWND control_handle, LPCWSTR font_type, int font_size)
+LRESULT GUI::OnMousemove(HWND hWnd)
 {
-    // Sets the font of the supplied hwnd
-    HFONT hFont = CreateFont(font_size, 0, 0, 0, FW_DONTCARE, FALSE, FALSE, FALSE, ANSI_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY, DEFAULT_PITCH | FF_SWISS, font_type);
-    // HWND handle_control_static = GetDlgItem(hWnd, ID_STATIC_TEXT);
-    SendMessage(control_handle, WM_SETFONT, WPARAM(hFont), TRUE);
+    // Arms the mousetracker once per enter/hover, not on every move
+    if(!mouse_input.OnMove(hWnd)){LOG_ERROR(L"TrackMouseEvent failed. Errnum =", GetLastError());}
+    return 0;
+}
+LRESULT GUI::OnMouseleave()
+{
+    // The mousetracker stops by itself when the mouse leaves the window
+    mouse_input.OnLeave();
+    return 0;
 }
 
-void GUI::AddButton(int x_pos, int y_pos)
+// Functions to add controls. They all go through the control registry, which also gives them their font
+HWND GUI::AddButton(int x_pos, int y_pos)
 {
-    HWND button_handle = CreateWindow(L"button", L"Button", WS_TABSTOP | WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON, x_pos, y_pos, WIDTH_BUTTON, HEIGHT_BUTTON, m_hWnd, (HMENU)ID_TEST_BUTTON, hInstance, 0);
-    this->SetFont(button_handle, FONT_TYPE);
+    TRACE_SPAN("GUI::AddButton");
+    return controls.Handle(controls.Create(m_hWnd, {CONTROLS::KIND::BUTTON, ID_TEST_BUTTON, L"Button", WIDTH_BUTTON, HEIGHT_BUTTON, FONT_SIZE}, x_pos, y_pos));
 }
 
-void GUI::AddButton(int x_pos, int y_pos, LPCWSTR button_text, HMENU button_id)
+HWND GUI::AddButton(int x_pos, int y_pos, LPCWSTR button_text, HMENU button_id)
 {
+    TRACE_SPAN_DETAIL("GUI::AddButton", button_text);
     // creates button with ID and text as arguments
-    HWND button_handle = CreateWindow(L"button", button_text, BS_MULTILINE | WS_TABSTOP | WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON, x_pos, y_pos, WIDTH_BUTTON, HEIGHT_BUTTON, m_hWnd, (HMENU)button_id, hInstance, 0);
-    this->SetFont(button_handle, FONT_TYPE);
+    return controls.Handle(controls.Create(m_hWnd, {CONTROLS::KIND::BUTTON, (int)(INT_PTR)button_id, button_text, WIDTH_BUTTON, HEIGHT_BUTTON, FONT_SIZE}, x_pos, y_pos));
 }
 
-void GUI::AddButton(int x_pos, int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height)
+HWND GUI::AddButton(int x_pos, int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height)
 {
+    TRACE_SPAN_DETAIL("GUI::AddButton", button_text);
     // creates button with ID, size and text as arguments
-    HWND button_handle = CreateWindow(L"button", button_text, BS_MULTILINE | WS_TABSTOP | WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON, x_pos, y_pos, width, height, m_hWnd, (HMENU)button_id, hInstance, 0);
-    this->SetFont(button_handle, FONT_TYPE);
+    return controls.Handle(controls.Create(m_hWnd, {CONTROLS::KIND::BUTTON, (int)(INT_PTR)button_id, button_text, width, height, FONT_SIZE}, x_pos, y_pos));
 }
 
-void GUI::AddButton(int x_pos, int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height, int font_size)
+HWND GUI::AddButton(int x_pos, int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height, int font_size)
 {
+    TRACE_SPAN_DETAIL("GUI::AddButton", button_text);
     // creates button with ID, size, text and text size as arguments
-    HWND button_handle = CreateWindow(L"button", button_text, BS_MULTILINE | WS_TABSTOP | WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON, x_pos, y_pos, width, height, m_hWnd, (HMENU)button_id, hInstance, 0);
-    this->SetFont(button_handle, FONT_TYPE, font_size);
+    return controls.Handle(controls.Create(m_hWnd, {CONTROLS::KIND::BUTTON, (int)(INT_PTR)button_id, button_text, width, height, font_size}, x_pos, y_pos));
 }
 
-void GUI::AddCheckbox(int x_pos, int y_pos, LPCWSTR checkbox_text, HMENU button_id, int width, int height)
+HWND GUI::AddCheckbox(int x_pos, int y_pos, LPCWSTR checkbox_text, HMENU button_id, int width, int height)
 {
-    // creates checkbox with ID, size, text and text size as arguments
-    HWND button_handle = CreateWindow(L"button", checkbox_text, BS_MULTILINE | WS_TABSTOP | WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX, x_pos, y_pos, width, height, m_hWnd, (HMENU)button_id, hInstance, 0);
-    this->SetFont(button_handle, FONT_TYPE);
+    TRACE_SPAN_DETAIL("GUI::AddCheckbox", checkbox_text);
+    // creates checkbox with ID, size and text as arguments
+    return controls.Handle(controls.Create(m_hWnd, {CONTROLS::KIND::CHECKBOX, (int)(INT_PTR)button_id, checkbox_text, width, height, FONT_SIZE}, x_pos, y_pos));
 }
 
-void GUI::AddTextLabel(int x_pos, int y_pos, LPCWSTR text, HMENU label_id, int width, int height)
+HWND GUI::AddTextLabel(int x_pos, int y_pos, LPCWSTR text, HMENU label_id, int width, int height)
 {
-    HWND text_handle = CreateWindow(L"static", text, SS_EDITCONTROL | WS_VISIBLE | WS_CHILD, x_pos, y_pos, width, height, m_hWnd, label_id, 0, 0);
-    this->SetFont(text_handle, FONT_TYPE);
+    TRACE_SPAN_DETAIL("GUI::AddTextLabel", text);
+    // label_id 0 (CONTROLS::AUTO_ID) gets the next free ID
+    return controls.Handle(controls.Create(m_hWnd, {CONTROLS::KIND::LABEL, (int)(INT_PTR)label_id, text, width, height, FONT_SIZE}, x_pos, y_pos));
 }
 
-void GUI::AddEditControl(int x_pos, int y_pos, LPCWSTR text, HMENU control_id, int width, int height)
+HWND GUI::AddEditControl(int x_pos, int y_pos, LPCWSTR text, HMENU control_id, int width, int height)
 {
-    HWND edit_handle = CreateWindow(L"edit", text, WS_VSCROLL | ES_AUTOVSCROLL | ES_MULTILINE | WS_TABSTOP | WS_VISIBLE | WS_CHILD | WS_BORDER, x_pos, y_pos, width, height, m_hWnd, control_id, 0, 0);
-    this->SetFont(edit_handle, FONT_TYPE);
+    TRACE_SPAN_DETAIL("GUI::AddEditControl", text);
+    return controls.Handle(controls.Create(m_hWnd, {CONTROLS::KIND::EDIT, (int)(INT_PTR)control_id, text, width, height, FONT_SIZE}, x_pos, y_pos));
 }
 
 void GUI::AddFenceBar(int x_pos, int y_pos)
 {
     // Use a small static text box as a fence between controls
-    CreateWindow(L"static", L"", SS_EDITCONTROL | WS_VISIBLE | WS_CHILD | SS_ETCHEDHORZ, x_pos, y_pos, 225, 5, m_hWnd, 0, 0, 0);
+    controls.Create(m_hWnd, {CONTROLS::KIND::FENCE, CONTROLS::AUTO_ID, L"", 225, 5, 0}, x_pos, y_pos);
 }
\ No newline at end of file
@@ -1,13 +1,38 @@
 ﻿#ifndef GUI_H
 #define GUI_H
-#define UNICODE
-/* 
-UNICODE needs to be defined before windows.h to correctly use widestring functions
-Most windows functions have a A and W variant. 
-Windows supplies a macro that decides the to use function depending on the UNICODE definition 
-*/
-#include <windows.h>
+#include "platform.h" // windows.h or the headless backend. Also defines UNICODE
+#include "clipboard.h"
+#include "clipmonitor.h"
+#include "controls.h"
+#include "gdicache.h"
+#include "input.h"
+#include "layout.h"
+#include "msgstats.h"
+#include "paint.h"
+#include "random.h"
+#include "record.h"
+#include "timerwheel.h"
+#include "workers.h"
+#include <functional>
 #include <string>
+#include <thread>
+#include <vector>
+
+// Defining IDs for the different controls
+constexpr int ID_TEST_BUTTON         = 100;
+constexpr int ID_CLIPBOARD_BUTTON    = 101;
+constexpr int ID_TEXT_EDIT           = 103;
+constexpr int ID_MESSAGEBOX_BUTTON   = 104;
+constexpr int ID_MOVE_MOUSE_BUTTON   = 105;
+constexpr int ID_FREE_CONSOLE_BUTTON = 106;
+constexpr int ID_CLEAR_TEXT_BUTTON   = 107;
+constexpr int ID_CHECKBOX            = 108;
+
+// The labels get their own IDs from here up, see CONTROLS. Right after the last fixed ID so the control tables have no holes
+constexpr int ID_FIRST_AUTO          = 109;
+
+// Posted by the worker pool when results are waiting for the UI thread
+constexpr UINT WM_WORKER_DONE = WM_APP + 1;
 
 
 
@@ -18,57 +43,174 @@ private:
     // Needs to be static because we are supplying this function to the "lpfnWndProc" for the windows message que.
     static LRESULT CALLBACK MessageHandler(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
+    // Registers the window class every GUI shares, unless it already is. Safe to call from any thread
+    static bool RegisterWindowClass(HINSTANCE hInstance);
+
     //Button overloads
-    void AddButton(int x_pos,int y_pos); // Add button without any settings. Any button created with this will share the same ID. For testing purposes. 
-    void AddButton(int x_pos,int y_pos, LPCWSTR button_text, HMENU button_id); // Add button with text and ID at the given pos
-    void AddButton(int x_pos,int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height); // Add button with a specific size, text, ID at the given pos
-    void AddButton(int x_pos,int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height, int text_size); // Add button with a specific size, text, ID at the given pos
+    HWND AddButton(int x_pos,int y_pos); // Add button without any settings. Any button created with this will share the same ID. For testing purposes. 
+    HWND AddButton(int x_pos,int y_pos, LPCWSTR button_text, HMENU button_id); // Add button with text and ID at the given pos
+    HWND AddButton(int x_pos,int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height); // Add button with a specific size, text, ID at the given pos
+    HWND AddButton(int x_pos,int y_pos, LPCWSTR button_text, HMENU button_id, int width, int height, int text_size); // Add button with a specific size, text, ID at the given pos
    
     // checkbox
-    void AddCheckbox(int x_pos,int y_pos, LPCWSTR checkbox_text, HMENU button_id, int width, int height); // Add button with a specific size, text, ID at the given pos
+    HWND AddCheckbox(int x_pos,int y_pos, LPCWSTR checkbox_text, HMENU button_id, int width, int height); // Add button with a specific size, text, ID at the given pos
     
     // Textlabel
-    void AddTextLabel(int x_pos,int y_pos, LPCWSTR text, HMENU label_id, int width, int height);
+    HWND AddTextLabel(int x_pos,int y_pos, LPCWSTR text, HMENU label_id, int width, int height);
     
     //text box
-    void AddEditControl(int x_pos,int y_pos, LPCWSTR text, HMENU control_id, int width, int height);
+    HWND AddEditControl(int x_pos,int y_pos, LPCWSTR text, HMENU control_id, int width, int height);
     
     //Fencebar
     void AddFenceBar(int x_pos, int y_pos);
 
-    // Function to set the font of a hwnd
-    void SetFont(HWND control_handle, LPCWSTR font_type,int font_size = 15);
-
     // Displays a test messagebox
     int DisplayMessageBox(HWND hWnd);
 
+    // Compile time dispatch tables for the messages and WM_COMMAND control IDs. Defined in gui.cpp
+    struct ROUTES;
+
     // Functions to handle message que callbacks
     LRESULT OnCommand(HWND hWnd, WPARAM wParam);
     LRESULT OnDestroy();
+    LRESULT OnNcDestroy(HWND hWnd);
     LRESULT OnSize(LPARAM lParam);
-    LRESULT OnCTLCOLORSTATIC(WPARAM wParam);
+    LRESULT OnPaint();
+    LRESULT OnEraseBackground();
+    LRESULT OnCTLCOLORSTATIC(WPARAM wParam, LPARAM lParam);
     LRESULT OnMousehover(HWND hWnd);
     LRESULT OnMousemove(HWND hWnd);
-    LRESULT OnMouseleave(HWND hWnd);
+    LRESULT OnMouseleave();
+    LRESULT OnRenderFormat(WPARAM wParam);
+    LRESULT OnRenderAllFormats(HWND hWnd);
+    LRESULT OnDestroyClipboard();
+    LRESULT OnClipboardUpdate();
+    LRESULT OnWorkerDone();
+
+    // Functions to handle WM_COMMAND of the different controls
+    LRESULT OnTestButton();
+    LRESULT OnClipboardButton(HWND hWnd);
+    LRESULT OnMessageBoxButton(HWND hWnd);
+    LRESULT OnMoveMouseButton();
+    LRESULT OnFreeConsoleButton();
+    LRESULT OnClearTextButton();
+    LRESULT OnCheckbox();
 
     // constants for various settings
     const LPCWSTR FONT_TYPE = L"ARIAL";
     const int WIDTH_BUTTON  = 50;
     const int HEIGHT_BUTTON = 30;
+    static constexpr int FONT_SIZE = 15;
 
-    // various window variables
-    HBRUSH hbrBkgnd     = NULL; // defined as NULL according to microsoft documentation 
+    // Positions of the controls. Solved again on WM_SIZE
+    LAYOUT layout;
+
+    // Handles, rectangles and checkbox states of the controls by ID, and their fonts. Cleared when the window is destroyed
+    CONTROLS controls{ID_TEST_BUTTON, ID_FIRST_AUTO, FONT_TYPE};
     HINSTANCE hInstance = GetModuleHandle(0);
-    HWND m_hWnd;
-    WNDCLASS wc;
+    HWND m_hWnd = NULL;
     MSG msg;
 
+    // Back buffer of the client area and the colors of the static controls
+    PAINTER painter;
+
+    // Owns what we put on the clipboard until another app replaces it
+    CLIPBOARD clipboard;
+
+    // What other programs copy
+    CLIPBOARD_MONITOR clipboard_monitor;
+
+    // Latency of the messages RunMainLoop dispatched
+    MESSAGE_STATS message_stats;
+
+    // Hover/leave tracking, mouse moves handled once a frame
+    MOUSE_INPUT mouse_input;
+
+    // Positions of the cursor and window jumps
+    RANDOM random;
+
+    // Writes the dispatched messages to a file while open
+    MESSAGE_RECORDER recorder;
+
+    // 0 for the window main creates, 1, 2... in the order Spawn was called. Keeps the files of GUI_RECORD and GUI_MESSAGE_STATS apart
+    int window_index = 0;
+
+    // Everything the window does later. RunMainLoop fires them, one waitable timer wakes it for the next one
+    TIMER_WHEEL timers;
+    HANDLE      wake_timer = NULL;
+    uint64_t    wake_due   = TIMER_WHEEL::NEVER;   // what wake_timer is set to
+
+    // GetMessage that fires the due timers while it waits. Same return values
+    BOOL NextMessage(LPMSG message);
+
+    // Records, times and dispatches a message of RunMainLoop. Also the moves MOUSE_INPUT held back to the end of a frame
+    void DispatchLoopMessage(MSG& message);
+
+    // Work that would block the message loop. Declared last so its threads are stopped before the members above go away
+    WORKER_POOL workers;
+
 public:
 
-    // main logic
-    void CreateMainWindow(int width, int height, LPCWSTR window_name);
+    GUI() = default;
+
+    // The window procedure points at this instance, a copy or a moved from GUI would leave it pointing at the wrong one
+    GUI(const GUI&) = delete;
+    GUI& operator=(const GUI&) = delete;
+
+    // Destroys the window if it is still open, it must not outlive the instance. Has to run on the thread that created the window
+    ~GUI();
+
+    // main logic. False if the window could not be created
+    bool CreateMainWindow(int width, int height, LPCWSTR window_name);
     int RunMainLoop();
 
+    /*
+    Creates a window on a new thread and runs its message loop there until the window is closed (WM_CLOSE, e.g. PostMessage from any thread).
+    The GUI lives on the stack of that thread. ready runs on it after CreateMainWindow, before the loop, with the GUI whose handle is NULL if creation failed.
+    Every window has its own loop, a slow handler in one does not stall the others.
+    Its recording and message stats go to the file names of GUI_RECORD and GUI_MESSAGE_STATS with .1, .2... appended, in the order of the Spawn calls.
+    */
+    static std::thread Spawn(int width, int height, std::wstring window_name, std::function<void(GUI&)> ready = nullptr);
+
+    // Handle of the main window. Used to feed messages to the window from outside, e.g. by the benchmarks
+    HWND GetWindowHandle() const { return m_hWnd; }
+
+    // Per message latency histograms of RunMainLoop. Only use from the thread that runs the loop
+    MESSAGE_STATS& GetMessageStats() { return message_stats; }
+
+    // Counters of the mouse moves RunMainLoop got and handled
+    MOUSE_INPUT::STATS GetMouseStats() const { return mouse_input.GetStats(); }
+    void ResetMouseStats() { mouse_input.ResetStats(); }
+
+    // Same seed, same cursor and window jumps. Also set by GUI_RANDOM_SEED
+    void SetRandomSeed(uint64_t seed) { random.Seed(seed); }
+    uint64_t GetRandomSeed() const { return random.GetSeed(); }
+
+    // Records every message RunMainLoop dispatches to the file until StopRecording. Also started by GUI_RECORD
+    bool StartRecording(const char* path);
+    void StopRecording() { recorder.Close(); }
+
+    // Dispatches a recorded session to this window with the recorded random seed. The handler times end up in GetMessageStats
+    MESSAGE_REPLAY::RESULT Replay(const MESSAGE_REPLAY& replay, MESSAGE_REPLAY::SPEED speed);
+
+    // Puts everything from input (e.g. stdin) on the clipboard, owned by this window. See CLIPBOARD::setClipboardToStream
+    bool SetClipboardToStream(HANDLE input, CLIPBOARD::STREAM_STATS* stats = nullptr) { return clipboard.setClipboardToStream(m_hWnd, input, stats); }
+
+    // Changes other programs make to the clipboard. The handler can be replaced, by default the changes are logged
+    CLIPBOARD_MONITOR& GetClipboardMonitor() { return clipboard_monitor; }
+
+    // The controls of the window by ID
+    const CONTROLS& GetControls() const { return controls; }
+
+    // Paint times and the colors of the static controls
+    PAINTER& GetPainter() { return painter; }
+
+    // Background threads. Results of Submit are delivered on the thread of RunMainLoop
+    WORKER_POOL& GetWorkers() { return workers; }
+
+    // Timers fired by RunMainLoop on its thread. Only use from that thread
+    TIMER_WHEEL& GetTimers() { return timers; }
+
 
 };
 
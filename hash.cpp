@@ -0,0 +1,225 @@
+#include "hash.h"
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if !defined(__SIZEOF_INT128__) && defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    // Per lane keys. Arbitrary odd constants
+    constexpr uint64_t KEYS[8] = {
+        0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+        0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+    };
+
+    constexpr uint64_t PRIME32_1 = 0x9E3779B1U;
+    constexpr uint64_t PRIME32_2 = 0x85EBCA77U;
+    constexpr uint64_t PRIME32_3 = 0xC2B2AE3DU;
+    constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+    uint64_t Read64(const unsigned char* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value)); // little endian on every platform we build for
+        return value;
+    }
+
+    // Full 128 bit product, low half ^ high half. 32 bit targets have no 128 bit type, the halves are put together from 32 bit products there
+    uint64_t MulFold64(uint64_t a, uint64_t b)
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        uint64_t high;
+        uint64_t low = _umul128(a, b, &high);
+        return low ^ high;
+#else
+        const uint64_t a_low = a & 0xFFFFFFFFULL, a_high = a >> 32;
+        const uint64_t b_low = b & 0xFFFFFFFFULL, b_high = b >> 32;
+        const uint64_t low_low   = a_low * b_low;
+        const uint64_t high_low  = a_high * b_low;
+        const uint64_t low_high  = a_low * b_high;
+        const uint64_t high_high = a_high * b_high;
+        const uint64_t cross     = (low_low >> 32) + (high_low & 0xFFFFFFFFULL) + low_high; // cannot overflow
+        const uint64_t low  = (cross << 32) | (low_low & 0xFFFFFFFFULL);
+        const uint64_t high = high_high + (high_low >> 32) + (cross >> 32);
+        return low ^ high;
+#endif
+    }
+
+    uint64_t Avalanche(uint64_t h)
+    {
+        h ^= h >> 37;
+        h *= 0x165667919E3779F9ULL;
+        h ^= h >> 32;
+        return h;
+    }
+
+    // One stripe: every lane adds its neighbours data and the product of the low and high half of data ^ key
+    void StripeScalar(uint64_t* acc, const unsigned char* stripe)
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            uint64_t data     = Read64(stripe + i * 8);
+            uint64_t data_key = data ^ KEYS[i];
+            acc[i ^ 1] += data;
+            acc[i]     += (data_key & 0xFFFFFFFFULL) * (data_key >> 32);
+        }
+    }
+
+    void Stripes(uint64_t* acc, const unsigned char* stripes, size_t count)
+    {
+#if defined(__AVX2__)
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+        __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4));
+        const __m256i k0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(KEYS));
+        const __m256i k1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(KEYS + 4));
+        for (size_t s = 0; s < count; s++, stripes += 64)
+        {
+            __m256i d0  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripes));
+            __m256i d1  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripes + 32));
+            __m256i dk0 = _mm256_xor_si256(d0, k0);
+            __m256i dk1 = _mm256_xor_si256(d1, k1);
+            // mul_epu32 multiplies the low halves, the shuffle moves the high half into the low half
+            __m256i p0  = _mm256_mul_epu32(dk0, _mm256_shuffle_epi32(dk0, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m256i p1  = _mm256_mul_epu32(dk1, _mm256_shuffle_epi32(dk1, _MM_SHUFFLE(0, 3, 0, 1)));
+            // Swapping the 64 bit pairs gives the neighbour lane
+            a0 = _mm256_add_epi64(a0, _mm256_add_epi64(p0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+            a1 = _mm256_add_epi64(a1, _mm256_add_epi64(p1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4), a1);
+#elif defined(__SSE2__)
+        __m128i a[4];
+        __m128i k[4];
+        for (size_t i = 0; i < 4; i++)
+        {
+            a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i * 2));
+            k[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(KEYS + i * 2));
+        }
+        for (size_t s = 0; s < count; s++, stripes += 64)
+        {
+            for (size_t i = 0; i < 4; i++)
+            {
+                __m128i d  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stripes + i * 16));
+                __m128i dk = _mm_xor_si128(d, k[i]);
+                __m128i p  = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+                a[i] = _mm_add_epi64(a[i], _mm_add_epi64(p, _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))));
+            }
+        }
+        for (size_t i = 0; i < 4; i++) { _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i * 2), a[i]); }
+#else
+        for (size_t s = 0; s < count; s++, stripes += 64) { StripeScalar(acc, stripes); }
+#endif
+    }
+
+    // Mixes the accumulators after every block so long inputs can not cancel each other out
+    void Scramble(uint64_t* acc)
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            uint64_t value = acc[i];
+            value ^= value >> 47;
+            value ^= KEYS[(i + 1) & 7];
+            acc[i] = value * PRIME32_1;
+        }
+    }
+}
+
+HASH::HASH() : buffered(0), stripes_in_block(0), total(0)
+{
+    const uint64_t init[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+    std::memcpy(acc, init, sizeof(acc));
+}
+
+void HASH::Accumulate(const unsigned char* stripes, size_t count)
+{
+    while (count > 0)
+    {
+        // Run the vector loop up to the next block boundary
+        size_t run = count < STRIPES_PER_BLOCK - stripes_in_block ? count : STRIPES_PER_BLOCK - stripes_in_block;
+        Stripes(acc, stripes, run);
+        stripes          += run * STRIPE;
+        count            -= run;
+        stripes_in_block += run;
+        if (stripes_in_block == STRIPES_PER_BLOCK)
+        {
+            Scramble(acc);
+            stripes_in_block = 0;
+        }
+    }
+}
+
+void HASH::Update(const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    total += size;
+
+    // Complete a partially filled stripe first
+    if (buffered > 0)
+    {
+        size_t take = size < STRIPE - buffered ? size : STRIPE - buffered;
+        std::memcpy(buffer + buffered, bytes, take);
+        buffered += take;
+        bytes    += take;
+        size     -= take;
+        if (buffered < STRIPE) { return; }
+        Accumulate(buffer, 1);
+        buffered = 0;
+    }
+
+    size_t stripes = size / STRIPE;
+    Accumulate(bytes, stripes);
+    bytes += stripes * STRIPE;
+    size  -= stripes * STRIPE;
+
+    std::memcpy(buffer, bytes, size);
+    buffered = size;
+}
+
+uint64_t HASH::Final() const
+{
+    uint64_t lanes[8];
+    std::memcpy(lanes, acc, sizeof(lanes));
+
+    // The tail is hashed as one zero padded stripe
+    if (buffered > 0)
+    {
+        unsigned char last[STRIPE] = {};
+        std::memcpy(last, buffer, buffered);
+        StripeScalar(lanes, last);
+    }
+
+    uint64_t result = total * PRIME64_1;
+    for (size_t i = 0; i < 8; i += 2)
+    {
+        result += MulFold64(lanes[i] ^ KEYS[i], lanes[i + 1] ^ KEYS[i + 1]);
+    }
+    return Avalanche(result);
+}
+
+uint64_t HASH::Of(const void* data, size_t size)
+{
+    HASH hash;
+    hash.Update(data, size);
+    return hash.Final();
+}
+
+const char* HASH::Implementation()
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
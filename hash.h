@@ -0,0 +1,41 @@
+#ifndef HASH_H
+#define HASH_H
+#include <cstddef>
+#include <cstdint>
+
+/*
+Fast 64 bit content hash for deduplication. Not cryptographic.
+The input is consumed in 64 byte stripes by 8 independent accumulators (the same scheme as XXH3), which maps directly onto SSE2/AVX2.
+The vector paths are picked at compile time (__AVX2__, __SSE2__) and produce exactly the same value as the scalar one.
+Can be fed incrementally, so chunked data hashes the same as the same bytes in one piece.
+*/
+class HASH
+{
+public:
+
+    HASH();
+
+    void Update(const void* data, size_t size);
+    uint64_t Final() const;
+
+    // Hash of one contiguous block
+    static uint64_t Of(const void* data, size_t size);
+
+    // Name of the code path that got compiled in ("avx2", "sse2" or "scalar")
+    static const char* Implementation();
+
+private:
+
+    static constexpr size_t STRIPE           = 64;
+    static constexpr size_t STRIPES_PER_BLOCK = 16;
+
+    void Accumulate(const unsigned char* stripes, size_t count);
+
+    uint64_t      acc[8];
+    unsigned char buffer[STRIPE];
+    size_t        buffered;
+    size_t        stripes_in_block;
+    uint64_t      total;
+};
+
+#endif // HASH_H
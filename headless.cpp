@@ -0,0 +1,2044 @@
+#include "platform.h"
+#if !defined(_WIN32) || defined(GUI_HEADLESS)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "utf.h"
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+Everything here simulates the winapi behaviour GUI and CLIPBOARD rely on. It does not try to be a complete window manager.
+- Every thread gets its own message queue on first use, windows post to the queue of the thread that created them (like on windows).
+- Window handles are increasing numbers that are never reused, so stale handles in a queue are simply ignored.
+- "button", "static" and "edit" are registered as system classes and keep their text and check state.
+- Window procedures are always called without holding the internal lock, so they can call back into the api from any thread.
+- SendMessage to a window of another thread waits until that thread takes it in GetMessage, PeekMessage or its own SendMessage, like on windows.
+  Once the thread has exited (windows would have destroyed its windows) the procedure runs on the sending thread.
+- Files, pipes and file mappings are not simulated, they wrap file descriptors and mmap. Only read only mappings of files are supported.
+- Windows and bitmaps have real pixels (one COLORREF each), FillRect and BitBlt cost about what they cost on windows. Text is not drawn.
+- The update area of a window is one bounding rectangle. WM_PAINT is generated like on windows, once no posted message is waiting.
+  Resizing, moving children and InvalidateRect mark it, children are included unless the parent has WS_CLIPCHILDREN.
+*/
+
+namespace
+{
+    struct QUEUE;
+
+    // SendMessage from another thread, on the stack of the sender until it is answered
+    struct SENT
+    {
+        HWND                   hwnd;
+        UINT                   message;
+        WPARAM                 wParam;
+        LPARAM                 lParam;
+        std::shared_ptr<QUEUE> reply_to;           // queue of the sender, woken up with the answer
+        LRESULT                result   = 0;       // set with the lock of reply_to
+        bool                   done     = false;
+        bool                   orphaned = false;   // the receiving thread exited before taking it
+    };
+
+    struct QUEUE
+    {
+        std::mutex              mutex;
+        std::condition_variable ready;
+        std::deque<MSG>         messages;
+        bool                    quit_posted = false;
+        int                     quit_code   = 0;
+        std::deque<HWND>        paints;     // windows with an update area, in the order they got one
+        std::deque<SENT*>       sent;       // answered before any posted message
+        bool                    exited      = false;
+    };
+
+    struct WINDOW
+    {
+        std::wstring           class_name;
+        std::wstring           text;
+        DWORD                  style     = 0;
+        int                    x         = 0;
+        int                    y         = 0;
+        int                    width     = 0;
+        int                    height    = 0;
+        HWND                   parent    = nullptr;
+        int                    id        = 0;
+        LONG_PTR               user_data = 0;
+        WNDPROC                proc      = nullptr;
+        std::shared_ptr<QUEUE> queue;
+        UINT                   check     = BST_UNCHECKED;
+        HFONT                  font      = nullptr;
+        std::vector<HWND>      children;
+        UINT                   class_style  = 0;
+        HBRUSH                 background   = nullptr;   // of the class, WM_ERASEBKGND fills with it
+        RECT                   update       = {0, 0, 0, 0};
+        bool                   erase        = false;     // BeginPaint sends WM_ERASEBKGND
+        bool                   paint_queued = false;     // in the paints of the queue, or being dispatched
+        size_t                 begin_paints = 0;
+        std::vector<COLORREF>  surface;                  // client area pixels, allocated by the first DC
+    };
+
+    struct GDI_OBJECT
+    {
+        enum class KIND { FONT, BRUSH, BITMAP };
+
+        bool                  stock;
+        KIND                  kind   = KIND::BRUSH;
+        COLORREF              color  = 0;   // BRUSH
+        int                   width  = 0;   // BITMAP
+        int                   height = 0;
+        std::vector<COLORREF> pixels = {};
+    };
+
+    // What a new DC has selected. A memory DC draws into a 1x1 bitmap until another one is selected, like on windows
+    GDI_OBJECT default_objects[3] = {{true, GDI_OBJECT::KIND::FONT}, {true, GDI_OBJECT::KIND::BRUSH, RGB(255, 255, 255)}, {true, GDI_OBJECT::KIND::BITMAP, 0, 1, 1, std::vector<COLORREF>(1)}};
+
+    struct DEFERRED_POSITION
+    {
+        HWND hWnd;
+        HWND insert_after;
+        int  x, y, cx, cy;
+        UINT flags;
+    };
+
+    struct DC
+    {
+        COLORREF                text_color = RGB(0, 0, 0);
+        COLORREF                bk_color   = RGB(255, 255, 255);
+        std::shared_ptr<WINDOW> window;                          // GetDC and BeginPaint draw into the window, memory DCs into the bitmap
+        GDI_OBJECT*             selected[3] = {&default_objects[0], &default_objects[1], &default_objects[2]};
+        RECT                    clip        = {0, 0, 0, 0};
+        bool                    clipped     = false;             // BeginPaint clips to the update area
+    };
+
+    // Windows that got an update area. They are added to the paints of their queue after the state lock is released
+    typedef std::vector<std::pair<std::shared_ptr<QUEUE>, HWND>> PAINT_LIST;
+
+    struct GLOBAL_MEMORY
+    {
+        SIZE_T size;
+        void*  bytes;
+    };
+
+    // Object behind a HANDLE of a file, pipe end, file mapping or waitable timer
+    struct KERNEL_OBJECT
+    {
+        enum class KIND { FILE, MAPPING, TIMER } kind;
+        int      fd;        // the mapping keeps its own duplicate, so the file can be closed first like on windows. -1 for timers
+        uint64_t size;      // MAPPING: bytes that can be mapped
+        bool     standard;  // stdin, stdout and stderr. Never closed
+
+        // TIMER, changed with the state lock. Signaled from due on until a wait takes it (auto reset) or the timer is set again (manual reset)
+        bool                                  armed        = false;
+        bool                                  manual_reset = false;
+        std::chrono::steady_clock::time_point due          = {};
+        std::chrono::milliseconds             period       = std::chrono::milliseconds(0);
+    };
+
+    struct CLIPBOARD_STATE
+    {
+        bool                      open = false;
+        std::thread::id           opener;
+        HWND                      open_window = nullptr;
+        HWND                      owner       = nullptr;
+        std::map<UINT, HGLOBAL>   data;
+        DWORD                     sequence    = 1;
+        std::map<std::wstring, UINT> registered;  // RegisterClipboardFormat names, ids from 0xC000 like windows
+        std::vector<HWND>         listeners;          // AddClipboardFormatListener
+        HWND                      render_owner = nullptr; // while it gets WM_RENDERFORMAT, it sets the data without opening the clipboard
+        DWORD                     open_sequence = 0;  // sequence when it was opened, a change is announced on close
+    };
+
+    struct STATE
+    {
+        std::mutex                                        mutex;
+        std::unordered_map<std::wstring, WNDCLASS>        classes;
+        std::unordered_map<ULONG_PTR, std::shared_ptr<WINDOW>> windows;
+        std::unordered_set<HDC>                           dcs;
+        std::unordered_set<KERNEL_OBJECT*>                kernel_objects;
+        std::unordered_map<const void*, size_t>           views;       // MapViewOfFile address -> length
+        ULONG_PTR                                         next_handle = 0x10000;
+        CLIPBOARD_STATE                                   clipboard;
+        POINT                                             cursor      = {0, 0};
+        int                                               screen_width  = 1920;
+        int                                               screen_height = 1080;
+        int                                               message_box_result = IDCANCEL;
+        int                                               dpi           = 96;
+
+        std::atomic<size_t> windows_created{0};
+        std::atomic<size_t> messages_posted{0};
+        std::atomic<size_t> messages_dispatched{0};
+        std::atomic<size_t> messages_sent{0};
+        std::atomic<size_t> track_mouse_calls{0};
+        std::atomic<size_t> gdi_objects_alive{0};
+        std::atomic<size_t> global_allocs_alive{0};
+        std::atomic<size_t> virtual_allocs_alive{0};
+        std::atomic<size_t> window_positions{0};
+        std::atomic<size_t> defer_batches{0};
+        std::atomic<size_t> paints{0};
+        std::atomic<size_t> pixels_drawn{0};
+
+        STATE();
+    };
+
+    GDI_OBJECT stock_objects[32] = {};
+    char       module_marker     = 0;
+    char       cursor_marker     = 0;
+
+    // The queue of the thread. When the thread ends, messages still sent to it are handed back to their senders
+    struct THREAD_QUEUE
+    {
+        std::shared_ptr<QUEUE> queue;
+
+        ~THREAD_QUEUE()
+        {
+            if (!queue) { return; }
+            std::deque<SENT*> orphans;
+            {
+                std::lock_guard<std::mutex> lock(queue->mutex);
+                queue->exited = true;
+                orphans.swap(queue->sent);
+            }
+            for (SENT* sent : orphans)
+            {
+                std::shared_ptr<QUEUE> reply_to = sent->reply_to;
+                {
+                    std::lock_guard<std::mutex> lock(reply_to->mutex);
+                    sent->orphaned = true;
+                }
+                reply_to->ready.notify_all();
+            }
+        }
+    };
+
+    thread_local THREAD_QUEUE           t_queue;
+    thread_local DWORD                  t_last_error   = ERROR_SUCCESS;
+    thread_local DWORD                  t_message_time = 0;
+
+    LRESULT CALLBACK ControlProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+    STATE::STATE()
+    {
+        for (GDI_OBJECT& object : stock_objects) { object.stock = true; }
+        stock_objects[WHITE_BRUSH].color  = RGB(255, 255, 255);
+        stock_objects[LTGRAY_BRUSH].color = RGB(192, 192, 192);
+
+        // System control classes
+        for (const wchar_t* name : {L"button", L"static", L"edit"})
+        {
+            WNDCLASS wc      = {};
+            wc.lpfnWndProc   = ControlProc;
+            wc.lpszClassName = name;
+            wc.style         = CS_HREDRAW | CS_VREDRAW;
+            classes[name]    = wc;
+        }
+    }
+
+    STATE& State()
+    {
+        static STATE state;
+        return state;
+    }
+
+    std::shared_ptr<QUEUE> CurrentQueue()
+    {
+        if (!t_queue.queue) { t_queue.queue = std::make_shared<QUEUE>(); }
+        return t_queue.queue;
+    }
+
+    std::wstring ClassKey(LPCWSTR class_name)
+    {
+        // Class names are case insensitive
+        std::wstring key = class_name ? class_name : L"";
+        for (wchar_t& c : key) { c = static_cast<wchar_t>(std::towlower(c)); }
+        return key;
+    }
+
+    ULONG_PTR HandleValue(HWND hWnd) { return reinterpret_cast<ULONG_PTR>(hWnd); }
+
+    // Caller must hold the state lock
+    WINDOW* FindLocked(HWND hWnd)
+    {
+        auto& windows = State().windows;
+        auto it = windows.find(HandleValue(hWnd));
+        return it == windows.end() ? nullptr : it->second.get();
+    }
+
+    std::shared_ptr<WINDOW> Find(HWND hWnd)
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto it = state.windows.find(HandleValue(hWnd));
+        if (it == state.windows.end()) { return nullptr; }
+        return it->second;
+    }
+
+    bool Matches(const MSG& msg, HWND hWnd, UINT filter_min, UINT filter_max)
+    {
+        if (hWnd && msg.hwnd != hWnd) { return false; }
+        if (filter_min == 0 && filter_max == 0) { return true; }
+        return msg.message >= filter_min && msg.message <= filter_max;
+    }
+
+    // Takes the first message matching the filter. Caller must hold the queue lock
+    bool TakeLocked(QUEUE& queue, LPMSG msg, HWND hWnd, UINT filter_min, UINT filter_max, bool remove)
+    {
+        for (auto it = queue.messages.begin(); it != queue.messages.end(); ++it)
+        {
+            if (Matches(*it, hWnd, filter_min, filter_max))
+            {
+                *msg = *it;
+                if (remove) { queue.messages.erase(it); }
+                t_message_time = msg->time;
+                return true;
+            }
+        }
+        if (queue.quit_posted)
+        {
+            *msg = {};
+            msg->message = WM_QUIT;
+            msg->wParam  = static_cast<WPARAM>(queue.quit_code);
+            msg->time    = GetTickCount();
+            if (remove) { queue.quit_posted = false; }
+            return true;
+        }
+
+        // Nothing posted: paint. DispatchMessage drops it if the window was validated in the meantime
+        for (auto it = queue.paints.begin(); it != queue.paints.end(); ++it)
+        {
+            MSG paint    = {};
+            paint.hwnd    = *it;
+            paint.message = WM_PAINT;
+            if (!Matches(paint, hWnd, filter_min, filter_max)) { continue; }
+            paint.time = GetTickCount();
+            *msg = paint;
+            if (remove) { queue.paints.erase(it); }
+            t_message_time = msg->time;
+            return true;
+        }
+        return false;
+    }
+
+    LRESULT CallProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        std::shared_ptr<WINDOW> window = Find(hWnd);
+        if (!window || !window->proc) { return 0; }
+        return window->proc(hWnd, uMsg, wParam, lParam);
+    }
+
+    // Answers what other threads sent to the windows of this thread. The queue lock is released while the procedures run
+    void ReplySentLocked(QUEUE& queue, std::unique_lock<std::mutex>& lock)
+    {
+        while (!queue.sent.empty())
+        {
+            SENT* sent = queue.sent.front();
+            queue.sent.pop_front();
+            lock.unlock();
+            LRESULT result = CallProc(sent->hwnd, sent->message, sent->wParam, sent->lParam);
+
+            // The sender returns as soon as it sees done, so its queue is held here
+            std::shared_ptr<QUEUE> reply_to = sent->reply_to;
+            {
+                std::lock_guard<std::mutex> reply_lock(reply_to->mutex);
+                sent->result = result;
+                sent->done   = true;
+            }
+            reply_to->ready.notify_all();
+            lock.lock();
+        }
+    }
+
+    void PushMessage(const std::shared_ptr<QUEUE>& queue, HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        MSG msg    = {};
+        msg.hwnd    = hWnd;
+        msg.message = uMsg;
+        msg.wParam  = wParam;
+        msg.lParam  = lParam;
+        msg.time    = GetTickCount();
+        GetCursorPos(&msg.pt);
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->messages.push_back(msg);
+        }
+        queue->ready.notify_one();
+        State().messages_posted++;
+    }
+
+    // Adds rect (client coordinates) to the update area of a visible window and of the children below it unless it clips them. Caller must hold the state lock
+    void InvalidateLocked(HWND hWnd, WINDOW* window, RECT rect, bool erase, PAINT_LIST* paints)
+    {
+        if (!(window->style & WS_VISIBLE)) { return; }
+        RECT client = {0, 0, window->width, window->height};
+        if (!IntersectRect(&rect, &rect, &client)) { return; }
+        UnionRect(&window->update, &window->update, &rect);
+        window->erase |= erase;
+        if (!window->paint_queued)
+        {
+            window->paint_queued = true;
+            paints->emplace_back(window->queue, hWnd);
+        }
+        if (window->style & WS_CLIPCHILDREN) { return; }
+        for (HWND child : window->children)
+        {
+            WINDOW* child_window = FindLocked(child);
+            if (!child_window) { continue; }
+            RECT in_child = {rect.left - child_window->x, rect.top - child_window->y, rect.right - child_window->x, rect.bottom - child_window->y};
+            InvalidateLocked(child, child_window, in_child, erase, paints);
+        }
+    }
+
+    void QueuePaints(const PAINT_LIST& paints)
+    {
+        for (const auto& [queue, hWnd] : paints)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queue->mutex);
+                queue->paints.push_back(hWnd);
+            }
+            queue->ready.notify_one();
+        }
+    }
+
+    // Pixels the DC draws into, width x height. Caller must hold the state lock
+    COLORREF* PixelsLocked(DC* dc, int* width, int* height)
+    {
+        if (dc->window)
+        {
+            WINDOW& window = *dc->window;
+            *width  = std::max(window.width, 0);
+            *height = std::max(window.height, 0);
+            // A resized window starts over, it gets repainted anyway
+            size_t size = static_cast<size_t>(*width) * static_cast<size_t>(*height);
+            if (window.surface.size() != size) { window.surface.assign(size, 0); }
+            return window.surface.data();
+        }
+        GDI_OBJECT* bitmap = dc->selected[static_cast<int>(GDI_OBJECT::KIND::BITMAP)];
+        *width  = bitmap->width;
+        *height = bitmap->height;
+        return bitmap->pixels.data();
+    }
+
+    // The part of rect a DC can draw to. Empty if none
+    RECT ClipLocked(const DC* dc, RECT rect, int width, int height)
+    {
+        RECT surface = {0, 0, width, height};
+        if (!IntersectRect(&rect, &rect, &surface)) { return {0, 0, 0, 0}; }
+        if (dc->clipped && !IntersectRect(&rect, &rect, &dc->clip)) { return {0, 0, 0, 0}; }
+        return rect;
+    }
+
+    LRESULT CALLBACK ControlProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_PAINT:
+            {
+                // Statics ask their parent for the colors every time they paint, then fill their background. The text is not drawn
+                HWND parent    = nullptr;
+                bool is_static = false;
+                {
+                    STATE& state = State();
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    WINDOW* window = FindLocked(hWnd);
+                    if (!window) { return 0; }
+                    parent    = window->parent;
+                    is_static = ClassKey(window->class_name.c_str()) == L"static";
+                }
+                if (!is_static) { break; }
+                PAINTSTRUCT paint;
+                HDC hdc = BeginPaint(hWnd, &paint);
+                HBRUSH brush = parent ? reinterpret_cast<HBRUSH>(SendMessage(parent, WM_CTLCOLORSTATIC, reinterpret_cast<WPARAM>(hdc), reinterpret_cast<LPARAM>(hWnd))) : nullptr;
+                FillRect(hdc, &paint.rcPaint, brush ? brush : reinterpret_cast<HBRUSH>(GetStockObject(WHITE_BRUSH)));
+                EndPaint(hWnd, &paint);
+                return 0;
+            }
+            case BM_GETCHECK:
+            {
+                STATE& state = State();
+                std::lock_guard<std::mutex> lock(state.mutex);
+                WINDOW* window = FindLocked(hWnd);
+                return window ? window->check : BST_UNCHECKED;
+            }
+            case BM_SETCHECK:
+            {
+                STATE& state = State();
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (WINDOW* window = FindLocked(hWnd)) { window->check = static_cast<UINT>(wParam); }
+                return 0;
+            }
+            case WM_LBUTTONUP:
+            {
+                // Letting go of a button clicks it. Real buttons also want the press inside them first, the stand-in does not track capture
+                bool is_button = false;
+                {
+                    STATE& state = State();
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    WINDOW* window = FindLocked(hWnd);
+                    is_button = window && ClassKey(window->class_name.c_str()) == L"button";
+                }
+                if (!is_button) { break; }
+                return SendMessage(hWnd, BM_CLICK, 0, 0);
+            }
+            case BM_CLICK:
+            {
+                // A click toggles auto checkboxes and notifies the parent just like a real mouse click
+                HWND parent = nullptr;
+                int  id     = 0;
+                {
+                    STATE& state = State();
+                    std::lock_guard<std::mutex> lock(state.mutex);
+                    WINDOW* window = FindLocked(hWnd);
+                    if (!window) { return 0; }
+                    if ((window->style & BS_TYPEMASK) == BS_AUTOCHECKBOX)
+                    {
+                        window->check = window->check == BST_CHECKED ? BST_UNCHECKED : BST_CHECKED;
+                    }
+                    parent = window->parent;
+                    id     = window->id;
+                }
+                if (parent) { SendMessage(parent, WM_COMMAND, MAKEWPARAM(id, BN_CLICKED), reinterpret_cast<LPARAM>(hWnd)); }
+                return 0;
+            }
+        }
+        return DefWindowProc(hWnd, uMsg, wParam, lParam);
+    }
+}
+
+
+// Module, errors, time
+HMODULE GetModuleHandle(LPCWSTR) { return reinterpret_cast<HMODULE>(&module_marker); }
+DWORD GetLastError() { return t_last_error; }
+void SetLastError(DWORD error_code) { t_last_error = error_code; }
+BOOL FreeConsole() { return TRUE; }
+
+DWORD GetTickCount()
+{
+    using namespace std::chrono;
+    return static_cast<DWORD>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+
+// Window classes and windows
+BOOL RegisterClass(const WNDCLASS* window_class)
+{
+    if (!window_class || !window_class->lpszClassName) { SetLastError(ERROR_INVALID_PARAMETER); return FALSE; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    std::wstring key = ClassKey(window_class->lpszClassName);
+    if (state.classes.count(key)) { SetLastError(ERROR_CLASS_ALREADY_EXISTS); return FALSE; }
+    state.classes[key] = *window_class;
+    return TRUE;
+}
+
+BOOL UnregisterClass(LPCWSTR class_name, HINSTANCE)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.classes.erase(ClassKey(class_name))) { SetLastError(ERROR_CLASS_DOES_NOT_EXIST); return FALSE; }
+    return TRUE;
+}
+
+BOOL GetClassInfo(HINSTANCE, LPCWSTR class_name, WNDCLASS* window_class)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto it = state.classes.find(ClassKey(class_name));
+    if (it == state.classes.end()) { SetLastError(ERROR_CLASS_DOES_NOT_EXIST); return FALSE; }
+    if (window_class) { *window_class = it->second; }
+    return TRUE;
+}
+
+HWND CreateWindowEx(DWORD ex_style, LPCWSTR class_name, LPCWSTR window_name, DWORD style, int x, int y, int width, int height, HWND parent, HMENU menu, HINSTANCE hInstance, LPVOID param)
+{
+    STATE& state = State();
+    auto window = std::make_shared<WINDOW>();
+    HWND hWnd;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto it = state.classes.find(ClassKey(class_name));
+        if (it == state.classes.end()) { SetLastError(ERROR_CLASS_DOES_NOT_EXIST); return nullptr; }
+        if (parent && !FindLocked(parent)) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return nullptr; }
+
+        window->class_name = class_name;
+        window->text       = window_name ? window_name : L"";
+        window->style      = style;
+        window->x          = x      == CW_USEDEFAULT ? 0 : x;
+        window->y          = y      == CW_USEDEFAULT ? 0 : y;
+        window->width      = width  == CW_USEDEFAULT ? 0 : width;
+        window->height     = height == CW_USEDEFAULT ? 0 : height;
+        window->parent     = parent;
+        window->id         = (style & WS_CHILD) ? static_cast<int>(reinterpret_cast<ULONG_PTR>(menu)) : 0;
+        window->proc       = it->second.lpfnWndProc;
+        window->queue      = CurrentQueue();
+        window->class_style = it->second.style;
+        window->background  = it->second.hbrBackground;
+
+        hWnd = reinterpret_cast<HWND>(state.next_handle++);
+        state.windows[HandleValue(hWnd)] = window;
+        if (WINDOW* parent_window = FindLocked(parent)) { parent_window->children.push_back(hWnd); }
+    }
+    state.windows_created++;
+
+    CREATESTRUCT cs = {};
+    cs.lpCreateParams = param;
+    cs.hInstance      = hInstance;
+    cs.hMenu          = menu;
+    cs.hwndParent     = parent;
+    cs.cx             = window->width;
+    cs.cy             = window->height;
+    cs.x              = window->x;
+    cs.y              = window->y;
+    cs.style          = static_cast<LONG>(style);
+    cs.lpszName       = window_name;
+    cs.lpszClass      = class_name;
+    cs.dwExStyle      = ex_style;
+
+    if (!SendMessage(hWnd, WM_NCCREATE, 0, reinterpret_cast<LPARAM>(&cs)) || SendMessage(hWnd, WM_CREATE, 0, reinterpret_cast<LPARAM>(&cs)) == -1)
+    {
+        DestroyWindow(hWnd);
+        return nullptr;
+    }
+    // There is no non client area in the simulation, so the client size equals the window size
+    SendMessage(hWnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(window->width, window->height));
+    InvalidateRect(hWnd, nullptr, TRUE);
+    return hWnd;
+}
+
+BOOL DestroyWindow(HWND hWnd)
+{
+    std::shared_ptr<WINDOW> window = Find(hWnd);
+    if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+
+    // A clipboard owner with delayed formats gets the chance to render them before it goes away
+    bool render_all = false;
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.clipboard.owner == hWnd)
+        {
+            for (const auto& [format, hMem] : state.clipboard.data) { render_all |= hMem == nullptr; }
+        }
+    }
+    if (render_all) { SendMessage(hWnd, WM_RENDERALLFORMATS, 0, 0); }
+
+    // Parent gets WM_DESTROY before its children, WM_NCDESTROY after them
+    SendMessage(hWnd, WM_DESTROY, 0, 0);
+    std::vector<HWND> children;
+    {
+        std::lock_guard<std::mutex> lock(State().mutex);
+        children = window->children;
+    }
+    for (HWND child : children) { DestroyWindow(child); }
+    SendMessage(hWnd, WM_NCDESTROY, 0, 0);
+
+    STATE& state = State();
+    PAINT_LIST paints;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    if (WINDOW* parent = FindLocked(window->parent))
+    {
+        auto& siblings = parent->children;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), hWnd), siblings.end());
+
+        // The parent shows where the child was
+        if (window->style & WS_VISIBLE) { InvalidateLocked(window->parent, parent, {window->x, window->y, window->x + window->width, window->y + window->height}, true, &paints); }
+    }
+    if (state.clipboard.owner == hWnd)
+    {
+        // Formats that were never rendered are gone with their owner
+        state.clipboard.owner = nullptr;
+        std::erase_if(state.clipboard.data, [](const auto& entry) { return entry.second == nullptr; });
+    }
+    std::erase(state.clipboard.listeners, hWnd); // A destroyed window stops listening, like on windows
+    state.windows.erase(HandleValue(hWnd));
+    lock.unlock();
+    QueuePaints(paints);
+    return TRUE;
+}
+
+BOOL IsWindow(HWND hWnd) { return Find(hWnd) != nullptr; }
+
+HWND FindWindow(LPCWSTR class_name, LPCWSTR window_name)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    std::wstring key = ClassKey(class_name);
+    for (const auto& [handle, window] : state.windows)
+    {
+        if (window->style & WS_CHILD) { continue; }
+        if (class_name && ClassKey(window->class_name.c_str()) != key) { continue; }
+        if (window_name && window->text != window_name) { continue; }
+        return reinterpret_cast<HWND>(handle);
+    }
+    return nullptr;
+}
+
+BOOL ShowWindow(HWND hWnd, int show_cmd)
+{
+    STATE& state = State();
+    BOOL was_visible;
+    PAINT_LIST paints;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        WINDOW* window = FindLocked(hWnd);
+        if (!window) { return FALSE; }
+        was_visible = (window->style & WS_VISIBLE) != 0;
+        if (show_cmd) { window->style |= WS_VISIBLE; } else { window->style &= ~static_cast<DWORD>(WS_VISIBLE); }
+        if (show_cmd && !was_visible) { InvalidateLocked(hWnd, window, {0, 0, window->width, window->height}, true, &paints); }
+    }
+    QueuePaints(paints);
+    return was_visible;
+}
+
+BOOL UpdateWindow(HWND hWnd)
+{
+    // Paints right away instead of when the queue is empty
+    std::shared_ptr<WINDOW> window = Find(hWnd);
+    if (!window) { return FALSE; }
+    bool dirty;
+    {
+        std::lock_guard<std::mutex> lock(State().mutex);
+        dirty = !IsRectEmpty(&window->update);
+    }
+    if (dirty) { SendMessage(hWnd, WM_PAINT, 0, 0); }
+    return TRUE;
+}
+
+BOOL SetWindowPos(HWND hWnd, HWND, int x, int y, int cx, int cy, UINT flags)
+{
+    bool resized = false;
+    int  width   = 0;
+    int  height  = 0;
+    PAINT_LIST paints;
+    State().window_positions++;
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        WINDOW* window = FindLocked(hWnd);
+        if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+        const RECT old_rect = {window->x, window->y, window->x + window->width, window->y + window->height};
+        bool moved = false;
+        if (!(flags & SWP_NOMOVE) && (window->x != x || window->y != y))
+        {
+            window->x = x;
+            window->y = y;
+            moved     = true;
+        }
+        if (!(flags & SWP_NOSIZE) && (window->width != cx || window->height != cy))
+        {
+            window->width  = cx;
+            window->height = cy;
+            resized        = true;
+        }
+        width  = window->width;
+        height = window->height;
+
+        if (resized)
+        {
+            // CS_HREDRAW and CS_VREDRAW repaint everything, otherwise only what was uncovered
+            const LONG old_width  = old_rect.right - old_rect.left;
+            const LONG old_height = old_rect.bottom - old_rect.top;
+            if ((width != old_width && (window->class_style & CS_HREDRAW)) || (height != old_height && (window->class_style & CS_VREDRAW)))
+            {
+                InvalidateLocked(hWnd, window, {0, 0, width, height}, true, &paints);
+            }
+            else
+            {
+                if (width > old_width)   { InvalidateLocked(hWnd, window, {old_width, 0, width, height}, true, &paints); }
+                if (height > old_height) { InvalidateLocked(hWnd, window, {0, old_height, width, height}, true, &paints); }
+            }
+        }
+        // A child that moves keeps its pixels, the parent shows where it was and is not any more
+        WINDOW* parent = FindLocked(window->parent);
+        RECT uncovered;
+        const RECT new_rect = {window->x, window->y, window->x + width, window->y + height};
+        if ((moved || resized) && parent && (window->style & WS_VISIBLE) && SubtractRect(&uncovered, &old_rect, &new_rect))
+        {
+            InvalidateLocked(window->parent, parent, uncovered, true, &paints);
+        }
+    }
+    QueuePaints(paints);
+    if (resized) { SendMessage(hWnd, WM_SIZE, SIZE_RESTORED, MAKELPARAM(width, height)); }
+    return TRUE;
+}
+
+HDWP BeginDeferWindowPos(int num_windows)
+{
+    // The handle is the list of the positions to apply
+    auto batch = new std::vector<DEFERRED_POSITION>();
+    batch->reserve(num_windows > 0 ? num_windows : 0);
+    return reinterpret_cast<HDWP>(batch);
+}
+
+HDWP DeferWindowPos(HDWP hWinPosInfo, HWND hWnd, HWND insert_after, int x, int y, int cx, int cy, UINT flags)
+{
+    if (!hWinPosInfo) { return nullptr; }
+    auto batch = reinterpret_cast<std::vector<DEFERRED_POSITION>*>(hWinPosInfo);
+    if (!IsWindow(hWnd))
+    {
+        // Like windows the whole batch is dropped
+        delete batch;
+        SetLastError(ERROR_INVALID_WINDOW_HANDLE);
+        return nullptr;
+    }
+    batch->push_back({hWnd, insert_after, x, y, cx, cy, flags});
+    return hWinPosInfo;
+}
+
+BOOL EndDeferWindowPos(HDWP hWinPosInfo)
+{
+    if (!hWinPosInfo) { return FALSE; }
+    auto batch = reinterpret_cast<std::vector<DEFERRED_POSITION>*>(hWinPosInfo);
+    State().defer_batches++;
+    BOOL result = TRUE;
+    for (const DEFERRED_POSITION& position : *batch)
+    {
+        if (!SetWindowPos(position.hWnd, position.insert_after, position.x, position.y, position.cx, position.cy, position.flags)) { result = FALSE; }
+    }
+    delete batch;
+    return result;
+}
+
+BOOL GetWindowRect(HWND hWnd, RECT* rect)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    if (!window || !rect) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+
+    // Child positions are stored relative to the parent, the rect is in screen coordinates
+    LONG left = window->x;
+    LONG top  = window->y;
+    for (WINDOW* parent = FindLocked(window->parent); parent; parent = FindLocked(parent->parent))
+    {
+        left += parent->x;
+        top  += parent->y;
+    }
+    *rect = {left, top, left + window->width, top + window->height};
+    return TRUE;
+}
+
+BOOL GetClientRect(HWND hWnd, RECT* rect)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    if (!window || !rect) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+    *rect = {0, 0, window->width, window->height};
+    return TRUE;
+}
+
+HWND GetDlgItem(HWND hDlg, int id)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hDlg);
+    if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return nullptr; }
+    for (HWND child : window->children)
+    {
+        WINDOW* child_window = FindLocked(child);
+        if (child_window && child_window->id == id) { return child; }
+    }
+    return nullptr;
+}
+
+int GetDlgCtrlID(HWND hWnd)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    return window ? window->id : 0;
+}
+
+HWND GetParent(HWND hWnd)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    return window ? window->parent : nullptr;
+}
+
+UINT IsDlgButtonChecked(HWND hDlg, int id)
+{
+    HWND button = GetDlgItem(hDlg, id);
+    return button ? static_cast<UINT>(SendMessage(button, BM_GETCHECK, 0, 0)) : BST_UNCHECKED;
+}
+
+int GetWindowTextLength(HWND hWnd) { return static_cast<int>(SendMessage(hWnd, WM_GETTEXTLENGTH, 0, 0)); }
+
+int GetWindowText(HWND hWnd, LPWSTR buffer, int max_count)
+{
+    return static_cast<int>(SendMessage(hWnd, WM_GETTEXT, static_cast<WPARAM>(max_count), reinterpret_cast<LPARAM>(buffer)));
+}
+
+BOOL SetWindowText(HWND hWnd, LPCWSTR text) { return static_cast<BOOL>(SendMessage(hWnd, WM_SETTEXT, 0, reinterpret_cast<LPARAM>(text))); }
+
+LONG_PTR SetWindowLongPtr(HWND hWnd, int index, LONG_PTR value)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    if (!window || index != GWLP_USERDATA) { SetLastError(ERROR_INVALID_PARAMETER); return 0; }
+    LONG_PTR previous = window->user_data;
+    window->user_data = value;
+    return previous;
+}
+
+LONG_PTR GetWindowLongPtrW(HWND hWnd, int index)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    if (!window || index != GWLP_USERDATA) { SetLastError(ERROR_INVALID_PARAMETER); return 0; }
+    return window->user_data;
+}
+
+LRESULT DefWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+    switch (uMsg)
+    {
+        case WM_NCCREATE:
+            return TRUE;
+        case WM_CLOSE:
+            DestroyWindow(hWnd);
+            return 0;
+        case WM_PAINT:
+        {
+            PAINTSTRUCT paint;
+            BeginPaint(hWnd, &paint);
+            EndPaint(hWnd, &paint);
+            return 0;
+        }
+        case WM_ERASEBKGND:
+        {
+            // With the background brush of the class. The DC of BeginPaint only lets the update area through
+            HBRUSH background = nullptr;
+            RECT   client     = {0, 0, 0, 0};
+            {
+                STATE& state = State();
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (WINDOW* window = FindLocked(hWnd))
+                {
+                    background = window->background;
+                    client     = {0, 0, window->width, window->height};
+                }
+            }
+            if (!background) { return 0; }
+            FillRect(reinterpret_cast<HDC>(wParam), &client, background);
+            return 1;
+        }
+        case WM_SETTEXT:
+        {
+            STATE& state = State();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            WINDOW* window = FindLocked(hWnd);
+            if (!window) { return FALSE; }
+            LPCWSTR text = reinterpret_cast<LPCWSTR>(lParam);
+            window->text = text ? text : L"";
+            return TRUE;
+        }
+        case WM_GETTEXT:
+        {
+            STATE& state = State();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            WINDOW* window = FindLocked(hWnd);
+            LPWSTR buffer = reinterpret_cast<LPWSTR>(lParam);
+            if (!window || !buffer || wParam == 0) { return 0; }
+            size_t count = std::min(window->text.size(), static_cast<size_t>(wParam) - 1);
+            std::wmemcpy(buffer, window->text.data(), count);
+            buffer[count] = L'\0';
+            return static_cast<LRESULT>(count);
+        }
+        case WM_GETTEXTLENGTH:
+        {
+            STATE& state = State();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            WINDOW* window = FindLocked(hWnd);
+            return window ? static_cast<LRESULT>(window->text.size()) : 0;
+        }
+        case WM_SETFONT:
+        {
+            STATE& state = State();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (WINDOW* window = FindLocked(hWnd)) { window->font = reinterpret_cast<HFONT>(wParam); }
+            return 0;
+        }
+        case WM_GETFONT:
+        {
+            STATE& state = State();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            WINDOW* window = FindLocked(hWnd);
+            return window ? reinterpret_cast<LRESULT>(window->font) : 0;
+        }
+    }
+    return 0;
+}
+
+HCURSOR LoadCursor(HINSTANCE, LPCWSTR) { return reinterpret_cast<HCURSOR>(&cursor_marker); }
+
+
+// Message queue
+BOOL GetMessage(LPMSG msg, HWND hWnd, UINT filter_min, UINT filter_max)
+{
+    std::shared_ptr<QUEUE> queue = CurrentQueue();
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    for (;;)
+    {
+        ReplySentLocked(*queue, lock);
+        if (TakeLocked(*queue, msg, hWnd, filter_min, filter_max, true)) { return msg->message != WM_QUIT; }
+        queue->ready.wait(lock);
+    }
+}
+
+BOOL PeekMessage(LPMSG msg, HWND hWnd, UINT filter_min, UINT filter_max, UINT remove_msg)
+{
+    std::shared_ptr<QUEUE> queue = CurrentQueue();
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    ReplySentLocked(*queue, lock);
+    return TakeLocked(*queue, msg, hWnd, filter_min, filter_max, (remove_msg & PM_REMOVE) != 0);
+}
+
+DWORD MsgWaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL wait_all, DWORD milliseconds, DWORD)
+{
+    if (wait_all || (count && !handles)) { SetLastError(ERROR_INVALID_PARAMETER); return WAIT_FAILED; }
+    const auto start    = std::chrono::steady_clock::now();
+    const auto deadline = milliseconds == INFINITE ? std::chrono::steady_clock::time_point::max() : start + std::chrono::milliseconds(milliseconds);
+    STATE& state = State();
+    std::shared_ptr<QUEUE> queue = CurrentQueue();
+    for (;;)
+    {
+        // Timers first, like windows returns the lowest signaled index and the queue comes after the handles
+        auto wake = deadline;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            auto now = std::chrono::steady_clock::now();
+            for (DWORD i = 0; i < count; i++)
+            {
+                KERNEL_OBJECT* timer = static_cast<KERNEL_OBJECT*>(handles[i]);
+                if (!state.kernel_objects.count(timer) || timer->kind != KERNEL_OBJECT::KIND::TIMER) { SetLastError(ERROR_INVALID_HANDLE); return WAIT_FAILED; }
+                if (!timer->armed) { continue; }
+                if (now >= timer->due)
+                {
+                    if (timer->period.count())   { timer->due += timer->period; }
+                    else if (!timer->manual_reset) { timer->armed = false; }
+                    return WAIT_OBJECT_0 + i;
+                }
+                wake = std::min(wake, timer->due);
+            }
+        }
+
+        // A timer set on another thread while we sleep is seen when we wake up
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        // A sent message counts as input too, the PeekMessage after the wait answers it
+        auto has_message = [&] { return !queue->messages.empty() || queue->quit_posted || !queue->paints.empty() || !queue->sent.empty(); };
+        if (has_message()) { return WAIT_OBJECT_0 + count; }
+        if (std::chrono::steady_clock::now() >= deadline) { return WAIT_TIMEOUT; }
+        if (wake == std::chrono::steady_clock::time_point::max()) { queue->ready.wait(lock, has_message); }
+        else { queue->ready.wait_until(lock, wake, has_message); }
+    }
+}
+
+BOOL TranslateMessage(const MSG*) { return FALSE; } // There is no keyboard to translate
+
+LRESULT DispatchMessage(const MSG* msg)
+{
+    if (!msg || !msg->hwnd) { return 0; }
+    std::shared_ptr<WINDOW> window = Find(msg->hwnd);
+    if (!window || !window->proc) { return 0; }
+    if (msg->message != WM_PAINT)
+    {
+        State().messages_dispatched++;
+        return window->proc(msg->hwnd, msg->message, msg->wParam, msg->lParam);
+    }
+
+    // WM_PAINT from the queue
+    STATE& state = State();
+    size_t begin_paints;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (IsRectEmpty(&window->update))
+        {
+            // Validated after it was queued (UpdateWindow, ValidateRect), there is nothing to paint
+            window->paint_queued = false;
+            return 0;
+        }
+        begin_paints = window->begin_paints;
+    }
+    state.messages_dispatched++;
+    LRESULT result = window->proc(msg->hwnd, msg->message, msg->wParam, msg->lParam);
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (window->begin_paints == begin_paints)
+    {
+        // The handler did not paint. Windows would send WM_PAINT again and again, here it counts as painted
+        window->update       = {0, 0, 0, 0};
+        window->erase        = false;
+        window->paint_queued = false;
+    }
+    return result;
+}
+
+BOOL PostMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+    // A NULL window posts to the calling thread like PostThreadMessage
+    if (!hWnd)
+    {
+        PushMessage(CurrentQueue(), nullptr, uMsg, wParam, lParam);
+        return TRUE;
+    }
+    std::shared_ptr<WINDOW> window = Find(hWnd);
+    if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+    PushMessage(window->queue, hWnd, uMsg, wParam, lParam);
+    return TRUE;
+}
+
+LRESULT SendMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+    std::shared_ptr<WINDOW> window = Find(hWnd);
+    if (!window || !window->proc) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return 0; }
+    State().messages_sent++;
+    std::shared_ptr<QUEUE> queue = CurrentQueue();
+    if (window->queue == queue) { return window->proc(hWnd, uMsg, wParam, lParam); }
+
+    // Another thread owns the window: it runs the procedure, we answer what is sent to us while we wait
+    SENT sent = {hWnd, uMsg, wParam, lParam, queue};
+    {
+        std::lock_guard<std::mutex> lock(window->queue->mutex);
+        if (window->queue->exited) { return window->proc(hWnd, uMsg, wParam, lParam); }
+        window->queue->sent.push_back(&sent);
+    }
+    window->queue->ready.notify_all();
+
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    for (;;)
+    {
+        ReplySentLocked(*queue, lock);
+        if (sent.done) { return sent.result; }
+        if (sent.orphaned) { break; }
+        queue->ready.wait(lock);
+    }
+    lock.unlock();
+    return window->proc(hWnd, uMsg, wParam, lParam);
+}
+
+void PostQuitMessage(int exit_code)
+{
+    std::shared_ptr<QUEUE> queue = CurrentQueue();
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->quit_posted = true;
+        queue->quit_code   = exit_code;
+    }
+    queue->ready.notify_one();
+}
+
+DWORD GetMessageTime() { return t_message_time; }
+
+
+// Input and desktop
+BOOL TrackMouseEvent(TRACKMOUSEEVENT* event_track)
+{
+    if (!event_track || event_track->cbSize != sizeof(TRACKMOUSEEVENT)) { SetLastError(ERROR_INVALID_PARAMETER); return FALSE; }
+    State().track_mouse_calls++;
+    return TRUE;
+}
+
+BOOL SetCursorPos(int x, int y)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.cursor = {x, y};
+    return TRUE;
+}
+
+BOOL GetCursorPos(POINT* point)
+{
+    if (!point) { return FALSE; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    *point = state.cursor;
+    return TRUE;
+}
+
+int GetSystemMetrics(int index)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    switch (index)
+    {
+        case SM_CXSCREEN: return state.screen_width;
+        case SM_CYSCREEN: return state.screen_height;
+    }
+    return 0;
+}
+
+int MessageBoxExW(HWND, LPCWSTR, LPCWSTR, UINT, WORD)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.message_box_result;
+}
+
+
+// GDI
+HDC GetDC(HWND hWnd)
+{
+    std::shared_ptr<WINDOW> window = hWnd ? Find(hWnd) : nullptr;
+    if (hWnd && !window) { return nullptr; }
+    DC* dc = new DC;
+    dc->window = std::move(window);
+    HDC hdc = reinterpret_cast<HDC>(dc);
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.dcs.insert(hdc);
+    return hdc;
+}
+
+int ReleaseDC(HWND, HDC hdc)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.dcs.erase(hdc)) { return 0; }
+    delete reinterpret_cast<DC*>(hdc);
+    return 1;
+}
+
+int GetDeviceCaps(HDC, int index)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    switch (index)
+    {
+        case LOGPIXELSX:
+        case LOGPIXELSY: return state.dpi;
+    }
+    return 0;
+}
+
+HGDIOBJ GetStockObject(int object)
+{
+    if (object < 0 || object >= static_cast<int>(std::size(stock_objects))) { return nullptr; }
+    State(); // Makes sure the stock objects are initialized
+    return reinterpret_cast<HGDIOBJ>(&stock_objects[object]);
+}
+
+HFONT CreateFont(int, int, int, int, int, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, LPCWSTR)
+{
+    State().gdi_objects_alive++;
+    return reinterpret_cast<HFONT>(new GDI_OBJECT{false, GDI_OBJECT::KIND::FONT});
+}
+
+HBRUSH CreateSolidBrush(COLORREF color)
+{
+    State().gdi_objects_alive++;
+    return reinterpret_cast<HBRUSH>(new GDI_OBJECT{false, GDI_OBJECT::KIND::BRUSH, color});
+}
+
+BOOL DeleteObject(HGDIOBJ object)
+{
+    GDI_OBJECT* gdi_object = reinterpret_cast<GDI_OBJECT*>(object);
+    if (!gdi_object) { return FALSE; }
+    if (gdi_object->stock) { return TRUE; } // Deleting stock objects is allowed and does nothing
+    STATE& state = State();
+    if (gdi_object->kind == GDI_OBJECT::KIND::BITMAP)
+    {
+        // Like windows a bitmap that is still selected into a DC can not be deleted
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (HDC hdc : state.dcs)
+        {
+            if (reinterpret_cast<DC*>(hdc)->selected[static_cast<int>(GDI_OBJECT::KIND::BITMAP)] == gdi_object) { return FALSE; }
+        }
+    }
+    state.gdi_objects_alive--;
+    delete gdi_object;
+    return TRUE;
+}
+
+COLORREF SetTextColor(HDC hdc, COLORREF color)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.dcs.count(hdc)) { return CLR_INVALID; }
+    DC* dc = reinterpret_cast<DC*>(hdc);
+    COLORREF previous = dc->text_color;
+    dc->text_color = color;
+    return previous;
+}
+
+COLORREF SetBkColor(HDC hdc, COLORREF color)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.dcs.count(hdc)) { return CLR_INVALID; }
+    DC* dc = reinterpret_cast<DC*>(hdc);
+    COLORREF previous = dc->bk_color;
+    dc->bk_color = color;
+    return previous;
+}
+
+
+HDC CreateCompatibleDC(HDC)
+{
+    // Memory DC, draws into the bitmap selected into it
+    HDC hdc = reinterpret_cast<HDC>(new DC);
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.dcs.insert(hdc);
+    return hdc;
+}
+
+BOOL DeleteDC(HDC hdc) { return ReleaseDC(nullptr, hdc); }
+
+HBITMAP CreateCompatibleBitmap(HDC, int width, int height)
+{
+    if (width <= 0 || height <= 0) { SetLastError(ERROR_INVALID_PARAMETER); return nullptr; }
+    State().gdi_objects_alive++;
+    GDI_OBJECT* bitmap = new GDI_OBJECT{false, GDI_OBJECT::KIND::BITMAP, 0, width, height};
+    bitmap->pixels.resize(static_cast<size_t>(width) * static_cast<size_t>(height));
+    return reinterpret_cast<HBITMAP>(bitmap);
+}
+
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ object)
+{
+    GDI_OBJECT* gdi_object = reinterpret_cast<GDI_OBJECT*>(object);
+    if (!gdi_object) { return nullptr; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.dcs.count(hdc)) { return nullptr; }
+    GDI_OBJECT*& selected = reinterpret_cast<DC*>(hdc)->selected[static_cast<int>(gdi_object->kind)];
+    GDI_OBJECT* previous = selected;
+    selected = gdi_object;
+    return previous;
+}
+
+int FillRect(HDC hdc, const RECT* rect, HBRUSH brush)
+{
+    if (!rect || !brush) { return 0; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.dcs.count(hdc)) { return 0; }
+    DC* dc = reinterpret_cast<DC*>(hdc);
+    int width, height;
+    COLORREF* pixels = PixelsLocked(dc, &width, &height);
+    RECT area = ClipLocked(dc, *rect, width, height);
+    const COLORREF color = reinterpret_cast<GDI_OBJECT*>(brush)->color;
+    for (LONG y = area.top; y < area.bottom; y++)
+    {
+        COLORREF* row = pixels + static_cast<size_t>(y) * width;
+        std::fill(row + area.left, row + area.right, color);
+    }
+    state.pixels_drawn += static_cast<size_t>(area.right - area.left) * static_cast<size_t>(area.bottom - area.top);
+    return 1;
+}
+
+BOOL BitBlt(HDC hdc, int x, int y, int cx, int cy, HDC hdc_source, int x_source, int y_source, DWORD rop)
+{
+    if (rop != SRCCOPY) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.dcs.count(hdc) || !state.dcs.count(hdc_source)) { SetLastError(ERROR_INVALID_HANDLE); return FALSE; }
+    DC* destination = reinterpret_cast<DC*>(hdc);
+    DC* source      = reinterpret_cast<DC*>(hdc_source);
+    int width, height, source_width, source_height;
+    COLORREF* to   = PixelsLocked(destination, &width, &height);
+    COLORREF* from = PixelsLocked(source, &source_width, &source_height);
+
+    // Clipped by both sides
+    const LONG dx = x_source - x;
+    const LONG dy = y_source - y;
+    RECT area = ClipLocked(destination, {x, y, x + cx, y + cy}, width, height);
+    RECT from_area = ClipLocked(source, {area.left + dx, area.top + dy, area.right + dx, area.bottom + dy}, source_width, source_height);
+    area = {from_area.left - dx, from_area.top - dy, from_area.right - dx, from_area.bottom - dy};
+    for (LONG row = area.top; row < area.bottom; row++)
+    {
+        std::memmove(to + static_cast<size_t>(row) * width + area.left, from + static_cast<size_t>(row + dy) * source_width + area.left + dx, static_cast<size_t>(area.right - area.left) * sizeof(COLORREF));
+    }
+    state.pixels_drawn += static_cast<size_t>(area.right - area.left) * static_cast<size_t>(area.bottom - area.top);
+    return TRUE;
+}
+
+
+// Painting
+HDC BeginPaint(HWND hWnd, LPPAINTSTRUCT paint)
+{
+    if (!paint) { SetLastError(ERROR_INVALID_PARAMETER); return nullptr; }
+    std::shared_ptr<WINDOW> window = Find(hWnd);
+    if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return nullptr; }
+    HDC hdc = GetDC(hWnd);
+    bool erase;
+    STATE& state = State();
+    {
+        // Everything that was invalid counts as painted from here on, changes during the paint queue a new WM_PAINT
+        std::lock_guard<std::mutex> lock(state.mutex);
+        *paint         = {};
+        paint->hdc     = hdc;
+        paint->rcPaint = window->update;
+        erase          = window->erase;
+        window->update       = {0, 0, 0, 0};
+        window->erase        = false;
+        window->paint_queued = false;
+        window->begin_paints++;
+        DC* dc      = reinterpret_cast<DC*>(hdc);
+        dc->clip    = paint->rcPaint;
+        dc->clipped = true;
+    }
+    state.paints++;
+
+    // The window erases first. If it does not, the painting has to
+    paint->fErase = erase && !SendMessage(hWnd, WM_ERASEBKGND, reinterpret_cast<WPARAM>(hdc), 0);
+    return hdc;
+}
+
+BOOL EndPaint(HWND hWnd, const PAINTSTRUCT* paint)
+{
+    if (!paint) { return FALSE; }
+    ReleaseDC(hWnd, paint->hdc);
+    return TRUE;
+}
+
+BOOL InvalidateRect(HWND hWnd, const RECT* rect, BOOL erase)
+{
+    PAINT_LIST paints;
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        WINDOW* window = FindLocked(hWnd);
+        if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+        InvalidateLocked(hWnd, window, rect ? *rect : RECT{0, 0, window->width, window->height}, erase != FALSE, &paints);
+    }
+    QueuePaints(paints);
+    return TRUE;
+}
+
+BOOL ValidateRect(HWND hWnd, const RECT* rect)
+{
+    // With one bounding rectangle the update area only goes away when all of it is validated
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+    RECT covered;
+    if (!rect || (IntersectRect(&covered, &window->update, rect) && std::memcmp(&covered, &window->update, sizeof(RECT)) == 0))
+    {
+        window->update = {0, 0, 0, 0};
+        window->erase  = false;
+    }
+    return TRUE;
+}
+
+BOOL GetUpdateRect(HWND hWnd, RECT* rect, BOOL)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    WINDOW* window = FindLocked(hWnd);
+    if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+    if (rect) { *rect = window->update; }
+    return !IsRectEmpty(&window->update);
+}
+
+
+// Rectangles
+BOOL SetRect(RECT* rect, int left, int top, int right, int bottom)
+{
+    if (!rect) { return FALSE; }
+    *rect = {left, top, right, bottom};
+    return TRUE;
+}
+
+BOOL IsRectEmpty(const RECT* rect) { return !rect || rect->right <= rect->left || rect->bottom <= rect->top; }
+
+BOOL IntersectRect(RECT* destination, const RECT* a, const RECT* b)
+{
+    RECT result = {std::max(a->left, b->left), std::max(a->top, b->top), std::min(a->right, b->right), std::min(a->bottom, b->bottom)};
+    if (IsRectEmpty(&result)) { *destination = {0, 0, 0, 0}; return FALSE; }
+    *destination = result;
+    return TRUE;
+}
+
+BOOL UnionRect(RECT* destination, const RECT* a, const RECT* b)
+{
+    // Empty rectangles are ignored
+    if (IsRectEmpty(a)) { *destination = *b; return !IsRectEmpty(b); }
+    if (IsRectEmpty(b)) { *destination = *a; return TRUE; }
+    *destination = {std::min(a->left, b->left), std::min(a->top, b->top), std::max(a->right, b->right), std::max(a->bottom, b->bottom)};
+    return TRUE;
+}
+
+BOOL SubtractRect(RECT* destination, const RECT* a, const RECT* b)
+{
+    // Like windows: only if b cuts off a whole side of a, otherwise the result is a
+    RECT result = *a;
+    if (b->top <= a->top && b->bottom >= a->bottom)
+    {
+        if (b->left <= a->left && b->right > a->left)        { result.left  = std::min(b->right, a->right); }
+        else if (b->right >= a->right && b->left < a->right) { result.right = std::max(b->left, a->left); }
+    }
+    else if (b->left <= a->left && b->right >= a->right)
+    {
+        if (b->top <= a->top && b->bottom > a->top)           { result.top    = std::min(b->bottom, a->bottom); }
+        else if (b->bottom >= a->bottom && b->top < a->bottom) { result.bottom = std::max(b->top, a->top); }
+    }
+    if (IsRectEmpty(&result)) { *destination = {0, 0, 0, 0}; return FALSE; }
+    *destination = result;
+    return TRUE;
+}
+
+
+// Memory
+LPVOID VirtualAlloc(LPVOID, SIZE_T size, DWORD, DWORD)
+{
+    // Committed pages are always zeroed
+    LPVOID memory = std::calloc(size, 1);
+    if (!memory) { SetLastError(ERROR_NOT_ENOUGH_MEMORY); return nullptr; }
+    State().virtual_allocs_alive++;
+    return memory;
+}
+
+BOOL VirtualFree(LPVOID address, SIZE_T, DWORD)
+{
+    if (!address) { SetLastError(ERROR_INVALID_PARAMETER); return FALSE; }
+    std::free(address);
+    State().virtual_allocs_alive--;
+    return TRUE;
+}
+
+HGLOBAL GlobalAlloc(UINT flags, SIZE_T bytes)
+{
+    void* memory = (flags & GMEM_ZEROINIT) ? std::calloc(bytes ? bytes : 1, 1) : std::malloc(bytes ? bytes : 1);
+    if (!memory) { SetLastError(ERROR_NOT_ENOUGH_MEMORY); return nullptr; }
+    State().global_allocs_alive++;
+    return reinterpret_cast<HGLOBAL>(new GLOBAL_MEMORY{bytes, memory});
+}
+
+HGLOBAL GlobalFree(HGLOBAL hMem)
+{
+    GLOBAL_MEMORY* global_memory = reinterpret_cast<GLOBAL_MEMORY*>(hMem);
+    if (!global_memory) { return nullptr; }
+    std::free(global_memory->bytes);
+    delete global_memory;
+    State().global_allocs_alive--;
+    return nullptr;
+}
+
+LPVOID GlobalLock(HGLOBAL hMem)
+{
+    GLOBAL_MEMORY* global_memory = reinterpret_cast<GLOBAL_MEMORY*>(hMem);
+    return global_memory ? global_memory->bytes : nullptr;
+}
+
+BOOL GlobalUnlock(HGLOBAL) { return FALSE; } // FALSE means the lock count dropped to zero
+
+SIZE_T GlobalSize(HGLOBAL hMem)
+{
+    GLOBAL_MEMORY* global_memory = reinterpret_cast<GLOBAL_MEMORY*>(hMem);
+    return global_memory ? global_memory->size : 0;
+}
+
+
+// Files, pipes and file mappings
+#if !defined(_WIN32)
+namespace
+{
+    KERNEL_OBJECT standard_handles[3] = {{KERNEL_OBJECT::KIND::FILE, 0, 0, true}, {KERNEL_OBJECT::KIND::FILE, 1, 0, true}, {KERNEL_OBJECT::KIND::FILE, 2, 0, true}};
+
+    DWORD ErrorFromErrno(int error)
+    {
+        switch (error)
+        {
+            case ENOENT: return ERROR_FILE_NOT_FOUND;
+            case EACCES: return ERROR_ACCESS_DENIED;
+            case EBADF:  return ERROR_INVALID_HANDLE;
+            case ENOMEM: return ERROR_NOT_ENOUGH_MEMORY;
+            case EPIPE:  return ERROR_BROKEN_PIPE;
+            default:     return ERROR_GEN_FAILURE;
+        }
+    }
+
+    // The object behind handle if it is one of kind, otherwise sets ERROR_INVALID_HANDLE
+    KERNEL_OBJECT* FindKernelObject(HANDLE handle, KERNEL_OBJECT::KIND kind)
+    {
+        KERNEL_OBJECT* object = static_cast<KERNEL_OBJECT*>(handle);
+        bool standard = object >= standard_handles && object < standard_handles + 3;
+        if (!standard)
+        {
+            STATE& state = State();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (!state.kernel_objects.count(object)) { object = nullptr; }
+        }
+        if (!object || object->kind != kind) { SetLastError(ERROR_INVALID_HANDLE); return nullptr; }
+        return object;
+    }
+
+    HANDLE NewKernelObject(KERNEL_OBJECT::KIND kind, int fd, uint64_t size)
+    {
+        KERNEL_OBJECT* object = new KERNEL_OBJECT{kind, fd, size, false};
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.kernel_objects.insert(object);
+        return object;
+    }
+}
+
+HANDLE GetStdHandle(DWORD std_handle)
+{
+    if (std_handle == STD_INPUT_HANDLE)  { return &standard_handles[0]; }
+    if (std_handle == STD_OUTPUT_HANDLE) { return &standard_handles[1]; }
+    if (std_handle == STD_ERROR_HANDLE)  { return &standard_handles[2]; }
+    SetLastError(ERROR_INVALID_PARAMETER);
+    return INVALID_HANDLE_VALUE;
+}
+
+HANDLE CreateFile(LPCWSTR file_name, DWORD desired_access, DWORD, LPSECURITY_ATTRIBUTES, DWORD creation_disposition, DWORD, HANDLE)
+{
+    if (!file_name) { SetLastError(ERROR_INVALID_PARAMETER); return INVALID_HANDLE_VALUE; }
+    size_t length = std::wcslen(file_name);
+    std::string path(UTF::Utf8Length(UTF::Wide(file_name), length), '\0');
+    UTF::ToUtf8(UTF::Wide(file_name), length, path.data());
+
+    bool read  = desired_access & GENERIC_READ;
+    bool write = desired_access & GENERIC_WRITE;
+    int flags  = read && write ? O_RDWR : write ? O_WRONLY : O_RDONLY;
+    if (creation_disposition == CREATE_ALWAYS) { flags |= O_CREAT | O_TRUNC; }
+    else if (creation_disposition != OPEN_EXISTING) { SetLastError(ERROR_NOT_SUPPORTED); return INVALID_HANDLE_VALUE; }
+
+    int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0) { SetLastError(ErrorFromErrno(errno)); return INVALID_HANDLE_VALUE; }
+    return NewKernelObject(KERNEL_OBJECT::KIND::FILE, fd, 0);
+}
+
+BOOL CreatePipe(HANDLE* read_pipe, HANDLE* write_pipe, LPSECURITY_ATTRIBUTES, DWORD)
+{
+    int fds[2];
+    if (pipe(fds) != 0) { SetLastError(ErrorFromErrno(errno)); return FALSE; }
+    *read_pipe  = NewKernelObject(KERNEL_OBJECT::KIND::FILE, fds[0], 0);
+    *write_pipe = NewKernelObject(KERNEL_OBJECT::KIND::FILE, fds[1], 0);
+    return TRUE;
+}
+
+BOOL ReadFile(HANDLE file, LPVOID buffer, DWORD bytes_to_read, LPDWORD bytes_read, LPOVERLAPPED)
+{
+    KERNEL_OBJECT* object = FindKernelObject(file, KERNEL_OBJECT::KIND::FILE);
+    if (bytes_read) { *bytes_read = 0; }
+    if (!object) { return FALSE; }
+    ssize_t result;
+    do { result = read(object->fd, buffer, bytes_to_read); } while (result < 0 && errno == EINTR);
+    if (result < 0) { SetLastError(ErrorFromErrno(errno)); return FALSE; }
+
+    // The end of a pipe is an error on windows, the end of a file is not
+    if (result == 0 && bytes_to_read && GetFileType(file) == FILE_TYPE_PIPE) { SetLastError(ERROR_BROKEN_PIPE); return FALSE; }
+    if (bytes_read) { *bytes_read = static_cast<DWORD>(result); }
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE file, LPCVOID buffer, DWORD bytes_to_write, LPDWORD bytes_written, LPOVERLAPPED)
+{
+    KERNEL_OBJECT* object = FindKernelObject(file, KERNEL_OBJECT::KIND::FILE);
+    if (bytes_written) { *bytes_written = 0; }
+    if (!object) { return FALSE; }
+
+    // Blocks until everything is written, like a synchronous WriteFile
+    const char* bytes = static_cast<const char*>(buffer);
+    DWORD written = 0;
+    while (written < bytes_to_write)
+    {
+        ssize_t result = write(object->fd, bytes + written, bytes_to_write - written);
+        if (result < 0 && errno == EINTR) { continue; }
+        if (result < 0) { SetLastError(ErrorFromErrno(errno)); return FALSE; }
+        written += static_cast<DWORD>(result);
+    }
+    if (bytes_written) { *bytes_written = written; }
+    return TRUE;
+}
+
+DWORD GetFileType(HANDLE file)
+{
+    KERNEL_OBJECT* object = FindKernelObject(file, KERNEL_OBJECT::KIND::FILE);
+    struct stat info;
+    if (!object || fstat(object->fd, &info) != 0) { return FILE_TYPE_UNKNOWN; }
+    if (S_ISREG(info.st_mode))  { return FILE_TYPE_DISK; }
+    if (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode)) { return FILE_TYPE_PIPE; }
+    if (S_ISCHR(info.st_mode))  { return FILE_TYPE_CHAR; }
+    return FILE_TYPE_UNKNOWN;
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+    KERNEL_OBJECT* object = FindKernelObject(file, KERNEL_OBJECT::KIND::FILE);
+    if (!object) { return FALSE; }
+    struct stat info;
+    if (fstat(object->fd, &info) != 0) { SetLastError(ErrorFromErrno(errno)); return FALSE; }
+    size->QuadPart = info.st_size;
+    return TRUE;
+}
+
+HANDLE CreateFileMapping(HANDLE file, LPSECURITY_ATTRIBUTES, DWORD protect, DWORD maximum_size_high, DWORD maximum_size_low, LPCWSTR)
+{
+    // Read only views of files are all we need. Page file backed mappings (INVALID_HANDLE_VALUE) are not simulated
+    if (protect != PAGE_READONLY) { SetLastError(ERROR_NOT_SUPPORTED); return nullptr; }
+    KERNEL_OBJECT* object = FindKernelObject(file, KERNEL_OBJECT::KIND::FILE);
+    if (!object) { return nullptr; }
+    struct stat info;
+    if (fstat(object->fd, &info) != 0) { SetLastError(ErrorFromErrno(errno)); return nullptr; }
+
+    // Size 0 means the whole file. Mapping an empty file fails on windows too
+    uint64_t size = (uint64_t(maximum_size_high) << 32) | maximum_size_low;
+    if (!size) { size = static_cast<uint64_t>(info.st_size); }
+    if (!size || size > static_cast<uint64_t>(info.st_size)) { SetLastError(ERROR_INVALID_PARAMETER); return nullptr; }
+    int fd = fcntl(object->fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) { SetLastError(ErrorFromErrno(errno)); return nullptr; }
+    return NewKernelObject(KERNEL_OBJECT::KIND::MAPPING, fd, size);
+}
+
+LPVOID MapViewOfFile(HANDLE mapping, DWORD desired_access, DWORD offset_high, DWORD offset_low, SIZE_T bytes)
+{
+    KERNEL_OBJECT* object = FindKernelObject(mapping, KERNEL_OBJECT::KIND::MAPPING);
+    if (!object) { return nullptr; }
+    if (desired_access != FILE_MAP_READ) { SetLastError(ERROR_ACCESS_DENIED); return nullptr; }
+    uint64_t offset = (uint64_t(offset_high) << 32) | offset_low;
+    if (offset >= object->size) { SetLastError(ERROR_INVALID_PARAMETER); return nullptr; }
+    size_t length = bytes ? bytes : static_cast<size_t>(object->size - offset);
+
+    void* view = mmap(nullptr, length, PROT_READ, MAP_SHARED, object->fd, static_cast<off_t>(offset));
+    if (view == MAP_FAILED) { SetLastError(ErrorFromErrno(errno)); return nullptr; }
+    madvise(view, length, MADV_SEQUENTIAL); // Views are mostly read front to back once, let the kernel read ahead
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.views[view] = length;
+    return view;
+}
+
+BOOL UnmapViewOfFile(LPCVOID address)
+{
+    size_t length;
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto it = state.views.find(address);
+        if (it == state.views.end()) { SetLastError(ERROR_INVALID_PARAMETER); return FALSE; }
+        length = it->second;
+        state.views.erase(it);
+    }
+    munmap(const_cast<void*>(address), length);
+    return TRUE;
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+    KERNEL_OBJECT* object = static_cast<KERNEL_OBJECT*>(handle);
+    if (object >= standard_handles && object < standard_handles + 3) { return TRUE; }
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.kernel_objects.erase(object)) { SetLastError(ERROR_INVALID_HANDLE); return FALSE; }
+    }
+    if (object->fd >= 0) { close(object->fd); }
+    delete object;
+    return TRUE;
+}
+
+HANDLE CreateWaitableTimerEx(LPSECURITY_ATTRIBUTES, LPCWSTR, DWORD flags, DWORD)
+{
+    // The condition variable of the queue waits with the precision of the steady clock, every timer is a high resolution one
+    KERNEL_OBJECT* timer = static_cast<KERNEL_OBJECT*>(NewKernelObject(KERNEL_OBJECT::KIND::TIMER, -1, 0));
+    timer->manual_reset = (flags & CREATE_WAITABLE_TIMER_MANUAL_RESET) != 0;
+    return timer;
+}
+
+BOOL SetWaitableTimer(HANDLE handle, const LARGE_INTEGER* due_time, LONG period, PTIMERAPCROUTINE completion, LPVOID, BOOL)
+{
+    if (!due_time || period < 0 || completion) { SetLastError(ERROR_INVALID_PARAMETER); return FALSE; }
+    KERNEL_OBJECT* timer = FindKernelObject(handle, KERNEL_OBJECT::KIND::TIMER);
+    if (!timer) { return FALSE; }
+
+    // Negative: relative in 100 ns units. Positive: absolute FILETIME (100 ns since 1601), converted through the system clock
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point due;
+    if (due_time->QuadPart <= 0) { due = now + std::chrono::nanoseconds(-due_time->QuadPart * 100); }
+    else
+    {
+        constexpr int64_t FILETIME_UNIX_EPOCH = 116444736000000000; // 1970 in FILETIME units
+        auto absolute = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds((due_time->QuadPart - FILETIME_UNIX_EPOCH) * 100)));
+        due = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(absolute - std::chrono::system_clock::now());
+    }
+
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    timer->armed  = true;
+    timer->due    = due;
+    timer->period = std::chrono::milliseconds(period);
+    return TRUE;
+}
+
+BOOL CancelWaitableTimer(HANDLE handle)
+{
+    KERNEL_OBJECT* timer = FindKernelObject(handle, KERNEL_OBJECT::KIND::TIMER);
+    if (!timer) { return FALSE; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    timer->armed = false;
+    return TRUE;
+}
+#else
+// GUI_HEADLESS on windows: no file descriptors to build on. Everything fails, callers see ERROR_NOT_SUPPORTED
+HANDLE GetStdHandle(DWORD) { SetLastError(ERROR_NOT_SUPPORTED); return INVALID_HANDLE_VALUE; }
+HANDLE CreateFile(LPCWSTR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD, DWORD, HANDLE) { SetLastError(ERROR_NOT_SUPPORTED); return INVALID_HANDLE_VALUE; }
+BOOL   CreatePipe(HANDLE*, HANDLE*, LPSECURITY_ATTRIBUTES, DWORD) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+BOOL   ReadFile(HANDLE, LPVOID, DWORD, LPDWORD, LPOVERLAPPED) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+BOOL   WriteFile(HANDLE, LPCVOID, DWORD, LPDWORD, LPOVERLAPPED) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+DWORD  GetFileType(HANDLE) { return FILE_TYPE_UNKNOWN; }
+BOOL   GetFileSizeEx(HANDLE, LARGE_INTEGER*) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+HANDLE CreateFileMapping(HANDLE, LPSECURITY_ATTRIBUTES, DWORD, DWORD, DWORD, LPCWSTR) { SetLastError(ERROR_NOT_SUPPORTED); return nullptr; }
+LPVOID MapViewOfFile(HANDLE, DWORD, DWORD, DWORD, SIZE_T) { SetLastError(ERROR_NOT_SUPPORTED); return nullptr; }
+BOOL   UnmapViewOfFile(LPCVOID) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+BOOL   CloseHandle(HANDLE) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+HANDLE CreateWaitableTimerEx(LPSECURITY_ATTRIBUTES, LPCWSTR, DWORD, DWORD) { SetLastError(ERROR_NOT_SUPPORTED); return nullptr; }
+BOOL   SetWaitableTimer(HANDLE, const LARGE_INTEGER*, LONG, PTIMERAPCROUTINE, LPVOID, BOOL) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+BOOL   CancelWaitableTimer(HANDLE) { SetLastError(ERROR_NOT_SUPPORTED); return FALSE; }
+#endif
+
+
+// Clipboard
+BOOL OpenClipboard(HWND new_owner)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    CLIPBOARD_STATE& clipboard = state.clipboard;
+    if (clipboard.open && clipboard.opener != std::this_thread::get_id()) { return FALSE; }
+    if (!clipboard.open) { clipboard.open_sequence = clipboard.sequence; }
+    clipboard.open        = true;
+    clipboard.opener      = std::this_thread::get_id();
+    clipboard.open_window = new_owner;
+    return TRUE;
+}
+
+BOOL CloseClipboard()
+{
+    std::vector<HWND> listeners;
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        CLIPBOARD_STATE& clipboard = state.clipboard;
+        if (!clipboard.open || clipboard.opener != std::this_thread::get_id()) { SetLastError(ERROR_CLIPBOARD_NOT_OPEN); return FALSE; }
+        clipboard.open        = false;
+        clipboard.open_window = nullptr;
+        if (clipboard.sequence != clipboard.open_sequence) { listeners = clipboard.listeners; }
+    }
+    // Like windows, the listeners hear about a change once it is complete
+    for (HWND listener : listeners) { PostMessage(listener, WM_CLIPBOARDUPDATE, 0, 0); }
+    return TRUE;
+}
+
+BOOL EmptyClipboard()
+{
+    std::map<UINT, HGLOBAL> old_data;
+    HWND old_owner = nullptr;
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        CLIPBOARD_STATE& clipboard = state.clipboard;
+        if (!clipboard.open || clipboard.opener != std::this_thread::get_id()) { SetLastError(ERROR_CLIPBOARD_NOT_OPEN); return FALSE; }
+        old_data.swap(clipboard.data);
+        old_owner       = clipboard.owner;
+        clipboard.owner = clipboard.open_window;
+        clipboard.sequence++;
+    }
+    // The previous owner can release whatever it kept for delayed rendering
+    if (old_owner) { SendMessage(old_owner, WM_DESTROYCLIPBOARD, 0, 0); }
+    for (auto& [format, hMem] : old_data) { GlobalFree(hMem); }
+    return TRUE;
+}
+
+HANDLE SetClipboardData(UINT format, HANDLE hMem)
+{
+    HGLOBAL replaced = nullptr;
+    {
+        STATE& state = State();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        CLIPBOARD_STATE& clipboard = state.clipboard;
+        WINDOW* render_owner = FindLocked(clipboard.render_owner);
+        const bool rendered_here = render_owner && render_owner->queue == t_queue.queue;
+        if (!clipboard.open || (clipboard.opener != std::this_thread::get_id() && !rendered_here)) { SetLastError(ERROR_CLIPBOARD_NOT_OPEN); return nullptr; }
+        auto it = clipboard.data.find(format);
+        bool rendering = it != clipboard.data.end() && it->second == nullptr && hMem != nullptr;
+        HGLOBAL& slot = clipboard.data[format];
+        replaced = slot;
+        slot     = static_cast<HGLOBAL>(hMem);
+
+        // Rendering a delayed format does not change the clipboard content
+        if (!rendering) { clipboard.sequence++; }
+    }
+    if (replaced && replaced != hMem) { GlobalFree(replaced); }
+    return hMem;
+}
+
+HANDLE GetClipboardData(UINT format)
+{
+    STATE& state = State();
+    HWND owner = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        CLIPBOARD_STATE& clipboard = state.clipboard;
+        if (!clipboard.open || clipboard.opener != std::this_thread::get_id()) { SetLastError(ERROR_CLIPBOARD_NOT_OPEN); return nullptr; }
+        auto it = clipboard.data.find(format);
+        if (it == clipboard.data.end()) { return nullptr; }
+        if (it->second) { return it->second; }
+        owner = clipboard.owner;
+        if (owner) { clipboard.render_owner = owner; }
+    }
+
+    // Delayed rendering: the owner produces the data now and hands it over with SetClipboardData
+    if (!owner) { return nullptr; }
+    SendMessage(owner, WM_RENDERFORMAT, format, 0);
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.clipboard.render_owner = nullptr;
+    auto it = state.clipboard.data.find(format);
+    return it == state.clipboard.data.end() ? nullptr : it->second;
+}
+
+BOOL IsClipboardFormatAvailable(UINT format)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.clipboard.data.count(format) != 0;
+}
+
+HWND GetClipboardOwner()
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.clipboard.owner;
+}
+
+DWORD GetClipboardSequenceNumber()
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.clipboard.sequence;
+}
+
+BOOL AddClipboardFormatListener(HWND hWnd)
+{
+    if (!IsWindow(hWnd)) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto& listeners = state.clipboard.listeners;
+    if (std::find(listeners.begin(), listeners.end(), hWnd) == listeners.end()) { listeners.push_back(hWnd); }
+    return TRUE;
+}
+
+BOOL RemoveClipboardFormatListener(HWND hWnd)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto& listeners = state.clipboard.listeners;
+    auto it = std::find(listeners.begin(), listeners.end(), hWnd);
+    if (it == listeners.end()) { SetLastError(ERROR_INVALID_PARAMETER); return FALSE; }
+    listeners.erase(it);
+    return TRUE;
+}
+
+UINT RegisterClipboardFormat(LPCWSTR name)
+{
+    if (!name || !*name) { SetLastError(ERROR_INVALID_PARAMETER); return 0; }
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    auto& registered = state.clipboard.registered;
+    auto it = registered.find(name);
+    if (it != registered.end()) { return it->second; }
+    UINT format = 0xC000 + static_cast<UINT>(registered.size());
+    registered.emplace(name, format);
+    return format;
+}
+
+
+// Simulation knobs
+HEADLESS::STATS HEADLESS::GetStats()
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    STATS stats = {};
+    stats.windows_created      = state.windows_created;
+    stats.windows_alive        = state.windows.size();
+    stats.messages_posted      = state.messages_posted;
+    stats.messages_dispatched  = state.messages_dispatched;
+    stats.messages_sent        = state.messages_sent;
+    stats.track_mouse_calls    = state.track_mouse_calls;
+    stats.gdi_objects_alive    = state.gdi_objects_alive;
+    stats.global_allocs_alive  = state.global_allocs_alive;
+    stats.virtual_allocs_alive = state.virtual_allocs_alive;
+    stats.window_positions     = state.window_positions;
+    stats.defer_batches        = state.defer_batches;
+    stats.kernel_handles_alive = state.kernel_objects.size();
+    stats.views_alive          = state.views.size();
+    stats.paints               = state.paints;
+    stats.pixels_drawn         = state.pixels_drawn;
+    return stats;
+}
+
+void HEADLESS::SetDpi(int dpi)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.dpi = dpi;
+}
+
+void HEADLESS::SetScreenSize(int width, int height)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.screen_width  = width;
+    state.screen_height = height;
+}
+
+void HEADLESS::SetMessageBoxResult(int result)
+{
+    STATE& state = State();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.message_box_result = result;
+}
+
+size_t HEADLESS::PendingMessages()
+{
+    std::shared_ptr<QUEUE> queue = CurrentQueue();
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->messages.size();
+}
+
+BOOL HEADLESS::MoveMouse(HWND hWnd, int x, int y, WPARAM keys)
+{
+    std::shared_ptr<WINDOW> window = Find(hWnd);
+    if (!window) { SetLastError(ERROR_INVALID_WINDOW_HANDLE); return FALSE; }
+    SetCursorPos(x, y);
+    {
+        std::lock_guard<std::mutex> lock(window->queue->mutex);
+        std::deque<MSG>& messages = window->queue->messages;
+        if (!messages.empty() && messages.back().message == WM_MOUSEMOVE && messages.back().hwnd == hWnd && messages.back().wParam == keys)
+        {
+            MSG& move   = messages.back();
+            move.lParam = MAKELPARAM(x, y);
+            move.time   = GetTickCount();
+            move.pt     = {x, y};
+            return TRUE;
+        }
+    }
+    PushMessage(window->queue, hWnd, WM_MOUSEMOVE, keys, MAKELPARAM(x, y));
+    return TRUE;
+}
+
+#endif // headless backend
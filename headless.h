@@ -0,0 +1,497 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+/*
+Headless backend.
+Declares the part of the winapi that GUI and CLIPBOARD use and implements it in memory (see headless.cpp).
+Windows, the per thread message queue and the clipboard are simulated, so the message handlers can be driven by synthetic messages on any OS.
+Names, types and constant values match windows.h so the rest of the program does not need to know which backend it runs on.
+Only include this through platform.h.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+
+// Calling conventions do not exist outside of windows
+#define CALLBACK
+#define WINAPI
+
+// Basic types
+typedef int            BOOL;
+typedef unsigned char  BYTE;
+typedef uint16_t       WORD;
+typedef uint32_t       DWORD;
+typedef int32_t        LONG;
+typedef unsigned int   UINT;
+typedef intptr_t       INT_PTR;
+typedef uintptr_t      UINT_PTR;
+typedef intptr_t       LONG_PTR;
+typedef uintptr_t      ULONG_PTR;
+typedef size_t         SIZE_T;
+typedef UINT_PTR       WPARAM;
+typedef LONG_PTR       LPARAM;
+typedef LONG_PTR       LRESULT;
+typedef DWORD          COLORREF;
+typedef void*          LPVOID;
+typedef const void*    LPCVOID;
+typedef DWORD*         LPDWORD;
+typedef wchar_t        WCHAR;
+typedef WCHAR*         LPWSTR;
+typedef const WCHAR*   LPCWSTR;
+typedef LPWSTR         LPTSTR;
+typedef LPCWSTR        LPCTSTR;
+
+// Handles are opaque pointers just like in windows.h
+#define HEADLESS_DECLARE_HANDLE(name) struct name##__; typedef struct name##__* name
+HEADLESS_DECLARE_HANDLE(HWND);
+HEADLESS_DECLARE_HANDLE(HMENU);
+HEADLESS_DECLARE_HANDLE(HINSTANCE);
+HEADLESS_DECLARE_HANDLE(HDC);
+HEADLESS_DECLARE_HANDLE(HFONT);
+HEADLESS_DECLARE_HANDLE(HBRUSH);
+HEADLESS_DECLARE_HANDLE(HBITMAP);
+HEADLESS_DECLARE_HANDLE(HICON);
+HEADLESS_DECLARE_HANDLE(HGLOBAL);
+HEADLESS_DECLARE_HANDLE(HDWP);
+#undef HEADLESS_DECLARE_HANDLE
+typedef void* HGDIOBJ; // Like windows.h, so every GDI handle converts to it
+typedef HICON     HCURSOR;
+typedef HINSTANCE HMODULE;
+typedef void*     HANDLE;
+
+#define FALSE 0
+#define TRUE  1
+
+// Helper macros
+#define LOWORD(l)          ((WORD)(((ULONG_PTR)(l)) & 0xffff))
+#define HIWORD(l)          ((WORD)((((ULONG_PTR)(l)) >> 16) & 0xffff))
+#define MAKELONG(a, b)     ((LONG)(((WORD)(((ULONG_PTR)(a)) & 0xffff)) | ((DWORD)((WORD)(((ULONG_PTR)(b)) & 0xffff))) << 16))
+#define MAKEWPARAM(l, h)   ((WPARAM)(DWORD)MAKELONG(l, h))
+#define MAKELPARAM(l, h)   ((LPARAM)(DWORD)MAKELONG(l, h))
+#define RGB(r, g, b)       ((COLORREF)(((BYTE)(r) | ((WORD)((BYTE)(g)) << 8)) | (((DWORD)(BYTE)(b)) << 16)))
+#define MAKEINTRESOURCE(i) ((LPWSTR)((ULONG_PTR)((WORD)(i))))
+
+// Structures
+struct POINT { LONG x; LONG y; };
+struct RECT  { LONG left; LONG top; LONG right; LONG bottom; };
+
+struct MSG
+{
+    HWND   hwnd;
+    UINT   message;
+    WPARAM wParam;
+    LPARAM lParam;
+    DWORD  time;
+    POINT  pt;
+};
+typedef MSG* LPMSG;
+
+typedef LRESULT (CALLBACK* WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+
+struct WNDCLASS
+{
+    UINT      style;
+    WNDPROC   lpfnWndProc;
+    int       cbClsExtra;
+    int       cbWndExtra;
+    HINSTANCE hInstance;
+    HICON     hIcon;
+    HCURSOR   hCursor;
+    HBRUSH    hbrBackground;
+    LPCWSTR   lpszMenuName;
+    LPCWSTR   lpszClassName;
+};
+
+struct CREATESTRUCT
+{
+    LPVOID    lpCreateParams;
+    HINSTANCE hInstance;
+    HMENU     hMenu;
+    HWND      hwndParent;
+    int       cy;
+    int       cx;
+    int       y;
+    int       x;
+    LONG      style;
+    LPCWSTR   lpszName;
+    LPCWSTR   lpszClass;
+    DWORD     dwExStyle;
+};
+typedef CREATESTRUCT* LPCREATESTRUCT;
+
+struct LARGE_INTEGER { int64_t QuadPart; }; // A union in windows.h, QuadPart is the part that gets used
+
+// Only ever passed as NULL
+struct SECURITY_ATTRIBUTES;
+typedef SECURITY_ATTRIBUTES* LPSECURITY_ATTRIBUTES;
+struct OVERLAPPED;
+typedef OVERLAPPED* LPOVERLAPPED;
+
+struct PAINTSTRUCT
+{
+    HDC  hdc;
+    BOOL fErase;
+    RECT rcPaint;
+    BOOL fRestore;
+    BOOL fIncUpdate;
+    BYTE rgbReserved[32];
+};
+typedef PAINTSTRUCT* LPPAINTSTRUCT;
+
+struct TRACKMOUSEEVENT
+{
+    DWORD cbSize;
+    DWORD dwFlags;
+    HWND  hwndTrack;
+    DWORD dwHoverTime;
+};
+
+// Window messages
+#define WM_NULL             0x0000
+#define WM_CREATE           0x0001
+#define WM_DESTROY          0x0002
+#define WM_MOVE             0x0003
+#define WM_SIZE             0x0005
+#define WM_SETTEXT          0x000C
+#define WM_GETTEXT          0x000D
+#define WM_GETTEXTLENGTH    0x000E
+#define WM_PAINT            0x000F
+#define WM_CLOSE            0x0010
+#define WM_QUIT             0x0012
+#define WM_ERASEBKGND       0x0014
+#define WM_SHOWWINDOW       0x0018
+#define WM_SETFONT          0x0030
+#define WM_GETFONT          0x0031
+#define WM_NCCREATE         0x0081
+#define WM_NCDESTROY        0x0082
+#define WM_KEYFIRST         0x0100
+#define WM_KEYDOWN          0x0100
+#define WM_KEYUP            0x0101
+#define WM_CHAR             0x0102
+#define WM_KEYLAST          0x0109
+#define WM_COMMAND          0x0111
+#define WM_TIMER            0x0113
+#define WM_CTLCOLORSTATIC   0x0138
+#define WM_MOUSEFIRST       0x0200
+#define WM_MOUSEMOVE        0x0200
+#define WM_LBUTTONDOWN      0x0201
+#define WM_LBUTTONUP        0x0202
+#define WM_MOUSELAST        0x020E
+#define WM_MOUSEHOVER       0x02A1
+#define WM_MOUSELEAVE       0x02A3
+#define WM_RENDERFORMAT     0x0305
+#define WM_RENDERALLFORMATS 0x0306
+#define WM_DESTROYCLIPBOARD 0x0307
+#define WM_CLIPBOARDUPDATE  0x031D
+#define WM_USER             0x0400
+#define WM_APP              0x8000
+#define MK_LBUTTON          0x0001
+
+// Button messages, states and notifications
+#define BM_GETCHECK   0x00F0
+#define BM_SETCHECK   0x00F1
+#define BM_CLICK      0x00F5
+#define BST_UNCHECKED 0x0000
+#define BST_CHECKED   0x0001
+#define BN_CLICKED    0
+
+// Window styles
+#define CS_VREDRAW          0x0001
+#define CS_HREDRAW          0x0002
+#define WS_OVERLAPPEDWINDOW 0x00CF0000L
+#define WS_VISIBLE          0x10000000L
+#define WS_CHILD            0x40000000L
+#define WS_TABSTOP          0x00010000L
+#define WS_BORDER           0x00800000L
+#define WS_VSCROLL          0x00200000L
+#define WS_CLIPCHILDREN     0x02000000L
+#define CW_USEDEFAULT       ((int)0x80000000)
+#define BS_DEFPUSHBUTTON    0x00000001L
+#define BS_AUTOCHECKBOX     0x00000003L
+#define BS_TYPEMASK         0x0000000FL
+#define BS_MULTILINE        0x00002000L
+#define SS_ETCHEDHORZ       0x00000010L
+#define SS_EDITCONTROL      0x00002000L
+#define ES_MULTILINE        0x0004L
+#define ES_AUTOVSCROLL      0x0040L
+#define GWLP_USERDATA       (-21)
+#define SIZE_RESTORED       0
+#define IDC_ARROW           MAKEINTRESOURCE(32512)
+
+// SetWindowPos
+#define HWND_TOP           ((HWND)0)
+#define SWP_NOSIZE         0x0001
+#define SWP_NOMOVE         0x0002
+#define SWP_NOZORDER       0x0004
+#define SWP_NOACTIVATE     0x0010
+#define SWP_ASYNCWINDOWPOS 0x4000
+
+// PeekMessage
+#define PM_NOREMOVE 0x0000
+#define PM_REMOVE   0x0001
+
+// Message box
+#define MB_ICONWARNING       0x00000030L
+#define MB_CANCELTRYCONTINUE 0x00000006L
+#define MB_DEFBUTTON2        0x00000100L
+#define IDOK                 1
+#define IDCANCEL             2
+#define IDTRYAGAIN           10
+#define IDCONTINUE           11
+
+// Mouse tracking
+#define TME_HOVER     0x00000001
+#define TME_LEAVE     0x00000002
+#define TME_CANCEL    0x80000000
+#define HOVER_DEFAULT 0xFFFFFFFF
+
+// System metrics
+#define SM_CXSCREEN 0
+#define SM_CYSCREEN 1
+#define LOGPIXELSX  88
+#define LOGPIXELSY  90
+
+// GDI
+#define WHITE_BRUSH         0
+#define LTGRAY_BRUSH        1
+#define CLR_INVALID         0xFFFFFFFF
+#define SRCCOPY             0x00CC0020
+#define FW_DONTCARE         0
+#define FW_NORMAL           400
+#define FW_BOLD             700
+#define ANSI_CHARSET        0
+#define DEFAULT_CHARSET     1
+#define OUT_DEFAULT_PRECIS  0
+#define CLIP_DEFAULT_PRECIS 0
+#define DEFAULT_QUALITY     0
+#define DEFAULT_PITCH       0
+#define FF_SWISS            (2 << 4)
+
+// Memory
+#define MEM_COMMIT     0x00001000
+#define MEM_RESERVE    0x00002000
+#define MEM_RELEASE    0x00008000
+#define PAGE_READWRITE 0x04
+#define GMEM_MOVEABLE  0x0002
+#define GMEM_ZEROINIT  0x0040
+
+// Files, pipes and file mappings
+#define GENERIC_READ          0x80000000
+#define GENERIC_WRITE         0x40000000
+#define FILE_SHARE_READ       0x00000001
+#define CREATE_ALWAYS         2
+#define OPEN_EXISTING         3
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define INVALID_HANDLE_VALUE  ((HANDLE)(LONG_PTR)-1)
+#define STD_INPUT_HANDLE      ((DWORD)-10)
+#define STD_OUTPUT_HANDLE     ((DWORD)-11)
+#define STD_ERROR_HANDLE      ((DWORD)-12)
+#define FILE_TYPE_UNKNOWN     0x0000
+#define FILE_TYPE_DISK        0x0001
+#define FILE_TYPE_CHAR        0x0002
+#define FILE_TYPE_PIPE        0x0003
+#define PAGE_READONLY         0x02
+#define FILE_MAP_READ         0x0004
+
+// Waiting and waitable timers
+#define INFINITE                              0xFFFFFFFF
+#define WAIT_OBJECT_0                         0x00000000
+#define WAIT_TIMEOUT                          258
+#define WAIT_FAILED                           ((DWORD)0xFFFFFFFF)
+#define QS_ALLINPUT                           0x04FF
+#define CREATE_WAITABLE_TIMER_MANUAL_RESET    0x00000001
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#define TIMER_ALL_ACCESS                      0x001F0003
+typedef void (CALLBACK* PTIMERAPCROUTINE)(LPVOID arg, DWORD timer_low, DWORD timer_high);
+
+// Clipboard formats
+#define CF_TEXT        1
+#define CF_UNICODETEXT 13
+
+// Error codes
+#define ERROR_SUCCESS                0
+#define ERROR_FILE_NOT_FOUND         2
+#define ERROR_ACCESS_DENIED          5
+#define ERROR_INVALID_HANDLE         6
+#define ERROR_NOT_ENOUGH_MEMORY      8
+#define ERROR_GEN_FAILURE            31
+#define ERROR_NOT_SUPPORTED          50
+#define ERROR_BROKEN_PIPE            109
+#define ERROR_INVALID_PARAMETER      87
+#define ERROR_INVALID_WINDOW_HANDLE  1400
+#define ERROR_CLASS_ALREADY_EXISTS   1410
+#define ERROR_CLASS_DOES_NOT_EXIST   1411
+#define ERROR_CLIPBOARD_NOT_OPEN     1418
+
+// Module, errors, time
+HMODULE GetModuleHandle(LPCWSTR module_name);
+DWORD   GetLastError();
+void    SetLastError(DWORD error_code);
+DWORD   GetTickCount();
+BOOL    FreeConsole();
+
+// Window classes and windows
+BOOL    RegisterClass(const WNDCLASS* window_class);
+BOOL    UnregisterClass(LPCWSTR class_name, HINSTANCE hInstance);
+BOOL    GetClassInfo(HINSTANCE hInstance, LPCWSTR class_name, WNDCLASS* window_class);
+HWND    CreateWindowEx(DWORD ex_style, LPCWSTR class_name, LPCWSTR window_name, DWORD style, int x, int y, int width, int height, HWND parent, HMENU menu, HINSTANCE hInstance, LPVOID param);
+#define CreateWindow(class_name, window_name, style, x, y, width, height, parent, menu, hInstance, param) \
+    CreateWindowEx(0, class_name, window_name, style, x, y, width, height, parent, menu, hInstance, param)
+BOOL    DestroyWindow(HWND hWnd);
+BOOL    IsWindow(HWND hWnd);
+HWND    FindWindow(LPCWSTR class_name, LPCWSTR window_name);
+BOOL    ShowWindow(HWND hWnd, int show_cmd);
+BOOL    UpdateWindow(HWND hWnd);
+BOOL    SetWindowPos(HWND hWnd, HWND insert_after, int x, int y, int cx, int cy, UINT flags);
+HDWP    BeginDeferWindowPos(int num_windows);
+HDWP    DeferWindowPos(HDWP hWinPosInfo, HWND hWnd, HWND insert_after, int x, int y, int cx, int cy, UINT flags);
+BOOL    EndDeferWindowPos(HDWP hWinPosInfo);
+BOOL    GetWindowRect(HWND hWnd, RECT* rect);
+BOOL    GetClientRect(HWND hWnd, RECT* rect);
+HWND    GetDlgItem(HWND hDlg, int id);
+int     GetDlgCtrlID(HWND hWnd);
+HWND    GetParent(HWND hWnd);
+UINT    IsDlgButtonChecked(HWND hDlg, int id);
+int     GetWindowTextLength(HWND hWnd);
+int     GetWindowText(HWND hWnd, LPWSTR buffer, int max_count);
+BOOL    SetWindowText(HWND hWnd, LPCWSTR text);
+LONG_PTR SetWindowLongPtr(HWND hWnd, int index, LONG_PTR value);
+LONG_PTR GetWindowLongPtrW(HWND hWnd, int index);
+inline LONG_PTR GetWindowLongPtr(HWND hWnd, int index) { return GetWindowLongPtrW(hWnd, index); }
+LRESULT DefWindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+HCURSOR LoadCursor(HINSTANCE hInstance, LPCWSTR cursor_name);
+
+// Message queue
+BOOL    GetMessage(LPMSG msg, HWND hWnd, UINT filter_min, UINT filter_max);
+BOOL    PeekMessage(LPMSG msg, HWND hWnd, UINT filter_min, UINT filter_max, UINT remove_msg);
+BOOL    TranslateMessage(const MSG* msg);
+LRESULT DispatchMessage(const MSG* msg);
+BOOL    PostMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+LRESULT SendMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+void    PostQuitMessage(int exit_code);
+DWORD   GetMessageTime();
+
+// Input and desktop
+BOOL    TrackMouseEvent(TRACKMOUSEEVENT* event_track);
+BOOL    SetCursorPos(int x, int y);
+BOOL    GetCursorPos(POINT* point);
+int     GetSystemMetrics(int index);
+int     MessageBoxExW(HWND hWnd, LPCWSTR text, LPCWSTR caption, UINT type, WORD language_id);
+
+// GDI
+HDC      GetDC(HWND hWnd);
+int      ReleaseDC(HWND hWnd, HDC hdc);
+HGDIOBJ  GetStockObject(int object);
+HFONT    CreateFont(int height, int width, int escapement, int orientation, int weight, DWORD italic, DWORD underline, DWORD strike_out, DWORD char_set, DWORD out_precision, DWORD clip_precision, DWORD quality, DWORD pitch_and_family, LPCWSTR face_name);
+HBRUSH   CreateSolidBrush(COLORREF color);
+BOOL     DeleteObject(HGDIOBJ object);
+COLORREF SetTextColor(HDC hdc, COLORREF color);
+COLORREF SetBkColor(HDC hdc, COLORREF color);
+int      GetDeviceCaps(HDC hdc, int index);
+HDC      CreateCompatibleDC(HDC hdc);
+BOOL     DeleteDC(HDC hdc);
+HBITMAP  CreateCompatibleBitmap(HDC hdc, int width, int height);
+HGDIOBJ  SelectObject(HDC hdc, HGDIOBJ object);
+int      FillRect(HDC hdc, const RECT* rect, HBRUSH brush);
+BOOL     BitBlt(HDC hdc, int x, int y, int cx, int cy, HDC hdc_source, int x_source, int y_source, DWORD rop);
+
+// Painting. The update area of a window is kept as one bounding rectangle instead of a region
+HDC      BeginPaint(HWND hWnd, LPPAINTSTRUCT paint);
+BOOL     EndPaint(HWND hWnd, const PAINTSTRUCT* paint);
+BOOL     InvalidateRect(HWND hWnd, const RECT* rect, BOOL erase);
+BOOL     ValidateRect(HWND hWnd, const RECT* rect);
+BOOL     GetUpdateRect(HWND hWnd, RECT* rect, BOOL erase);
+
+// Rectangles
+BOOL     SetRect(RECT* rect, int left, int top, int right, int bottom);
+BOOL     IsRectEmpty(const RECT* rect);
+BOOL     IntersectRect(RECT* destination, const RECT* a, const RECT* b);
+BOOL     UnionRect(RECT* destination, const RECT* a, const RECT* b);
+BOOL     SubtractRect(RECT* destination, const RECT* a, const RECT* b);
+
+// Memory
+LPVOID  VirtualAlloc(LPVOID address, SIZE_T size, DWORD allocation_type, DWORD protect);
+BOOL    VirtualFree(LPVOID address, SIZE_T size, DWORD free_type);
+HGLOBAL GlobalAlloc(UINT flags, SIZE_T bytes);
+HGLOBAL GlobalFree(HGLOBAL hMem);
+LPVOID  GlobalLock(HGLOBAL hMem);
+BOOL    GlobalUnlock(HGLOBAL hMem);
+SIZE_T  GlobalSize(HGLOBAL hMem);
+
+// Files, pipes and file mappings. Only implemented outside of windows (file descriptors and mmap)
+HANDLE  GetStdHandle(DWORD std_handle);
+HANDLE  CreateFile(LPCWSTR file_name, DWORD desired_access, DWORD share_mode, LPSECURITY_ATTRIBUTES security, DWORD creation_disposition, DWORD flags, HANDLE template_file);
+BOOL    CreatePipe(HANDLE* read_pipe, HANDLE* write_pipe, LPSECURITY_ATTRIBUTES security, DWORD size);
+BOOL    ReadFile(HANDLE file, LPVOID buffer, DWORD bytes_to_read, LPDWORD bytes_read, LPOVERLAPPED overlapped);
+BOOL    WriteFile(HANDLE file, LPCVOID buffer, DWORD bytes_to_write, LPDWORD bytes_written, LPOVERLAPPED overlapped);
+DWORD   GetFileType(HANDLE file);
+BOOL    GetFileSizeEx(HANDLE file, LARGE_INTEGER* size);
+HANDLE  CreateFileMapping(HANDLE file, LPSECURITY_ATTRIBUTES security, DWORD protect, DWORD maximum_size_high, DWORD maximum_size_low, LPCWSTR name);
+LPVOID  MapViewOfFile(HANDLE mapping, DWORD desired_access, DWORD offset_high, DWORD offset_low, SIZE_T bytes);
+BOOL    UnmapViewOfFile(LPCVOID address);
+BOOL    CloseHandle(HANDLE object);
+
+// Waitable timers are only implemented outside of windows. Due times are on the steady clock, the completion routine is not supported
+// MsgWaitForMultipleObjects waits for any of the timers (wait_all is not supported) or for a message in the queue of the thread. wake_mask is not looked at, every message counts
+HANDLE  CreateWaitableTimerEx(LPSECURITY_ATTRIBUTES security, LPCWSTR name, DWORD flags, DWORD desired_access);
+BOOL    SetWaitableTimer(HANDLE timer, const LARGE_INTEGER* due_time, LONG period, PTIMERAPCROUTINE completion, LPVOID arg, BOOL resume);
+BOOL    CancelWaitableTimer(HANDLE timer);
+DWORD   MsgWaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL wait_all, DWORD milliseconds, DWORD wake_mask);
+
+// Clipboard
+BOOL    OpenClipboard(HWND new_owner);
+BOOL    CloseClipboard();
+BOOL    EmptyClipboard();
+HANDLE  SetClipboardData(UINT format, HANDLE hMem);
+HANDLE  GetClipboardData(UINT format);
+BOOL    IsClipboardFormatAvailable(UINT format);
+HWND    GetClipboardOwner();
+DWORD   GetClipboardSequenceNumber();
+UINT    RegisterClipboardFormat(LPCWSTR name);
+BOOL    AddClipboardFormatListener(HWND hWnd);
+BOOL    RemoveClipboardFormatListener(HWND hWnd);
+
+
+// Knobs and counters of the simulation that have no winapi equivalent. Benchmarks and tests use these to set up and verify a run.
+class HEADLESS
+{
+public:
+
+    struct STATS
+    {
+        size_t windows_created;
+        size_t windows_alive;
+        size_t messages_posted;
+        size_t messages_dispatched;
+        size_t messages_sent;
+        size_t track_mouse_calls;
+        size_t gdi_objects_alive;
+        size_t global_allocs_alive;
+        size_t virtual_allocs_alive;
+        size_t window_positions;   // SetWindowPos calls, including the ones of a DeferWindowPos batch
+        size_t defer_batches;      // EndDeferWindowPos calls
+        size_t kernel_handles_alive; // files, pipes and file mappings that were not closed
+        size_t views_alive;          // MapViewOfFile without UnmapViewOfFile
+        size_t paints;               // BeginPaint calls
+        size_t pixels_drawn;         // FillRect and BitBlt, into windows and bitmaps
+    };
+
+    static STATS GetStats();
+
+    // Size reported by GetSystemMetrics(SM_CXSCREEN/SM_CYSCREEN). Defaults to 1920x1080
+    static void SetScreenSize(int width, int height);
+
+    // DPI reported by GetDeviceCaps(LOGPIXELSX/LOGPIXELSY). Defaults to 96 (100 %)
+    static void SetDpi(int dpi);
+
+    // Button that MessageBoxExW "presses". Defaults to IDCANCEL
+    static void SetMessageBoxResult(int result);
+
+    // Number of messages waiting in the queue of the calling thread
+    static size_t PendingMessages();
+
+    // The mouse moves to x, y over hWnd, like the system reports it: a WM_MOUSEMOVE that is merged into the move
+    // still waiting at the end of the queue, so a loop that falls behind gets the newest position once. PostMessage never merges
+    static BOOL MoveMouse(HWND hWnd, int x, int y, WPARAM keys = 0);
+};
+
+#endif // HEADLESS_H
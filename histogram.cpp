@@ -0,0 +1,60 @@
+#include "histogram.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+size_t HISTOGRAM::Index(uint64_t value)
+{
+    value = std::min(value, (uint64_t(1) << MAX_BITS) - 1);
+    if (value < 2 * SUB_BUCKETS) { return static_cast<size_t>(value); }
+
+    // The top SUB_BUCKET_BITS + 1 bits of the value select the bucket, the rest gets dropped
+    int shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+    return static_cast<size_t>(shift) * SUB_BUCKETS + static_cast<size_t>(value >> shift);
+}
+
+uint64_t HISTOGRAM::HighestInBucket(size_t index)
+{
+    if (index < 2 * SUB_BUCKETS) { return index; }
+    size_t   shift    = index / SUB_BUCKETS - 1;
+    uint64_t mantissa = index % SUB_BUCKETS + SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void HISTOGRAM::Record(uint64_t value)
+{
+    buckets[Index(value)]++;
+    count++;
+    sum += value;
+    if (value > max) { max = value; }
+}
+
+void HISTOGRAM::Merge(const HISTOGRAM& other)
+{
+    for (size_t i = 0; i < BUCKETS; i++) { buckets[i] += other.buckets[i]; }
+    count += other.count;
+    sum   += other.sum;
+    max    = std::max(max, other.max);
+}
+
+void HISTOGRAM::Reset()
+{
+    buckets.fill(0);
+    count = 0;
+    max   = 0;
+    sum   = 0;
+}
+
+uint64_t HISTOGRAM::Percentile(double percentile) const
+{
+    if (count == 0) { return 0; }
+    // Rank of the value we look for, at least the first one
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(count * std::clamp(percentile, 0.0, 100.0) / 100.0)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank) { return std::min(HighestInBucket(i), max); }
+    }
+    return max;
+}
@@ -0,0 +1,49 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+Log-linear histogram of durations in nanoseconds (the HDR histogram layout).
+Values below 64 ns are counted exactly, above that every power of two is split into 32 buckets, so a percentile is off by at most ~3 %.
+Values up to 2^36 ns (~68 s) are distinguished, bigger ones are counted in the last bucket.
+Fixed memory (8 KB), recording is a count leading zeros and an increment. Not thread safe.
+*/
+class HISTOGRAM
+{
+public:
+
+    static constexpr int    SUB_BUCKET_BITS = 5;
+    static constexpr size_t SUB_BUCKETS     = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr int    MAX_BITS        = 36;
+    static constexpr size_t BUCKETS         = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void Record(uint64_t value);
+
+    // Adds the counts of other
+    void Merge(const HISTOGRAM& other);
+
+    void Reset();
+
+    // Value below which percentile (0-100) of the recorded values are. 0 if nothing was recorded
+    uint64_t Percentile(double percentile) const;
+
+    uint64_t Count() const { return count; }
+    uint64_t Max() const { return max; }
+    uint64_t Sum() const { return sum; }
+
+private:
+
+    static size_t Index(uint64_t value);
+
+    // Biggest value that falls into bucket index
+    static uint64_t HighestInBucket(size_t index);
+
+    std::array<uint64_t, BUCKETS> buckets = {};
+    uint64_t count = 0;
+    uint64_t max   = 0;
+    uint64_t sum   = 0;
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,337 @@
+#include "history.h"
+#include "hash.h"
+#include <algorithm>
+#include <cstring>
+
+HISTORY::HISTORY(size_t budget, size_t max_entries)
+    : budget(budget), ring(max_entries ? max_entries : 1)
+{
+}
+
+uint64_t HISTORY::Hash(const PAYLOAD& payload)
+{
+    // A compressed payload by its blocks, the text is never decompressed for the history
+    HASH hash;
+    for (size_t i = 0; i < payload.ChunkCount(); i++)
+    {
+        size_t length;
+        if (payload.IsCompressed())
+        {
+            const unsigned char* block = payload.Block(i, &length);
+            hash.Update(block, length);
+        }
+        else
+        {
+            const WCHAR* text = payload.Chunk(i, &length);
+            hash.Update(text, length * sizeof(WCHAR));
+        }
+    }
+    return hash.Final();
+}
+
+bool HISTORY::Add(std::shared_ptr<const PAYLOAD> payload)
+{
+    if (!payload->IsCompressed()) { return Add(*payload); }
+
+    const size_t bytes = payload->StoredBytes();
+    if (bytes > budget) { return false; }
+    const uint64_t value = Hash(*payload);
+    adds++;
+
+    uint32_t text = FindDuplicate(value, *payload);
+    if (text != NONE)
+    {
+        dedup_hits++;
+        Touch(text);
+    }
+    else
+    {
+        while (bytes_used + bytes > budget) { Evict(); }
+        text = NewText(bytes, value);
+        texts[text].payload = std::move(payload);
+        bytes_used += bytes;
+    }
+    Remember(text);
+    return true;
+}
+
+bool HISTORY::Add(const PAYLOAD& payload)
+{
+    // Do not hash hundreds of MB only to find out they do not fit
+    if (payload.Length() * sizeof(WCHAR) > budget) { return false; }
+    return Add(payload, Hash(payload));
+}
+
+bool HISTORY::Add(const PAYLOAD& payload, uint64_t hash)
+{
+    if (payload.IsCompressed()) { return false; }
+    std::vector<PIECE> pieces(payload.ChunkCount());
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        pieces[i].text = payload.Chunk(i, &pieces[i].length);
+    }
+    return Add(pieces.data(), pieces.size(), payload.Length() * sizeof(WCHAR), hash);
+}
+
+bool HISTORY::Add(const WCHAR* text, size_t length)
+{
+    PIECE piece = {text, length};
+    return Add(&piece, 1, length * sizeof(WCHAR), HASH::Of(text, length * sizeof(WCHAR)));
+}
+
+bool HISTORY::Add(const PIECE* pieces, size_t count, size_t bytes, uint64_t value)
+{
+    if (bytes > budget) { return false; }
+    adds++;
+
+    uint32_t text = FindDuplicate(value, pieces, count, bytes);
+    if (text != NONE)
+    {
+        dedup_hits++;
+        Touch(text);
+    }
+    else
+    {
+        text = Store(pieces, count, bytes, value);
+    }
+    Remember(text);
+    return true;
+}
+
+void HISTORY::Remember(uint32_t text)
+{
+    texts[text].entries++;
+
+    // The oldest entry falls out of the ring. Its text goes away once nothing references it anymore
+    ENTRY& slot = ring[next_entry % ring.size()];
+    if (next_entry >= ring.size())
+    {
+        TEXT& old = texts[slot.text];
+        if (old.alive && old.generation == slot.generation && --old.entries == 0) { Free(slot.text); }
+    }
+    slot = {text, texts[text].generation};
+    next_entry++;
+}
+
+uint32_t HISTORY::FindDuplicate(uint64_t hash, const PIECE* pieces, size_t count, size_t bytes) const
+{
+    auto range = by_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const TEXT& candidate = texts[it->second];
+        if (candidate.payload || candidate.bytes != bytes) { continue; }
+
+        // Same hash and size, make sure it is really the same text
+        const unsigned char* stored = arena.get() + candidate.offset;
+        bool same = true;
+        for (size_t i = 0; i < count && same; i++)
+        {
+            size_t piece_bytes = pieces[i].length * sizeof(WCHAR);
+            same    = std::memcmp(stored, pieces[i].text, piece_bytes) == 0;
+            stored += piece_bytes;
+        }
+        if (same) { return it->second; }
+    }
+    return NONE;
+}
+
+uint32_t HISTORY::FindDuplicate(uint64_t hash, const PAYLOAD& payload) const
+{
+    auto range = by_hash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const PAYLOAD* candidate = texts[it->second].payload.get();
+        if (!candidate || candidate->Length() != payload.Length() || candidate->ChunkCount() != payload.ChunkCount()) { continue; }
+
+        // Same blocks, same text
+        bool same = true;
+        for (size_t i = 0; i < payload.ChunkCount() && same; i++)
+        {
+            size_t bytes, candidate_bytes;
+            const unsigned char* block = payload.Block(i, &bytes);
+            const unsigned char* stored = candidate->Block(i, &candidate_bytes);
+            same = bytes == candidate_bytes && std::memcmp(block, stored, bytes) == 0;
+        }
+        if (same) { return it->second; }
+    }
+    return NONE;
+}
+
+uint32_t HISTORY::Store(const PIECE* pieces, size_t count, size_t bytes, uint64_t hash)
+{
+    while (bytes_used + bytes > budget) { Evict(); }
+    if (top + bytes > budget) { Compact(budget); } // Enough space in total, but not in one piece
+    Grow(bytes);
+
+    const uint32_t text = NewText(bytes, hash);
+    texts[text].offset = top;
+
+    unsigned char* destination = arena.get() + top;
+    for (size_t i = 0; i < count; i++)
+    {
+        std::memcpy(destination, pieces[i].text, pieces[i].length * sizeof(WCHAR));
+        destination += pieces[i].length * sizeof(WCHAR);
+    }
+    top        += bytes;
+    bytes_used += bytes;
+    return text;
+}
+
+uint32_t HISTORY::NewText(size_t bytes, uint64_t hash)
+{
+    uint32_t text;
+    if (!free_texts.empty())
+    {
+        text = free_texts.back();
+        free_texts.pop_back();
+    }
+    else
+    {
+        text = static_cast<uint32_t>(texts.size());
+        texts.push_back({});
+    }
+
+    TEXT& stored = texts[text];
+    stored.offset  = 0;
+    stored.bytes   = bytes;
+    stored.hash    = hash;
+    stored.entries = 0;
+    stored.alive   = true;
+    stored.newer   = NONE;
+    stored.older   = NONE;
+
+    by_hash.emplace(hash, text);
+    Touch(text);
+    return text;
+}
+
+std::shared_ptr<const PAYLOAD> HISTORY::Recall(size_t n, std::shared_ptr<BUFFER_POOL> pool)
+{
+    if (n >= std::min(next_entry, ring.size())) { return nullptr; }
+
+    const ENTRY& entry = ring[(next_entry - 1 - n) % ring.size()];
+    TEXT& text = texts[entry.text];
+    if (!text.alive || text.generation != entry.generation) { return nullptr; } // evicted
+
+    Touch(entry.text);
+    if (text.payload) { return text.payload; }
+    return std::make_shared<const PAYLOAD>(reinterpret_cast<const WCHAR*>(arena.get() + text.offset), text.bytes / sizeof(WCHAR), std::move(pool));
+}
+
+void HISTORY::SetBudget(size_t new_budget)
+{
+    while (bytes_used > new_budget) { Evict(); }
+    Compact(new_budget);
+}
+
+HISTORY::STATS HISTORY::GetStats() const
+{
+    STATS stats = {};
+    stats.budget      = budget;
+    stats.capacity    = capacity;
+    stats.bytes_used  = bytes_used;
+    stats.texts       = texts.size() - free_texts.size();
+    stats.adds        = adds;
+    stats.dedup_hits  = dedup_hits;
+    stats.evictions   = evictions;
+    stats.compactions = compactions;
+    for (size_t n = 0; n < std::min(next_entry, ring.size()); n++)
+    {
+        const ENTRY& entry = ring[(next_entry - 1 - n) % ring.size()];
+        const TEXT&  text  = texts[entry.text];
+        if (text.alive && text.generation == entry.generation) { stats.entries++; }
+    }
+    return stats;
+}
+
+void HISTORY::Touch(uint32_t text)
+{
+    if (newest == text) { return; }
+    Unlink(text);
+    texts[text].older = newest;
+    texts[text].newer = NONE;
+    if (newest != NONE) { texts[newest].newer = text; }
+    newest = text;
+    if (oldest == NONE) { oldest = text; }
+}
+
+void HISTORY::Unlink(uint32_t text)
+{
+    TEXT& node = texts[text];
+    if (node.newer != NONE) { texts[node.newer].older = node.older; } else if (newest == text) { newest = node.older; }
+    if (node.older != NONE) { texts[node.older].newer = node.newer; } else if (oldest == text) { oldest = node.newer; }
+    node.newer = NONE;
+    node.older = NONE;
+}
+
+void HISTORY::Free(uint32_t text)
+{
+    TEXT& node = texts[text];
+    Unlink(text);
+
+    auto range = by_hash.equal_range(node.hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == text)
+        {
+            by_hash.erase(it);
+            break;
+        }
+    }
+
+    // The newest text in the arena can give its space back right away
+    if (node.payload) { node.payload.reset(); }
+    else if (node.offset + node.bytes == top) { top = node.offset; }
+    bytes_used -= node.bytes;
+    node.alive  = false;
+    node.generation++;
+    free_texts.push_back(text);
+}
+
+void HISTORY::Evict()
+{
+    Free(oldest);
+    evictions++;
+}
+
+void HISTORY::Grow(size_t bytes)
+{
+    if (top + bytes <= capacity) { return; }
+
+    // Doubling keeps the copies down to about the size of the arena in total
+    const size_t new_capacity = std::min(budget, std::max(top + bytes, capacity * 2));
+    std::unique_ptr<unsigned char[]> grown = std::make_unique_for_overwrite<unsigned char[]>(new_capacity);
+    if (top) { std::memcpy(grown.get(), arena.get(), top); }
+    arena    = std::move(grown);
+    capacity = new_capacity;
+}
+
+void HISTORY::Compact(size_t new_budget)
+{
+    // Moves all texts to the front in arena order. Needs a new arena if the budget shrinks below what is allocated
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < texts.size(); i++)
+    {
+        if (texts[i].alive && !texts[i].payload) { order.push_back(i); }
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return texts[a].offset < texts[b].offset; });
+
+    const size_t new_capacity = std::min(capacity, new_budget);
+    std::unique_ptr<unsigned char[]> target = new_capacity == capacity ? nullptr : std::make_unique_for_overwrite<unsigned char[]>(new_capacity);
+    unsigned char* destination = target ? target.get() : arena.get();
+    size_t offset = 0;
+    for (uint32_t text : order)
+    {
+        std::memmove(destination + offset, arena.get() + texts[text].offset, texts[text].bytes);
+        texts[text].offset = offset;
+        offset += texts[text].bytes;
+    }
+    if (target)
+    {
+        arena    = std::move(target);
+        capacity = new_capacity;
+    }
+    budget = new_budget;
+    top    = offset;
+    compactions++;
+}
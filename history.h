@@ -0,0 +1,129 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+#include "platform.h"
+#include "payload.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+Bounded history of clipboard texts.
+- Every text is stored once in a single arena. Copying the same text again only references the stored copy (found by HASH, confirmed by comparing the bytes).
+- The arena grows with the texts (doubling) and never past the byte budget. When a new text does not fit, the least recently used texts are evicted.
+  An empty history takes no arena at all, a window that never copies anything does not pay for the budget.
+- A compressed payload (PAYLOAD::Compress) is kept as it is instead of being copied, its blocks count against the budget.
+  It is hashed and compared by its blocks, so it is never decompressed. It is only deduplicated against other compressed payloads.
+- Entries are numbered by recency, Recall(0) is the newest. Evicted entries return nullptr.
+*/
+class HISTORY
+{
+public:
+
+    static constexpr size_t DEFAULT_BUDGET      = size_t(64) << 20; // 64 MB
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 128;
+
+    struct STATS
+    {
+        size_t budget;        // bytes the arena may use
+        size_t capacity;      // bytes the arena has allocated so far
+        size_t bytes_used;    // bytes of all stored texts
+        size_t texts;         // distinct texts stored
+        size_t entries;       // entries that can still be recalled
+        size_t adds;
+        size_t dedup_hits;
+        size_t evictions;
+        size_t compactions;
+    };
+
+    explicit HISTORY(size_t budget = DEFAULT_BUDGET, size_t max_entries = DEFAULT_MAX_ENTRIES);
+
+    // Adds the text as newest entry. Returns false if it is bigger than the whole budget
+    bool Add(std::shared_ptr<const PAYLOAD> payload);
+    bool Add(const PAYLOAD& payload);
+    bool Add(const WCHAR* text, size_t length);
+
+    // Same as Add(payload) with the hash already computed by Hash(), e.g. on another thread. Compressed payloads are only taken as shared_ptr
+    bool Add(const PAYLOAD& payload, uint64_t hash);
+    static uint64_t Hash(const PAYLOAD& payload);
+
+    // Entry n (0 = newest) or nullptr if there is no such entry (anymore). Text from the arena is copied into a new payload with chunks from pool
+    std::shared_ptr<const PAYLOAD> Recall(size_t n, std::shared_ptr<BUFFER_POOL> pool = nullptr);
+
+    // Changes the budget. Evicts until everything fits
+    void SetBudget(size_t budget);
+    size_t GetBudget() const { return budget; }
+
+    STATS GetStats() const;
+
+private:
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    // A piece of the text that is added, the payload chunks or one contiguous block
+    struct PIECE
+    {
+        const WCHAR* text;
+        size_t       length;
+    };
+
+    // A stored text. Doubly linked in LRU order
+    struct TEXT
+    {
+        std::shared_ptr<const PAYLOAD> payload; // a compressed text, kept outside the arena
+        size_t   offset;      // in the arena
+        size_t   bytes;
+        uint64_t hash;
+        uint32_t generation;  // bumped every time the slot is reused, stale entries detect it
+        uint32_t entries;     // number of ring entries referencing this text
+        uint32_t newer;
+        uint32_t older;
+        bool     alive;
+    };
+
+    struct ENTRY
+    {
+        uint32_t text;
+        uint32_t generation;
+    };
+
+    bool Add(const PIECE* pieces, size_t count, size_t bytes, uint64_t hash);
+    uint32_t FindDuplicate(uint64_t hash, const PIECE* pieces, size_t count, size_t bytes) const;
+    uint32_t FindDuplicate(uint64_t hash, const PAYLOAD& payload) const;
+    uint32_t Store(const PIECE* pieces, size_t count, size_t bytes, uint64_t hash);
+    uint32_t NewText(size_t bytes, uint64_t hash);
+
+    // Makes text the newest entry of the ring
+    void Remember(uint32_t text);
+    void Touch(uint32_t text);
+    void Unlink(uint32_t text);
+    void Free(uint32_t text);
+    void Evict();
+    void Compact(size_t new_budget);
+
+    // Makes room for bytes more at top
+    void Grow(size_t bytes);
+
+    std::unique_ptr<unsigned char[]> arena;
+    size_t capacity = 0;
+    size_t budget;
+    size_t top        = 0; // end of the last stored text in the arena
+    size_t bytes_used = 0;
+
+    std::vector<TEXT>     texts;
+    std::vector<uint32_t> free_texts;
+    std::unordered_multimap<uint64_t, uint32_t> by_hash;
+    uint32_t newest = NONE;
+    uint32_t oldest = NONE;
+
+    // Ring of entries, next_entry counts all adds ever made
+    std::vector<ENTRY> ring;
+    size_t next_entry = 0;
+
+    size_t adds        = 0;
+    size_t dedup_hits  = 0;
+    size_t evictions   = 0;
+    size_t compactions = 0;
+};
+
+#endif // HISTORY_H
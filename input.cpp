@@ -0,0 +1,116 @@
+#include "input.h"
+
+namespace
+{
+    // Messages a user makes, they must not overtake a move made before them
+    bool IsInput(UINT message)
+    {
+        return (message >= WM_KEYFIRST && message <= WM_KEYLAST) || (message >= WM_MOUSEFIRST && message <= WM_MOUSELAST)
+            || message == WM_MOUSEHOVER || message == WM_MOUSELEAVE;
+    }
+}
+
+void MOUSE_INPUT::Attach(TIMER_WHEEL* frame_timers, std::function<void(MSG&)> dispatch_move)
+{
+    Flush();
+    timers   = frame_timers;
+    dispatch = std::move(dispatch_move);
+}
+
+bool MOUSE_INPUT::Defer(MSG& msg)
+{
+    if (msg.message != WM_MOUSEMOVE)
+    {
+        if (has_waiting && IsInput(msg.message)) { Flush(); }
+        return false;
+    }
+    stats.received++;
+
+    // Posted moves are not merged by the system. Only the front of the queue, a filtered PeekMessage would pull moves past a click.
+    // Something posted between the two peeks comes out first (posted messages go before input), it is kept for the loop
+    MSG next;
+    while (!has_taken && PeekMessage(&next, NULL, 0, 0, PM_NOREMOVE) && next.message == WM_MOUSEMOVE && next.hwnd == msg.hwnd)
+    {
+        PeekMessage(&next, NULL, 0, 0, PM_REMOVE);
+        if (next.message != WM_MOUSEMOVE || next.hwnd != msg.hwnd)
+        {
+            taken     = next;
+            has_taken = true;
+            break;
+        }
+        msg = next;
+        stats.received++;
+        stats.coalesced++;
+    }
+    if (!timers) { return false; }
+
+    // A move of another window ends the frame of the one before
+    if (has_waiting && waiting.hwnd != msg.hwnd) { Flush(); }
+    if (has_waiting)
+    {
+        waiting = msg;
+        stats.coalesced++;
+        return true;
+    }
+
+    const uint64_t now = TIMER_WHEEL::Now();
+    if (now - last_handled >= FRAME_NS)
+    {
+        last_handled = now;
+        return false;
+    }
+    waiting     = msg;
+    has_waiting = true;
+    frame_end   = timers->ScheduleAt(last_handled + FRAME_NS, [this] { Flush(); });
+    return true;
+}
+
+bool MOUSE_INPUT::TakeOther(MSG& msg)
+{
+    if (!has_taken) { return false; }
+    has_taken = false;
+    msg = taken;
+    return true;
+}
+
+void MOUSE_INPUT::Flush()
+{
+    if (!has_waiting) { return; }
+    has_waiting = false;
+
+    // Cancel fails when the timer itself called this, it is gone already
+    timers->Cancel(frame_end);
+    frame_end    = 0;
+    last_handled = TIMER_WHEEL::Now();
+    stats.deferred++;
+    MSG move = waiting;
+    dispatch(move);
+}
+
+bool MOUSE_INPUT::OnMove(HWND hWnd)
+{
+    stats.handled++;
+    if (state == STATE::TRACKING) { return true; }
+
+    // Leave tracking is still armed after a hover, asking for it again does not hurt
+    TRACKMOUSEEVENT tme = {};
+    tme.cbSize      = sizeof(tme);
+    tme.dwFlags     = TME_HOVER | TME_LEAVE;
+    tme.hwndTrack   = hWnd;
+    tme.dwHoverTime = 0;
+    stats.track_calls++;
+    if (!TrackMouseEvent(&tme)) { return false; }
+    state = STATE::TRACKING;
+    return true;
+}
+
+void MOUSE_INPUT::OnHover()
+{
+    if (state == STATE::TRACKING) { state = STATE::HOVERED; }
+}
+
+void MOUSE_INPUT::OnLeave()
+{
+    // The system cancelled all tracking when it posted WM_MOUSELEAVE
+    state = STATE::OUTSIDE;
+}
@@ -0,0 +1,81 @@
+#ifndef INPUT_H
+#define INPUT_H
+#include "platform.h"
+#include "timerwheel.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/*
+Mouse input of one window.
+
+Hover and leave tracking is armed with TrackMouseEvent once when the cursor enters the window and once again after every WM_MOUSEHOVER
+(hover tracking ends when the hover message is posted, leave tracking when the leave message is posted). Moves in between cost no system call.
+
+Windows already merges the moves that wait in the queue, a loop that keeps up still gets one WM_MOUSEMOVE per mouse report (1000 Hz for gaming mice).
+So moves are handled at most once a frame: the first move after a quiet frame goes out right away, the ones after it wait for the end of the frame
+on a timer and only the newest of them is dispatched. Any other input dispatches the waiting move first, so clicks and keys see the position they were made at.
+Posted moves are not merged by the system, the ones right behind the move the loop got are taken with it.
+The positions in between are dropped, GetMouseMovePointsEx would give them back to a handler that draws the path.
+Only the thread of the window may use it.
+*/
+class MOUSE_INPUT
+{
+public:
+
+    enum class STATE
+    {
+        OUTSIDE,   // Nothing armed, the next move arms hover and leave tracking
+        TRACKING,  // Waiting for WM_MOUSEHOVER or WM_MOUSELEAVE
+        HOVERED,   // Hover fired, only leave tracking is left. The next move arms hover again
+    };
+
+    struct STATS
+    {
+        size_t received;     // WM_MOUSEMOVEs the loop took out of the queue
+        size_t coalesced;    // of these, replaced by a newer one and never dispatched
+        size_t deferred;     // dispatched at the end of a frame or before other input instead of right away
+        size_t handled;      // moves that reached OnMove
+        size_t track_calls;  // TrackMouseEvent calls
+    };
+
+    static constexpr uint64_t FRAME_NS = 16666667; // 60 Hz
+
+    // Timers that end the frames and the function that dispatches a move like the loop does. Until then every move is dispatched right away
+    void Attach(TIMER_WHEEL* timers, std::function<void(MSG&)> dispatch);
+
+    // msg was just taken out of the queue. If it is a move, the moves of the same window right behind it are taken too and msg becomes the newest.
+    // True if that waits for the end of the frame, the loop must not dispatch it then. Any other input dispatches the waiting move first
+    bool Defer(MSG& msg);
+
+    // A message Defer took out of the queue that was no move of the window. The loop handles it next, like one it got itself
+    bool TakeOther(MSG& msg);
+
+    // Dispatches the waiting move now, if there is one
+    void Flush();
+
+    // Arms tracking if nothing is armed. Returns false if TrackMouseEvent failed
+    bool OnMove(HWND hWnd);
+    void OnHover();
+    void OnLeave();
+
+    STATE GetState() const { return state; }
+    STATS GetStats() const { return stats; }
+    void ResetStats() { stats = {}; }
+
+private:
+
+    STATE state = STATE::OUTSIDE;
+    STATS stats = {};
+
+    TIMER_WHEEL*               timers = nullptr;
+    std::function<void(MSG&)>  dispatch;
+    MSG                        waiting     = {};
+    bool                       has_waiting = false;
+    TIMER_WHEEL::TIMER         frame_end   = 0;
+    uint64_t                   last_handled = 0;   // TIMER_WHEEL::Now() of the last move that went out
+    MSG                        taken       = {};
+    bool                       has_taken   = false;
+};
+
+#endif // INPUT_H
@@ -0,0 +1,200 @@
+#include "layout.h"
+#include <algorithm>
+#include <cmath>
+
+int LAYOUT::Root(int padding, int gap)
+{
+    nodes.clear();
+    moved.clear();
+    return Add(NONE, KIND::COLUMN, Flex(), Flex(), padding, gap, NULL);
+}
+
+int LAYOUT::Row(int parent, LENGTH width, LENGTH height, int padding, int gap)
+{
+    return Add(parent, KIND::ROW, width, height, padding, gap, NULL);
+}
+
+int LAYOUT::Column(int parent, LENGTH width, LENGTH height, int padding, int gap)
+{
+    return Add(parent, KIND::COLUMN, width, height, padding, gap, NULL);
+}
+
+int LAYOUT::Control(int parent, HWND hWnd, LENGTH width, LENGTH height)
+{
+    return Add(parent, KIND::LEAF, width, height, 0, 0, hWnd);
+}
+
+int LAYOUT::Spacer(int parent, LENGTH width, LENGTH height)
+{
+    return Add(parent, KIND::LEAF, width, height, 0, 0, NULL);
+}
+
+int LAYOUT::Add(int parent, KIND kind, LENGTH width, LENGTH height, int padding, int gap, HWND hWnd)
+{
+    int index = static_cast<int>(nodes.size());
+    NODE node = {};
+    node.kind    = kind;
+    node.width   = width;
+    node.height  = height;
+    node.padding = padding;
+    node.gap     = gap;
+    node.hWnd    = hWnd;
+    node.parent  = parent;
+    nodes.push_back(node);
+
+    if (parent != NONE)
+    {
+        // Append to the children of parent, the siblings move so parent has to be laid out again
+        NODE& parent_node = nodes[parent];
+        if (parent_node.last_child == NONE) { parent_node.first_child = index; }
+        else { nodes[parent_node.last_child].next_sibling = index; }
+        parent_node.last_child = index;
+        Invalidate(parent);
+    }
+    return index;
+}
+
+void LAYOUT::SetSize(int node, LENGTH width, LENGTH height)
+{
+    nodes[node].width  = width;
+    nodes[node].height = height;
+    Invalidate(nodes[node].parent != NONE ? nodes[node].parent : node);
+}
+
+void LAYOUT::SetScale(float new_scale)
+{
+    if (new_scale == scale) { return; }
+    scale = new_scale;
+    // Every size changes, so everything is laid out again
+    for (NODE& node : nodes) { node.dirty = true; }
+}
+
+void LAYOUT::Invalidate(int node)
+{
+    nodes[node].dirty = true;
+    // Ancestors that are already marked have their ancestors marked as well
+    for (int parent = nodes[node].parent; parent != NONE && !nodes[parent].child_dirty; parent = nodes[parent].parent)
+    {
+        nodes[parent].child_dirty = true;
+    }
+}
+
+int LAYOUT::Scale(int pixels) const
+{
+    return static_cast<int>(std::lround(pixels * scale));
+}
+
+size_t LAYOUT::Resize(int new_width, int new_height)
+{
+    width  = new_width;
+    height = new_height;
+    if (nodes.empty()) { return 0; }
+    size_t solved = 0;
+    Solve(0, {0, 0, width, height}, &solved);
+    return solved;
+}
+
+void LAYOUT::Solve(int index, const RECT& rect, size_t* solved)
+{
+    NODE& node = nodes[index];
+    bool changed = rect.left != node.rect.left || rect.top != node.rect.top || rect.right != node.rect.right || rect.bottom != node.rect.bottom;
+
+    if (!changed && !node.dirty)
+    {
+        // Same place as last time, only walk down to the dirty nodes below
+        if (node.child_dirty)
+        {
+            for (int child = node.first_child; child != NONE; child = nodes[child].next_sibling)
+            {
+                if (nodes[child].dirty || nodes[child].child_dirty) { Solve(child, nodes[child].rect, solved); }
+            }
+            node.child_dirty = false;
+        }
+        return;
+    }
+
+    (*solved)++;
+    node.rect        = rect;
+    node.dirty       = false;
+    node.child_dirty = false;
+    if (changed && node.hWnd && !node.moved)
+    {
+        node.moved = true;
+        moved.push_back(index);
+    }
+    if (node.kind == KIND::LEAF) { return; }
+
+    // Space inside the padding. Main is the direction the children are lined up in
+    const bool row     = node.kind == KIND::ROW;
+    const int  padding = Scale(node.padding);
+    const int  gap     = Scale(node.gap);
+    const RECT inner   = {rect.left + padding, rect.top + padding, rect.right - padding, rect.bottom - padding};
+    const int  main    = std::max(0, row ? inner.right - inner.left : inner.bottom - inner.top);
+    const int  cross   = std::max(0, row ? inner.bottom - inner.top : inner.right - inner.left);
+
+    int   fixed_total = 0;
+    float flex_total  = 0.0f;
+    int   count       = 0;
+    for (int child = node.first_child; child != NONE; child = nodes[child].next_sibling)
+    {
+        const LENGTH& length = row ? nodes[child].width : nodes[child].height;
+        if (length.flex > 0.0f) { flex_total += length.flex; } else { fixed_total += Scale(length.pixels); }
+        count++;
+    }
+    const int remaining = std::max(0, main - fixed_total - gap * std::max(0, count - 1));
+
+    int   position    = row ? inner.left : inner.top;
+    float flex_before = 0.0f;
+    for (int child = node.first_child; child != NONE; child = nodes[child].next_sibling)
+    {
+        const LENGTH& main_length  = row ? nodes[child].width : nodes[child].height;
+        const LENGTH& cross_length = row ? nodes[child].height : nodes[child].width;
+
+        int size;
+        if (main_length.flex > 0.0f)
+        {
+            // Rounded from the running total, so the flex nodes fill the remaining space without gaps
+            int begin    = static_cast<int>(std::lround(remaining * flex_before / flex_total));
+            flex_before += main_length.flex;
+            size         = static_cast<int>(std::lround(remaining * flex_before / flex_total)) - begin;
+        }
+        else
+        {
+            size = Scale(main_length.pixels);
+        }
+        const int cross_size = cross_length.flex > 0.0f ? cross : Scale(cross_length.pixels);
+
+        RECT child_rect = row ? RECT{position, inner.top, position + size, inner.top + cross_size}
+                              : RECT{inner.left, position, inner.left + cross_size, position + size};
+        Solve(child, child_rect, solved);
+        position += size + gap;
+    }
+}
+
+size_t LAYOUT::Apply()
+{
+    if (moved.empty()) { return 0; }
+
+    // One batch, so windows repaints once instead of once per control
+    HDWP batch = BeginDeferWindowPos(static_cast<int>(moved.size()));
+    for (int index : moved)
+    {
+        NODE& node = nodes[index];
+        node.moved = false;
+        if (batch) { batch = DeferWindowPos(batch, node.hWnd, NULL, node.rect.left, node.rect.top, node.rect.right - node.rect.left, node.rect.bottom - node.rect.top, SWP_NOZORDER | SWP_NOACTIVATE); }
+    }
+    if (batch) { EndDeferWindowPos(batch); }
+    else
+    {
+        // The batch failed (e.g. one of the controls is gone) and was dropped, move them one by one
+        for (int index : moved)
+        {
+            const NODE& node = nodes[index];
+            SetWindowPos(node.hWnd, NULL, node.rect.left, node.rect.top, node.rect.right - node.rect.left, node.rect.bottom - node.rect.top, SWP_NOZORDER | SWP_NOACTIVATE);
+        }
+    }
+
+    size_t count = moved.size();
+    moved.clear();
+    return count;
+}
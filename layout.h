@@ -0,0 +1,101 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+#include "platform.h"
+#include <vector>
+
+/*
+Declarative layout of the controls of a window.
+The layout is a tree of rows and columns. Every node has a width and a height that is either fixed (pixels at 96 DPI) or a flex weight.
+Fixed sizes are taken first, the space that is left is split between the flex nodes by their weight. Flex in the cross direction means stretch.
+
+    int root    = layout.Root(10, 5);                                                // Column with 10 px padding and 5 px gap
+    int edit    = layout.Control(root, edit_handle, LAYOUT::Flex(), LAYOUT::Fixed(50));
+    int buttons = layout.Row(root, LAYOUT::Flex(), LAYOUT::Fixed(30));
+    ...
+    layout.Resize(width, height);                                                    // On WM_SIZE
+    layout.Apply();
+
+Resize only recomputes the subtrees whose rectangle changed or that were invalidated, Apply moves only the controls that moved, all in one DeferWindowPos batch.
+Solving does not touch any window, so the same tree can be solved headless.
+*/
+class LAYOUT
+{
+public:
+
+    struct LENGTH
+    {
+        int   pixels;
+        float flex;   // > 0 means flex
+    };
+
+    static constexpr LENGTH Fixed(int pixels) { return {pixels, 0.0f}; }
+    static constexpr LENGTH Flex(float weight = 1.0f) { return {0, weight}; }
+
+    static constexpr int NONE = -1;
+
+    // The root is a column that fills the whole client area
+    int Root(int padding = 0, int gap = 0);
+
+    int Row(int parent, LENGTH width, LENGTH height, int padding = 0, int gap = 0);
+    int Column(int parent, LENGTH width, LENGTH height, int padding = 0, int gap = 0);
+
+    // A control that gets moved to the rectangle of its node
+    int Control(int parent, HWND hWnd, LENGTH width, LENGTH height);
+
+    // Empty space
+    int Spacer(int parent, LENGTH width, LENGTH height);
+
+    // Changes the size of a node. Only its parent gets laid out again
+    void SetSize(int node, LENGTH width, LENGTH height);
+
+    // DPI scale (1.0 = 96 DPI). Every size, padding and gap is multiplied by it
+    void SetScale(float scale);
+
+    // Solves the tree for a client area of width x height. Returns the number of nodes that were recomputed
+    size_t Resize(int width, int height);
+
+    // Moves all controls whose rectangle changed since the last Apply. Returns the number of moved controls
+    size_t Apply();
+
+    RECT GetRect(int node) const { return nodes[node].rect; }
+    size_t NodeCount() const { return nodes.size(); }
+
+private:
+
+    enum class KIND { ROW, COLUMN, LEAF };
+
+    struct NODE
+    {
+        KIND   kind;
+        LENGTH width;
+        LENGTH height;
+        int    padding;
+        int    gap;
+        HWND   hWnd;
+        int    parent;
+        int    first_child  = NONE;
+        int    last_child   = NONE;
+        int    next_sibling = NONE;
+        RECT   rect         = {0, 0, 0, 0};
+        bool   dirty        = true;  // The children have to be laid out again
+        bool   child_dirty  = false; // Some node below is dirty
+        bool   moved        = false; // Waiting for Apply
+    };
+
+    int Add(int parent, KIND kind, LENGTH width, LENGTH height, int padding, int gap, HWND hWnd);
+
+    // Marks node for layout and its ancestors so Resize finds it
+    void Invalidate(int node);
+
+    void Solve(int node, const RECT& rect, size_t* solved);
+
+    int Scale(int pixels) const;
+
+    std::vector<NODE> nodes;
+    std::vector<int>  moved;   // Controls waiting for Apply
+    float             scale  = 1.0f;
+    int               width  = 0;
+    int               height = 0;
+};
+
+#endif // LAYOUT_H
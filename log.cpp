@@ -0,0 +1,353 @@
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<uint8_t> LOG::min_level{LOG::LEVEL_INFO};
+
+/*
+The rings and the background thread that empties them.
+A ring belongs to one thread (the producer), only the writer thread consumes it. head and tail live on their own cache lines.
+When the thread ends its ring goes back to the free list and the next new thread that logs takes it over, records that were not written yet included.
+Programs that start a thread per window or per job keep as many rings as threads log at the same time, not one per thread that ever logged.
+After a burst of such threads the writer frees what is on the free list beyond MAX_FREE_RINGS, once it has written out their records.
+*/
+class LOG_WRITER
+{
+public:
+
+    struct alignas(64) RING
+    {
+        std::atomic<size_t> head{0};           // Next slot the producer writes
+        size_t              cached_tail = 0;   // Producer's copy of tail, so it only reads the shared one when the ring looks full
+        alignas(64) std::atomic<size_t> tail{0}; // Next slot the writer reads
+        std::atomic<size_t> dropped{0};
+        LOG::RECORD         records[LOG::RING_RECORDS];
+    };
+
+    enum class SINK { CONSOLE, FILE, DISCARD };
+
+    // Rings of finished threads kept for the next ones, the rest is freed
+    static constexpr size_t MAX_FREE_RINGS = 8;
+
+    static LOG_WRITER& Instance()
+    {
+        // Never destroyed, threads may log while static objects are destroyed. The writer thread is stopped by SHUTDOWN below
+        static LOG_WRITER* writer = new LOG_WRITER();
+        return *writer;
+    }
+
+    // Ring for the calling thread, one a finished thread gave back if there is one. The writer thread starts with the first one
+    RING* AddRing()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free_rings.empty())
+        {
+            // head and cached_tail were left by the previous owner, the lock orders its last Publish before our first Reserve
+            RING* ring = free_rings.back();
+            free_rings.pop_back();
+            return ring;
+        }
+        rings.push_back(std::make_unique<RING>());
+        if (!thread.joinable() && !stopped) { thread = std::thread(&LOG_WRITER::Run, this); }
+        return rings.back().get();
+    }
+
+    // The owner of ring exits. The writer keeps draining it
+    void ReleaseRing(RING* ring)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_rings.push_back(ring);
+    }
+
+    void SetSink(SINK new_sink, FILE* new_file)
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        if (file) { std::fclose(file); }
+        sink = new_sink;
+        file = new_file;
+    }
+
+    void Flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!thread.joinable()) { return; }
+        // The pass that is running right now may have passed our ring already, so wait for the one after it
+        size_t target = drained + 2;
+        flush_requested = true;
+        wake.notify_all();
+        done.wait(lock, [&] { return drained >= target || !thread.joinable(); });
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+            wake.notify_all();
+        }
+        if (thread.joinable()) { thread.join(); }
+        SetSink(SINK::DISCARD, nullptr);
+    }
+
+    LOG::STATS GetStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        LOG::STATS stats = {};
+        stats.written = written.load(std::memory_order_relaxed);
+        stats.threads = rings.size() - free_rings.size();
+        for (auto& ring : rings) { stats.dropped += ring->dropped.load(std::memory_order_relaxed); }
+        return stats;
+    }
+
+private:
+
+    void Run()
+    {
+        // Everything that waits less than this gets written in one go
+        constexpr auto IDLE_WAIT = std::chrono::milliseconds(10);
+
+        std::vector<RING*> snapshot;
+        std::wstring       batch;
+        bool               stopping = false;
+        while (!stopping)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_for(lock, IDLE_WAIT, [&] { return stopped || flush_requested; });
+                stopping        = stopped;
+                flush_requested = false;
+                snapshot.clear();
+                for (auto& ring : rings) { snapshot.push_back(ring.get()); }
+            }
+
+            batch.clear();
+            for (RING* ring : snapshot) { Drain(*ring, batch); }
+            if (!batch.empty()) { WriteBatch(batch); }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                drained++;
+                FreeRings();
+            }
+            done.notify_all();
+        }
+    }
+
+    // Frees free rings beyond MAX_FREE_RINGS that have nothing left to write. Between passes, with the lock, no snapshot points at them
+    void FreeRings()
+    {
+        while (free_rings.size() > MAX_FREE_RINGS)
+        {
+            RING* ring = free_rings.back();
+            if (ring->tail.load(std::memory_order_relaxed) != ring->head.load(std::memory_order_relaxed)) { return; } // next pass
+            free_rings.pop_back();
+            rings.erase(std::find_if(rings.begin(), rings.end(), [&](const std::unique_ptr<RING>& owned) { return owned.get() == ring; }));
+        }
+    }
+
+    void Drain(RING& ring, std::wstring& batch)
+    {
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        size_t head = ring.head.load(std::memory_order_acquire);
+        for (; tail != head; tail++)
+        {
+            Format(ring.records[tail % LOG::RING_RECORDS], batch);
+            written.fetch_add(1, std::memory_order_relaxed);
+        }
+        ring.tail.store(tail, std::memory_order_release);
+    }
+
+    static void Format(const LOG::RECORD& record, std::wstring& out)
+    {
+        static const wchar_t* const LEVELS[] = {L"DEBUG", L"INFO ", L"WARN ", L"ERROR", L"OFF  "};
+        wchar_t number[64];
+        std::swprintf(number, 64, L"%10.3f ", record.time_ns / 1e9);
+        out += number;
+        out += LEVELS[std::min<int>(record.level, LOG::LEVEL_OFF)];
+
+        for (uint8_t i = 0; i < record.fields; i++)
+        {
+            const LOG::FIELD& field = record.field[i];
+            out += L' ';
+            switch (field.type)
+            {
+                case LOG::TYPE::INT:     std::swprintf(number, 64, L"%lld", (long long)field.i); out += number; break;
+                case LOG::TYPE::UINT:    std::swprintf(number, 64, L"%llu", (unsigned long long)field.u); out += number; break;
+                case LOG::TYPE::FLOAT:   std::swprintf(number, 64, L"%g", field.f); out += number; break;
+                case LOG::TYPE::POINTER: std::swprintf(number, 64, L"0x%llx", (unsigned long long)(uintptr_t)field.p); out += number; break;
+                case LOG::TYPE::LITERAL: out += field.literal ? field.literal : L"(null)"; break;
+                case LOG::TYPE::NARROW_LITERAL:
+                    for (const char* c = field.narrow ? field.narrow : "(null)"; *c; c++) { out += static_cast<wchar_t>(static_cast<unsigned char>(*c)); }
+                    break;
+                case LOG::TYPE::TEXT:    out.append(record.text + field.text.offset, field.text.length); break;
+            }
+        }
+        out += L'\n';
+    }
+
+    void WriteBatch(const std::wstring& batch)
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        switch (sink)
+        {
+            case SINK::CONSOLE:
+                // One flush per batch instead of one per line
+                std::wcout << batch;
+                std::wcout.flush();
+                break;
+            case SINK::FILE:
+            {
+                std::string utf8 = ToUtf8(batch);
+                std::fwrite(utf8.data(), 1, utf8.size(), file);
+                std::fflush(file);
+                break;
+            }
+            case SINK::DISCARD:
+                break;
+        }
+    }
+
+    static std::string ToUtf8(const std::wstring& text)
+    {
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            uint32_t c = static_cast<uint32_t>(text[i]);
+            // Surrogate pairs when wchar_t is 16 bit (windows)
+            if (c >= 0xD800 && c < 0xDC00 && i + 1 < text.size() && text[i + 1] >= 0xDC00 && text[i + 1] < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<uint32_t>(text[++i]) - 0xDC00);
+            }
+            if (c < 0x80)         { out += static_cast<char>(c); }
+            else if (c < 0x800)   { out += static_cast<char>(0xC0 | (c >> 6)); out += static_cast<char>(0x80 | (c & 0x3F)); }
+            else if (c < 0x10000) { out += static_cast<char>(0xE0 | (c >> 12)); out += static_cast<char>(0x80 | ((c >> 6) & 0x3F)); out += static_cast<char>(0x80 | (c & 0x3F)); }
+            else
+            {
+                out += static_cast<char>(0xF0 | (c >> 18));
+                out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
+        return out;
+    }
+
+    std::mutex                         mutex;        // rings, thread state
+    std::condition_variable            wake;
+    std::condition_variable            done;
+    std::vector<std::unique_ptr<RING>> rings;
+    std::vector<RING*>                 free_rings;   // of threads that ended
+    std::thread                        thread;
+    bool                               stopped         = false;
+    bool                               flush_requested = false;
+    size_t                             drained         = 0;
+    std::atomic<size_t>                written{0};
+
+    std::mutex sink_mutex;
+    SINK       sink = SINK::CONSOLE;
+    FILE*      file = nullptr;
+};
+
+namespace
+{
+    thread_local LOG_WRITER::RING* t_ring = nullptr;
+    thread_local size_t            t_head = 0;  // Slot Reserve handed out, Publish makes it visible
+    thread_local bool              t_exited = false;
+
+    // Gives the ring of the thread back when it ends. Only constructed by threads that log, so the fast path keeps plain thread_locals
+    struct RING_RETURN
+    {
+        ~RING_RETURN()
+        {
+            LOG_WRITER::Instance().ReleaseRing(t_ring);
+            t_ring   = nullptr;
+            t_exited = true;
+        }
+    };
+
+    const auto origin = std::chrono::steady_clock::now();
+
+    // Writes what is left and stops the thread when the program exits
+    struct SHUTDOWN
+    {
+        ~SHUTDOWN() { LOG_WRITER::Instance().Stop(); }
+    } log_shutdown;
+}
+
+LOG::RECORD* LOG::Reserve()
+{
+    if (!t_ring)
+    {
+        t_ring = LOG_WRITER::Instance().AddRing();
+        // A destructor of another thread_local that logs after ours ran keeps its ring, there is nothing left to return it
+        if (!t_exited) { thread_local RING_RETURN ring_return; }
+    }
+    LOG_WRITER::RING& ring = *t_ring;
+
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.cached_tail >= RING_RECORDS)
+    {
+        ring.cached_tail = ring.tail.load(std::memory_order_acquire);
+        if (head - ring.cached_tail >= RING_RECORDS)
+        {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+    }
+    t_head = head;
+    RECORD& record = ring.records[head % RING_RECORDS];
+    record.time_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+    return &record;
+}
+
+void LOG::Publish()
+{
+    t_ring->head.store(t_head + 1, std::memory_order_release);
+}
+
+void LOG::AddText(RECORD& record, FIELD& field, std::wstring_view text)
+{
+    // Texts share the buffer of the record, whatever does not fit is cut off
+    size_t length     = std::min(text.size(), TEXT_CHARS - record.text_used);
+    field.type        = TYPE::TEXT;
+    field.text.offset = record.text_used;
+    field.text.length = static_cast<uint16_t>(length);
+    std::copy(text.begin(), text.begin() + length, record.text + record.text_used);
+    record.text_used  = static_cast<uint16_t>(record.text_used + length);
+}
+
+void LOG::ToConsole()
+{
+    LOG_WRITER::Instance().SetSink(LOG_WRITER::SINK::CONSOLE, nullptr);
+}
+
+bool LOG::ToFile(const char* path)
+{
+    FILE* file = std::fopen(path, "ab");
+    if (!file) { return false; }
+    LOG_WRITER::Instance().SetSink(LOG_WRITER::SINK::FILE, file);
+    return true;
+}
+
+void LOG::Discard()
+{
+    LOG_WRITER::Instance().SetSink(LOG_WRITER::SINK::DISCARD, nullptr);
+}
+
+void LOG::Flush()
+{
+    LOG_WRITER::Instance().Flush();
+}
+
+LOG::STATS LOG::GetStats()
+{
+    return LOG_WRITER::Instance().GetStats();
+}
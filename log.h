@@ -0,0 +1,131 @@
+#ifndef LOG_H
+#define LOG_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/*
+Asynchronous logger. Handlers only copy a record into a ring, a background thread formats it and writes it to the console or a file.
+
+    LOG_INFO(L"Clipboard set to", length, L"characters");
+    LOG_ERROR(L"TrackMouseEvent failed. Errnum =", GetLastError());
+
+The arguments are stored as fields and printed separated by spaces. Numbers and pointers are stored by value.
+const wchar_t* and const char* arguments are stored as pointers, so they have to be string literals. Anything else goes in as std::wstring/std::wstring_view and gets copied (up to TEXT_CHARS characters per record).
+
+Every thread that logs gets its own single producer single consumer ring, so writing a record never locks and never waits for I/O.
+When a ring is full the record is dropped and counted instead of blocking the UI thread.
+*/
+class LOG
+{
+public:
+
+    // Prefixed, windows.h defines ERROR
+    enum LEVEL : uint8_t { LEVEL_DEBUG, LEVEL_INFO, LEVEL_WARN, LEVEL_ERROR, LEVEL_OFF };
+
+    static constexpr size_t RING_RECORDS = 1024;  // per thread
+    static constexpr size_t MAX_FIELDS   = 6;
+    static constexpr size_t TEXT_CHARS   = 48;
+
+    struct STATS
+    {
+        size_t written;  // records the background thread wrote
+        size_t dropped;  // records that did not fit into their ring
+        size_t threads;  // threads that logged and are still running
+    };
+
+    // Records below level are skipped before anything gets copied. Default INFO
+    static void SetLevel(LEVEL level) { min_level.store(level, std::memory_order_relaxed); }
+    static bool Enabled(LEVEL level) { return level >= min_level.load(std::memory_order_relaxed); }
+
+    // Where the records go. Can be switched any time, e.g. after the console got detached with FreeConsole
+    static void ToConsole();
+    static bool ToFile(const char* path); // Appends as UTF-8. Returns false if the file can not be opened
+    static void Discard();
+
+    // Blocks until everything logged before the call is written
+    static void Flush();
+
+    static STATS GetStats();
+
+    template<class... A>
+    static void Write(LEVEL level, const A&... args)
+    {
+        static_assert(sizeof...(A) <= MAX_FIELDS, "Too many fields for one record");
+        RECORD* record = Reserve();
+        if (!record) { return; }
+        record->level     = level;
+        record->fields    = 0;
+        record->text_used = 0;
+        (AddField(*record, args), ...);
+        Publish();
+    }
+
+private:
+
+    enum class TYPE : uint8_t { INT, UINT, FLOAT, POINTER, LITERAL, NARROW_LITERAL, TEXT };
+
+    struct FIELD
+    {
+        TYPE type;
+        union
+        {
+            int64_t        i;
+            uint64_t       u;
+            double         f;
+            const void*    p;
+            const wchar_t* literal;
+            const char*    narrow;
+            struct { uint16_t offset, length; } text;
+        };
+    };
+
+    struct RECORD
+    {
+        uint64_t time_ns;
+        LEVEL    level;
+        uint8_t  fields;
+        uint16_t text_used;
+        FIELD    field[MAX_FIELDS];
+        wchar_t  text[TEXT_CHARS];
+    };
+
+    template<class A>
+    static void AddField(RECORD& record, const A& value)
+    {
+        FIELD& field = record.field[record.fields++];
+        if constexpr (std::is_convertible_v<const A&, const wchar_t*>)   { field.type = TYPE::LITERAL;        field.literal = value; }
+        else if constexpr (std::is_convertible_v<const A&, const char*>) { field.type = TYPE::NARROW_LITERAL; field.narrow  = value; }
+        else if constexpr (std::is_convertible_v<const A&, std::wstring_view>) { AddText(record, field, value); }
+        else if constexpr (std::is_pointer_v<A>)                          { field.type = TYPE::POINTER;        field.p = value; }
+        else if constexpr (std::is_floating_point_v<A>)                   { field.type = TYPE::FLOAT;          field.f = value; }
+        else if constexpr (std::is_enum_v<A>)                             { field.type = TYPE::INT;            field.i = static_cast<int64_t>(value); }
+        else if constexpr (std::is_signed_v<A>)                           { field.type = TYPE::INT;            field.i = value; }
+        else
+        {
+            static_assert(std::is_integral_v<A>, "Unsupported log field type");
+            field.type = TYPE::UINT;
+            field.u    = value;
+        }
+    }
+
+    static void AddText(RECORD& record, FIELD& field, std::wstring_view text);
+
+    // Slot for the next record of the calling thread or nullptr if its ring is full
+    static RECORD* Reserve();
+    static void Publish();
+
+    friend class LOG_WRITER;
+
+    static std::atomic<uint8_t> min_level;
+};
+
+#define LOG_DEBUG(...) do { if (LOG::Enabled(LOG::LEVEL_DEBUG)) { LOG::Write(LOG::LEVEL_DEBUG, __VA_ARGS__); } } while (0)
+#define LOG_INFO(...)  do { if (LOG::Enabled(LOG::LEVEL_INFO))  { LOG::Write(LOG::LEVEL_INFO, __VA_ARGS__); } } while (0)
+#define LOG_WARN(...)  do { if (LOG::Enabled(LOG::LEVEL_WARN))  { LOG::Write(LOG::LEVEL_WARN, __VA_ARGS__); } } while (0)
+#define LOG_ERROR(...) do { if (LOG::Enabled(LOG::LEVEL_ERROR)) { LOG::Write(LOG::LEVEL_ERROR, __VA_ARGS__); } } while (0)
+
+#endif // LOG_H
@@ -0,0 +1,190 @@
+#include "lz.h"
+#include <bit>
+#include <cstring>
+
+namespace
+{
+    uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint64_t Read64(const uint8_t* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // Fibonacci hashing, the top bits are the best mixed
+    template<int BITS>
+    uint32_t HashOf(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - BITS);
+    }
+
+    // Length of the common prefix of a and b, stopping at limit (on the side of a)
+    size_t CommonLength(const uint8_t* a, const uint8_t* b, const uint8_t* limit)
+    {
+        const uint8_t* start = a;
+        while (a + 8 <= limit)
+        {
+            const uint64_t difference = Read64(a) ^ Read64(b);
+            if (difference)
+            {
+                // Little endian: the first differing byte is the lowest one
+                if constexpr (std::endian::native == std::endian::little) { return a - start + std::countr_zero(difference) / 8; }
+                else { return a - start + std::countl_zero(difference) / 8; }
+            }
+            a += 8;
+            b += 8;
+        }
+        while (a < limit && *a == *b) { a++; b++; }
+        return a - start;
+    }
+
+    // 15 in the token, then bytes of 255 and the rest
+    uint8_t* WriteLength(uint8_t* out, size_t length)
+    {
+        for (; length >= 255; length -= 255) { *out++ = 255; }
+        *out++ = static_cast<uint8_t>(length);
+        return out;
+    }
+
+    // Adds the extra length bytes that follow a nibble of 15. False if they run past end
+    bool ReadLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (in >= end) { return false; }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+size_t LZ::Compress(const void* source, size_t bytes, void* destination, size_t capacity)
+{
+    const uint8_t* const begin  = static_cast<const uint8_t*>(source);
+    const uint8_t* const end    = begin + bytes;
+    uint8_t*             out    = static_cast<uint8_t*>(destination);
+    uint8_t* const       out_end = out + capacity;
+    const uint8_t*       anchor = begin; // first literal not written yet
+
+    if (bytes > MATCH_LIMIT)
+    {
+        // Positions in the block. The table starts at 0, a wrong candidate is caught by comparing the bytes
+        uint32_t table[size_t(1) << HASH_BITS] = {};
+        const uint8_t* const last_start = end - MATCH_LIMIT;
+        const uint8_t* const match_end  = end - LAST_LITERALS;
+        const uint8_t* in = begin;
+        uint32_t misses = 1u << SKIP_TRIGGER;
+        while (in <= last_start)
+        {
+            const uint32_t sequence = Read32(in);
+            const uint32_t hash     = HashOf<HASH_BITS>(sequence);
+            const uint8_t* candidate = begin + table[hash];
+            table[hash] = static_cast<uint32_t>(in - begin);
+            if (candidate >= in || static_cast<size_t>(in - candidate) > MAX_OFFSET || Read32(candidate) != sequence)
+            {
+                in += misses++ >> SKIP_TRIGGER;
+                continue;
+            }
+
+            // The match may start earlier than where the hash found it
+            while (in > anchor && candidate > begin && in[-1] == candidate[-1]) { in--; candidate--; }
+            const size_t literals = in - anchor;
+            const size_t match    = MIN_MATCH + CommonLength(in + MIN_MATCH, candidate + MIN_MATCH, match_end);
+
+            // Token, both lengths with their extra bytes, the literals and the offset
+            if (out + 1 + literals / 255 + 1 + literals + 2 + (match - MIN_MATCH) / 255 + 1 > out_end) { return 0; }
+            uint8_t* token = out++;
+            if (literals >= 15) { *token = 15 << 4; out = WriteLength(out, literals - 15); } else { *token = static_cast<uint8_t>(literals << 4); }
+            std::memcpy(out, anchor, literals);
+            out += literals;
+            const size_t offset = in - candidate;
+            *out++ = static_cast<uint8_t>(offset);
+            *out++ = static_cast<uint8_t>(offset >> 8);
+            if (match - MIN_MATCH >= 15) { *token |= 15; out = WriteLength(out, match - MIN_MATCH - 15); } else { *token |= static_cast<uint8_t>(match - MIN_MATCH); }
+
+            in    += match;
+            anchor = in;
+            misses = 1u << SKIP_TRIGGER;
+
+            // The position just before the next search is often the start of the next match
+            if (in <= last_start) { table[HashOf<HASH_BITS>(Read32(in - 2))] = static_cast<uint32_t>(in - 2 - begin); }
+        }
+    }
+
+    // The rest as literals
+    const size_t literals = end - anchor;
+    if (out + 1 + literals / 255 + 1 + literals > out_end) { return 0; }
+    if (literals >= 15) { *out++ = 15 << 4; out = WriteLength(out, literals - 15); } else { *out++ = static_cast<uint8_t>(literals << 4); }
+    if (literals) { std::memcpy(out, anchor, literals); } // an empty block may have no source at all
+    out += literals;
+    return out - static_cast<uint8_t*>(destination);
+}
+
+size_t LZ::Decompress(const void* source, size_t bytes, void* destination, size_t capacity)
+{
+    const uint8_t*       in      = static_cast<const uint8_t*>(source);
+    const uint8_t* const in_end  = in + bytes;
+    uint8_t* const       begin   = static_cast<uint8_t*>(destination);
+    uint8_t*             out     = begin;
+    uint8_t* const       out_end = out + capacity;
+
+    for (;;)
+    {
+        if (in >= in_end) { return SIZE_MAX; }
+        const uint8_t token = *in++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !ReadLength(in, in_end, literals)) { return SIZE_MAX; }
+        if (literals > static_cast<size_t>(in_end - in) || literals > static_cast<size_t>(out_end - out)) { return SIZE_MAX; }
+
+        // Short runs are the common case, one fixed size copy when there is room for it
+        if (literals <= 16 && in_end - in >= 16 && out_end - out >= 16) { std::memcpy(out, in, 16); }
+        else { std::memcpy(out, in, literals); }
+        in  += literals;
+        out += literals;
+
+        // The last sequence has no match
+        if (in == in_end) { return out - begin; }
+
+        if (in_end - in < 2) { return SIZE_MAX; }
+        const size_t offset = in[0] | (size_t(in[1]) << 8);
+        in += 2;
+        if (offset == 0 || offset > static_cast<size_t>(out - begin)) { return SIZE_MAX; }
+
+        size_t match = token & 15;
+        if (match == 15 && !ReadLength(in, in_end, match)) { return SIZE_MAX; }
+        match += MIN_MATCH;
+        if (match > static_cast<size_t>(out_end - out)) { return SIZE_MAX; }
+
+        // Overlapping matches repeat the last offset bytes and have to be copied front to back.
+        // 16 bytes apart or more every 16 byte step reads what is already written
+        const uint8_t* from = out - offset;
+        if (offset >= 16)
+        {
+            size_t copied = 0;
+            if (static_cast<size_t>(out_end - out) >= match + 15)
+            {
+                for (; copied < match; copied += 16) { std::memcpy(out + copied, from + copied, 16); }
+            }
+            else
+            {
+                for (; copied + 16 <= match; copied += 16) { std::memcpy(out + copied, from + copied, 16); }
+                std::memcpy(out + copied, from + copied, match - copied);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < match; i++) { out[i] = from[i]; }
+        }
+        out += match;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef LZ_H
+#define LZ_H
+#include <cstddef>
+#include <cstdint>
+
+/*
+Fast block compression for text that sits in memory a long time (compressed clipboard payloads, see PAYLOAD::Compress).
+The output is the LZ4 block format: runs of literals and matches up to 64 KB back, no entropy coding. So it decompresses at memory speed and any LZ4 tool can read a block.
+Compression is a greedy single pass with a small hash table of 4 byte sequences. It speeds up over data that does not compress (the search steps grow), like LZ4 with acceleration 1.
+
+Blocks are independent, they can be compressed and decompressed on different threads. The size of the decompressed block is not stored, the caller keeps it.
+Blocks up to 4 GB.
+*/
+class LZ
+{
+public:
+
+    // Room Compress needs for bytes of input in the worst case, input that does not compress at all
+    static size_t Bound(size_t bytes) { return bytes + bytes / 255 + 16; }
+
+    // Compresses source into destination. Returns the compressed size, 0 if it does not fit into capacity
+    static size_t Compress(const void* source, size_t bytes, void* destination, size_t capacity);
+
+    // Returns the decompressed size, SIZE_MAX if source is not a valid block or does not fit into capacity. Never reads or writes outside the buffers
+    static size_t Decompress(const void* source, size_t bytes, void* destination, size_t capacity);
+
+private:
+
+    static constexpr size_t   MIN_MATCH     = 4;
+    static constexpr size_t   LAST_LITERALS = 5;      // the format ends every block with at least this many literals
+    static constexpr size_t   MATCH_LIMIT   = 12;     // and the last match starts at least this far from the end
+    static constexpr size_t   MAX_OFFSET    = 65535;
+    static constexpr int      HASH_BITS     = 12;     // 16 KB table on the stack, fits into L1
+    static constexpr uint32_t SKIP_TRIGGER  = 6;      // after 2^6 misses in a row the search steps 2 bytes, then 3...
+};
+
+#endif // LZ_H
@@ -1,14 +1,59 @@
 #include "gui.h"
+#include "trace.h"
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 int main() {
 
+    TRACE::StartFromEnvironment(); // Set GUI_TRACE=trace.json to see where the startup time goes
+
     int window_width    = 341; //-16 real size after borders and menubar
     int window_height   = 399; // -39
     LPCWSTR window_name = L"Jordans winapi demo";
 
     GUI gui;
-    gui.CreateMainWindow(window_width, window_height, window_name);
+    if (!gui.CreateMainWindow(window_width, window_height, window_name)) { std::wcout << "Could not create the window" << std::endl; return 1; }
+
+    // GUI_REPLAY=<file> plays a session recorded with GUI_RECORD as fast as possible and prints the handler times instead of running the loop
+    if (const char* replay_path = std::getenv("GUI_REPLAY"))
+    {
+        MESSAGE_REPLAY replay;
+        if (!replay.Load(replay_path)) { std::wcout << "Could not read " << replay_path << std::endl; return 1; }
+        auto speed = std::getenv("GUI_REPLAY_REALTIME") ? MESSAGE_REPLAY::SPEED::ORIGINAL : MESSAGE_REPLAY::SPEED::MAXIMUM;
+        MESSAGE_REPLAY::RESULT result = gui.Replay(replay, speed);
+        std::wcout << result.messages << " messages in " << result.elapsed_ns / 1e6 << " ms, " << result.skipped << " skipped" << std::endl;
+        std::ostringstream table;
+        gui.GetMessageStats().Write(table);
+        std::string text = table.str();
+        std::wcout << std::wstring(text.begin(), text.end()); // The log writes to std::wcout too, stay wide
+        return 0;
+    }
+
+    // GUI_STDIN=1 puts everything on stdin on the clipboard before the loop starts, e.g. "type big.log | win32_demo.exe"
+    if (std::getenv("GUI_STDIN"))
+    {
+        CLIPBOARD::STREAM_STATS stats;
+        if (!gui.SetClipboardToStream(GetStdHandle(STD_INPUT_HANDLE), &stats)) { std::wcout << "Could not read stdin" << std::endl; return 1; }
+        double seconds = stats.elapsed_ns / 1e9;
+        std::wcout << stats.bytes << " bytes, " << stats.characters << " characters in " << seconds * 1e3 << " ms ("
+                   << (seconds > 0 ? stats.bytes / 1e6 / seconds : 0) << " MB/s, " << (stats.mapped ? "mapped" : "read") << ")";
+        if (stats.errors) { std::wcout << ", " << stats.errors << " invalid sequences replaced"; }
+        std::wcout << std::endl;
+    }
+
+    // GUI_WINDOWS=<n> opens n - 1 more windows, each with its own thread and message loop. The program ends when all of them are closed
+    std::vector<std::thread> windows;
+    if (const char* count = std::getenv("GUI_WINDOWS"))
+    {
+        for (long i = 1; i < std::strtol(count, nullptr, 10); i++) { windows.push_back(GUI::Spawn(window_width, window_height, window_name)); }
+    }
+
     gui.RunMainLoop();
+    for (std::thread& window : windows) { window.join(); }
     
     return 0;
 };
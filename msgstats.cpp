@@ -0,0 +1,123 @@
+#include "msgstats.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+    // Names of the messages the GUI deals with, everything else is printed as a number
+    const char* MessageName(UINT message)
+    {
+        switch (message)
+        {
+            case WM_DESTROY:          return "WM_DESTROY";
+            case WM_SIZE:             return "WM_SIZE";
+            case WM_CLOSE:            return "WM_CLOSE";
+            case WM_QUIT:             return "WM_QUIT";
+            case WM_COMMAND:          return "WM_COMMAND";
+            case WM_TIMER:            return "WM_TIMER";
+            case WM_MOUSEMOVE:        return "WM_MOUSEMOVE";
+            case WM_MOUSEHOVER:       return "WM_MOUSEHOVER";
+            case WM_MOUSELEAVE:       return "WM_MOUSELEAVE";
+            case WM_CTLCOLORSTATIC:   return "WM_CTLCOLORSTATIC";
+            case WM_RENDERFORMAT:     return "WM_RENDERFORMAT";
+            case WM_RENDERALLFORMATS: return "WM_RENDERALLFORMATS";
+            case WM_DESTROYCLIPBOARD: return "WM_DESTROYCLIPBOARD";
+        }
+        return nullptr;
+    }
+}
+
+MESSAGE_STATS::ENTRY& MESSAGE_STATS::Find(const MSG& msg)
+{
+    std::unique_ptr<ENTRY>* slot = msg.message < WM_USER ? &system[msg.message] : &user[msg.message];
+
+    // Allocated the first time a message shows up
+    if (!*slot) { *slot = std::make_unique<ENTRY>(); }
+    return **slot;
+}
+
+void MESSAGE_STATS::Record(const MSG& msg, uint64_t queue_ns, uint64_t handler_ns)
+{
+    ENTRY& entry = Find(msg);
+    entry.queue.Record(queue_ns);
+    entry.handler.Record(handler_ns);
+}
+
+void MESSAGE_STATS::RecordCommand(int control_id, uint64_t handler_ns)
+{
+    std::unique_ptr<ENTRY>& slot = commands[control_id];
+    if (!slot) { slot = std::make_unique<ENTRY>(); }
+    slot->handler.Record(handler_ns);
+}
+
+std::vector<MESSAGE_STATS::ROW> MESSAGE_STATS::Snapshot() const
+{
+    std::vector<ROW> rows;
+    auto add = [&rows](UINT message, int control_id, const ENTRY& entry)
+    {
+        ROW row        = {};
+        row.message    = message;
+        row.control_id = control_id;
+        row.count      = entry.handler.Count();
+        row.queue_p50  = entry.queue.Percentile(50);
+        row.queue_p99  = entry.queue.Percentile(99);
+        row.queue_p999 = entry.queue.Percentile(99.9);
+        row.queue_max  = entry.queue.Max();
+        row.handler_p50  = entry.handler.Percentile(50);
+        row.handler_p99  = entry.handler.Percentile(99);
+        row.handler_p999 = entry.handler.Percentile(99.9);
+        row.handler_max  = entry.handler.Max();
+        rows.push_back(row);
+    };
+
+    for (UINT message = 0; message < system.size(); message++)
+    {
+        if (system[message]) { add(message, NO_CONTROL, *system[message]); }
+    }
+    for (auto& [message, entry] : user) { add(message, NO_CONTROL, *entry); }
+    for (auto& [control_id, entry] : commands) { add(WM_COMMAND, control_id, *entry); }
+
+    std::sort(rows.begin(), rows.end(), [](const ROW& a, const ROW& b)
+    {
+        return a.message != b.message ? a.message < b.message : a.control_id < b.control_id;
+    });
+    return rows;
+}
+
+void MESSAGE_STATS::Write(std::ostream& out) const
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-22s %7s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+        "message", "control", "count", "queue_p50", "queue_p99", "queue_p999", "handler_p50", "handler_p99", "handler_p999", "handler_max");
+    out << line;
+    for (const ROW& row : Snapshot())
+    {
+        char message[32];
+        const char* name = MessageName(row.message);
+        if (name) { std::snprintf(message, sizeof(message), "%s", name); }
+        else      { std::snprintf(message, sizeof(message), "0x%04X", row.message); }
+
+        // Durations in microseconds
+        std::snprintf(line, sizeof(line), "%-22s %7d %10llu %10.1f %10.1f %10.1f %10.2f %10.2f %10.2f %10.2f\n",
+            message, row.control_id, (unsigned long long)row.count,
+            row.queue_p50 / 1e3, row.queue_p99 / 1e3, row.queue_p999 / 1e3,
+            row.handler_p50 / 1e3, row.handler_p99 / 1e3, row.handler_p999 / 1e3, row.handler_max / 1e3);
+        out << line;
+    }
+}
+
+bool MESSAGE_STATS::Dump(const char* path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) { return false; }
+    Write(file);
+    return static_cast<bool>(file);
+}
+
+void MESSAGE_STATS::Reset()
+{
+    for (auto& entry : system) { entry.reset(); }
+    user.clear();
+    commands.clear();
+}
@@ -0,0 +1,69 @@
+#ifndef MSGSTATS_H
+#define MSGSTATS_H
+#include "platform.h"
+#include "histogram.h"
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/*
+Latency of every message the main loop dispatches, per message type and for WM_COMMAND per control ID.
+For each of them two histograms are kept:
+- queue:   time from posting to dispatching. Taken from MSG::time, so it only has the resolution of GetTickCount (ms)
+- handler: time DispatchMessage took, i.e. the window procedure
+The rows per control ID come from RecordCommand, which the WM_COMMAND handler calls. A click sends WM_COMMAND from inside the WM_LBUTTONUP of the button,
+the loop never sees it. So these rows count every command, sent or posted, and only have handler time (also part of the message that sent them).
+Cheap enough to stay on: a lookup in a flat table and two histogram increments per message. Only the thread of the loop may record and read.
+*/
+class MESSAGE_STATS
+{
+public:
+
+    static constexpr int NO_CONTROL = -1;
+
+    struct ROW
+    {
+        UINT     message;
+        int      control_id; // NO_CONTROL unless message is WM_COMMAND
+        uint64_t count;
+        uint64_t queue_p50, queue_p99, queue_p999, queue_max;             // ns
+        uint64_t handler_p50, handler_p99, handler_p999, handler_max;     // ns
+    };
+
+    void Record(const MSG& msg, uint64_t queue_ns, uint64_t handler_ns);
+
+    // Handler time of the command of control_id, however the WM_COMMAND arrived
+    void RecordCommand(int control_id, uint64_t handler_ns);
+
+    // Rows sorted by message and control ID
+    std::vector<ROW> Snapshot() const;
+
+    // Snapshot as a table, one row per line
+    void Write(std::ostream& out) const;
+    bool Dump(const char* path) const;
+
+    void Reset();
+
+    bool Enabled() const { return enabled; }
+    void SetEnabled(bool enable) { enabled = enable; }
+
+private:
+
+    struct ENTRY
+    {
+        HISTOGRAM queue;
+        HISTOGRAM handler;
+    };
+
+    ENTRY& Find(const MSG& msg);
+
+    // Everything below WM_USER is looked up directly, the rest (WM_COMMAND IDs, WM_USER/WM_APP messages) in maps
+    std::vector<std::unique_ptr<ENTRY>>             system = std::vector<std::unique_ptr<ENTRY>>(WM_USER);
+    std::unordered_map<UINT, std::unique_ptr<ENTRY>> user;
+    std::unordered_map<int, std::unique_ptr<ENTRY>>  commands;
+    bool enabled = true;
+};
+
+#endif // MSGSTATS_H
@@ -0,0 +1,124 @@
+#include "paint.h"
+#include "gdicache.h"
+#include "trace.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+
+bool PAINTER::Start(HWND window, COLORREF background)
+{
+    hWnd = window;
+    background_brush = GDI_CACHE::Shared().AcquireBrush(background);
+    Assign(default_colors, RGB(0, 0, 0), background);
+    if (!background_brush || !default_colors.brush) { LOG_ERROR(L"Could not get the background brush. Errnum =", GetLastError()); return false; }
+    return true;
+}
+
+void PAINTER::Stop()
+{
+    if (buffer_dc)
+    {
+        SelectObject(buffer_dc, original_bitmap);
+        DeleteDC(buffer_dc);
+    }
+    if (buffer) { DeleteObject(buffer); }
+    buffer_dc     = NULL;
+    buffer        = NULL;
+    buffer_width  = 0;
+    buffer_height = 0;
+
+    GDI_CACHE& cache = GDI_CACHE::Shared();
+    for (auto& [control, control_colors] : colors) { cache.Release(control_colors.brush); }
+    colors.clear();
+    cache.Release(default_colors.brush);
+    cache.Release(background_brush);
+    default_colors   = {};
+    background_brush = NULL;
+    hWnd             = NULL;
+}
+
+void PAINTER::Assign(COLORS& colors, COLORREF text, COLORREF background)
+{
+    HBRUSH previous   = colors.brush;
+    colors.text       = text;
+    colors.background = background;
+    colors.brush      = GDI_CACHE::Shared().AcquireBrush(background);
+    GDI_CACHE::Shared().Release(previous);
+}
+
+void PAINTER::SetColors(HWND control, COLORREF text, COLORREF background)
+{
+    auto [entry, inserted] = colors.try_emplace(control, COLORS{});
+    if (!inserted && entry->second.text == text && entry->second.background == background) { return; }
+    Assign(entry->second, text, background);
+    InvalidateRect(control, NULL, TRUE);
+}
+
+bool PAINTER::EnsureBuffer(HDC hdc)
+{
+    RECT client;
+    GetClientRect(hWnd, &client);
+    const int width  = client.right - client.left;
+    const int height = client.bottom - client.top;
+    if (buffer && width <= buffer_width && height <= buffer_height) { return true; }
+
+    TRACE_SPAN("PAINTER::EnsureBuffer");
+    if (!buffer_dc)
+    {
+        buffer_dc = CreateCompatibleDC(hdc);
+        if (!buffer_dc) { LOG_ERROR(L"CreateCompatibleDC failed. Errnum =", GetLastError()); return false; }
+    }
+    const int new_width  = (std::max(width, buffer_width) + BUFFER_GRANULARITY - 1) / BUFFER_GRANULARITY * BUFFER_GRANULARITY;
+    const int new_height = (std::max(height, buffer_height) + BUFFER_GRANULARITY - 1) / BUFFER_GRANULARITY * BUFFER_GRANULARITY;
+    HBITMAP new_buffer = CreateCompatibleBitmap(hdc, new_width, new_height);
+    if (!new_buffer) { LOG_ERROR(L"CreateCompatibleBitmap failed. Errnum =", GetLastError()); return false; }
+
+    // The old bitmap has to be out of the DC before it can be deleted
+    HGDIOBJ previous = SelectObject(buffer_dc, new_buffer);
+    if (buffer) { DeleteObject(buffer); }
+    else        { original_bitmap = previous; }
+    buffer        = new_buffer;
+    buffer_width  = new_width;
+    buffer_height = new_height;
+    stats.buffer_resizes++;
+    return true;
+}
+
+void PAINTER::OnPaint()
+{
+    auto start = std::chrono::steady_clock::now();
+    PAINTSTRUCT paint;
+    HDC hdc = BeginPaint(hWnd, &paint);
+    if (!hdc) { return; }
+
+    const RECT& area = paint.rcPaint;
+    if (!IsRectEmpty(&area) && EnsureBuffer(hdc))
+    {
+        // Everything is drawn into the back buffer first, then shown in one go
+        FillRect(buffer_dc, &area, background_brush);
+        const int width  = area.right - area.left;
+        const int height = area.bottom - area.top;
+        BitBlt(hdc, area.left, area.top, width, height, buffer_dc, area.left, area.top, SRCCOPY);
+        stats.pixels += static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+    }
+    EndPaint(hWnd, &paint);
+
+    stats.frames++;
+    frame_times.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+}
+
+HBRUSH PAINTER::OnCtlColorStatic(HDC hdc, HWND control)
+{
+    stats.color_lookups++;
+    auto found = colors.find(control);
+    const COLORS& control_colors = found != colors.end() ? found->second : default_colors;
+    SetTextColor(hdc, control_colors.text);
+    SetBkColor(hdc, control_colors.background);
+    return control_colors.brush;
+}
+
+void PAINTER::ResetStats()
+{
+    stats = {};
+    frame_times.Reset();
+}
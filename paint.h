@@ -0,0 +1,87 @@
+#ifndef PAINT_H
+#define PAINT_H
+#include "platform.h"
+#include "histogram.h"
+#include <cstdint>
+#include <unordered_map>
+
+/*
+Paints the client area of a window through a back buffer and answers WM_CTLCOLORSTATIC from a table.
+
+WM_PAINT only draws the update area (rcPaint) into a memory bitmap and copies that area to the window with one BitBlt, so a half drawn frame is never visible.
+The bitmap is kept between frames. It is only created again when the client area outgrows it, rounded up so a resize drag does not reallocate on every step.
+WM_ERASEBKGND has to return 1 without erasing, the background is part of the frame.
+
+The window class should not have CS_HREDRAW / CS_VREDRAW and the window should have WS_CLIPCHILDREN.
+Resizing then only invalidates what was uncovered, and repainting the window does not repaint every control on it.
+
+The colors of static controls are decided in SetColors and only looked up on WM_CTLCOLORSTATIC, the brushes come from the GDI_CACHE.
+*/
+class PAINTER
+{
+public:
+
+    struct COLORS
+    {
+        COLORREF text;
+        COLORREF background;
+        HBRUSH   brush;       // of background
+    };
+
+    struct STATS
+    {
+        uint64_t frames;          // WM_PAINT
+        uint64_t pixels;          // copied from the back buffer to the window
+        uint64_t buffer_resizes;  // back buffer created or grown
+        uint64_t color_lookups;   // WM_CTLCOLORSTATIC
+    };
+
+    // Back buffer sizes are rounded up to a multiple of this
+    static constexpr int BUFFER_GRANULARITY = 128;
+
+    // Paints hWnd with background. Controls without their own colors get black text on background
+    bool Start(HWND hWnd, COLORREF background);
+
+    // Frees the back buffer and gives the brushes back. On WM_NCDESTROY
+    void Stop();
+
+    // Colors of one static control instead of the default. Only that control is repainted
+    void SetColors(HWND control, COLORREF text, COLORREF background);
+
+    // WM_PAINT
+    void OnPaint();
+
+    // WM_CTLCOLORSTATIC. Sets the colors on the DC of the control and returns the background brush
+    HBRUSH OnCtlColorStatic(HDC hdc, HWND control);
+
+    STATS GetStats() const { return stats; }
+
+    // Nanoseconds per WM_PAINT, BeginPaint to EndPaint
+    const HISTOGRAM& GetFrameTimes() const { return frame_times; }
+
+    void ResetStats();
+
+private:
+
+    // Makes sure the back buffer covers the client area
+    bool EnsureBuffer(HDC hdc);
+
+    // Sets colors to text and background with a brush from the GDI_CACHE, gives the old brush back
+    static void Assign(COLORS& colors, COLORREF text, COLORREF background);
+
+    HWND    hWnd             = NULL;
+    HBRUSH  background_brush = NULL;
+    HDC     buffer_dc        = NULL;
+    HBITMAP buffer           = NULL;
+    HGDIOBJ original_bitmap  = NULL;   // selected again before buffer_dc is deleted
+    int     buffer_width     = 0;
+    int     buffer_height    = 0;
+
+    COLORS                           default_colors = {};
+    std::unordered_map<HWND, COLORS> colors;
+
+    STATS     stats = {};
+    HISTOGRAM frame_times;
+};
+
+#endif // PAINT_H
@@ -0,0 +1,232 @@
+#include "payload.h"
+#include "lz.h"
+#include "log.h"
+#include "workers.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace
+{
+    // Runs work(i) for every i below count, on the workers too if there are any and characters is big enough to be worth it
+    template<class WORK>
+    void ForEachParallel(WORKER_POOL* workers, size_t count, size_t characters, WORK work)
+    {
+        if (!workers || characters < PAYLOAD::PARALLEL_CHARS || count < 2)
+        {
+            for (size_t i = 0; i < count; i++) { work(i); }
+            return;
+        }
+        workers->ParallelFor(count, work);
+    }
+}
+
+PAYLOAD::PAYLOAD(std::shared_ptr<BUFFER_POOL> pool) : pool(std::move(pool))
+{
+}
+
+PAYLOAD::PAYLOAD(const WCHAR* text, size_t length, std::shared_ptr<BUFFER_POOL> pool) : pool(std::move(pool))
+{
+    Append(text, length);
+}
+
+PAYLOAD::~PAYLOAD()
+{
+    for (CHUNK& chunk : chunks)
+    {
+        if (chunk.data)
+        {
+            if (pool) { pool->Release(chunk.data, chunk.capacity); } else { delete[] chunk.data; }
+        }
+        delete[] chunk.packed;
+    }
+}
+
+void PAYLOAD::AddChunk(size_t chunk_length)
+{
+    // The memory is not zeroed, it gets overwritten right away
+    CHUNK chunk = {nullptr, 0, chunk_length, nullptr, 0};
+    if (pool) { chunk.data = pool->Acquire(chunk_length, &chunk.capacity); } else { chunk.data = new WCHAR[chunk_length]; }
+    chunks.push_back(chunk);
+}
+
+void PAYLOAD::Append(const WCHAR* text, size_t count)
+{
+    while (count > 0)
+    {
+        // Start a new chunk when the last one is full
+        // The first chunk is only as big as the first append needs, so short texts stay small
+        if (chunks.empty() || chunks.back().used == chunks.back().capacity)
+        {
+            AddChunk(chunks.empty() ? std::min(count, CHUNK_CHARS) : CHUNK_CHARS);
+        }
+        CHUNK& chunk = chunks.back();
+        size_t take = std::min(count, chunk.capacity - chunk.used);
+        std::memcpy(chunk.data + chunk.used, text, take * sizeof(WCHAR));
+        chunk.used += take;
+        length     += take;
+        text       += take;
+        count      -= take;
+    }
+}
+
+UTF::RESULT PAYLOAD::AppendUtf8(const char* text, size_t count)
+{
+    // A byte never gives more than one character, so count bytes always fit into count characters of room
+    UTF::RESULT result = {};
+    while (count > 0)
+    {
+        size_t room = chunks.empty() ? 0 : chunks.back().capacity - chunks.back().used;
+        size_t take = count <= room ? count : UTF::CompleteUtf8(text, room);
+        if (take == 0)
+        {
+            AddChunk(chunks.empty() ? std::min(count, CHUNK_CHARS) : CHUNK_CHARS);
+            continue;
+        }
+        CHUNK& chunk = chunks.back();
+        UTF::RESULT decoded = UTF::FromUtf8(text, take, UTF::Wide(chunk.data + chunk.used));
+        chunk.used     += decoded.written;
+        length         += decoded.written;
+        result.written += decoded.written;
+        result.errors  += decoded.errors;
+        text           += take;
+        count          -= take;
+    }
+    return result;
+}
+
+WCHAR* PAYLOAD::Reserve(size_t reserve_length)
+{
+    if (chunks.empty() || chunks.back().capacity - chunks.back().used < reserve_length)
+    {
+        AddChunk(reserve_length);
+    }
+    return chunks.back().data + chunks.back().used;
+}
+
+void PAYLOAD::Commit(size_t written)
+{
+    chunks.back().used += written;
+    length             += written;
+}
+
+const WCHAR* PAYLOAD::Chunk(size_t index, size_t* chunk_length) const
+{
+    *chunk_length = chunks[index].used;
+    return chunks[index].data;
+}
+
+bool PAYLOAD::CopyTo(WCHAR* destination, WORKER_POOL* workers) const
+{
+    if (compressed)
+    {
+        // Every block knows where its text goes, so they can be decompressed in any order
+        std::vector<size_t> offsets(chunks.size());
+        for (size_t i = 1; i < chunks.size(); i++) { offsets[i] = offsets[i - 1] + chunks[i - 1].used; }
+        std::atomic<bool> intact{true};
+        ForEachParallel(workers, chunks.size(), length, [&](size_t i)
+        {
+            if (!Unpack(i, destination + offsets[i])) { intact.store(false, std::memory_order_relaxed); }
+        });
+        return intact.load(std::memory_order_relaxed);
+    }
+    for (const CHUNK& chunk : chunks)
+    {
+        std::memcpy(destination, chunk.data, chunk.used * sizeof(WCHAR));
+        destination += chunk.used;
+    }
+    return true;
+}
+
+void PAYLOAD::Compress(WORKER_POOL* workers)
+{
+    if (compressed) { return; }
+    std::vector<CHUNK> blocks = Pack(chunks, length, workers);
+    for (CHUNK& chunk : chunks)
+    {
+        if (pool) { pool->Release(chunk.data, chunk.capacity); } else { delete[] chunk.data; }
+    }
+    for (CHUNK& block : blocks) { block.data = nullptr; }
+    chunks     = std::move(blocks);
+    compressed = true;
+}
+
+std::shared_ptr<PAYLOAD> PAYLOAD::Compressed(WORKER_POOL* workers) const
+{
+    std::shared_ptr<PAYLOAD> copy = std::make_shared<PAYLOAD>(pool);
+    copy->chunks = compressed ? chunks : Pack(chunks, length, workers);
+    for (CHUNK& block : copy->chunks)
+    {
+        // Own copies of the blocks if this one is compressed already, the data stays here
+        if (compressed)
+        {
+            unsigned char* packed = new unsigned char[block.packed_bytes];
+            std::memcpy(packed, block.packed, block.packed_bytes);
+            block.packed = packed;
+        }
+        block.data = nullptr;
+    }
+    copy->length     = length;
+    copy->compressed = true;
+    return copy;
+}
+
+const unsigned char* PAYLOAD::Block(size_t index, size_t* block_bytes) const
+{
+    *block_bytes = chunks[index].packed_bytes;
+    return chunks[index].packed;
+}
+
+std::vector<PAYLOAD::CHUNK> PAYLOAD::Pack(const std::vector<CHUNK>& chunks, size_t length, WORKER_POOL* workers)
+{
+    // Chunks from Reserve can have any size. Blocks of at most CHUNK_CHARS keep READER small and give the workers of CopyTo enough pieces
+    std::vector<CHUNK> blocks;
+    for (const CHUNK& chunk : chunks)
+    {
+        for (size_t start = 0; start < chunk.used; start += CHUNK_CHARS)
+        {
+            const size_t used = std::min(CHUNK_CHARS, chunk.used - start);
+            blocks.push_back({chunk.data + start, used, used, nullptr, 0});
+        }
+    }
+
+    // Compressed into a scratch buffer of the worst case size, then moved to a block of the exact size.
+    // The scratch buffer stays with the thread for the next payload, about 1 MB on each worker and the thread that compresses
+    ForEachParallel(workers, blocks.size(), length, [&](size_t i)
+    {
+        thread_local std::vector<unsigned char> scratch;
+        CHUNK& block = blocks[i];
+        const size_t bytes = block.used * sizeof(WCHAR);
+        scratch.resize(LZ::Bound(bytes));
+        block.packed_bytes = LZ::Compress(block.data, bytes, scratch.data(), scratch.size());
+        block.packed       = new unsigned char[block.packed_bytes];
+        std::memcpy(block.packed, scratch.data(), block.packed_bytes);
+    });
+    return blocks;
+}
+
+bool PAYLOAD::Unpack(size_t index, WCHAR* destination) const
+{
+    const CHUNK& chunk = chunks[index];
+    const size_t bytes = LZ::Decompress(chunk.packed, chunk.packed_bytes, destination, chunk.used * sizeof(WCHAR));
+    if (bytes == chunk.used * sizeof(WCHAR)) { return true; }
+    LOG_ERROR(L"Compressed chunk", index, L"is damaged");
+    return false;
+}
+
+size_t PAYLOAD::StoredBytes() const
+{
+    size_t bytes = 0;
+    for (const CHUNK& chunk : chunks) { bytes += compressed ? chunk.packed_bytes : chunk.capacity * sizeof(WCHAR); }
+    return bytes;
+}
+
+const WCHAR* PAYLOAD::READER::Chunk(size_t index, size_t* chunk_length)
+{
+    if (!payload.compressed) { return payload.Chunk(index, chunk_length); }
+
+    // Compressed chunks are never longer than CHUNK_CHARS
+    if (!buffer) { buffer = std::make_unique_for_overwrite<WCHAR[]>(CHUNK_CHARS); }
+    *chunk_length = payload.chunks[index].used;
+    return payload.Unpack(index, buffer.get()) ? buffer.get() : nullptr;
+}
@@ -0,0 +1,121 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+#include "platform.h"
+#include "pool.h"
+#include "utf.h"
+#include <memory>
+#include <vector>
+
+class WORKER_POOL;
+
+/*
+Text that is (or will be) on the clipboard.
+The text is stored in chunks of up to CHUNK_CHARS characters, so appending never moves what is already stored and a huge text never needs one huge allocation.
+A payload is filled once and then shared read only (std::shared_ptr<const PAYLOAD>) by every clipboard format rendered from it.
+With a pool the chunks come from and go back to it, otherwise they are plain heap memory.
+
+A filled payload can be compressed (Compress) to keep a big text on the clipboard in a fraction of the memory.
+The text is then stored as independent LZ blocks (see lz.h) of up to CHUNK_CHARS characters, one per chunk. Nothing is decompressed until the text is read:
+READER decompresses one chunk at a time when it is asked for it, CopyTo decompresses straight into the destination.
+Compress, Compressed and CopyTo split a big text over the workers they are given (WORKER_POOL::ParallelFor), without workers they run on the calling thread.
+A damaged block is never handed out as text: READER gives nullptr for it and CopyTo false.
+*/
+class PAYLOAD
+{
+public:
+
+    static constexpr size_t CHUNK_CHARS = size_t(1) << 18; // 256k characters per chunk
+
+    // Compress and CopyTo of a compressed payload use the workers from this many characters on
+    static constexpr size_t PARALLEL_CHARS = CHUNK_CHARS * 8;
+
+    /*
+    Reads the chunks of a payload one after the other, compressed or not.
+    A compressed chunk is decompressed into a buffer of the reader, so reading never needs more than one chunk of memory. The text stays valid until the next Chunk call.
+    */
+    class READER
+    {
+    public:
+        explicit READER(const PAYLOAD& payload) : payload(payload) {}
+
+        // nullptr if the block of a compressed chunk is damaged
+        const WCHAR* Chunk(size_t index, size_t* chunk_length);
+    private:
+        const PAYLOAD& payload;
+        std::unique_ptr<WCHAR[]> buffer;
+    };
+
+    explicit PAYLOAD(std::shared_ptr<BUFFER_POOL> pool = nullptr);
+    PAYLOAD(const WCHAR* text, size_t length, std::shared_ptr<BUFFER_POOL> pool = nullptr);
+    ~PAYLOAD();
+
+    PAYLOAD(const PAYLOAD&) = delete;
+    PAYLOAD& operator=(const PAYLOAD&) = delete;
+
+    // Adds text to the end. Only valid while the payload is still being filled
+    void Append(const WCHAR* text, size_t length);
+
+    /*
+    Decodes UTF-8 and adds it to the end. Fills every chunk up to the last few characters, whatever the script.
+    A sequence cut off at the end of text is replaced with U+FFFD, so text that arrives in pieces should be split with UTF::CompleteUtf8.
+    */
+    UTF::RESULT AppendUtf8(const char* text, size_t length);
+
+    /*
+    Lets a producer write straight into the payload instead of copying through a temporary buffer.
+    Reserve returns room for length characters in one piece, Commit adds the first written characters of it to the text.
+    */
+    WCHAR* Reserve(size_t length);
+    void Commit(size_t written);
+
+    // Number of characters without terminating zero
+    size_t Length() const { return length; }
+
+    size_t ChunkCount() const { return chunks.size(); }
+
+    // Returns the characters of chunk index and stores how many there are in chunk_length. Not for a compressed payload, READER reads both
+    const WCHAR* Chunk(size_t index, size_t* chunk_length) const;
+
+    // Copies the text to destination. destination needs room for Length() characters, no terminating zero is written.
+    // False if a compressed block is damaged, destination is not the text then
+    bool CopyTo(WCHAR* destination, WORKER_POOL* workers = nullptr) const;
+
+    // Replaces the text with compressed blocks. Only once the payload is filled, nothing can be appended afterwards
+    void Compress(WORKER_POOL* workers = nullptr);
+    bool IsCompressed() const { return compressed; }
+
+    // Compressed copy of a filled payload. This one is only read, so it can be rendered meanwhile, e.g. while a worker compresses it
+    std::shared_ptr<PAYLOAD> Compressed(WORKER_POOL* workers = nullptr) const;
+
+    // LZ block of chunk index of a compressed payload. The same text cut into the same chunks always compresses to the same blocks
+    const unsigned char* Block(size_t index, size_t* block_bytes) const;
+
+    // Memory the text takes, compressed or not
+    size_t StoredBytes() const;
+
+private:
+
+    struct CHUNK
+    {
+        WCHAR*         data;           // nullptr once compressed
+        size_t         used;
+        size_t         capacity;
+        unsigned char* packed;         // the LZ block of a compressed payload
+        size_t         packed_bytes;
+    };
+
+    // Decompresses chunk index to destination. False if the block is damaged
+    bool Unpack(size_t index, WCHAR* destination) const;
+
+    // Blocks of at most CHUNK_CHARS over the text of chunks, compressed. Their data still points into chunks
+    static std::vector<CHUNK> Pack(const std::vector<CHUNK>& chunks, size_t length, WORKER_POOL* workers);
+
+    void AddChunk(size_t length);
+
+    std::shared_ptr<BUFFER_POOL> pool;
+    std::vector<CHUNK> chunks;
+    size_t length = 0;
+    bool compressed = false;
+};
+
+#endif // PAYLOAD_H
@@ -0,0 +1,23 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+/*
+UNICODE needs to be defined before windows.h to correctly use widestring functions
+Most windows functions have a A and W variant.
+Windows supplies a macro that decides the to use function depending on the UNICODE definition
+*/
+#ifndef UNICODE
+#define UNICODE
+#endif
+
+/*
+Selects the backend GUI and CLIPBOARD are built against.
+On windows this is simply windows.h. Everywhere else (or when GUI_HEADLESS is defined) the headless backend is used.
+It implements the subset of the winapi this program uses in memory, so the message handling can run without a desktop.
+*/
+#if defined(_WIN32) && !defined(GUI_HEADLESS)
+#include <windows.h>
+#else
+#include "headless.h"
+#endif
+
+#endif // PLATFORM_H
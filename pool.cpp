@@ -0,0 +1,78 @@
+#include "pool.h"
+#include <bit>
+
+BUFFER_POOL::BUFFER_POOL(size_t max_pooled_bytes) : max_pooled_bytes(max_pooled_bytes)
+{
+}
+
+BUFFER_POOL::~BUFFER_POOL()
+{
+    Trim();
+}
+
+size_t BUFFER_POOL::SizeClass(size_t capacity)
+{
+    return static_cast<size_t>(std::countr_zero(capacity));
+}
+
+WCHAR* BUFFER_POOL::Acquire(size_t length, size_t* capacity)
+{
+    *capacity = std::bit_ceil(length < MIN_CAPACITY ? MIN_CAPACITY : length);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.buffers_in_use++;
+        stats.bytes_in_use += *capacity * sizeof(WCHAR);
+
+        std::vector<WCHAR*>& free_list = free_buffers[SizeClass(*capacity)];
+        if (!free_list.empty())
+        {
+            WCHAR* buffer = free_list.back();
+            free_list.pop_back();
+            stats.reuses++;
+            stats.buffers_pooled--;
+            stats.bytes_pooled -= *capacity * sizeof(WCHAR);
+            return buffer;
+        }
+        stats.heap_allocations++;
+    }
+    // Not zeroed, every user overwrites the buffer
+    return new WCHAR[*capacity];
+}
+
+void BUFFER_POOL::Release(WCHAR* buffer, size_t capacity)
+{
+    if (!buffer) { return; }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.buffers_in_use--;
+        stats.bytes_in_use -= capacity * sizeof(WCHAR);
+        if (stats.bytes_pooled + capacity * sizeof(WCHAR) <= max_pooled_bytes)
+        {
+            free_buffers[SizeClass(capacity)].push_back(buffer);
+            stats.buffers_pooled++;
+            stats.bytes_pooled += capacity * sizeof(WCHAR);
+            return;
+        }
+        stats.heap_frees++;
+    }
+    delete[] buffer;
+}
+
+void BUFFER_POOL::Trim()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::vector<WCHAR*>& free_list : free_buffers)
+    {
+        for (WCHAR* buffer : free_list) { delete[] buffer; }
+        stats.heap_frees += free_list.size();
+        free_list.clear();
+    }
+    stats.buffers_pooled = 0;
+    stats.bytes_pooled   = 0;
+}
+
+BUFFER_POOL::STATS BUFFER_POOL::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,61 @@
+#ifndef POOL_H
+#define POOL_H
+#include "platform.h"
+#include <mutex>
+#include <vector>
+
+/*
+Pool of text buffers.
+Buffers are handed out in power of two sizes and come back here instead of being freed, so a steady stream of clipboard texts stops allocating after the first few.
+The pool keeps at most max_pooled_bytes of free buffers, anything above that goes back to the heap.
+Thread safe, buffers can be released from any thread.
+*/
+class BUFFER_POOL
+{
+public:
+
+    static constexpr size_t DEFAULT_MAX_POOLED = size_t(64) << 20; // 64 MB
+    static constexpr size_t MIN_CAPACITY       = 64;               // characters
+
+    // Counters so tests and benchmarks can check that memory stays flat
+    struct STATS
+    {
+        size_t heap_allocations; // buffers that had to be allocated
+        size_t heap_frees;       // buffers given back to the heap
+        size_t reuses;           // requests served from the pool
+        size_t buffers_in_use;
+        size_t bytes_in_use;
+        size_t buffers_pooled;
+        size_t bytes_pooled;
+    };
+
+    explicit BUFFER_POOL(size_t max_pooled_bytes = DEFAULT_MAX_POOLED);
+    ~BUFFER_POOL();
+
+    BUFFER_POOL(const BUFFER_POOL&) = delete;
+    BUFFER_POOL& operator=(const BUFFER_POOL&) = delete;
+
+    // Returns a buffer for at least length characters and stores its real size in capacity
+    WCHAR* Acquire(size_t length, size_t* capacity);
+
+    // Gives a buffer back. capacity must be the value Acquire returned
+    void Release(WCHAR* buffer, size_t capacity);
+
+    // Frees all pooled buffers
+    void Trim();
+
+    STATS GetStats() const;
+
+private:
+
+    static constexpr size_t CLASSES = sizeof(size_t) * 8;
+
+    static size_t SizeClass(size_t capacity);
+
+    mutable std::mutex  mutex;
+    std::vector<WCHAR*> free_buffers[CLASSES]; // index = log2 of the capacity
+    size_t              max_pooled_bytes;
+    STATS               stats = {};
+};
+
+#endif // POOL_H
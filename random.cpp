@@ -0,0 +1,66 @@
+#include "random.h"
+#include <random>
+
+namespace
+{
+    uint64_t Rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    // Spreads a 64 bit seed over the state, recommended by the xoshiro authors
+    uint64_t SplitMix64(uint64_t& x)
+    {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+}
+
+RANDOM::RANDOM()
+{
+    std::random_device device;
+    Seed((uint64_t(device()) << 32) | device());
+}
+
+void RANDOM::Seed(uint64_t new_seed)
+{
+    seed = new_seed;
+    uint64_t x = new_seed;
+    for (uint64_t& word : state) { word = SplitMix64(x); }
+    next = BATCH;
+}
+
+void RANDOM::Fill()
+{
+    uint64_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+    for (uint64_t& value : batch)
+    {
+        value = Rotl(s1 * 5, 7) * 9;
+        uint64_t t = s1 << 17;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = Rotl(s3, 45);
+    }
+    state[0] = s0; state[1] = s1; state[2] = s2; state[3] = s3;
+    next = 0;
+}
+
+int RANDOM::Between(int low, int high)
+{
+    if (high <= low) { return low; }
+
+    // Lemire's multiply and reject: the high half of x * range is uniform once the few x that land in the short slice are thrown away
+    uint64_t range = uint64_t(int64_t(high) - low) + 1;  // at most 2^32
+    uint64_t m = (Next() >> 32) * range;
+    if (uint32_t(m) < range)
+    {
+        uint64_t threshold = ((uint64_t(1) << 32) - range) % range;
+        while (uint32_t(m) < threshold) { m = (Next() >> 32) * range; }
+    }
+    return static_cast<int>(int64_t(low) + int64_t(m >> 32));
+}
@@ -0,0 +1,45 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+#include <cstddef>
+#include <cstdint>
+
+/*
+Random numbers for the GUI (window and cursor jumps).
+xoshiro256** with 32 bytes of state instead of a std::random_device read and a 5 KB std::mt19937 on every event.
+Numbers are generated BATCH at a time, so most calls only read the next one from the buffer.
+By default it is seeded once from std::random_device. Seed(x) makes it repeat the same sequence, e.g. to replay a recorded session.
+Not thread safe, every GUI has its own.
+*/
+class RANDOM
+{
+public:
+
+    static constexpr size_t BATCH = 32;
+
+    RANDOM();
+    explicit RANDOM(uint64_t seed) { Seed(seed); }
+
+    // Starts the sequence that belongs to seed
+    void Seed(uint64_t seed);
+    uint64_t GetSeed() const { return seed; }
+
+    uint64_t Next()
+    {
+        if (next == BATCH) { Fill(); }
+        return batch[next++];
+    }
+
+    // Uniform in [low, high] without modulo bias
+    int Between(int low, int high);
+
+private:
+
+    void Fill();
+
+    uint64_t state[4];
+    uint64_t batch[BATCH];
+    size_t   next = BATCH;
+    uint64_t seed = 0;
+};
+
+#endif // RANDOM_H
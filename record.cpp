@@ -0,0 +1,165 @@
+#include "record.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace
+{
+    const char MAGIC[8] = {'G', 'U', 'I', 'M', 'S', 'G', '0', '1'};
+
+    struct HEADER
+    {
+        char     magic[8];
+        uint64_t seed;
+        uint64_t reserved[2];
+    };
+
+    uint64_t NowUs()
+    {
+        using namespace std::chrono;
+        return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+
+    void PutVarint(std::vector<unsigned char>& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    // Returns false at the end of the data or on a varint that does not end
+    bool GetVarint(const unsigned char*& in, const unsigned char* end, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; in < end && shift < 64; shift += 7)
+        {
+            unsigned char byte = *in++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) { return true; }
+        }
+        return false;
+    }
+
+    // Small negative lParams (e.g. mouse coordinates left of the window) stay small
+    uint64_t ZigZag(int64_t value) { return (uint64_t(value) << 1) ^ uint64_t(value >> 63); }
+    int64_t UnZigZag(uint64_t value) { return int64_t(value >> 1) ^ -int64_t(value & 1); }
+}
+
+bool MESSAGE_RECORDER::Open(const char* path, HWND main, uint64_t seed)
+{
+    Close();
+    file = std::fopen(path, "wb");
+    if (!file) { return false; }
+
+    HEADER header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.seed = seed;
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    main_window = main;
+    last_us     = 0;
+    count       = 0;
+    buffer.clear();
+    buffer.reserve(BUFFER_BYTES + 64);
+    return true;
+}
+
+void MESSAGE_RECORDER::Close()
+{
+    if (!file) { return; }
+    WriteBuffer();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void MESSAGE_RECORDER::Record(const MSG& msg)
+{
+    if (!file) { return; }
+
+    uint32_t target;
+    if (msg.hwnd == main_window) { target = 0; }
+    else if (msg.hwnd && GetParent(msg.hwnd) == main_window) { target = static_cast<uint32_t>(GetDlgCtrlID(msg.hwnd)) + 1; }
+    else { return; }
+
+    uint64_t now_us = NowUs();
+    PutVarint(buffer, count ? now_us - last_us : 0);
+    PutVarint(buffer, msg.message);
+    PutVarint(buffer, target);
+    PutVarint(buffer, msg.wParam);
+    PutVarint(buffer, ZigZag(static_cast<int64_t>(msg.lParam)));
+    last_us = now_us;
+    count++;
+
+    if (buffer.size() >= BUFFER_BYTES) { WriteBuffer(); }
+}
+
+void MESSAGE_RECORDER::WriteBuffer()
+{
+    std::fwrite(buffer.data(), 1, buffer.size(), file);
+    buffer.clear();
+}
+
+bool MESSAGE_REPLAY::Load(const char* path)
+{
+    records.clear();
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path, "rb"), &std::fclose);
+    if (!file) { return false; }
+
+    HEADER header;
+    if (std::fread(&header, sizeof(header), 1, file.get()) != 1 || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) { return false; }
+    seed = header.seed;
+
+    std::vector<unsigned char> data;
+    unsigned char block[64 * 1024];
+    for (size_t read; (read = std::fread(block, 1, sizeof(block), file.get())) > 0;) { data.insert(data.end(), block, block + read); }
+
+    const unsigned char* in  = data.data();
+    const unsigned char* end = in + data.size();
+    uint64_t time_us = 0;
+    while (in < end)
+    {
+        uint64_t delta, message, target, wParam, lParam;
+        // A recording that was cut off (e.g. the program crashed) is replayed up to the last whole record
+        if (!GetVarint(in, end, delta) || !GetVarint(in, end, message) || !GetVarint(in, end, target) ||
+            !GetVarint(in, end, wParam) || !GetVarint(in, end, lParam)) { break; }
+        time_us += delta;
+        records.push_back({time_us, static_cast<UINT>(message), static_cast<uint32_t>(target), static_cast<WPARAM>(wParam), static_cast<LPARAM>(UnZigZag(lParam))});
+    }
+    return true;
+}
+
+MESSAGE_REPLAY::RESULT MESSAGE_REPLAY::Run(HWND main_window, SPEED speed, MESSAGE_STATS* stats) const
+{
+    RESULT result = {};
+    auto start = std::chrono::steady_clock::now();
+    for (const RECORD& record : records)
+    {
+        MSG msg     = {};
+        msg.hwnd    = record.target == 0 ? main_window : GetDlgItem(main_window, static_cast<int>(record.target - 1));
+        msg.message = record.message;
+        msg.wParam  = record.wParam;
+        msg.lParam  = record.lParam;
+        if (!msg.hwnd) { result.skipped++; continue; }
+
+        // lParam of a control notification is the HWND of the control, which is a different one now
+        if (msg.message == WM_COMMAND && msg.lParam) { msg.lParam = reinterpret_cast<LPARAM>(GetDlgItem(main_window, LOWORD(msg.wParam))); }
+
+        if (speed == SPEED::ORIGINAL) { std::this_thread::sleep_until(start + std::chrono::microseconds(record.time_us)); }
+        msg.time = GetTickCount();
+
+        auto dispatch_start = std::chrono::steady_clock::now();
+        DispatchMessage(&msg);
+        if (stats)
+        {
+            auto handler_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - dispatch_start).count();
+            stats->Record(msg, 0, static_cast<uint64_t>(handler_ns));
+        }
+        result.messages++;
+    }
+    result.elapsed_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    return result;
+}
@@ -0,0 +1,93 @@
+#ifndef RECORD_H
+#define RECORD_H
+#include "platform.h"
+#include "msgstats.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*
+Recording and replaying of the messages RunMainLoop dispatched, to reproduce a slow session and to time the same session on every build.
+
+File layout: a 32 byte header (magic, random seed of the GUI) and then one record per message.
+A record is five LEB128 varints: microseconds since the previous record, message, target, wParam, lParam (zigzag encoded).
+target is 0 for the main window and control ID + 1 for its controls, so a replay finds the same controls again although their HWNDs differ.
+Mouse moves and commands take 6-10 bytes, a million messages are ~10 MB.
+*/
+class MESSAGE_RECORDER
+{
+public:
+
+    MESSAGE_RECORDER() = default;
+    ~MESSAGE_RECORDER() { Close(); }
+
+    MESSAGE_RECORDER(const MESSAGE_RECORDER&) = delete;
+    MESSAGE_RECORDER& operator=(const MESSAGE_RECORDER&) = delete;
+
+    // Starts a new file. Messages of windows other than main_window and its controls are not recorded
+    bool Open(const char* path, HWND main_window, uint64_t seed);
+    void Close();
+    bool IsOpen() const { return file != nullptr; }
+
+    // Call with every message right before it is dispatched
+    void Record(const MSG& msg);
+
+    size_t Count() const { return count; }
+
+private:
+
+    void WriteBuffer();
+
+    static constexpr size_t BUFFER_BYTES = 64 * 1024;
+
+    FILE*    file        = nullptr;
+    HWND     main_window = NULL;
+    uint64_t last_us     = 0;
+    size_t   count       = 0;
+    std::vector<unsigned char> buffer;
+};
+
+class MESSAGE_REPLAY
+{
+public:
+
+    enum class SPEED
+    {
+        ORIGINAL,  // Waits between the messages like the user did
+        MAXIMUM,   // Back to back, for timing the handlers
+    };
+
+    struct RESULT
+    {
+        size_t   messages;    // dispatched
+        size_t   skipped;     // the control they went to does not exist
+        uint64_t elapsed_ns;
+    };
+
+    // Reads and decodes the whole file, so decoding is not part of the replay time
+    bool Load(const char* path);
+
+    size_t Count() const { return records.size(); }
+
+    // Seed the recorded GUI had. Set it on the replaying GUI to get the same random positions
+    uint64_t Seed() const { return seed; }
+
+    // Dispatches the messages to main_window and its controls. Handler times go to stats if it is not nullptr
+    RESULT Run(HWND main_window, SPEED speed, MESSAGE_STATS* stats = nullptr) const;
+
+private:
+
+    struct RECORD
+    {
+        uint64_t time_us;  // since the first message
+        UINT     message;
+        uint32_t target;
+        WPARAM   wParam;
+        LPARAM   lParam;
+    };
+
+    std::vector<RECORD> records;
+    uint64_t seed = 0;
+};
+
+#endif // RECORD_H
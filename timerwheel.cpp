@@ -0,0 +1,227 @@
+#include "timerwheel.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+uint64_t TIMER_WHEEL::Now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+TIMER_WHEEL::TIMER_WHEEL(uint64_t now_ns) : origin(now_ns)
+{
+    std::fill(std::begin(heads), std::end(heads), NIL);
+}
+
+TIMER_WHEEL::TIMER TIMER_WHEEL::ScheduleAt(uint64_t due_ns, std::function<void()> callback, uint64_t period_ns)
+{
+    uint32_t index;
+    if (!free_nodes.empty())
+    {
+        index = free_nodes.back();
+        free_nodes.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    // Rounded up to a tick, and never into the tick that was already processed
+    NODE& node    = nodes[index];
+    node.due      = std::max(ToTick(due_ns), current + 1);
+    node.period   = period_ns ? std::max<uint64_t>(1, (period_ns + TICK_NS - 1) / TICK_NS) : 0;
+    node.callback = std::move(callback);
+    node.alive    = true;
+    alive++;
+    stats.scheduled++;
+    Insert(index);
+    return (static_cast<uint64_t>(node.generation) << 32) | index;
+}
+
+bool TIMER_WHEEL::Cancel(TIMER timer)
+{
+    const uint32_t index      = static_cast<uint32_t>(timer);
+    const uint32_t generation = static_cast<uint32_t>(timer >> 32);
+    if (index >= nodes.size() || !nodes[index].alive || nodes[index].generation != generation) { return false; }
+
+    // A periodic timer whose callback runs right now is in no list
+    if (nodes[index].list != NO_LIST) { Unlink(index); }
+    Free(index);
+    stats.cancelled++;
+    return true;
+}
+
+void TIMER_WHEEL::Insert(uint32_t index)
+{
+    NODE& node = nodes[index];
+    const uint64_t delta = node.due - current;
+
+    // The lowest level that reaches the due tick
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) { level++; }
+
+    // Further than the wheel reaches: waits in the last slot of the top level and is put back in when that comes up
+    uint64_t slot_tick = node.due;
+    if (delta >= (uint64_t(1) << (SLOT_BITS * LEVELS))) { slot_tick = current + (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1; }
+
+    const uint32_t slot = static_cast<uint32_t>(slot_tick >> (SLOT_BITS * level)) & (SLOTS - 1);
+    Link(index, level * SLOTS + slot);
+}
+
+void TIMER_WHEEL::Link(uint32_t index, uint32_t list)
+{
+    NODE& node = nodes[index];
+    node.prev  = NIL;
+    node.next  = heads[list];
+    node.list  = list;
+    if (node.next != NIL) { nodes[node.next].prev = index; }
+    heads[list] = index;
+    if (list < EXPIRED) { occupied[list / SLOTS][(list % SLOTS) / 64] |= uint64_t(1) << (list % 64); }
+}
+
+void TIMER_WHEEL::Unlink(uint32_t index)
+{
+    NODE& node = nodes[index];
+    const uint32_t list = node.list;
+    if (node.prev != NIL) { nodes[node.prev].next = node.next; } else { heads[list] = node.next; }
+    if (node.next != NIL) { nodes[node.next].prev = node.prev; }
+    node.prev = NIL;
+    node.next = NIL;
+    node.list = NO_LIST;
+    if (list < EXPIRED && heads[list] == NIL) { occupied[list / SLOTS][(list % SLOTS) / 64] &= ~(uint64_t(1) << (list % 64)); }
+}
+
+void TIMER_WHEEL::Free(uint32_t index)
+{
+    NODE& node    = nodes[index];
+    node.callback = nullptr;
+    node.alive    = false;
+    if (++node.generation == 0) { node.generation = 1; } // 0 would make TIMER 0 valid
+    free_nodes.push_back(index);
+    alive--;
+}
+
+void TIMER_WHEEL::Cascade(int level, uint32_t slot)
+{
+    const uint32_t list = level * SLOTS + slot;
+    uint32_t index = heads[list];
+    heads[list] = NIL;
+    occupied[level][slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    while (index != NIL)
+    {
+        const uint32_t next = nodes[index].next;
+        nodes[index].list = NO_LIST;
+        Insert(index);
+        stats.cascaded++;
+        index = next;
+    }
+}
+
+size_t TIMER_WHEEL::Expire()
+{
+    const uint32_t list = static_cast<uint32_t>(current) & (SLOTS - 1);
+    if (heads[list] == NIL) { return 0; }
+
+    // The slot moves to EXPIRED as a whole, so a callback can still cancel a timer that waits behind it
+    heads[EXPIRED] = heads[list];
+    heads[list]    = NIL;
+    occupied[0][list / 64] &= ~(uint64_t(1) << (list % 64));
+    for (uint32_t index = heads[EXPIRED]; index != NIL; index = nodes[index].next) { nodes[index].list = EXPIRED; }
+
+    size_t fired = 0;
+    while (heads[EXPIRED] != NIL)
+    {
+        const uint32_t index = heads[EXPIRED];
+        Unlink(index);
+
+        // The callback may schedule timers and grow nodes, nothing may point into it while it runs
+        const uint32_t generation = nodes[index].generation;
+        const bool     periodic   = nodes[index].period != 0;
+        std::function<void()> callback = std::move(nodes[index].callback);
+        if (!periodic) { Free(index); }
+        stats.fired++;
+        fired++;
+        callback();
+
+        if (periodic && nodes[index].alive && nodes[index].generation == generation)
+        {
+            NODE& node    = nodes[index];
+            node.callback = std::move(callback);
+            node.due      = std::max(node.due + node.period, current + 1);
+            Insert(index);
+        }
+    }
+    return fired;
+}
+
+size_t TIMER_WHEEL::Advance(uint64_t now_ns)
+{
+    // Ticks that have fully passed
+    const uint64_t target = now_ns <= origin ? 0 : (now_ns - origin) / TICK_NS;
+    size_t fired = 0;
+    while (current < target)
+    {
+        // Next level 0 slot with timers in this block of 256 ticks, empty ticks are skipped
+        const uint64_t block_end = (current | (SLOTS - 1)) + 1;
+        uint32_t distance;
+        if (NextOccupied(0, static_cast<uint32_t>(current + 1) & (SLOTS - 1), &distance) >= 0)
+        {
+            const uint64_t tick = current + 1 + distance;
+            if (tick < block_end && tick <= target)
+            {
+                current = tick;
+                fired += Expire();
+                continue;
+            }
+        }
+        if (block_end > target)
+        {
+            current = target;
+            break;
+        }
+
+        // Next block: the slots above that turn over move down, from the top level
+        current = block_end;
+        int top = 1;
+        while (top < LEVELS - 1 && ((current >> (SLOT_BITS * top)) & (SLOTS - 1)) == 0) { top++; }
+        for (int level = top; level >= 1; level--) { Cascade(level, static_cast<uint32_t>(current >> (SLOT_BITS * level)) & (SLOTS - 1)); }
+        fired += Expire();
+    }
+    return fired;
+}
+
+int TIMER_WHEEL::NextOccupied(int level, uint32_t slot, uint32_t* distance) const
+{
+    for (uint32_t step = 0; step < SLOTS;)
+    {
+        const uint32_t at   = (slot + step) & (SLOTS - 1);
+        const uint64_t bits = occupied[level][at / 64] >> (at % 64);
+        if (bits)
+        {
+            *distance = step + static_cast<uint32_t>(std::countr_zero(bits));
+            return static_cast<int>((slot + *distance) & (SLOTS - 1));
+        }
+        step += 64 - at % 64;
+    }
+    return -1;
+}
+
+uint64_t TIMER_WHEEL::NextDue() const
+{
+    if (!alive) { return NEVER; }
+    uint64_t tick = NEVER;
+    uint32_t distance;
+
+    // Level 0 holds exact ticks, the levels above the tick their slot moves down
+    if (NextOccupied(0, static_cast<uint32_t>(current + 1) & (SLOTS - 1), &distance) >= 0) { tick = current + 1 + distance; }
+    for (int level = 1; level < LEVELS; level++)
+    {
+        const uint64_t block = current >> (SLOT_BITS * level);
+        if (NextOccupied(level, static_cast<uint32_t>(block + 1) & (SLOTS - 1), &distance) >= 0)
+        {
+            tick = std::min(tick, (block + 1 + distance) << (SLOT_BITS * level));
+        }
+    }
+    return tick == NEVER ? NEVER : origin + tick * TICK_NS;
+}
@@ -0,0 +1,107 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+Timers for work the UI thread does later: a callback after a delay, once or every period.
+Hierarchical timer wheel with 4 levels of 256 slots. A tick is TICK_NS (0.1 ms), level 0 covers the next 256 ticks, level 1 the next 65536 and so on (about 5 days in total).
+Every slot is a linked list through the timers, so Schedule and Cancel are O(1) no matter how many timers wait.
+A timer far away moves down a level each time its slot comes up, at most 3 times.
+
+The owner calls Advance with the time now to fire what is due and asks NextDue when it should call again, e.g. to set one waitable timer for all of them.
+Timers never fire early, they fire at the first tick boundary after their due time, as late as Advance is called after that.
+Callbacks may schedule and cancel timers, themselves included. Not thread safe, one wheel per thread (GUI runs its own in RunMainLoop).
+*/
+class TIMER_WHEEL
+{
+public:
+
+    // 0 is never a timer
+    typedef uint64_t TIMER;
+
+    static constexpr uint64_t TICK_NS   = 100000;
+    static constexpr int      LEVELS    = 4;
+    static constexpr int      SLOT_BITS = 8;
+    static constexpr int      SLOTS     = 1 << SLOT_BITS;
+
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    struct STATS
+    {
+        uint64_t scheduled;
+        uint64_t cancelled;
+        uint64_t fired;
+        uint64_t cascaded;   // timers moved down a level
+    };
+
+    // Time on the steady clock, in nanoseconds. What Advance and ScheduleAt expect
+    static uint64_t Now();
+
+    TIMER_WHEEL() : TIMER_WHEEL(Now()) {}
+    explicit TIMER_WHEEL(uint64_t now_ns);
+
+    // Runs callback delay_ns from now, then every period_ns if that is not 0
+    TIMER Schedule(uint64_t delay_ns, std::function<void()> callback, uint64_t period_ns = 0) { return ScheduleAt(Now() + delay_ns, std::move(callback), period_ns); }
+    TIMER ScheduleAt(uint64_t due_ns, std::function<void()> callback, uint64_t period_ns = 0);
+
+    // False if the timer already fired (and was not periodic) or was cancelled
+    bool Cancel(TIMER timer);
+
+    // Fires every timer that is due at now_ns, in order of their due ticks. Returns how many fired
+    size_t Advance(uint64_t now_ns);
+
+    // When Advance has to be called next, NEVER if no timer waits. Can be a tick where a far timer only moves down a level
+    uint64_t NextDue() const;
+
+    size_t Count() const { return alive; }
+    STATS GetStats() const { return stats; }
+
+private:
+
+    static constexpr uint32_t NIL     = UINT32_MAX;
+    static constexpr uint32_t EXPIRED = LEVELS * SLOTS;   // list of the timers Advance is firing
+    static constexpr uint32_t NO_LIST = EXPIRED + 1;
+
+    struct NODE
+    {
+        uint64_t              due;         // tick
+        uint64_t              period;      // ticks, 0 for once
+        std::function<void()> callback;
+        uint32_t              prev       = NIL;
+        uint32_t              next       = NIL;
+        uint32_t              list       = NO_LIST;
+        uint32_t              generation = 1;   // goes up when the node is freed, old TIMER values stop matching
+        bool                  alive      = false;
+    };
+
+    uint64_t ToTick(uint64_t ns) const { return ns <= origin ? 0 : (ns - origin + TICK_NS - 1) / TICK_NS; }
+
+    // Puts a timer into the slot for its due tick
+    void Insert(uint32_t index);
+    void Link(uint32_t index, uint32_t list);
+    void Unlink(uint32_t index);
+    void Free(uint32_t index);
+
+    // Moves the timers of slot of level down, they are due within the next level below
+    void Cascade(int level, uint32_t slot);
+
+    // Fires everything in the level 0 slot of current
+    size_t Expire();
+
+    // First occupied slot of level at or after slot going around, -1 if the level is empty. distance gets how far it is
+    int NextOccupied(int level, uint32_t slot, uint32_t* distance) const;
+
+    uint64_t origin;        // ns of tick 0
+    uint64_t current = 0;   // last tick that was processed
+
+    std::vector<NODE>     nodes;
+    std::vector<uint32_t> free_nodes;
+    uint32_t              heads[LEVELS * SLOTS + 1];
+    uint64_t              occupied[LEVELS][SLOTS / 64] = {};
+    size_t                alive = 0;
+    STATS                 stats = {};
+};
+
+#endif // TIMERWHEEL_H
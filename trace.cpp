@@ -0,0 +1,211 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+std::atomic<bool> TRACE::enabled{false};
+
+namespace
+{
+    struct EVENT
+    {
+        const char* name;
+        uint64_t    start_ns;
+        uint64_t    end_ns;
+        char        detail[40]; // Empty string if there is none
+    };
+
+    constexpr size_t BLOCK_EVENTS = 4096;
+    constexpr size_t MAX_BLOCKS   = 1024; // 4M spans per thread
+
+    /*
+    Spans of one thread. Only that thread writes, Dump reads.
+    Blocks never move once allocated, so count (released after the event is written) is all a reader needs to synchronize with.
+    */
+    struct BUFFER
+    {
+        uint32_t                 tid;
+        std::unique_ptr<EVENT[]> blocks[MAX_BLOCKS];
+        std::atomic<size_t>      count{0};
+        std::atomic<size_t>      first{0};   // Events before this were cleared
+        std::atomic<size_t>      dropped{0};
+    };
+
+    struct REGISTRY
+    {
+        std::mutex                           mutex;
+        std::vector<std::unique_ptr<BUFFER>> buffers; // Kept after their thread exited, so its spans still end up in the dump
+        std::string                          exit_path;
+    };
+
+    // Never destroyed, threads can still record while static objects get destroyed
+    REGISTRY& Registry()
+    {
+        static REGISTRY* registry = new REGISTRY();
+        return *registry;
+    }
+
+    thread_local BUFFER* t_buffer = nullptr;
+
+    const auto origin = std::chrono::steady_clock::now();
+
+    BUFFER* ThreadBuffer()
+    {
+        if (!t_buffer)
+        {
+            REGISTRY& registry = Registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.buffers.push_back(std::make_unique<BUFFER>());
+            t_buffer      = registry.buffers.back().get();
+            t_buffer->tid = static_cast<uint32_t>(registry.buffers.size());
+        }
+        return t_buffer;
+    }
+
+    void WriteEscaped(std::ostream& out, const char* text)
+    {
+        for (; *text; text++)
+        {
+            char c = *text;
+            if (c == '"' || c == '\\') { out << '\\' << c; }
+            else if (static_cast<unsigned char>(c) < 0x20) { out << ' '; }
+            else { out << c; }
+        }
+    }
+
+    void DumpAtExit()
+    {
+        TRACE::Stop();
+        const std::string& path = Registry().exit_path;
+        if (!path.empty()) { TRACE::Dump(path.c_str()); }
+    }
+}
+
+void TRACE::StartFromEnvironment()
+{
+    const char* path = std::getenv("GUI_TRACE");
+    if (!path || !*path) { return; }
+    Registry().exit_path = path;
+    std::atexit(DumpAtExit);
+    Start();
+}
+
+void TRACE::Start()
+{
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void TRACE::Stop()
+{
+    enabled.store(false, std::memory_order_relaxed);
+}
+
+uint64_t TRACE::NowNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count());
+}
+
+void TRACE::Record(const char* name, uint64_t start_ns, uint64_t end_ns, const wchar_t* detail)
+{
+    BUFFER* buffer = ThreadBuffer();
+    size_t index = buffer->count.load(std::memory_order_relaxed);
+    size_t block = index / BLOCK_EVENTS;
+    if (block >= MAX_BLOCKS) { buffer->dropped.fetch_add(1, std::memory_order_relaxed); return; }
+    if (!buffer->blocks[block]) { buffer->blocks[block] = std::make_unique<EVENT[]>(BLOCK_EVENTS); }
+
+    EVENT& event   = buffer->blocks[block][index % BLOCK_EVENTS];
+    event.name     = name;
+    event.start_ns = start_ns;
+    event.end_ns   = end_ns;
+
+    // Control texts are short, keep the start of it. Everything outside of ASCII becomes '?'
+    size_t length = 0;
+    if (detail)
+    {
+        for (; detail[length] && length < sizeof(event.detail) - 1; length++)
+        {
+            wchar_t c = detail[length];
+            event.detail[length] = (c >= 0x20 && c < 0x7F) ? static_cast<char>(c) : '?';
+        }
+    }
+    event.detail[length] = '\0';
+
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void TRACE::Clear()
+{
+    REGISTRY& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& buffer : registry.buffers)
+    {
+        buffer->first.store(buffer->count.load(std::memory_order_acquire), std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t TRACE::SpanCount()
+{
+    REGISTRY& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    size_t spans = 0;
+    for (auto& buffer : registry.buffers) { spans += buffer->count.load(std::memory_order_acquire) - buffer->first.load(std::memory_order_relaxed); }
+    return spans;
+}
+
+size_t TRACE::DroppedCount()
+{
+    REGISTRY& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    size_t dropped = 0;
+    for (auto& buffer : registry.buffers) { dropped += buffer->dropped.load(std::memory_order_relaxed); }
+    return dropped;
+}
+
+void TRACE::WriteJson(std::ostream& out)
+{
+    REGISTRY& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // "X" events are complete spans with a start and a duration, both in microseconds
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first_event = true;
+    char number[64];
+    for (auto& buffer : registry.buffers)
+    {
+        if (!first_event) { out << ",\n"; }
+        first_event = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t index = buffer->first.load(std::memory_order_relaxed); index < count; index++)
+        {
+            const EVENT& event = buffer->blocks[index / BLOCK_EVENTS][index % BLOCK_EVENTS];
+            std::snprintf(number, sizeof(number), "\"ts\":%.3f,\"dur\":%.3f", event.start_ns / 1e3, (event.end_ns - event.start_ns) / 1e3);
+            out << ",\n{\"name\":\"";
+            WriteEscaped(out, event.name);
+            out << "\",\"cat\":\"gui\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid << ',' << number;
+            if (event.detail[0])
+            {
+                out << ",\"args\":{\"detail\":\"";
+                WriteEscaped(out, event.detail);
+                out << "\"}";
+            }
+            out << '}';
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool TRACE::Dump(const char* path)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) { return false; }
+    WriteJson(file);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+/*
+Scoped spans in the Chrome trace event format. The dump opens in chrome://tracing or ui.perfetto.dev.
+
+    void GUI::AddButton(...)
+    {
+        TRACE_SPAN("AddButton");                  // Span from here to the end of the scope
+        TRACE_SPAN_DETAIL("CreateFont", face);    // Same with a short text shown as args.detail
+        ...
+    }
+
+Set GUI_TRACE=trace.json to record from the start of main() and write the file on exit, or use Start/Dump from code.
+Every thread records into its own buffer, so recording does not lock. When tracing is off a span is a single load and branch.
+Names have to be string literals, only the pointer is stored.
+*/
+class TRACE
+{
+public:
+
+    // Starts recording if the environment variable GUI_TRACE is set and writes the trace to that path on exit
+    static void StartFromEnvironment();
+
+    static void Start();
+    static void Stop();
+
+    static bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Writes everything recorded so far as trace event JSON. Can be called while other threads are recording
+    static bool Dump(const char* path);
+    static void WriteJson(std::ostream& out);
+
+    // Drops everything recorded so far
+    static void Clear();
+
+    // Number of spans recorded since the last Clear and spans that did not fit into the buffers
+    static size_t SpanCount();
+    static size_t DroppedCount();
+
+    static uint64_t NowNs();
+
+    // Used by TRACE_SCOPE
+    static void Record(const char* name, uint64_t start_ns, uint64_t end_ns, const wchar_t* detail);
+
+private:
+
+    static std::atomic<bool> enabled;
+};
+
+// Records one span for the lifetime of the object. Use the macros below
+class TRACE_SCOPE
+{
+public:
+
+    explicit TRACE_SCOPE(const char* name, const wchar_t* detail = nullptr)
+    {
+        if (TRACE::Enabled())
+        {
+            this->name   = name;
+            this->detail = detail;
+            start_ns     = TRACE::NowNs();
+        }
+    }
+
+    ~TRACE_SCOPE()
+    {
+        if (name) { TRACE::Record(name, start_ns, TRACE::NowNs(), detail); }
+    }
+
+    TRACE_SCOPE(const TRACE_SCOPE&) = delete;
+    TRACE_SCOPE& operator=(const TRACE_SCOPE&) = delete;
+
+private:
+
+    const char*    name     = nullptr;
+    const wchar_t* detail   = nullptr;
+    uint64_t       start_ns = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) TRACE_SCOPE TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_SPAN_DETAIL(name, detail) TRACE_SCOPE TRACE_CONCAT(trace_scope_, __LINE__)(name, detail)
+
+#endif // TRACE_H
@@ -0,0 +1,349 @@
+#include "utf.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr char32_t REPLACEMENT = 0xFFFD;
+
+    // A vector run at least this long means the text is mostly what the vector code handles
+    constexpr size_t LONG_VECTOR_RUN = 16;
+
+    // Units the scalar code converts at most before the vector code tries again. Shorter runs lose more to retries that fail on CJK than they win on mixed text
+    constexpr size_t SCALAR_RUN = 64;
+
+    /*
+    Where the scalar code hands back to the vector code. After a long vector run the text is mostly ASCII, so only the one code point that stopped it is converted.
+    Otherwise (CJK with spaces in between) the vector code would give up again after a unit or two, so the scalar code takes a whole run.
+    */
+    size_t ScalarStop(size_t i, size_t length, size_t vector_units)
+    {
+        return vector_units >= LONG_VECTOR_RUN ? i : std::min(length, i + SCALAR_RUN);
+    }
+
+    // Next code point of UTF-16 text at i. Advances i past it
+    char32_t Next(const char16_t* text, size_t length, size_t& i, size_t& errors)
+    {
+        char32_t unit = text[i++];
+        if (unit < 0xD800 || unit >= 0xE000) { return unit; }
+        if (UTF::IsHighSurrogate(unit) && i < length && UTF::IsLowSurrogate(text[i]))
+        {
+            return 0x10000 + ((unit - 0xD800) << 10) + (text[i++] - 0xDC00);
+        }
+        errors++;
+        return REPLACEMENT;
+    }
+
+    char32_t Next(const char32_t* text, size_t, size_t& i, size_t& errors)
+    {
+        char32_t unit = text[i++];
+        if (unit > 0x10FFFF || (unit >= 0xD800 && unit < 0xE000)) { errors++; return REPLACEMENT; }
+        return unit;
+    }
+
+    /*
+    Next code point of UTF-8 text at i. Advances i past it.
+    An invalid sequence gives one U+FFFD and skips its longest valid beginning (the "maximal subpart" of the unicode standard),
+    so "\xE2\x82" followed by "A" is U+FFFD and A.
+    */
+    char32_t NextUtf8(const unsigned char* text, size_t length, size_t& i, size_t& errors)
+    {
+        unsigned char lead = text[i];
+        if (lead < 0x80) { i++; return lead; }
+
+        size_t   continuations;
+        char32_t code_point;
+        unsigned char low = 0x80, high = 0xBF;  // allowed range of the first continuation byte
+        if (lead >= 0xC2 && lead <= 0xDF)      { continuations = 1; code_point = lead & 0x1F; }
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            continuations = 2;
+            code_point    = lead & 0x0F;
+            if (lead == 0xE0) { low = 0xA0; }   // overlong
+            if (lead == 0xED) { high = 0x9F; }  // surrogates
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            continuations = 3;
+            code_point    = lead & 0x07;
+            if (lead == 0xF0) { low = 0x90; }         // overlong
+            if (lead == 0xF4) { high = 0x8F; }        // above U+10FFFF
+        }
+        else { i++; errors++; return REPLACEMENT; }
+
+        size_t next = i + 1;
+        for (size_t k = 0; k < continuations; k++, next++)
+        {
+            if (next >= length || text[next] < low || text[next] > high) { i = next; errors++; return REPLACEMENT; }
+            code_point = (code_point << 6) | (text[next] & 0x3F);
+            low  = 0x80;
+            high = 0xBF;
+        }
+        i = next;
+        return code_point;
+    }
+
+    size_t Utf8Bytes(char32_t code_point)
+    {
+        return code_point < 0x80 ? 1 : code_point < 0x800 ? 2 : code_point < 0x10000 ? 3 : 4;
+    }
+
+    // Inlined into the loops, otherwise gcc splits off the 3 byte case and every CJK character pays for a call
+    [[gnu::always_inline]] inline size_t PutUtf8(char* out, char32_t code_point)
+    {
+        if (code_point < 0x80) { out[0] = static_cast<char>(code_point); return 1; }
+        if (code_point < 0x800)
+        {
+            out[0] = static_cast<char>(0xC0 | (code_point >> 6));
+            out[1] = static_cast<char>(0x80 | (code_point & 0x3F));
+            return 2;
+        }
+        if (code_point < 0x10000)
+        {
+            out[0] = static_cast<char>(0xE0 | (code_point >> 12));
+            out[1] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            out[2] = static_cast<char>(0x80 | (code_point & 0x3F));
+            return 3;
+        }
+        out[0] = static_cast<char>(0xF0 | (code_point >> 18));
+        out[1] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out[2] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out[3] = static_cast<char>(0x80 | (code_point & 0x3F));
+        return 4;
+    }
+
+    // The scalar fallback without surrogates, as fast as the one character loop a caller would write
+    [[gnu::always_inline]] inline size_t PutBmp(char* out, char32_t unit)
+    {
+        if (unit < 0x80) { out[0] = static_cast<char>(unit); return 1; }
+        if (unit < 0x800)
+        {
+            out[0] = static_cast<char>(0xC0 | (unit >> 6));
+            out[1] = static_cast<char>(0x80 | (unit & 0x3F));
+            return 2;
+        }
+        out[0] = static_cast<char>(0xE0 | (unit >> 12));
+        out[1] = static_cast<char>(0x80 | ((unit >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (unit & 0x3F));
+        return 3;
+    }
+
+    size_t Put(char16_t* out, char32_t code_point)
+    {
+        if (code_point < 0x10000) { out[0] = static_cast<char16_t>(code_point); return 1; }
+        code_point -= 0x10000;
+        out[0] = static_cast<char16_t>(0xD800 + (code_point >> 10));
+        out[1] = static_cast<char16_t>(0xDC00 + (code_point & 0x3FF));
+        return 2;
+    }
+
+    size_t Put(char32_t* out, char32_t code_point)
+    {
+        out[0] = code_point;
+        return 1;
+    }
+
+    /*
+    pshufb masks that pack 4 units, each as [lead, second, third, 0] in a 32 bit lane, to their 1, 2 or 3 byte UTF-8 sequences.
+    Indexed by which of the units are below 0x80 (low 4 bits) and below 0x800 (high 4 bits).
+    */
+    struct PACK
+    {
+        alignas(16) uint8_t shuffle[16];
+        uint8_t             bytes;
+    };
+
+    constexpr std::array<PACK, 256> PACKS = []
+    {
+        std::array<PACK, 256> packs = {};
+        for (unsigned index = 0; index < packs.size(); index++)
+        {
+            PACK& pack = packs[index];
+            unsigned out = 0;
+            for (unsigned unit = 0; unit < 4; unit++)
+            {
+                const unsigned bytes = 3 - ((index >> unit) & 1) - ((index >> (unit + 4)) & 1);
+                for (unsigned byte = 0; byte < bytes; byte++) { pack.shuffle[out++] = static_cast<uint8_t>(unit * 4 + byte); }
+            }
+            pack.bytes = static_cast<uint8_t>(out);
+            for (; out < 16; out++) { pack.shuffle[out] = 0x80; } // zero
+        }
+        return packs;
+    }();
+}
+
+/*
+The vector code, once as the compiler flags allow and once more for every instruction set above them that GCC can target per function.
+UTF picks the best the CPU has when it is first used, so the default SSE2 build still runs the SSSE3 and AVX2 code.
+*/
+#if defined(__AVX2__)
+#define UTF_AVX2 1
+#else
+#define UTF_AVX2 0
+#endif
+#if defined(__SSSE3__)
+#define UTF_SSSE3 1
+#else
+#define UTF_SSSE3 0
+#endif
+#if defined(__SSE2__)
+#define UTF_SSE2 1
+#else
+#define UTF_SSE2 0
+#endif
+namespace
+{
+    namespace baseline
+    {
+        #include "utf_simd.h"
+    }
+}
+#undef UTF_SSE2
+#undef UTF_SSSE3
+#undef UTF_AVX2
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF_DISPATCH 1
+#define UTF_SSE2  1
+#define UTF_AVX2  0
+#define UTF_SSSE3 1
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+namespace
+{
+    namespace ssse3
+    {
+        #include "utf_simd.h"
+    }
+}
+#pragma GCC pop_options
+#undef UTF_AVX2
+#define UTF_AVX2 1
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace
+{
+    namespace avx2
+    {
+        #include "utf_simd.h"
+    }
+}
+#pragma GCC pop_options
+#undef UTF_SSE2
+#undef UTF_SSSE3
+#undef UTF_AVX2
+#else
+#define UTF_DISPATCH 0
+namespace
+{
+    namespace ssse3 = baseline;
+    namespace avx2  = baseline;
+}
+#endif
+
+namespace
+{
+    enum class LEVEL { BASELINE, SSSE3, AVX2 };
+
+    const char* BaselineName()
+    {
+#if defined(__AVX2__)
+        return "avx2";
+#elif defined(__SSSE3__)
+        return "ssse3";
+#elif defined(__SSE2__)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    bool Supported(LEVEL level)
+    {
+#if UTF_DISPATCH
+        __builtin_cpu_init();
+        if (level == LEVEL::AVX2)  { return __builtin_cpu_supports("avx2"); }
+        if (level == LEVEL::SSSE3) { return __builtin_cpu_supports("ssse3"); }
+#endif
+        return level == LEVEL::BASELINE;
+    }
+
+    // Chosen on the first call. SetImplementation changes it
+    std::atomic<LEVEL>& Level()
+    {
+        static std::atomic<LEVEL> level(Supported(LEVEL::AVX2) ? LEVEL::AVX2 : Supported(LEVEL::SSSE3) ? LEVEL::SSSE3 : LEVEL::BASELINE);
+        return level;
+    }
+}
+
+// Calls the function of the chosen instruction set
+#define UTF_CALL(call)                                                   \
+    switch (Level().load(std::memory_order_relaxed))                     \
+    {                                                                    \
+        case LEVEL::AVX2:  return avx2::call;                            \
+        case LEVEL::SSSE3: return ssse3::call;                           \
+        default:           return baseline::call;                        \
+    }
+
+size_t UTF::Utf8Length(const char16_t* text, size_t length) { UTF_CALL(Utf8LengthOf(text, length)) }
+size_t UTF::Utf8Length(const char32_t* text, size_t length) { UTF_CALL(Utf8LengthOf(text, length)) }
+
+UTF::RESULT UTF::ToUtf8(const char16_t* text, size_t length, char* out) { UTF_CALL(ToUtf8Of(text, length, out)) }
+UTF::RESULT UTF::ToUtf8(const char32_t* text, size_t length, char* out) { UTF_CALL(ToUtf8Of(text, length, out)) }
+
+UTF::RESULT UTF::FromUtf8(const char* text, size_t length, char16_t* out) { UTF_CALL(FromUtf8Of(text, length, out)) }
+UTF::RESULT UTF::FromUtf8(const char* text, size_t length, char32_t* out) { UTF_CALL(FromUtf8Of(text, length, out)) }
+
+UTF::RESULT UTF::ToLatin1(const char16_t* text, size_t length, char* out) { UTF_CALL(ToLatin1Of(text, length, out)) }
+UTF::RESULT UTF::ToLatin1(const char32_t* text, size_t length, char* out) { UTF_CALL(ToLatin1Of(text, length, out)) }
+
+bool UTF::IsValidUtf8(const char* text, size_t length) { UTF_CALL(IsValidUtf8Of(reinterpret_cast<const unsigned char*>(text), length)) }
+
+#undef UTF_CALL
+
+size_t UTF::CompleteUtf8(const char* utf8, size_t length)
+{
+    // Only the last 3 bytes can belong to an unfinished sequence. Cutting in front of a lead byte never changes how the rest decodes
+    const unsigned char* text = reinterpret_cast<const unsigned char*>(utf8);
+    for (size_t back = 1; back <= 3 && back <= length; back++)
+    {
+        unsigned char byte = text[length - back];
+        if (byte < 0x80) { break; }
+        if (byte < 0xC0) { continue; }  // continuation byte
+        size_t needed = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : 2;
+        return needed > back ? length - back : length;
+    }
+    return length;
+}
+
+const char* UTF::Implementation()
+{
+    switch (Level().load(std::memory_order_relaxed))
+    {
+        case LEVEL::AVX2:  return "avx2";
+        case LEVEL::SSSE3: return "ssse3";
+        default:           return BaselineName();
+    }
+}
+
+bool UTF::SetImplementation(const char* name)
+{
+    const std::string_view wanted = name;
+    for (LEVEL level : {LEVEL::AVX2, LEVEL::SSSE3, LEVEL::BASELINE})
+    {
+        const char* level_name = level == LEVEL::AVX2 ? "avx2" : level == LEVEL::SSSE3 ? "ssse3" : BaselineName();
+        if (wanted == level_name && Supported(level))
+        {
+            Level().store(level, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef UTF_H
+#define UTF_H
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/*
+Conversion between UTF-8, UTF-16 and UTF-32 plus the Latin-1 CF_TEXT of the headless backend, for clipboard formats and text from stdin.
+Runs of ASCII are converted 16 (SSE2) or 32 (AVX2) characters at a time. With SSSE3, UTF-16/32 without surrogates goes to UTF-8 8 characters at a time
+through shuffles, runs of 3 byte UTF-8 (most of CJK) come back 4 at a time and IsValidUtf8 checks any UTF-8 16 bytes at a time. Everything else goes through the scalar code.
+The vector paths give exactly the same output as the scalar one. With GCC on x86 the SSSE3 and AVX2 ones are always compiled in and picked at runtime by what
+the CPU has, so the default build uses them too. Other compilers get what their flags allow, like HASH.
+
+Invalid input is never rejected: unpaired surrogates, invalid UTF-8 bytes and code points above U+10FFFF become U+FFFD and are counted in RESULT::errors.
+So errors == 0 means the input was valid.
+
+WCHAR is UTF-16 on windows and UTF-32 where wchar_t has 32 bits (the headless build), WIDE is the matching char16_t or char32_t.
+*/
+class UTF
+{
+public:
+
+    using WIDE = std::conditional_t<sizeof(wchar_t) == 2, char16_t, char32_t>;
+
+    struct RESULT
+    {
+        size_t written;  // code units
+        size_t errors;   // replaced with U+FFFD (or '?' for Latin1)
+    };
+
+    // Exact number of bytes ToUtf8 writes
+    static size_t Utf8Length(const char16_t* text, size_t length);
+    static size_t Utf8Length(const char32_t* text, size_t length);
+
+    // out needs Utf8Length (at most 3 * length) bytes. No terminating zero is written
+    static RESULT ToUtf8(const char16_t* text, size_t length, char* out);
+    static RESULT ToUtf8(const char32_t* text, size_t length, char* out);
+
+    // out needs room for length units (UTF-8 never takes fewer units in UTF-16 or UTF-32 than in bytes)
+    static RESULT FromUtf8(const char* text, size_t length, char16_t* out);
+    static RESULT FromUtf8(const char* text, size_t length, char32_t* out);
+
+    // ISO 8859-1 (also what code page 1252 has above 0x9F). Other characters become '?'. out needs length bytes
+    static RESULT ToLatin1(const char16_t* text, size_t length, char* out);
+    static RESULT ToLatin1(const char32_t* text, size_t length, char* out);
+
+    static bool IsValidUtf8(const char* text, size_t length);
+
+    // Length of text without a sequence at the end that is cut off, for UTF-8 that arrives in pieces. The cut off bytes go in front of the next piece
+    static size_t CompleteUtf8(const char* text, size_t length);
+
+    // WCHAR text as WIDE
+    static const WIDE* Wide(const wchar_t* text) { return reinterpret_cast<const WIDE*>(text); }
+    static WIDE* Wide(wchar_t* text) { return reinterpret_cast<WIDE*>(text); }
+
+    static bool IsHighSurrogate(uint32_t unit) { return unit >= 0xD800 && unit < 0xDC00; }
+    static bool IsLowSurrogate(uint32_t unit) { return unit >= 0xDC00 && unit < 0xE000; }
+
+    // Name of the code path in use ("avx2", "ssse3", "sse2" or "scalar")
+    static const char* Implementation();
+
+    // Uses the named code path from now on, e.g. to compare them in the benchmarks. False if it is not compiled in or the CPU does not have it
+    static bool SetImplementation(const char* name);
+};
+
+#endif // UTF_H
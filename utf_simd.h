@@ -0,0 +1,508 @@
+/*
+The vector code of UTF and the loops around it. No include guard: utf.cpp includes it once per instruction set, each time in its own namespace
+and with UTF_SSE2, UTF_SSSE3 and UTF_AVX2 set to what that copy may use (a #pragma GCC target does not change __SSSE3__ and the like in C++).
+*/
+
+/*
+Vector paths. Each converts blocks from the start of the text as long as the condition holds and returns the number of units it converted.
+The block that breaks the condition is written completely, but only the units in front of the first one that does not fit count.
+The scalar code overwrites the rest, so out needs room for a whole block wherever a block of input is left (the callers' buffers always have that).
+*/
+
+// UTF-16 units below limit (0x80 or 0x100) to bytes
+size_t Narrow(const char16_t* text, size_t length, char* out, uint16_t limit)
+{
+    size_t i = 0;
+    [[maybe_unused]] const uint16_t mask = static_cast<uint16_t>(~(limit - 1));
+#if UTF_AVX2
+    const __m256i mask256 = _mm256_set1_epi16(static_cast<short>(mask));
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + 16));
+        if (!_mm256_testz_si256(_mm256_or_si256(a, b), mask256)) { break; }
+        // packus works per 128 bit lane, the permute puts the four quarters back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+#endif
+#if UTF_SSE2
+    const __m128i mask128 = _mm_set1_epi16(static_cast<short>(mask));
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 8));
+        unsigned fits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(a, mask128), _mm_setzero_si128())))
+                      | static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(b, mask128), _mm_setzero_si128()))) << 16;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(a, b));
+        if (fits != 0xFFFFFFFF) { return i + std::countr_one(fits) / 2; }
+    }
+#endif
+    (void)text; (void)length; (void)out;
+    return i;
+}
+
+// UTF-32 units below limit to bytes
+size_t Narrow(const char32_t* text, size_t length, char* out, uint32_t limit)
+{
+    size_t i = 0;
+#if UTF_SSE2
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(~(limit - 1)));
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 4));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 8));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 12));
+        const __m128i zero = _mm_setzero_si128();
+        uint64_t fits = uint64_t(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(a, mask), zero))))
+                      | uint64_t(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(b, mask), zero)))) << 16
+                      | uint64_t(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(c, mask), zero)))) << 32
+                      | uint64_t(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(d, mask), zero)))) << 48;
+        // The values below the limit come out unchanged through the saturating packs
+        __m128i words = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), words);
+        if (fits != ~uint64_t(0)) { return i + std::countr_one(fits) / 4; }
+    }
+#endif
+    (void)text; (void)length; (void)out; (void)limit;
+    return i;
+}
+
+// ASCII bytes to UTF-16 units
+size_t Widen(const unsigned char* text, size_t length, char16_t* out)
+{
+    size_t i = 0;
+#if UTF_AVX2
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        if (_mm256_movemask_epi8(bytes)) { break; }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+    }
+#endif
+#if UTF_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+        if (int high = _mm_movemask_epi8(bytes)) { return i + std::countr_zero(static_cast<unsigned>(high)); }
+    }
+#endif
+    (void)text; (void)length; (void)out;
+    return i;
+}
+
+// ASCII bytes to UTF-32 units
+size_t Widen(const unsigned char* text, size_t length, char32_t* out)
+{
+    size_t i = 0;
+#if UTF_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i low  = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 12), _mm_unpackhi_epi16(high, zero));
+        if (int non_ascii = _mm_movemask_epi8(bytes)) { return i + std::countr_zero(static_cast<unsigned>(non_ascii)); }
+    }
+#endif
+    (void)text; (void)length; (void)out;
+    return i;
+}
+
+#if UTF_SSSE3
+// Ones where mask is set, the others from b
+inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// 8 BMP units to UTF-8. False, with nothing written, if one is a surrogate or all are ASCII (Narrow does those faster)
+inline bool EncodeBlock(__m128i units, char* out, size_t& written)
+{
+    const __m128i zero      = _mm_setzero_si128();
+    const __m128i high      = _mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xF800)));
+    const __m128i below_80  = _mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xFF80))), zero);
+    const __m128i below_800 = _mm_cmpeq_epi16(high, zero);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_set1_epi16(static_cast<short>(0xD800)))) || _mm_movemask_epi8(below_80) == 0xFFFF) { return false; }
+
+    const __m128i low6   = _mm_set1_epi16(0x3F);
+    const __m128i last   = _mm_or_si128(_mm_and_si128(units, low6), _mm_set1_epi16(0x80));
+    const __m128i middle = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(units, 6), low6), _mm_set1_epi16(0x80));
+    const __m128i lead2  = _mm_or_si128(_mm_srli_epi16(units, 6), _mm_set1_epi16(0xC0));
+    const __m128i lead3  = _mm_or_si128(_mm_srli_epi16(units, 12), _mm_set1_epi16(0xE0));
+    const __m128i first  = Select(below_80, units, Select(below_800, lead2, lead3));
+    const __m128i second = Select(below_800, last, middle);
+
+    // [first, second, last, 0] per unit, 4 units per vector
+    const __m128i pairs = _mm_or_si128(first, _mm_slli_epi16(second, 8));
+    const __m128i low   = _mm_unpacklo_epi16(pairs, last);
+    const __m128i upper = _mm_unpackhi_epi16(pairs, last);
+
+    // Bits 0-7 below 0x80, 8-15 below 0x800
+    const unsigned below = static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(below_80, below_800)));
+    const PACK& a = PACKS[(below & 0x0F) | ((below >> 4) & 0xF0)];
+    const PACK& b = PACKS[((below >> 4) & 0x0F) | ((below >> 8) & 0xF0)];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), _mm_shuffle_epi8(low, _mm_load_si128(reinterpret_cast<const __m128i*>(a.shuffle))));
+    written += a.bytes;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), _mm_shuffle_epi8(upper, _mm_load_si128(reinterpret_cast<const __m128i*>(b.shuffle))));
+    written += b.bytes;
+    return true;
+}
+#endif
+
+/*
+Blocks of 8 units up to U+FFFF, without surrogates, to UTF-8. Stops at a block that is all ASCII.
+Only runs with 16 more units behind the block: the second store writes 16 bytes, which the bytes of those units always cover, so it never writes past Utf8Length.
+*/
+size_t Encode(const char16_t* text, size_t length, char* out, size_t& written)
+{
+    size_t i = 0;
+#if UTF_SSSE3
+    for (; i + 24 <= length; i += 8)
+    {
+        if (!EncodeBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)), out, written)) { break; }
+    }
+#endif
+    (void)text; (void)length; (void)out; (void)written;
+    return i;
+}
+
+size_t Encode(const char32_t* text, size_t length, char* out, size_t& written)
+{
+    size_t i = 0;
+#if UTF_SSSE3
+    const __m128i low_halves = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i above_bmp  = _mm_set1_epi32(static_cast<int>(0xFFFF0000));
+    for (; i + 24 <= length; i += 8)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 4));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(a, b), above_bmp), _mm_setzero_si128())) != 0xFFFF) { break; }
+        const __m128i units = _mm_unpacklo_epi64(_mm_shuffle_epi8(a, low_halves), _mm_shuffle_epi8(b, low_halves));
+        if (!EncodeBlock(units, out, written)) { break; }
+    }
+#endif
+    (void)text; (void)length; (void)out; (void)written;
+    return i;
+}
+
+/*
+Runs of 3 byte sequences (most of CJK) to units, 4 at a time. Stops at anything else, including invalid sequences the scalar code has to replace.
+Returns the units written, each took 3 bytes of text.
+*/
+template<class UNIT>
+size_t DecodeThree(const unsigned char* text, size_t length, UNIT* out)
+{
+    size_t units = 0;
+#if UTF_SSSE3
+    // [third, second, lead, 0] per 32 bit lane
+    const __m128i gather  = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    const __m128i form    = _mm_set1_epi32(0x00F0C0C0);
+    const __m128i sequence = _mm_set1_epi32(0x00E08080);
+    for (size_t i = 0; i + 16 <= length; i += 12, units += 4)
+    {
+        const __m128i lanes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)), gather);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(lanes, form), sequence)) != 0xFFFF) { break; }
+        const __m128i code = _mm_or_si128(_mm_or_si128(_mm_and_si128(lanes, _mm_set1_epi32(0x3F)),
+                                                       _mm_srli_epi32(_mm_and_si128(lanes, _mm_set1_epi32(0x3F00)), 2)),
+                                          _mm_srli_epi32(_mm_and_si128(lanes, _mm_set1_epi32(0x0F0000)), 4));
+
+        // Overlong forms and surrogates
+        const __m128i invalid = _mm_or_si128(_mm_cmplt_epi32(code, _mm_set1_epi32(0x800)),
+                                             _mm_cmpeq_epi32(_mm_and_si128(code, _mm_set1_epi32(0xF800)), _mm_set1_epi32(0xD800)));
+        if (_mm_movemask_epi8(invalid)) { break; }
+        if constexpr (sizeof(UNIT) == 2)
+        {
+            const __m128i low_halves = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + units), _mm_shuffle_epi8(code, low_halves));
+        }
+        else { _mm_storeu_si128(reinterpret_cast<__m128i*>(out + units), code); }
+    }
+#endif
+    (void)text; (void)length; (void)out;
+    return units;
+}
+
+#if !UTF_SSSE3
+// Number of leading ASCII bytes (up to the last whole block)
+size_t SkipAscii(const unsigned char* text, size_t length)
+{
+    size_t i = 0;
+#if UTF_SSE2
+    for (; i + 16 <= length; i += 16)
+    {
+        if (int high = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)))) { return i + std::countr_zero(static_cast<unsigned>(high)); }
+    }
+#endif
+    (void)text; (void)length;
+    return i;
+}
+#endif
+
+/*
+UTF-8 length of UTF-16 blocks without surrogates: every unit takes 3 bytes, minus one if it is below 0x800 and one more if it is below 0x80.
+The compares give -1 per lane, so the lanes sum up the bytes to subtract. Adds to bytes, returns the units counted.
+*/
+size_t CountUtf8(const char16_t* text, size_t length, size_t& bytes)
+{
+    size_t i = 0;
+#if UTF_SSE2
+    const __m128i ascii_mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i high_mask  = _mm_set1_epi16(static_cast<short>(0xF800));
+    const __m128i surrogate  = _mm_set1_epi16(static_cast<short>(0xD800));
+    const __m128i zero       = _mm_setzero_si128();
+    const __m128i ones       = _mm_set1_epi16(1);
+    long long saved = 0;  // subtracted bytes of the flushed blocks, negative
+    __m128i   sum   = zero;
+    size_t    blocks = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i high  = _mm_and_si128(units, high_mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, surrogate))) { break; }
+        __m128i below_80  = _mm_cmpeq_epi16(_mm_and_si128(units, ascii_mask), zero);
+        __m128i below_800 = _mm_cmpeq_epi16(high, zero);
+        sum = _mm_add_epi16(sum, _mm_add_epi16(below_80, below_800));
+
+        // A lane drops by at most 2 per block, flush before it can overflow
+        if (++blocks == 16000)
+        {
+            __m128i pairs = _mm_madd_epi16(sum, ones);
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), pairs);
+            saved += static_cast<long long>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+            sum    = zero;
+            blocks = 0;
+        }
+    }
+    __m128i pairs = _mm_madd_epi16(sum, ones);
+    alignas(16) int lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), pairs);
+    saved += static_cast<long long>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    bytes += static_cast<size_t>(static_cast<long long>(3 * i) + saved);
+#endif
+    (void)text; (void)length; (void)bytes;
+    return i;
+}
+
+size_t CountUtf8(const char32_t*, size_t, size_t&)
+{
+    return 0;
+}
+
+template<class UNIT>
+size_t Utf8LengthOf(const UNIT* text, size_t length)
+{
+    size_t bytes = 0, errors = 0, i = 0;
+    while (i < length)
+    {
+        size_t counted = CountUtf8(text + i, length - i, bytes);
+        i += counted;
+        if (i == length) { break; }
+        size_t stop = ScalarStop(i, length, counted);
+        do { bytes += Utf8Bytes(Next(text, length, i, errors)); } while (i < stop);
+    }
+    return bytes;
+}
+
+template<class UNIT>
+UTF::RESULT ToUtf8Of(const UNIT* text, size_t length, char* out)
+{
+    // Locals instead of result members, the char stores through out could alias those
+    size_t i = 0, written = 0, errors = 0;
+    while (i < length)
+    {
+        size_t ascii = Narrow(text + i, length - i, out + written, 0x80);
+        i += ascii;
+        written += ascii;
+        if (i == length) { break; }
+        size_t encoded = Encode(text + i, length - i, out, written);
+        i += encoded;
+        if (i == length) { break; }
+        size_t stop = ScalarStop(i, length, ascii + encoded);
+        do
+        {
+            const char32_t unit = text[i];
+            if (unit < 0xD800 || (unit >= 0xE000 && unit < 0x10000)) { written += PutBmp(out + written, unit); i++; }
+            else { written += PutUtf8(out + written, Next(text, length, i, errors)); }
+        } while (i < stop);
+    }
+    return { written, errors };
+}
+
+template<class UNIT>
+UTF::RESULT FromUtf8Of(const char* utf8, size_t length, UNIT* out)
+{
+    const unsigned char* text = reinterpret_cast<const unsigned char*>(utf8);
+    UTF::RESULT result = {};
+    size_t i = 0;
+    while (i < length)
+    {
+        size_t ascii = Widen(text + i, length - i, out + result.written);
+        i += ascii;
+        result.written += ascii;
+        if (i == length) { break; }
+        size_t decoded = DecodeThree(text + i, length - i, out + result.written);
+        i += 3 * decoded;
+        result.written += decoded;
+        if (i == length) { break; }
+        size_t stop = ScalarStop(i, length, ascii + decoded);
+        do { result.written += Put(out + result.written, NextUtf8(text, length, i, result.errors)); } while (i < stop);
+    }
+    return result;
+}
+
+template<class UNIT>
+UTF::RESULT ToLatin1Of(const UNIT* text, size_t length, char* out)
+{
+    UTF::RESULT result = {};
+    size_t i = 0;
+    while (i < length)
+    {
+        size_t direct = Narrow(text + i, length - i, out + result.written, 0x100);
+        i += direct;
+        result.written += direct;
+        if (i == length) { break; }
+        size_t stop = ScalarStop(i, length, direct);
+        do
+        {
+            size_t errors = 0;
+            char32_t code_point = Next(text, length, i, errors);
+            if (code_point < 0x100 && !errors) { out[result.written++] = static_cast<char>(code_point); }
+            else { out[result.written++] = '?'; result.errors++; }
+        } while (i < stop);
+    }
+    return result;
+}
+
+#if UTF_SSSE3
+/*
+Errors of a block of 16 bytes, the lookup validation of Keiser and Lemire ("Validating UTF-8 In Less Than One Instruction Per Byte", as in simdjson).
+Three table lookups of the nibbles of each byte and the one before it flag every invalid pair: a lead without continuation, a continuation without lead,
+overlong forms, surrogates and code points above U+10FFFF. The third and fourth byte of a sequence are checked by whether the byte 2 or 3 back is a lead of 3 or 4 bytes.
+*/
+inline __m128i Utf8Errors(__m128i input, __m128i previous)
+{
+    constexpr char TOO_SHORT  = 1 << 0;  // lead or ASCII followed by a lead: 11______ 0_______, 11______ 11______
+    constexpr char TOO_LONG   = 1 << 1;  // ASCII followed by a continuation
+    constexpr char OVERLONG_3 = 1 << 2;  // 11100000 100_____
+    constexpr char TOO_LARGE  = 1 << 3;  // 11110100 1001____, 11110100 101_____, 11110101 1001____...
+    constexpr char SURROGATE  = 1 << 4;  // 11101101 101_____
+    constexpr char OVERLONG_2 = 1 << 5;  // 1100000_ 10______
+    constexpr char LARGE_1000 = 1 << 6;  // 11110101 1000____, 1111011_ 1000____, 11111___ 1000____
+    constexpr char OVERLONG_4 = 1 << 6;  // 11110000 1000____
+    constexpr char TWO_CONTS  = static_cast<char>(1 << 7);  // 10______ 10______, unless the byte before starts 3 or 4 bytes
+    constexpr char CARRY      = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    const __m128i byte_1_high_table = _mm_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | LARGE_1000 | OVERLONG_4);
+    const __m128i byte_1_low_table = _mm_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | LARGE_1000,
+        CARRY | TOO_LARGE | LARGE_1000);
+    const __m128i byte_2_high_table = _mm_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i prev1  = _mm_alignr_epi8(input, previous, 15);
+    const __m128i byte_1_high = _mm_shuffle_epi8(byte_1_high_table, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+    const __m128i byte_1_low  = _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, nibble));
+    const __m128i byte_2_high = _mm_shuffle_epi8(byte_2_high_table, _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+    const __m128i special     = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+    // Only 111_____ two bytes back and 1111____ three bytes back end up at 0x80 or above
+    const __m128i third  = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 14), _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(input, previous, 13), _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(must_continue, special);
+}
+
+// Not zero if the block ends in a sequence that needs bytes of the next one
+inline __m128i Utf8Incomplete(__m128i input)
+{
+    const __m128i last = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                       static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm_subs_epu8(input, last);
+}
+#endif
+
+bool IsValidUtf8Of(const unsigned char* text, size_t length)
+{
+#if UTF_SSSE3
+    const __m128i zero = _mm_setzero_si128();
+    __m128i errors = zero, previous = zero, incomplete = zero;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+
+        if (_mm_movemask_epi8(input))
+        {
+            errors     = _mm_or_si128(errors, Utf8Errors(input, previous));
+            incomplete = Utf8Incomplete(input);
+        }
+        else
+        {
+            // ASCII only has to finish what the block before started
+            errors     = _mm_or_si128(errors, incomplete);
+            incomplete = zero;
+        }
+        previous = input;
+    }
+
+    // The rest with zeros behind it. Zeros are ASCII, so a sequence the end cuts off is too short, or incomplete if it reaches the last bytes of the block
+    if (i < length)
+    {
+        alignas(16) unsigned char rest[16] = {};
+        std::memcpy(rest, text + i, length - i);
+        const __m128i input = _mm_load_si128(reinterpret_cast<const __m128i*>(rest));
+        errors     = _mm_or_si128(errors, Utf8Errors(input, previous));
+        incomplete = Utf8Incomplete(input);
+    }
+    errors = _mm_or_si128(errors, incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(errors, zero)) == 0xFFFF;
+#else
+    size_t errors = 0, i = 0;
+    while (i < length && !errors)
+    {
+        size_t ascii = SkipAscii(text + i, length - i);
+        i += ascii;
+        if (i == length) { break; }
+        size_t stop = ScalarStop(i, length, ascii);
+        do { NextUtf8(text, length, i, errors); } while (i < stop);
+    }
+    return errors == 0;
+#endif
+}
@@ -0,0 +1,249 @@
+#include "workers.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace
+{
+    // Pool and deque of the worker the calling thread is, if any
+    thread_local const WORKER_POOL* t_pool  = nullptr;
+    thread_local size_t             t_index = 0;
+}
+
+WORKER_POOL::WORKER_POOL(size_t threads)
+    : thread_count(threads ? threads : std::max<size_t>(1, std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1))
+{
+    for (size_t i = 0; i < thread_count; i++) { queues.push_back(std::make_unique<QUEUE>()); }
+}
+
+WORKER_POOL::~WORKER_POOL()
+{
+    Cancel();
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (std::thread& thread : threads) { thread.join(); }
+}
+
+void WORKER_POOL::SetTarget(HWND hWnd, UINT message)
+{
+    bool announce;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        target         = hWnd;
+        target_message = message;
+
+        // Results that came before there was a window
+        announce  = hWnd && !announced && !completions.empty();
+        announced = announced || announce;
+    }
+    if (announce && !PostMessage(hWnd, message, 0, 0))
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        announced = false;
+    }
+}
+
+void WORKER_POOL::Start()
+{
+    for (size_t i = 0; i < thread_count; i++) { threads.emplace_back(&WORKER_POOL::Work, this, i); }
+}
+
+void WORKER_POOL::Push(std::unique_ptr<TASK> task)
+{
+    std::call_once(started, &WORKER_POOL::Start, this);
+
+    // Workers keep what they spawn, everybody else deals the tasks out
+    size_t index = t_pool == this ? t_index : next_queue.fetch_add(1, std::memory_order_relaxed) % thread_count;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+        pending.fetch_add(1, std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+    }
+    idle.notify_one();
+}
+
+std::unique_ptr<WORKER_POOL::TASK> WORKER_POOL::Pop(size_t index)
+{
+    // Newest of our own first, it is most likely still in the cache
+    {
+        QUEUE& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            std::unique_ptr<TASK> task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+
+    // Oldest of somebody else
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        QUEUE& victim = *queues[(index + i) % thread_count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            std::unique_ptr<TASK> task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void WORKER_POOL::Work(size_t index)
+{
+    t_pool  = this;
+    t_index = index;
+    for (;;)
+    {
+        std::unique_ptr<TASK> task = Pop(index);
+        if (!task)
+        {
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            idle.wait(lock, [this] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+            if (stopping) { return; }
+            continue;
+        }
+
+        if (task->generation != generation.load(std::memory_order_relaxed))
+        {
+            cancelled.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        TRACE_SPAN("WORKER_POOL task");
+        task->Run();
+    }
+}
+
+void WORKER_POOL::Complete(std::unique_ptr<TASK> completion)
+{
+    HWND hWnd;
+    UINT message;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        if (completion->generation != generation.load(std::memory_order_relaxed))
+        {
+            cancelled.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // One message for everything that waits until RunCompletions takes it
+        completions.push_back(std::move(completion));
+        if (announced || !target) { return; }
+        announced = true;
+        hWnd      = target;
+        message   = target_message;
+    }
+
+    // The queue may be full (10,000 posted messages). The next result tries again
+    if (!PostMessage(hWnd, message, 0, 0))
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        announced = false;
+    }
+}
+
+void WORKER_POOL::ParallelFor(size_t count, const std::function<void(size_t)>& work)
+{
+    // Shared with the helper tasks. One that starts after everything is done finds nothing left and never touches work
+    struct JOB
+    {
+        const std::function<void(size_t)>* work;
+        size_t                  count;
+        std::atomic<size_t>     next{0};
+        std::atomic<size_t>     left;
+        std::mutex              mutex;
+        std::condition_variable done;
+    };
+    auto job = std::make_shared<JOB>();
+    job->work  = &work;
+    job->count = count;
+    job->left  = count;
+
+    // Indices are handed out one at a time, a slow one does not hold up the others
+    auto run = [](JOB& job)
+    {
+        for (size_t i = job.next++; i < job.count; i = job.next++)
+        {
+            (*job.work)(i);
+            if (--job.left == 0)
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.done.notify_all();
+            }
+        }
+    };
+    const uint64_t job_generation = generation.load(std::memory_order_relaxed);
+    for (size_t i = 1; i < std::min(count, thread_count + 1); i++) { Push(MakeTask(job_generation, [job, run] { run(*job); })); }
+    run(*job);
+
+    // Only the indices a worker has started are left, none is waiting in a queue
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->done.wait(lock, [&job] { return job->left == 0; });
+}
+
+size_t WORKER_POOL::RunCompletions()
+{
+    std::vector<std::unique_ptr<TASK>> ready;
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        ready.swap(completions);
+        announced = false;
+    }
+
+    size_t ran = 0;
+    for (std::unique_ptr<TASK>& completion : ready)
+    {
+        // Cancel may have been called by an earlier done function
+        if (completion->generation != generation.load(std::memory_order_relaxed))
+        {
+            cancelled.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        completion->Run();
+        ran++;
+    }
+    completed.fetch_add(ran, std::memory_order_relaxed);
+    return ran;
+}
+
+void WORKER_POOL::Cancel()
+{
+    generation.fetch_add(1, std::memory_order_relaxed);
+
+    size_t dropped = 0;
+    for (auto& queue : queues)
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        dropped += queue->tasks.size();
+        pending.fetch_sub(queue->tasks.size(), std::memory_order_relaxed);
+        queue->tasks.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(completions_mutex);
+        dropped += completions.size();
+        completions.clear();
+        announced = false;   // the message may never come, e.g. the window is gone. One more costs an empty RunCompletions
+    }
+    cancelled.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+WORKER_POOL::STATS WORKER_POOL::GetStats() const
+{
+    STATS stats     = {};
+    stats.threads   = thread_count;
+    stats.submitted = submitted.load(std::memory_order_relaxed);
+    stats.completed = completed.load(std::memory_order_relaxed);
+    stats.cancelled = cancelled.load(std::memory_order_relaxed);
+    stats.stolen    = stolen.load(std::memory_order_relaxed);
+    return stats;
+}
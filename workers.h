@@ -0,0 +1,172 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+#include "platform.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+Background threads for work that would freeze the window.
+
+    workers.Submit([payload] { return HISTORY::Hash(*payload); },        // runs on a worker
+                   [this, payload](uint64_t hash) { ... });              // runs on the UI thread
+
+The result is handed back through the message given to SetTarget. The window procedure calls RunCompletions for it, which runs the done functions on the UI thread.
+One message is posted for any number of results that are waiting. If posting fails (full queue, no target yet) the next result or SetTarget posts again.
+
+Every worker has its own deque. Tasks submitted by a worker go to its own deque, tasks from other threads are dealt out round robin.
+A worker takes its newest task first and steals the oldest one of another worker when it runs out.
+The threads are started with the first Submit.
+
+ParallelFor splits one job over the workers and the calling thread and returns when it is done, e.g. to decompress the blocks of a big text.
+The caller takes part, so it never waits for a worker that is busy with something else, and a worker of the pool may call it too.
+
+Cancel drops everything that has not started and every result that was not delivered yet (e.g. when the window is destroyed).
+Work that takes a while can take a const WORKER_POOL::CANCEL& and stop early when Requested() is true.
+*/
+class WORKER_POOL
+{
+public:
+
+    struct STATS
+    {
+        size_t threads;     // started with the first Submit
+        size_t submitted;
+        size_t completed;   // done functions that ran
+        size_t cancelled;   // tasks or results dropped by Cancel
+        size_t stolen;      // tasks a worker took from the deque of another one
+    };
+
+    class CANCEL
+    {
+    public:
+        bool Requested() const { return pool.generation.load(std::memory_order_relaxed) != generation; }
+    private:
+        friend class WORKER_POOL;
+        CANCEL(const WORKER_POOL& pool, uint64_t generation) : pool(pool), generation(generation) {}
+        const WORKER_POOL& pool;
+        uint64_t           generation;
+    };
+
+    // threads = 0 uses one thread less than there are cores, at least one
+    explicit WORKER_POOL(size_t threads = 0);
+    ~WORKER_POOL();
+
+    WORKER_POOL(const WORKER_POOL&) = delete;
+    WORKER_POOL& operator=(const WORKER_POOL&) = delete;
+
+    // Window and message the results are announced with
+    void SetTarget(HWND hWnd, UINT message);
+
+    // Runs work on a worker and done(result) on the thread that calls RunCompletions
+    template<class WORK, class DONE>
+    void Submit(WORK work, DONE done)
+    {
+        const uint64_t task_generation = generation.load(std::memory_order_relaxed);
+        submitted.fetch_add(1, std::memory_order_relaxed);
+        Push(MakeTask(task_generation, [this, task_generation, work = std::move(work), done = std::move(done)]() mutable
+        {
+            CANCEL cancel(*this, task_generation);
+            if constexpr (std::is_void_v<decltype(Invoke(work, cancel))>)
+            {
+                Invoke(work, cancel);
+                Complete(MakeTask(task_generation, std::move(done)));
+            }
+            else
+            {
+                auto result = Invoke(work, cancel);
+                Complete(MakeTask(task_generation, [done = std::move(done), result = std::move(result)]() mutable { done(std::move(result)); }));
+            }
+        }));
+    }
+
+    // Runs work(i) for every i below count on the calling thread and the workers that are idle. Returns when all of them are done
+    void ParallelFor(size_t count, const std::function<void(size_t)>& work);
+
+    // Runs the done functions of the finished tasks. Call it on the UI thread for the message given to SetTarget. Returns how many ran
+    size_t RunCompletions();
+
+    void Cancel();
+
+    STATS GetStats() const;
+
+private:
+
+    struct TASK
+    {
+        explicit TASK(uint64_t generation) : generation(generation) {}
+        virtual ~TASK() = default;
+        virtual void Run() = 0;
+        uint64_t generation;
+    };
+
+    template<class F>
+    struct CALL : TASK
+    {
+        CALL(uint64_t generation, F&& function) : TASK(generation), function(std::move(function)) {}
+        void Run() override { function(); }
+        F function;
+    };
+
+    template<class F>
+    static std::unique_ptr<TASK> MakeTask(uint64_t generation, F function)
+    {
+        return std::make_unique<CALL<F>>(generation, std::move(function));
+    }
+
+    template<class WORK>
+    static decltype(auto) Invoke(WORK& work, const CANCEL& cancel)
+    {
+        if constexpr (std::is_invocable_v<WORK&, const CANCEL&>) { return work(cancel); }
+        else { return work(); }
+    }
+
+    struct alignas(64) QUEUE
+    {
+        std::mutex                        mutex;
+        std::deque<std::unique_ptr<TASK>> tasks;
+    };
+
+    void Start();
+    void Push(std::unique_ptr<TASK> task);
+    std::unique_ptr<TASK> Pop(size_t index);
+    void Work(size_t index);
+    void Complete(std::unique_ptr<TASK> completion);
+
+    const size_t               thread_count;
+    std::vector<std::unique_ptr<QUEUE>> queues;
+    std::vector<std::thread>   threads;
+    std::once_flag             started;
+    std::atomic<size_t>        next_queue{0};
+
+    // Sleeping workers wait here until pending is not 0
+    std::mutex                 idle_mutex;
+    std::condition_variable    idle;
+    std::atomic<size_t>        pending{0};
+    bool                       stopping = false;
+
+    // Bumped by Cancel. Tasks and results of an older generation are dropped
+    std::atomic<uint64_t>      generation{0};
+
+    std::mutex                          completions_mutex;
+    std::vector<std::unique_ptr<TASK>>  completions;
+    HWND                                target         = NULL;
+    UINT                                target_message = 0;
+    bool                                announced      = false;   // a message is posted and RunCompletions has not run for it yet
+
+    std::atomic<size_t> submitted{0};
+    std::atomic<size_t> completed{0};
+    std::atomic<size_t> cancelled{0};
+    std::atomic<size_t> stolen{0};
+};
+
+#endif // WORKERS_H